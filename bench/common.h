@@ -0,0 +1,161 @@
+#pragma once
+
+// Shared by the benchmark tools in this directory: the defaults main.js
+// uses for -p, the clock of the "frame" stamps, just enough JSON to read the
+// metadata, the checksum and seq stamp of synthetic frames and the stats
+// line format of stats-logger.js.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <time.h>
+
+#include "../fdpass/histogram.h"
+
+namespace bench {
+
+// main.js: -p <port> means these two
+constexpr const char *kFdSockDir = "/tmp/electron-hwaccel";
+
+inline std::string fd_socket_for_port(int port) {
+  return std::string(kFdSockDir) + "/" + std::to_string(port) + ".sock";
+}
+
+inline std::string zmq_endpoint_for_port(int port) {
+  return "tcp://127.0.0.1:" + std::to_string(port);
+}
+
+constexpr int kStatsIntervalUs = 3000000;
+
+// CLOCK_MONOTONIC in microseconds, the clock of every stamp in the metadata
+// (process.hrtime() on the Electron side).
+inline int64_t now_us() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// "1920x1080"
+inline bool parse_size(const char *text, int *width, int *height) {
+  char *end = nullptr;
+  long w = std::strtol(text, &end, 10);
+  if (end == text || (*end != 'x' && *end != 'X')) return false;
+  const char *rest = end + 1;
+  long h = std::strtol(rest, &end, 10);
+  if (end == rest || *end != '\0' || w <= 0 || h <= 0 || w > 16384 || h > 16384) return false;
+  *width = static_cast<int>(w);
+  *height = static_cast<int>(h);
+  return true;
+}
+
+// Numeric value of the first "key": in a JSON text; false if it is missing
+// or not a number (null). Enough for the flat fields of the metadata without
+// a JSON library.
+inline bool json_number(const std::string &json, const char *key, double *value) {
+  const std::string needle = std::string("\"") + key + "\":";
+  size_t pos = json.find(needle);
+  if (pos == std::string::npos) return false;
+  const char *start = json.c_str() + pos + needle.size();
+  char *end = nullptr;
+  double v = std::strtod(start, &end);
+  if (end == start) return false;
+  *value = v;
+  return true;
+}
+
+// The object value of the first "key": in a JSON text, braces included, or
+// an empty string. Strings inside it must not contain braces.
+inline std::string json_object(const std::string &json, const char *key) {
+  const std::string needle = std::string("\"") + key + "\":{";
+  size_t start = json.find(needle);
+  if (start == std::string::npos) return std::string();
+  start += needle.size() - 1;
+  int depth = 0;
+  for (size_t i = start; i < json.size(); ++i) {
+    if (json[i] == '{') {
+      ++depth;
+    } else if (json[i] == '}' && --depth == 0) {
+      return json.substr(start, i - start + 1);
+    }
+  }
+  return std::string();
+}
+
+// Value of the first "key":"..." in a JSON text, without unescaping.
+inline bool json_string(const std::string &json, const char *key, std::string *value) {
+  const std::string needle = std::string("\"") + key + "\":\"";
+  size_t start = json.find(needle);
+  if (start == std::string::npos) return false;
+  start += needle.size();
+  size_t end = json.find('"', start);
+  if (end == std::string::npos) return false;
+  *value = json.substr(start, end - start);
+  return true;
+}
+
+// Checksum of the visible pixels of a synthetic frame, row by row so that
+// stride padding does not count. Both sides must agree, it is not meant to
+// be anything beyond that.
+inline uint64_t frame_checksum(const uint8_t *pixels, size_t stride, size_t row_bytes, int height) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (int y = 0; y < height; ++y) {
+    const uint8_t *row = pixels + static_cast<size_t>(y) * stride;
+    size_t x = 0;
+    for (; x + 8 <= row_bytes; x += 8) {
+      uint64_t word;
+      std::memcpy(&word, row + x, 8);
+      hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    for (; x < row_bytes; ++x) hash = (hash ^ row[x]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// Synthetic frames carry the low 32 bits of their seq in the top left
+// corner, one 8x8 BGRA cell per bit (white set, black clear), so a consumer
+// can tell from the pixels alone which frame a buffer holds.
+constexpr int kStampBits = 32;
+constexpr int kStampCell = 8;
+
+inline bool has_stamp(int width, int height) {
+  return width >= kStampBits * kStampCell && height >= kStampCell;
+}
+
+inline void write_stamp(uint8_t *pixels, size_t stride, uint64_t seq) {
+  for (int y = 0; y < kStampCell; ++y) {
+    uint8_t *row = pixels + static_cast<size_t>(y) * stride;
+    for (int bit = 0; bit < kStampBits; ++bit) {
+      std::memset(row + bit * kStampCell * 4, (seq >> bit) & 1 ? 0xff : 0x00, kStampCell * 4);
+    }
+  }
+}
+
+// Samples the middle of every cell, so scaling or dithering at the edges
+// does not flip bits.
+inline uint32_t read_stamp(const uint8_t *pixels, size_t stride) {
+  const uint8_t *row = pixels + static_cast<size_t>(kStampCell / 2) * stride;
+  uint32_t seq = 0;
+  for (int bit = 0; bit < kStampBits; ++bit) {
+    if (row[(bit * kStampCell + kStampCell / 2) * 4 + 1] >= 0x80) seq |= 1u << bit;
+  }
+  return seq;
+}
+
+// stats-logger.js format
+inline std::string format_histogram(const char *name, const fdpass::Histogram &histogram) {
+  const fdpass::Histogram::Snapshot s = histogram.Take();
+  char text[256];
+  if (s.count == 0) {
+    std::snprintf(text, sizeof(text), "%s_us -", name);
+  } else {
+    std::snprintf(text, sizeof(text), "%s_us p50=%llu p90=%llu p99=%llu p99.9=%llu max=%llu", name,
+                  static_cast<unsigned long long>(s.p50), static_cast<unsigned long long>(s.p90),
+                  static_cast<unsigned long long>(s.p99), static_cast<unsigned long long>(s.p999),
+                  static_cast<unsigned long long>(s.max));
+  }
+  return text;
+}
+
+} // namespace bench
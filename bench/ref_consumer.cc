@@ -0,0 +1,509 @@
+// Reference consumer: the receiving side of one output, for end to end
+// benchmarks with main.js or synth-producer and as a starting point for
+// encoders. It listens on the output's fd socket and binds its ZMQ
+// endpoint, receives the frame fds on a thread of their own, pairs each
+// metadata message with its fd and replies with {"receivedUs": ...}, so the
+// producer's stats include the receive stage too.
+//
+// Pairing follows the producer's ordering: an fd is always sent before the
+// metadata of its frame, and a frame whose fd was not sent has a null
+// "fdSentUs", so every metadata message with an fdSentUs takes the oldest
+// fd received. Fds received before the frame's "paintUs", the last stamp
+// before its fd went out, belong to frames whose metadata never came (a
+// consumer that was there for the fd but not yet for the metadata) and are
+// dropped first.
+//
+// With --map every frame is mmap()ed and checksummed between
+// DMA_BUF_IOCTL_SYNC calls, the CPU read path of an encoder. Pooled buffers
+// come back with a new fd every time, so mappings are kept per buffer
+// (inode) like CudaDmaBufImportCache keeps CUDA imports. Frames from
+// synth-producer are also checked against their seq stamp and checksum.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <zmq.h>
+
+#include "common.h"
+
+namespace {
+
+constexpr int kPollIntervalMs = 250;
+// The fd of a frame is sent before its metadata, but may be read later
+constexpr int kFdWaitMs = 100;
+// Pool buffers kept mapped; Electron and synth-producer cycle through fewer
+constexpr size_t kMaxMappings = 32;
+// Fds nobody asked for (metadata lost) are dropped beyond this many
+constexpr size_t kMaxQueuedFds = 64;
+constexpr size_t kMaxMessage = 64 * 1024;
+
+struct Options {
+  std::string fd_socket;
+  std::string zmq_endpoint;
+  std::string name = "consumer";
+  bool map = false;
+  int fps = 0;
+  uint64_t frames = 0;
+};
+
+std::atomic<bool> g_running{true};
+
+void on_signal(int) { g_running = false; }
+
+void usage() {
+  std::fprintf(stderr,
+               "usage: ref-consumer (-p <port> | --fd-socket <path> --zmq-endpoint <endpoint>)\n"
+               "       [--name <name>] [--map] [--fps N (asked of the producer)] [--frames N]\n");
+}
+
+bool parse_options(int argc, char **argv, Options *options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--map") {
+      options->map = true;
+      continue;
+    }
+    if (i + 1 >= argc) return false;
+    const char *value = argv[++i];
+    if (arg == "-p") {
+      int port = std::atoi(value);
+      if (port <= 0 || port > 65535) return false;
+      options->fd_socket = bench::fd_socket_for_port(port);
+      options->zmq_endpoint = bench::zmq_endpoint_for_port(port);
+    } else if (arg == "--fd-socket") {
+      options->fd_socket = value;
+    } else if (arg == "--zmq-endpoint") {
+      options->zmq_endpoint = value;
+    } else if (arg == "--name") {
+      options->name = value;
+    } else if (arg == "--fps") {
+      // The range output.js accepts
+      options->fps = std::atoi(value);
+      if (options->fps < 1 || options->fps > 240) return false;
+    } else if (arg == "--frames") {
+      options->frames = std::strtoull(value, nullptr, 10);
+    } else {
+      return false;
+    }
+  }
+  return !options->fd_socket.empty() && !options->zmq_endpoint.empty();
+}
+
+// Accepts one producer at a time on the fd socket and queues the fds it
+// sends, in order, with the time they were received.
+class FdReceiver {
+ public:
+  ~FdReceiver() {
+    stop();
+    for (const Received &received : fds_) close(received.fd);
+  }
+
+  bool listen(const std::string &path) {
+    path_ = path;
+    const size_t slash = path.rfind('/');
+    if (slash != std::string::npos && slash > 0) mkdir(path.substr(0, slash).c_str(), 0755);
+    unlink(path.c_str());
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (listen_fd_ < 0 || path.size() >= sizeof(addr.sun_path)) return false;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(listen_fd_, 1) < 0) {
+      return false;
+    }
+    thread_ = std::thread([this] { run(); });
+    return true;
+  }
+
+  void stop() {
+    if (thread_.joinable()) thread_.join();
+    if (listen_fd_ >= 0) {
+      close(listen_fd_);
+      unlink(path_.c_str());
+    }
+    listen_fd_ = -1;
+  }
+
+  // The oldest fd received at or after |not_before_us|, or -1 if none
+  // arrives within |timeout_ms|. Older fds are closed on the way.
+  int take(int64_t not_before_us, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto ready = [this, not_before_us] {
+      while (!fds_.empty() && fds_.front().us < not_before_us) {
+        close(fds_.front().fd);
+        fds_.pop_front();
+        stale++;
+      }
+      return !fds_.empty();
+    };
+    if (!ready_.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready)) return -1;
+    int fd = fds_.front().fd;
+    fds_.pop_front();
+    return fd;
+  }
+
+  std::atomic<uint64_t> received{0};
+  std::atomic<uint64_t> discarded{0};
+  // Fds older than the frame that asked for one
+  std::atomic<uint64_t> stale{0};
+  std::atomic<uint64_t> connections{0};
+
+ private:
+  void run() {
+    while (g_running) {
+      if (!wait_readable(listen_fd_)) continue;
+      int sock = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (sock < 0) continue;
+      connections++;
+      while (g_running) {
+        if (!wait_readable(sock)) continue;
+        if (!receive(sock)) break;
+      }
+      close(sock);
+    }
+  }
+
+  bool wait_readable(int fd) {
+    pollfd pfd{fd, POLLIN, 0};
+    return poll(&pfd, 1, kPollIntervalMs) > 0;
+  }
+
+  // One sendFd() message: a single byte and its fd. False once the
+  // producer has gone.
+  bool receive(int sock) {
+    char byte;
+    // Room for a few fds, in case a sender batches them
+    char control[CMSG_SPACE(sizeof(int) * 4)];
+    iovec iov{&byte, 1};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) return true;
+    if (n <= 0) return false;
+    const int64_t received_us = bench::now_us();
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+      const size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (size_t i = 0; i < count; ++i) {
+        int fd;
+        std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+        fds_.push_back({fd, received_us});
+        received++;
+      }
+      while (fds_.size() > kMaxQueuedFds) {
+        close(fds_.front().fd);
+        fds_.pop_front();
+        discarded++;
+      }
+      ready_.notify_one();
+    }
+    return true;
+  }
+
+  struct Received {
+    int fd;
+    int64_t us;
+  };
+
+  std::string path_;
+  int listen_fd_ = -1;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<Received> fds_;
+};
+
+// Read mappings of pool buffers, keyed by inode: a dma-buf or memfd keeps
+// its inode whichever fd it arrives on.
+class MappingCache {
+ public:
+  ~MappingCache() {
+    for (auto &entry : mappings_) munmap(entry.second.pixels, entry.second.size);
+  }
+
+  const uint8_t *map(int fd, size_t size) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) return nullptr;
+    auto it = mappings_.find(st.st_ino);
+    if (it != mappings_.end() && it->second.size >= size) return it->second.pixels;
+    if (it != mappings_.end()) {
+      munmap(it->second.pixels, it->second.size);
+      mappings_.erase(it);
+    }
+    if (mappings_.size() >= kMaxMappings) {
+      // Pools are small and cycle, so any entry is as good to drop
+      munmap(mappings_.begin()->second.pixels, mappings_.begin()->second.size);
+      mappings_.erase(mappings_.begin());
+    }
+    void *pixels = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (pixels == MAP_FAILED) return nullptr;
+    mappings_[st.st_ino] = Mapping{static_cast<uint8_t *>(pixels), size};
+    return static_cast<uint8_t *>(pixels);
+  }
+
+ private:
+  struct Mapping {
+    uint8_t *pixels;
+    size_t size;
+  };
+  std::map<ino_t, Mapping> mappings_;
+};
+
+// Cache coherency for CPU reads of a dma-buf; memfds do not know the ioctl.
+void sync_read(int fd, bool start) {
+  dma_buf_sync sync{};
+  sync.flags = DMA_BUF_SYNC_READ | (start ? DMA_BUF_SYNC_START : DMA_BUF_SYNC_END);
+  while (ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync) < 0 && (errno == EINTR || errno == EAGAIN)) {
+  }
+}
+
+struct Totals {
+  uint64_t frames = 0;
+  // Metadata that announced an fd which never arrived
+  uint64_t unpaired = 0;
+  // Frames the producer stamped but that never got here
+  uint64_t gaps = 0;
+  uint64_t map_errors = 0;
+  uint64_t stamp_errors = 0;
+  uint64_t checksum_errors = 0;
+};
+
+struct Stats {
+  fdpass::Histogram received;
+  fdpass::Histogram fd_sent;
+  fdpass::Histogram metadata_sent;
+  fdpass::Histogram fd_wait;
+  fdpass::Histogram map;
+  fdpass::Histogram interval;
+  uint64_t frames = 0;
+  uint64_t bytes = 0;
+
+  void reset() {
+    for (fdpass::Histogram *h : {&received, &fd_sent, &metadata_sent, &fd_wait, &map, &interval}) h->Reset();
+    frames = 0;
+    bytes = 0;
+  }
+};
+
+void print_stats(const Options &options, const Stats &stats, const Totals &totals, const FdReceiver &receiver,
+                 double elapsed_s) {
+  const double fps = elapsed_s > 0 ? stats.frames / elapsed_s : 0;
+  const fdpass::Histogram::Snapshot interval = stats.interval.Take();
+  std::string jitter = interval.count > 0 ? " jitter=" + std::to_string(static_cast<long long>(interval.stddev)) : "";
+  std::printf(
+      "[%s] Receive stats: %llu frames in %.1fs = %.1f fps (%.0f MB/s mapped), total frames=%llu fds=%llu "
+      "discarded=%llu stale=%llu connections=%llu unpaired=%llu gaps=%llu map_errors=%llu stamp_errors=%llu checksum_errors=%llu, %s%s, %s, "
+      "%s, %s, %s, %s\n",
+      options.name.c_str(), static_cast<unsigned long long>(stats.frames), elapsed_s, fps,
+      elapsed_s > 0 ? stats.bytes / 1e6 / elapsed_s : 0, static_cast<unsigned long long>(totals.frames),
+      static_cast<unsigned long long>(receiver.received.load()),
+      static_cast<unsigned long long>(receiver.discarded.load()),
+      static_cast<unsigned long long>(receiver.stale.load()),
+      static_cast<unsigned long long>(receiver.connections.load()), static_cast<unsigned long long>(totals.unpaired),
+      static_cast<unsigned long long>(totals.gaps), static_cast<unsigned long long>(totals.map_errors),
+      static_cast<unsigned long long>(totals.stamp_errors), static_cast<unsigned long long>(totals.checksum_errors),
+      bench::format_histogram("interval", stats.interval).c_str(), jitter.c_str(),
+      bench::format_histogram("swap>received", stats.received).c_str(),
+      bench::format_histogram("fdSent>received", stats.fd_sent).c_str(),
+      bench::format_histogram("metadataSent>received", stats.metadata_sent).c_str(),
+      bench::format_histogram("fdWait", stats.fd_wait).c_str(), bench::format_histogram("map", stats.map).c_str());
+  std::fflush(stdout);
+}
+
+// What the consumer needs from one metadata message
+struct Frame {
+  double seq = -1;
+  double swap_us = -1;
+  double paint_us = -1;
+  double fd_sent_us = -1;
+  double metadata_sent_us = -1;
+  int width = 0;
+  int height = 0;
+  size_t stride = 0;
+  size_t offset = 0;
+  size_t size = 0;
+  bool synthetic = false;
+  std::string checksum;
+};
+
+Frame parse_frame(const std::string &json) {
+  Frame frame;
+  const std::string stamps = bench::json_object(json, "frame");
+  bench::json_number(stamps, "seq", &frame.seq);
+  bench::json_number(stamps, "swapUs", &frame.swap_us);
+  bench::json_number(stamps, "paintUs", &frame.paint_us);
+  bench::json_number(stamps, "fdSentUs", &frame.fd_sent_us);
+  bench::json_number(stamps, "metadataSentUs", &frame.metadata_sent_us);
+  const std::string coded = bench::json_object(json, "codedSize");
+  double value;
+  if (bench::json_number(coded, "width", &value)) frame.width = static_cast<int>(value);
+  if (bench::json_number(coded, "height", &value)) frame.height = static_cast<int>(value);
+  const size_t planes = json.find("\"planes\":");
+  if (planes != std::string::npos) {
+    const std::string plane = json.substr(planes);
+    if (bench::json_number(plane, "stride", &value)) frame.stride = static_cast<size_t>(value);
+    if (bench::json_number(plane, "offset", &value)) frame.offset = static_cast<size_t>(value);
+    if (bench::json_number(plane, "size", &value)) frame.size = static_cast<size_t>(value);
+  }
+  const std::string synthetic = bench::json_object(json, "synthetic");
+  frame.synthetic = !synthetic.empty();
+  bench::json_string(synthetic, "checksum", &frame.checksum);
+  return frame;
+}
+
+// Maps and checksums one frame; checks synthetic frames against their
+// stamp and checksum.
+void read_frame(const Frame &frame, int fd, MappingCache *mappings, Totals *totals, Stats *stats) {
+  const size_t row_bytes = static_cast<size_t>(frame.width) * 4;
+  if (frame.stride < row_bytes || frame.height <= 0) {
+    totals->map_errors++;
+    return;
+  }
+  const size_t size = frame.offset + std::max(frame.size, frame.stride * static_cast<size_t>(frame.height));
+  const int64_t start_us = bench::now_us();
+  const uint8_t *base = mappings->map(fd, size);
+  if (!base) {
+    totals->map_errors++;
+    return;
+  }
+  const uint8_t *pixels = base + frame.offset;
+  sync_read(fd, true);
+  const uint64_t checksum = bench::frame_checksum(pixels, frame.stride, row_bytes, frame.height);
+  const uint32_t stamp = frame.synthetic && bench::has_stamp(frame.width, frame.height)
+                             ? bench::read_stamp(pixels, frame.stride)
+                             : 0;
+  sync_read(fd, false);
+  stats->map.Record(bench::now_us() - start_us);
+  stats->bytes += frame.stride * static_cast<size_t>(frame.height);
+  if (!frame.synthetic) return;
+  if (bench::has_stamp(frame.width, frame.height) && stamp != static_cast<uint32_t>(static_cast<uint64_t>(frame.seq))) {
+    totals->stamp_errors++;
+  }
+  if (!frame.checksum.empty() && std::strtoull(frame.checksum.c_str(), nullptr, 16) != checksum) {
+    totals->checksum_errors++;
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse_options(argc, argv, &options)) {
+    usage();
+    return 2;
+  }
+  std::signal(SIGINT, on_signal);
+  std::signal(SIGTERM, on_signal);
+  std::signal(SIGPIPE, SIG_IGN);
+
+  FdReceiver receiver;
+  if (!receiver.listen(options.fd_socket)) {
+    std::fprintf(stderr, "[%s] cannot listen on %s: %s\n", options.name.c_str(), options.fd_socket.c_str(),
+                 std::strerror(errno));
+    return 1;
+  }
+  void *zmq_context = zmq_ctx_new();
+  void *reply = zmq_socket(zmq_context, ZMQ_REP);
+  const int linger = 0;
+  const int timeout = kPollIntervalMs;
+  zmq_setsockopt(reply, ZMQ_LINGER, &linger, sizeof(linger));
+  zmq_setsockopt(reply, ZMQ_RCVTIMEO, &timeout, sizeof(timeout));
+  if (zmq_bind(reply, options.zmq_endpoint.c_str()) < 0) {
+    std::fprintf(stderr, "[%s] cannot bind %s: %s\n", options.name.c_str(), options.zmq_endpoint.c_str(),
+                 zmq_strerror(zmq_errno()));
+    g_running = false;
+    return 1;
+  }
+  std::printf("[%s] fds on %s, metadata on %s%s\n", options.name.c_str(), options.fd_socket.c_str(),
+              options.zmq_endpoint.c_str(), options.map ? ", mapping frames" : "");
+  std::fflush(stdout);
+
+  MappingCache mappings;
+  Totals totals;
+  Stats stats;
+  std::vector<char> message(kMaxMessage);
+  int64_t stats_start_us = bench::now_us();
+  int64_t last_received_us = -1;
+  double last_seq = -1;
+  bool send_fps = options.fps > 0;
+
+  while (g_running && (options.frames == 0 || totals.frames < options.frames)) {
+    const int n = zmq_recv(reply, message.data(), message.size(), 0);
+    const int64_t received_us = bench::now_us();
+    if (received_us - stats_start_us >= bench::kStatsIntervalUs) {
+      print_stats(options, stats, totals, receiver, (received_us - stats_start_us) / 1e6);
+      stats.reset();
+      stats_start_us = received_us;
+    }
+    if (n < 0) continue;
+    const std::string json(message.data(), std::min(static_cast<size_t>(n), message.size()));
+    const Frame frame = parse_frame(json);
+    totals.frames++;
+    stats.frames++;
+
+    if (frame.seq >= 0) {
+      if (last_seq >= 0 && frame.seq > last_seq + 1) totals.gaps += static_cast<uint64_t>(frame.seq - last_seq - 1);
+      // A restarted producer counts from 1 again and forgot the rate
+      if (last_seq >= 0 && frame.seq <= last_seq) send_fps = options.fps > 0;
+      last_seq = frame.seq;
+    }
+    if (frame.swap_us >= 0) stats.received.Record(received_us - static_cast<int64_t>(frame.swap_us));
+    if (frame.fd_sent_us >= 0) stats.fd_sent.Record(received_us - static_cast<int64_t>(frame.fd_sent_us));
+    if (frame.metadata_sent_us >= 0) {
+      stats.metadata_sent.Record(received_us - static_cast<int64_t>(frame.metadata_sent_us));
+    }
+    if (last_received_us >= 0) stats.interval.Record(received_us - last_received_us);
+    last_received_us = received_us;
+
+    // Reply first, the producer waits for it before the next metadata
+    std::string answer = "{\"receivedUs\":" + std::to_string(received_us);
+    if (send_fps) answer += ",\"fps\":" + std::to_string(options.fps);
+    answer += "}";
+    send_fps = false;
+    zmq_send(reply, answer.data(), answer.size(), 0);
+
+    if (frame.fd_sent_us < 0) continue;
+    const int fd = receiver.take(static_cast<int64_t>(frame.paint_us), kFdWaitMs);
+    stats.fd_wait.Record(bench::now_us() - received_us);
+    if (fd < 0) {
+      totals.unpaired++;
+      continue;
+    }
+    if (options.map) read_frame(frame, fd, &mappings, &totals, &stats);
+    close(fd);
+  }
+
+  print_stats(options, stats, totals, receiver, (bench::now_us() - stats_start_us) / 1e6);
+  g_running = false;
+  receiver.stop();
+  zmq_close(reply);
+  zmq_ctx_term(zmq_context);
+  return 0;
+}
@@ -0,0 +1,627 @@
+// Synthetic frame producer for benchmarking consumers without Electron, a
+// GPU or a page to render. It stands in for one output of main.js: frames
+// are BGRA buffers from a small pool of memfds or udmabufs, filled with a
+// test pattern at a fixed rate, and each one is published exactly like the
+// forwarding thread does it: the buffer fd over the output's UNIX socket
+// (one SCM_RIGHTS message with a single byte, as fdpass' sendFd()), then the
+// texture JSON with the "frame" stamps as a ZMQ request, waiting for the
+// reply. Replies with "receivedUs" count towards the swap-to-receive
+// latency, like in the Electron stats.
+//
+// Every frame has its seq stamped into the pixels (see write_stamp()); with
+// --checksum the metadata also carries a checksum of the whole frame.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <linux/udmabuf.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <zmq.h>
+
+#include "common.h"
+
+namespace {
+
+// How often a missing consumer is looked for, like the output's probe
+constexpr int64_t kProbeIntervalUs = 250000;
+constexpr int64_t kWarnIntervalUs = 3000000;
+// A consumer slower than this to reply loses the frame's metadata
+constexpr int kReplyTimeoutMs = 1000;
+// GBM and the GPU drivers align rows at least this much
+constexpr size_t kStrideAlign = 64;
+
+enum class Backing { kMemfd, kUdmabuf };
+enum class Pattern { kBars, kGradient, kNoise };
+enum class Fill { kStamp, kFull };
+
+struct Options {
+  std::string fd_socket;
+  std::string zmq_endpoint;
+  std::string name = "synth";
+  int width = 1920;
+  int height = 1080;
+  double fps = 60;
+  uint64_t frames = 0;
+  int buffers = 4;
+  Backing backing = Backing::kMemfd;
+  Pattern pattern = Pattern::kBars;
+  Fill fill = Fill::kStamp;
+  bool checksum = false;
+};
+
+// One pooled frame. |fd| is what goes over the socket: the memfd itself or
+// the udmabuf made from it; the pixels are written through the memfd.
+struct Buffer {
+  int memfd = -1;
+  int fd = -1;
+  uint8_t *pixels = nullptr;
+  size_t mapped = 0;
+};
+
+std::atomic<bool> g_running{true};
+
+void on_signal(int) { g_running = false; }
+
+void usage() {
+  std::fprintf(stderr,
+               "usage: synth-producer (-p <port> | --fd-socket <path> --zmq-endpoint <endpoint>)\n"
+               "       [--name <name>] [--size WxH] [--fps N (0: as fast as possible)] [--frames N]\n"
+               "       [--buffers N] [--backing memfd|udmabuf] [--pattern bars|gradient|noise]\n"
+               "       [--fill stamp|full] [--checksum]\n");
+}
+
+bool parse_options(int argc, char **argv, Options *options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--checksum") {
+      options->checksum = true;
+      continue;
+    }
+    if (i + 1 >= argc) return false;
+    const char *value = argv[++i];
+    if (arg == "-p") {
+      int port = std::atoi(value);
+      if (port <= 0 || port > 65535) return false;
+      options->fd_socket = bench::fd_socket_for_port(port);
+      options->zmq_endpoint = bench::zmq_endpoint_for_port(port);
+    } else if (arg == "--fd-socket") {
+      options->fd_socket = value;
+    } else if (arg == "--zmq-endpoint") {
+      options->zmq_endpoint = value;
+    } else if (arg == "--name") {
+      options->name = value;
+    } else if (arg == "--size") {
+      if (!bench::parse_size(value, &options->width, &options->height)) return false;
+    } else if (arg == "--fps") {
+      options->fps = std::atof(value);
+      if (options->fps < 0) return false;
+    } else if (arg == "--frames") {
+      options->frames = std::strtoull(value, nullptr, 10);
+    } else if (arg == "--buffers") {
+      options->buffers = std::atoi(value);
+      if (options->buffers < 1 || options->buffers > 64) return false;
+    } else if (arg == "--backing") {
+      if (!std::strcmp(value, "memfd")) options->backing = Backing::kMemfd;
+      else if (!std::strcmp(value, "udmabuf")) options->backing = Backing::kUdmabuf;
+      else return false;
+    } else if (arg == "--pattern") {
+      if (!std::strcmp(value, "bars")) options->pattern = Pattern::kBars;
+      else if (!std::strcmp(value, "gradient")) options->pattern = Pattern::kGradient;
+      else if (!std::strcmp(value, "noise")) options->pattern = Pattern::kNoise;
+      else return false;
+    } else if (arg == "--fill") {
+      if (!std::strcmp(value, "stamp")) options->fill = Fill::kStamp;
+      else if (!std::strcmp(value, "full")) options->fill = Fill::kFull;
+      else return false;
+    } else {
+      return false;
+    }
+  }
+  return !options->fd_socket.empty() && !options->zmq_endpoint.empty();
+}
+
+bool allocate_buffer(Backing backing, size_t size, Buffer *buffer) {
+  const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  buffer->mapped = (size + page - 1) / page * page;
+  buffer->memfd = memfd_create("synth-frame", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (buffer->memfd < 0 || ftruncate(buffer->memfd, static_cast<off_t>(buffer->mapped)) < 0) {
+    std::perror("memfd");
+    return false;
+  }
+  buffer->pixels = static_cast<uint8_t *>(
+      mmap(nullptr, buffer->mapped, PROT_READ | PROT_WRITE, MAP_SHARED, buffer->memfd, 0));
+  if (buffer->pixels == MAP_FAILED) {
+    buffer->pixels = nullptr;
+    std::perror("mmap");
+    return false;
+  }
+  if (backing == Backing::kMemfd) {
+    buffer->fd = buffer->memfd;
+    return true;
+  }
+  // udmabuf wants the size fixed and the memfd still writable
+  if (fcntl(buffer->memfd, F_ADD_SEALS, F_SEAL_SHRINK) < 0) {
+    std::perror("F_ADD_SEALS");
+    return false;
+  }
+  int dev = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+  if (dev < 0) {
+    std::perror("/dev/udmabuf");
+    return false;
+  }
+  udmabuf_create create{};
+  create.memfd = static_cast<uint32_t>(buffer->memfd);
+  create.flags = UDMABUF_FLAGS_CLOEXEC;
+  create.offset = 0;
+  create.size = buffer->mapped;
+  buffer->fd = ioctl(dev, UDMABUF_CREATE, &create);
+  close(dev);
+  if (buffer->fd < 0) {
+    std::perror("UDMABUF_CREATE");
+    return false;
+  }
+  return true;
+}
+
+void free_buffer(Buffer *buffer) {
+  if (buffer->pixels) munmap(buffer->pixels, buffer->mapped);
+  if (buffer->fd >= 0 && buffer->fd != buffer->memfd) close(buffer->fd);
+  if (buffer->memfd >= 0) close(buffer->memfd);
+  *buffer = Buffer();
+}
+
+// CPU writes to a dma-buf are bracketed for coherency; a no-op for memfds.
+void sync_write(const Buffer &buffer, bool start) {
+  if (buffer.fd == buffer.memfd) return;
+  dma_buf_sync sync{};
+  sync.flags = DMA_BUF_SYNC_WRITE | (start ? DMA_BUF_SYNC_START : DMA_BUF_SYNC_END);
+  while (ioctl(buffer.fd, DMA_BUF_IOCTL_SYNC, &sync) < 0 && (errno == EINTR || errno == EAGAIN)) {
+  }
+}
+
+// The pattern for frame |seq|; it scrolls with seq, so with --fill full every
+// frame differs everywhere.
+void draw_pattern(Pattern pattern, uint8_t *pixels, size_t stride, int width, int height, uint64_t seq) {
+  const int shift = static_cast<int>((seq * 4) % static_cast<uint64_t>(width));
+  switch (pattern) {
+    case Pattern::kBars: {
+      // White, yellow, cyan, green, magenta, red, blue, black; 0xAARRGGBB
+      // is BGRA in memory
+      static const uint32_t kBars[] = {0xffffffff, 0xffffff00, 0xff00ffff, 0xff00ff00,
+                                       0xffff00ff, 0xffff0000, 0xff0000ff, 0xff000000};
+      uint32_t *first = reinterpret_cast<uint32_t *>(pixels);
+      for (int x = 0; x < width; ++x) first[x] = kBars[((x + shift) % width) * 8 / width];
+      for (int y = 1; y < height; ++y) std::memcpy(pixels + static_cast<size_t>(y) * stride, pixels, width * 4);
+      break;
+    }
+    case Pattern::kGradient:
+      for (int y = 0; y < height; ++y) {
+        uint8_t *row = pixels + static_cast<size_t>(y) * stride;
+        const uint8_t g = static_cast<uint8_t>(y * 255 / height);
+        for (int x = 0; x < width; ++x) {
+          row[x * 4] = static_cast<uint8_t>(((x + shift) % width) * 255 / width);
+          row[x * 4 + 1] = g;
+          row[x * 4 + 2] = static_cast<uint8_t>(255 - g);
+          row[x * 4 + 3] = 0xff;
+        }
+      }
+      break;
+    case Pattern::kNoise: {
+      // xorshift64, incompressible: the worst case for an encoder
+      uint64_t state = seq * 0x9e3779b97f4a7c15ull | 1;
+      for (int y = 0; y < height; ++y) {
+        uint8_t *row = pixels + static_cast<size_t>(y) * stride;
+        for (size_t x = 0; x + 8 <= static_cast<size_t>(width) * 4; x += 8) {
+          state ^= state << 13;
+          state ^= state >> 7;
+          state ^= state << 17;
+          const uint64_t word = state | 0xff000000ff000000ull;
+          std::memcpy(row + x, &word, 8);
+        }
+      }
+      break;
+    }
+  }
+}
+
+// The fd socket side of fdpass: one cached connection, reconnected on
+// failure.
+class FdSender {
+ public:
+  explicit FdSender(std::string path) : path_(std::move(path)) {}
+  ~FdSender() { disconnect(); }
+
+  bool connected() const { return sock_ >= 0; }
+
+  bool connect() {
+    if (sock_ >= 0) return true;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path_.size() >= sizeof(addr.sun_path)) {
+      close(fd);
+      return false;
+    }
+    std::strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+      close(fd);
+      return false;
+    }
+    sock_ = fd;
+    return true;
+  }
+
+  void disconnect() {
+    if (sock_ >= 0) close(sock_);
+    sock_ = -1;
+  }
+
+  bool send(int send_fd) {
+    char dummy = 0;
+    char control[CMSG_SPACE(sizeof(int))];
+    iovec iov{&dummy, 1};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    std::memset(control, 0, sizeof(control));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &send_fd, sizeof(int));
+    if (sendmsg(sock_, &msg, MSG_NOSIGNAL) == 1) return true;
+    disconnect();
+    return false;
+  }
+
+ private:
+  std::string path_;
+  int sock_ = -1;
+};
+
+// Follows the peers of the metadata socket through a socket monitor, like
+// the forwarding thread follows its socket's connect and disconnect events.
+// A peer counts from its completed handshake on, when ZMQ_IMMEDIATE starts
+// to let messages through.
+class PeerMonitor {
+ public:
+  PeerMonitor(void *context, void *socket) : socket_(socket) {
+    const std::string endpoint = "inproc://synth-monitor-" + std::to_string(reinterpret_cast<uintptr_t>(socket));
+    if (zmq_socket_monitor(socket, endpoint.c_str(), ZMQ_EVENT_HANDSHAKE_SUCCEEDED | ZMQ_EVENT_DISCONNECTED) < 0) {
+      return;
+    }
+    pair_ = zmq_socket(context, ZMQ_PAIR);
+    if (zmq_connect(pair_, endpoint.c_str()) < 0) close();
+  }
+  ~PeerMonitor() { close(); }
+
+  bool ok() const { return pair_ != nullptr; }
+
+  // Applies the events so far; true while there is a peer.
+  bool connected() {
+    while (pair_) {
+      zmq_msg_t event;
+      zmq_msg_init(&event);
+      if (zmq_msg_recv(&event, pair_, ZMQ_DONTWAIT) < 0) {
+        zmq_msg_close(&event);
+        break;
+      }
+      // A 16 bit event id and a 32 bit value, then the peer's address
+      uint16_t id = 0;
+      if (zmq_msg_size(&event) >= sizeof(id)) std::memcpy(&id, zmq_msg_data(&event), sizeof(id));
+      zmq_msg_close(&event);
+      zmq_msg_t address;
+      zmq_msg_init(&address);
+      if (zmq_msg_recv(&address, pair_, 0) >= 0) {
+        const std::string text(static_cast<const char *>(zmq_msg_data(&address)), zmq_msg_size(&address));
+        if (id == ZMQ_EVENT_HANDSHAKE_SUCCEEDED) peers_.insert(text);
+        else if (id == ZMQ_EVENT_DISCONNECTED) peers_.erase(text);
+      }
+      zmq_msg_close(&address);
+    }
+    return !peers_.empty();
+  }
+
+  // Before the monitored socket is closed
+  void close() {
+    if (!pair_) return;
+    zmq_socket_monitor(socket_, nullptr, 0);
+    zmq_close(pair_);
+    pair_ = nullptr;
+  }
+
+ private:
+  void *socket_;
+  void *pair_ = nullptr;
+  std::set<std::string> peers_;
+};
+
+// JSON null for stamps that were not taken
+std::string stamp(int64_t us) {
+  return us < 0 ? "null" : std::to_string(us);
+}
+
+// Texture JSON of an offscreen paint as far as consumers read it, plus the
+// synthetic frame description and the forwarding thread's "frame" object.
+std::string metadata(const Options &options, size_t stride, int fd, int buffer, uint64_t seq, int64_t swap_us,
+                     int64_t paint_us, int64_t fd_sent_us, int64_t metadata_sent_us, const char *checksum) {
+  static const char *kPatterns[] = {"bars", "gradient", "noise"};
+  char text[1024];
+  std::snprintf(
+      text, sizeof(text),
+      "{\"textureInfo\":{\"widgetType\":\"frame\",\"pixelFormat\":\"bgra\","
+      "\"codedSize\":{\"width\":%d,\"height\":%d},"
+      "\"visibleRect\":{\"x\":0,\"y\":0,\"width\":%d,\"height\":%d},"
+      "\"contentRect\":{\"x\":0,\"y\":0,\"width\":%d,\"height\":%d},"
+      "\"timestamp\":%lld,\"planes\":[{\"stride\":%zu,\"offset\":0,\"size\":%zu,\"fd\":%d}],\"modifier\":\"0\"},"
+      "\"synthetic\":{\"pattern\":\"%s\",\"buffer\":%d,\"checksum\":%s},"
+      "\"frame\":{\"seq\":%llu,\"swapSequence\":%llu,\"swapUs\":%lld,\"paintUs\":%lld,\"fdSentUs\":%s,"
+      "\"metadataSentUs\":%lld}}",
+      options.width, options.height, options.width, options.height, options.width, options.height,
+      static_cast<long long>(swap_us), stride, stride * static_cast<size_t>(options.height), fd,
+      kPatterns[static_cast<int>(options.pattern)], buffer, checksum, static_cast<unsigned long long>(seq),
+      static_cast<unsigned long long>(seq), static_cast<long long>(swap_us), static_cast<long long>(paint_us),
+      stamp(fd_sent_us).c_str(), static_cast<long long>(metadata_sent_us));
+  return text;
+}
+
+struct Totals {
+  uint64_t frames = 0;
+  uint64_t fds_sent = 0;
+  uint64_t fd_errors = 0;
+  uint64_t metadata_sent = 0;
+  uint64_t metadata_errors = 0;
+  // Ticks without a consumer on the fd socket or the metadata endpoint
+  uint64_t skipped = 0;
+  // Ticks lost because a frame took longer than the frame interval
+  uint64_t late = 0;
+};
+
+struct Stats {
+  fdpass::Histogram paint;
+  fdpass::Histogram interval;
+  fdpass::Histogram fd_sent;
+  fdpass::Histogram metadata_sent;
+  fdpass::Histogram reply;
+  fdpass::Histogram received;
+  uint64_t frames = 0;
+
+  void reset() {
+    for (fdpass::Histogram *h : {&paint, &interval, &fd_sent, &metadata_sent, &reply, &received}) h->Reset();
+    frames = 0;
+  }
+};
+
+void print_stats(const Options &options, const Stats &stats, const Totals &totals, double elapsed_s,
+                 size_t frame_bytes) {
+  const double fps = elapsed_s > 0 ? stats.frames / elapsed_s : 0;
+  const fdpass::Histogram::Snapshot interval = stats.interval.Take();
+  std::string jitter = interval.count > 0 ? " jitter=" + std::to_string(static_cast<long long>(interval.stddev)) : "";
+  std::printf(
+      "[%s] Send stats: %llu frames in %.1fs = %.1f fps (%.0f MB/s), total frames=%llu fds=%llu fd_errors=%llu "
+      "metadata=%llu metadata_errors=%llu skipped=%llu late=%llu, %s, %s%s, %s, %s, %s, %s\n",
+      options.name.c_str(), static_cast<unsigned long long>(stats.frames), elapsed_s, fps,
+      fps * static_cast<double>(frame_bytes) / 1e6, static_cast<unsigned long long>(totals.frames),
+      static_cast<unsigned long long>(totals.fds_sent), static_cast<unsigned long long>(totals.fd_errors),
+      static_cast<unsigned long long>(totals.metadata_sent), static_cast<unsigned long long>(totals.metadata_errors),
+      static_cast<unsigned long long>(totals.skipped), static_cast<unsigned long long>(totals.late),
+      bench::format_histogram("swap>paint", stats.paint).c_str(), bench::format_histogram("interval", stats.interval).c_str(),
+      jitter.c_str(), bench::format_histogram("swap>fdSent", stats.fd_sent).c_str(),
+      bench::format_histogram("swap>metadataSent", stats.metadata_sent).c_str(),
+      bench::format_histogram("reply", stats.reply).c_str(),
+      bench::format_histogram("swap>received", stats.received).c_str());
+  std::fflush(stdout);
+}
+
+void sleep_until_us(int64_t deadline_us) {
+  timespec ts;
+  ts.tv_sec = deadline_us / 1000000;
+  ts.tv_nsec = (deadline_us % 1000000) * 1000;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR && g_running) {
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse_options(argc, argv, &options)) {
+    usage();
+    return 2;
+  }
+  std::signal(SIGINT, on_signal);
+  std::signal(SIGTERM, on_signal);
+
+  const size_t row_bytes = static_cast<size_t>(options.width) * 4;
+  const size_t stride = (row_bytes + kStrideAlign - 1) / kStrideAlign * kStrideAlign;
+  const size_t frame_bytes = stride * static_cast<size_t>(options.height);
+  std::vector<Buffer> buffers(options.buffers);
+  for (Buffer &buffer : buffers) {
+    if (!allocate_buffer(options.backing, frame_bytes, &buffer)) return 1;
+    draw_pattern(options.pattern, buffer.pixels, stride, options.width, options.height, 0);
+  }
+  const bool stamped = bench::has_stamp(options.width, options.height);
+
+  void *zmq_context = zmq_ctx_new();
+  void *request = zmq_socket(zmq_context, ZMQ_REQ);
+  const int linger = 0;
+  const int immediate = 1;
+  const int relaxed = 1;
+  const int timeout = kReplyTimeoutMs;
+  zmq_setsockopt(request, ZMQ_LINGER, &linger, sizeof(linger));
+  // Without a peer a non-blocking send fails instead of queueing, so the
+  // metadata is skipped like the forwarding thread does
+  zmq_setsockopt(request, ZMQ_IMMEDIATE, &immediate, sizeof(immediate));
+  zmq_setsockopt(request, ZMQ_RCVTIMEO, &timeout, sizeof(timeout));
+  // A reply that timed out must not wedge the REQ socket
+  zmq_setsockopt(request, ZMQ_REQ_RELAXED, &relaxed, sizeof(relaxed));
+  zmq_setsockopt(request, ZMQ_REQ_CORRELATE, &relaxed, sizeof(relaxed));
+  PeerMonitor peer(zmq_context, request);
+  if (!peer.ok()) {
+    std::fprintf(stderr, "[%s] ZMQ monitor error: %s\n", options.name.c_str(), zmq_strerror(zmq_errno()));
+    return 1;
+  }
+  if (zmq_connect(request, options.zmq_endpoint.c_str()) < 0) {
+    std::fprintf(stderr, "[%s] ZMQ connect error: %s\n", options.name.c_str(), zmq_strerror(zmq_errno()));
+    return 1;
+  }
+
+  char rate[32] = "unpaced";
+  if (options.fps > 0) std::snprintf(rate, sizeof(rate), "%g fps", options.fps);
+  std::printf("[%s] %dx%d bgra, stride %zu, %d %s buffers, %s pattern, %s fill, %s to %s and %s\n",
+              options.name.c_str(), options.width, options.height, stride, options.buffers,
+              options.backing == Backing::kMemfd ? "memfd" : "udmabuf",
+              options.pattern == Pattern::kBars ? "bars" : options.pattern == Pattern::kGradient ? "gradient" : "noise",
+              options.fill == Fill::kStamp ? "stamp" : "full",
+              rate,
+              options.fd_socket.c_str(), options.zmq_endpoint.c_str());
+  std::fflush(stdout);
+
+  FdSender sender(options.fd_socket);
+  Totals totals;
+  Stats stats;
+  std::vector<char> reply(4096);
+  const int64_t interval_us = options.fps > 0 ? static_cast<int64_t>(1e6 / options.fps) : 0;
+  const int64_t start_us = bench::now_us();
+  int64_t next_us = start_us;
+  int64_t next_probe_us = start_us;
+  int64_t last_warn_us = 0;
+  int64_t last_peer_warn_us = 0;
+  int64_t last_frame_us = -1;
+  int64_t stats_start_us = start_us;
+  uint64_t seq = 0;
+
+  while (g_running && (options.frames == 0 || seq < options.frames)) {
+    int64_t swap_us;
+    if (interval_us > 0) {
+      sleep_until_us(next_us);
+      const int64_t now = bench::now_us();
+      if (now - next_us >= interval_us) {
+        // Keep the cadence rather than catch up with a burst
+        const int64_t missed = (now - next_us) / interval_us;
+        totals.late += static_cast<uint64_t>(missed);
+        next_us += missed * interval_us;
+      }
+      swap_us = next_us;
+      next_us += interval_us;
+    } else {
+      swap_us = bench::now_us();
+    }
+
+    if (swap_us - stats_start_us >= bench::kStatsIntervalUs) {
+      print_stats(options, stats, totals, (swap_us - stats_start_us) / 1e6, frame_bytes);
+      stats.reset();
+      stats_start_us = swap_us;
+    }
+
+    // Like a throttled output, nothing is rendered without a consumer
+    if (!sender.connected()) {
+      if (swap_us < next_probe_us || !sender.connect()) {
+        if (swap_us >= next_probe_us) next_probe_us = swap_us + kProbeIntervalUs;
+        if (swap_us - last_warn_us >= kWarnIntervalUs) {
+          std::fprintf(stderr, "[%s] FD socket not ready yet: %s\n", options.name.c_str(), options.fd_socket.c_str());
+          last_warn_us = swap_us;
+        }
+        totals.skipped++;
+        if (interval_us == 0) sleep_until_us(next_probe_us);
+        continue;
+      }
+    }
+    // Nor before the metadata can go out: an fd without its metadata would
+    // be taken by the consumer for the next frame's
+    if (!peer.connected()) {
+      if (swap_us - last_peer_warn_us >= kWarnIntervalUs) {
+        std::fprintf(stderr, "[%s] ZMQ consumer not connected yet: %s\n", options.name.c_str(),
+                     options.zmq_endpoint.c_str());
+        last_peer_warn_us = swap_us;
+      }
+      totals.skipped++;
+      if (interval_us == 0) sleep_until_us(swap_us + kProbeIntervalUs);
+      continue;
+    }
+
+    ++seq;
+    const int slot = static_cast<int>((seq - 1) % buffers.size());
+    Buffer &buffer = buffers[slot];
+    sync_write(buffer, true);
+    if (options.fill == Fill::kFull) {
+      draw_pattern(options.pattern, buffer.pixels, stride, options.width, options.height, seq);
+    }
+    if (stamped) bench::write_stamp(buffer.pixels, stride, seq);
+    char checksum[24] = "null";
+    if (options.checksum) {
+      std::snprintf(checksum, sizeof(checksum), "\"%016llx\"",
+                    static_cast<unsigned long long>(
+                        bench::frame_checksum(buffer.pixels, stride, row_bytes, options.height)));
+    }
+    sync_write(buffer, false);
+    const int64_t paint_us = bench::now_us();
+    stats.paint.Record(paint_us - swap_us);
+    if (last_frame_us >= 0) stats.interval.Record(paint_us - last_frame_us);
+    last_frame_us = paint_us;
+    totals.frames++;
+    stats.frames++;
+
+    int64_t fd_sent_us = -1;
+    if (sender.send(buffer.fd)) {
+      fd_sent_us = bench::now_us();
+      totals.fds_sent++;
+      stats.fd_sent.Record(fd_sent_us - swap_us);
+    } else {
+      totals.fd_errors++;
+    }
+
+    const int64_t metadata_sent_us = bench::now_us();
+    const std::string json = metadata(options, stride, buffer.fd, slot, seq, swap_us, paint_us, fd_sent_us,
+                                      metadata_sent_us, checksum);
+    if (zmq_send(request, json.data(), json.size(), ZMQ_DONTWAIT) < 0) {
+      // The peer went away since the check above
+      totals.metadata_errors++;
+      continue;
+    }
+    stats.metadata_sent.Record(metadata_sent_us - swap_us);
+    const int n = zmq_recv(request, reply.data(), reply.size() - 1, 0);
+    if (n < 0) {
+      totals.metadata_errors++;
+      continue;
+    }
+    totals.metadata_sent++;
+    stats.reply.Record(bench::now_us() - metadata_sent_us);
+    double received_us;
+    const std::string text(reply.data(), std::min(static_cast<size_t>(n), reply.size() - 1));
+    if (bench::json_number(text, "receivedUs", &received_us)) {
+      stats.received.Record(static_cast<int64_t>(received_us) - swap_us);
+    }
+  }
+
+  const int64_t end_us = bench::now_us();
+  print_stats(options, stats, totals, (end_us - stats_start_us) / 1e6, frame_bytes);
+  const double elapsed_s = (end_us - start_us) / 1e6;
+  std::printf("[%s] %llu frames in %.1fs = %.1f fps, %.0f MB/s\n", options.name.c_str(),
+              static_cast<unsigned long long>(totals.frames), elapsed_s, elapsed_s > 0 ? totals.frames / elapsed_s : 0,
+              elapsed_s > 0 ? totals.frames * static_cast<double>(frame_bytes) / 1e6 / elapsed_s : 0);
+
+  peer.close();
+  zmq_close(request);
+  zmq_ctx_term(zmq_context);
+  for (Buffer &buffer : buffers) free_buffer(&buffer);
+  return 0;
+}
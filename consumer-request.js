@@ -0,0 +1,17 @@
+// Requests consumers send back on the metadata and control channels: a JSON
+// object such as {"fps": 30}, {"pull": 2} or {"receivedUs": ...}, read by
+// the main thread (output.js) and the forwarding thread (forwarder.js).
+
+// JSON object sent by the consumer, or null for plain acknowledgements.
+function parseRequest (message) {
+  const text = String(message)
+  if (!text.startsWith('{')) return null
+  try {
+    const request = JSON.parse(text)
+    return request && typeof request === 'object' ? request : null
+  } catch {
+    return null
+  }
+}
+
+module.exports = { parseRequest }
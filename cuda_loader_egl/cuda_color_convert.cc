@@ -0,0 +1,122 @@
+#include "cuda_color_convert.h"
+
+#include "cuda_color_convert_ptx.h"
+
+namespace viz {
+
+namespace {
+
+// 256 threads, wide in x so a warp reads 64 adjacent pixels of two rows.
+constexpr unsigned int kBlockWidth = 32;
+constexpr unsigned int kBlockHeight = 8;
+
+// Matches the format argument of the kernel.
+unsigned int KernelFormat(CudaExportFormat format) {
+  switch (format) {
+    case CudaExportFormat::kNV12:
+      return 0;
+    case CudaExportFormat::kI420:
+      return 1;
+    case CudaExportFormat::kP010:
+      return 2;
+    case CudaExportFormat::kBGRA:
+      break;
+  }
+  return 0;
+}
+
+}  // namespace
+
+CudaFrameLayout GetCudaFrameLayout(CudaExportFormat format,
+                                   size_t max_width,
+                                   size_t max_height) {
+  const size_t chroma_width = (max_width + 1) / 2;
+  const size_t chroma_height = (max_height + 1) / 2;
+
+  CudaFrameLayout layout;
+  layout.format = format;
+  switch (format) {
+    case CudaExportFormat::kBGRA:
+      layout.planes = 1;
+      layout.pitch[0] = max_width * 4;
+      layout.size = layout.pitch[0] * max_height;
+      break;
+    case CudaExportFormat::kNV12:
+      layout.planes = 2;
+      layout.pitch[0] = max_width;
+      layout.offset[1] = layout.pitch[0] * max_height;
+      layout.pitch[1] = chroma_width * 2;
+      layout.size = layout.offset[1] + layout.pitch[1] * chroma_height;
+      break;
+    case CudaExportFormat::kI420:
+      layout.planes = 3;
+      layout.pitch[0] = max_width;
+      layout.offset[1] = layout.pitch[0] * max_height;
+      layout.pitch[1] = chroma_width;
+      layout.offset[2] = layout.offset[1] + layout.pitch[1] * chroma_height;
+      layout.pitch[2] = chroma_width;
+      layout.size = layout.offset[2] + layout.pitch[2] * chroma_height;
+      break;
+    case CudaExportFormat::kP010:
+      layout.planes = 2;
+      layout.pitch[0] = max_width * 2;
+      layout.offset[1] = layout.pitch[0] * max_height;
+      layout.pitch[1] = chroma_width * 4;
+      layout.size = layout.offset[1] + layout.pitch[1] * chroma_height;
+      break;
+  }
+  return layout;
+}
+
+CudaColorConverter::CudaColorConverter() = default;
+
+CudaColorConverter::~CudaColorConverter() {
+  if (module_)
+    CHECK_CU(cuModuleUnload(module_));
+}
+
+bool CudaColorConverter::Init() {
+  if (CHECK_CU(cuModuleLoadData(&module_, kBGRAToYUVPtx))) {
+    module_ = nullptr;
+    return false;
+  }
+  if (CHECK_CU(cuModuleGetFunction(&kernel_, module_, kBGRAToYUVKernelName))) {
+    CHECK_CU(cuModuleUnload(module_));
+    module_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool CudaColorConverter::Convert(CUdeviceptr src,
+                                 size_t src_pitch,
+                                 int width,
+                                 int height,
+                                 CUdeviceptr dst,
+                                 const CudaFrameLayout& layout,
+                                 CUstream stream) {
+  if (layout.format == CudaExportFormat::kBGRA || width <= 0 || height <= 0)
+    return false;
+
+  unsigned int src_pitch_arg = static_cast<unsigned int>(src_pitch);
+  unsigned int width_arg = static_cast<unsigned int>(width);
+  unsigned int height_arg = static_cast<unsigned int>(height);
+  CUdeviceptr dst_y = dst + layout.offset[0];
+  unsigned int y_pitch = static_cast<unsigned int>(layout.pitch[0]);
+  CUdeviceptr dst_u = dst + layout.offset[1];
+  CUdeviceptr dst_v = dst + layout.offset[2];
+  unsigned int uv_pitch = static_cast<unsigned int>(layout.pitch[1]);
+  unsigned int format = KernelFormat(layout.format);
+  void* params[] = {&src,   &src_pitch_arg, &width_arg, &height_arg,
+                    &dst_y, &y_pitch,       &dst_u,     &dst_v,
+                    &uv_pitch, &format};
+
+  const unsigned int chroma_width = (width_arg + 1) / 2;
+  const unsigned int chroma_height = (height_arg + 1) / 2;
+  return !CHECK_CU(cuLaunchKernel(
+      kernel_, (chroma_width + kBlockWidth - 1) / kBlockWidth,
+      (chroma_height + kBlockHeight - 1) / kBlockHeight, 1, kBlockWidth,
+      kBlockHeight, 1, 0, stream, params, nullptr));
+}
+
+}  // namespace viz
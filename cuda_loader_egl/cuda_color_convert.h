@@ -0,0 +1,65 @@
+#ifndef __cuda_color_convert_h__
+#define __cuda_color_convert_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cuda_export_config.h"
+#include "cuda_wrapper_include.h"
+
+namespace viz {
+
+// Plane layout of one ring slot. Pitches and plane offsets follow the
+// configured maximum size rather than the frame, so a consumer can map a
+// slot once and read any frame out of it.
+//
+//   bgra  one plane, 4 bytes per pixel
+//   nv12  Y, then interleaved UV at half resolution, 8 bit
+//   i420  Y, U, V, chroma at half resolution, 8 bit
+//   p010  like nv12 with 16 bit samples, 10 bit value in the high bits
+struct CudaFrameLayout {
+  CudaExportFormat format = CudaExportFormat::kBGRA;
+  int planes = 1;
+  size_t offset[3] = {};
+  size_t pitch[3] = {};
+  // Bytes of one slot.
+  size_t size = 0;
+};
+
+CudaFrameLayout GetCudaFrameLayout(CudaExportFormat format,
+                                   size_t max_width,
+                                   size_t max_height);
+
+// Converts BGRA device memory into one of the YUV layouts with a PTX kernel
+// loaded through cuModuleLoadData, JIT compiled by the driver for whatever
+// GPU is present. The context it was created in must be current on every
+// call. The math is spelled out next to ConvertBGRAReference() in
+// cuda_color_convert_reference.h.
+class CudaColorConverter {
+ public:
+  CudaColorConverter();
+  ~CudaColorConverter();
+
+  CudaColorConverter(const CudaColorConverter&) = delete;
+  CudaColorConverter& operator=(const CudaColorConverter&) = delete;
+
+  // Loads the module; false if the driver cannot JIT it.
+  bool Init();
+
+  // Queues the conversion of |width| x |height| pixels on |stream|.
+  bool Convert(CUdeviceptr src,
+               size_t src_pitch,
+               int width,
+               int height,
+               CUdeviceptr dst,
+               const CudaFrameLayout& layout,
+               CUstream stream);
+
+ private:
+  CUmodule module_ = nullptr;
+  CUfunction kernel_ = nullptr;
+};
+
+}  // namespace viz
+
+#endif  // __cuda_color_convert_h__
@@ -0,0 +1,264 @@
+#ifndef __cuda_color_convert_ptx_h__
+#define __cuda_color_convert_ptx_h__
+
+namespace viz {
+
+// PTX of the BGRA to YUV kernel, JIT compiled by the driver on load. Written
+// by hand so the build needs no CUDA toolkit; it must stay bit-exact with
+// ConvertBGRAReference() in cuda_color_convert_reference.cc.
+//
+// bgra_to_yuv(src, src_pitch, width, height,
+//             dst_y, y_pitch, dst_u, dst_v, uv_pitch, format)
+//
+// One thread per chroma sample, i.e. per 2x2 block of pixels; format is
+// 0 nv12, 1 i420, 2 p010. dst_v is only read for i420.
+constexpr char kBGRAToYUVKernelName[] = "bgra_to_yuv";
+constexpr char kBGRAToYUVPtx[] = R"ptx(
+.version 5.0
+.target sm_30
+.address_size 64
+
+.visible .entry bgra_to_yuv(
+    .param .u64 p_src,
+    .param .u32 p_src_pitch,
+    .param .u32 p_width,
+    .param .u32 p_height,
+    .param .u64 p_dst_y,
+    .param .u32 p_y_pitch,
+    .param .u64 p_dst_u,
+    .param .u64 p_dst_v,
+    .param .u32 p_uv_pitch,
+    .param .u32 p_format)
+{
+    .reg .pred %p<4>;
+    .reg .b32 %r<64>;
+    .reg .b64 %rd<32>;
+
+    // chroma sample (cx, cy) = (%r4, %r5)
+    mov.u32 %r1, %ctaid.x;
+    mov.u32 %r2, %ntid.x;
+    mov.u32 %r3, %tid.x;
+    mad.lo.u32 %r4, %r1, %r2, %r3;
+    mov.u32 %r1, %ctaid.y;
+    mov.u32 %r2, %ntid.y;
+    mov.u32 %r3, %tid.y;
+    mad.lo.u32 %r5, %r1, %r2, %r3;
+
+    ld.param.u32 %r6, [p_width];
+    ld.param.u32 %r7, [p_height];
+    add.u32 %r8, %r6, 1;
+    shr.u32 %r8, %r8, 1;
+    add.u32 %r9, %r7, 1;
+    shr.u32 %r9, %r9, 1;
+    setp.ge.u32 %p1, %r4, %r8;
+    setp.ge.u32 %p2, %r5, %r9;
+    or.pred %p1, %p1, %p2;
+    @%p1 bra L_DONE;
+
+    // BT.709 weights for 8 bit output, or for 10 bit when p010 (%p3):
+    // y = %r53..%r55, u = %r56, %r57, %r58, v = %r58, %r59, %r60
+    ld.param.u32 %r50, [p_format];
+    setp.eq.u32 %p3, %r50, 2;
+    selp.u32 %r53, 187, 47, %p3;
+    selp.u32 %r54, 629, 157, %p3;
+    selp.u32 %r55, 63, 16, %p3;
+    selp.s32 %r56, -103, -26, %p3;
+    selp.s32 %r57, -347, -86, %p3;
+    selp.s32 %r58, 450, 112, %p3;
+    selp.s32 %r59, -409, -102, %p3;
+    selp.s32 %r60, -41, -10, %p3;
+
+    // pixel columns x0, x1 = (%r10, %r11) and rows y0, y1 = (%r13, %r14),
+    // the second one clamped to the frame
+    shl.b32 %r10, %r4, 1;
+    add.u32 %r11, %r10, 1;
+    sub.u32 %r12, %r6, 1;
+    min.u32 %r11, %r11, %r12;
+    shl.b32 %r13, %r5, 1;
+    add.u32 %r14, %r13, 1;
+    sub.u32 %r12, %r7, 1;
+    min.u32 %r14, %r14, %r12;
+
+    ld.param.u64 %rd1, [p_src];
+    ld.param.u32 %r15, [p_src_pitch];
+    mul.wide.u32 %rd2, %r13, %r15;
+    add.u64 %rd2, %rd1, %rd2;
+    mul.wide.u32 %rd3, %r14, %r15;
+    add.u64 %rd3, %rd1, %rd3;
+    mul.wide.u32 %rd4, %r10, 4;
+    mul.wide.u32 %rd5, %r11, 4;
+    add.u64 %rd6, %rd2, %rd4;
+    ld.global.u32 %r16, [%rd6];
+    add.u64 %rd6, %rd2, %rd5;
+    ld.global.u32 %r17, [%rd6];
+    add.u64 %rd6, %rd3, %rd4;
+    ld.global.u32 %r18, [%rd6];
+    add.u64 %rd6, %rd3, %rd5;
+    ld.global.u32 %r19, [%rd6];
+
+    // unscaled luma of each pixel in %r20..%r23, channel sums of the block
+    // in b, g, r = %r40, %r41, %r42
+    bfe.u32 %r40, %r16, 0, 8;
+    bfe.u32 %r41, %r16, 8, 8;
+    bfe.u32 %r42, %r16, 16, 8;
+    mul.lo.u32 %r20, %r42, %r53;
+    mad.lo.u32 %r20, %r41, %r54, %r20;
+    mad.lo.u32 %r20, %r40, %r55, %r20;
+
+    bfe.u32 %r30, %r17, 0, 8;
+    bfe.u32 %r31, %r17, 8, 8;
+    bfe.u32 %r32, %r17, 16, 8;
+    mul.lo.u32 %r21, %r32, %r53;
+    mad.lo.u32 %r21, %r31, %r54, %r21;
+    mad.lo.u32 %r21, %r30, %r55, %r21;
+    add.u32 %r40, %r40, %r30;
+    add.u32 %r41, %r41, %r31;
+    add.u32 %r42, %r42, %r32;
+
+    bfe.u32 %r30, %r18, 0, 8;
+    bfe.u32 %r31, %r18, 8, 8;
+    bfe.u32 %r32, %r18, 16, 8;
+    mul.lo.u32 %r22, %r32, %r53;
+    mad.lo.u32 %r22, %r31, %r54, %r22;
+    mad.lo.u32 %r22, %r30, %r55, %r22;
+    add.u32 %r40, %r40, %r30;
+    add.u32 %r41, %r41, %r31;
+    add.u32 %r42, %r42, %r32;
+
+    bfe.u32 %r30, %r19, 0, 8;
+    bfe.u32 %r31, %r19, 8, 8;
+    bfe.u32 %r32, %r19, 16, 8;
+    mul.lo.u32 %r23, %r32, %r53;
+    mad.lo.u32 %r23, %r31, %r54, %r23;
+    mad.lo.u32 %r23, %r30, %r55, %r23;
+    add.u32 %r40, %r40, %r30;
+    add.u32 %r41, %r41, %r31;
+    add.u32 %r42, %r42, %r32;
+
+    // rounded block mean, then unscaled u = %r43 and v = %r44
+    add.u32 %r40, %r40, 2;
+    shr.u32 %r40, %r40, 2;
+    add.u32 %r41, %r41, 2;
+    shr.u32 %r41, %r41, 2;
+    add.u32 %r42, %r42, 2;
+    shr.u32 %r42, %r42, 2;
+    mul.lo.s32 %r43, %r40, %r58;
+    mad.lo.s32 %r43, %r42, %r56, %r43;
+    mad.lo.s32 %r43, %r41, %r57, %r43;
+    mul.lo.s32 %r44, %r42, %r58;
+    mad.lo.s32 %r44, %r41, %r59, %r44;
+    mad.lo.s32 %r44, %r40, %r60, %r44;
+
+    ld.param.u64 %rd10, [p_dst_y];
+    ld.param.u32 %r51, [p_y_pitch];
+    ld.param.u64 %rd11, [p_dst_u];
+    ld.param.u64 %rd12, [p_dst_v];
+    ld.param.u32 %r52, [p_uv_pitch];
+    mul.wide.u32 %rd13, %r13, %r51;
+    add.u64 %rd13, %rd10, %rd13;
+    mul.wide.u32 %rd14, %r14, %r51;
+    add.u64 %rd14, %rd10, %rd14;
+    mul.wide.u32 %rd15, %r5, %r52;
+    @%p3 bra L_P010;
+
+    add.u32 %r20, %r20, 128;
+    shr.u32 %r20, %r20, 8;
+    add.u32 %r20, %r20, 16;
+    add.u32 %r21, %r21, 128;
+    shr.u32 %r21, %r21, 8;
+    add.u32 %r21, %r21, 16;
+    add.u32 %r22, %r22, 128;
+    shr.u32 %r22, %r22, 8;
+    add.u32 %r22, %r22, 16;
+    add.u32 %r23, %r23, 128;
+    shr.u32 %r23, %r23, 8;
+    add.u32 %r23, %r23, 16;
+    cvt.u64.u32 %rd4, %r10;
+    cvt.u64.u32 %rd5, %r11;
+    add.u64 %rd6, %rd13, %rd4;
+    st.global.u8 [%rd6], %r20;
+    add.u64 %rd6, %rd13, %rd5;
+    st.global.u8 [%rd6], %r21;
+    add.u64 %rd6, %rd14, %rd4;
+    st.global.u8 [%rd6], %r22;
+    add.u64 %rd6, %rd14, %rd5;
+    st.global.u8 [%rd6], %r23;
+
+    add.s32 %r43, %r43, 128;
+    shr.s32 %r43, %r43, 8;
+    add.s32 %r43, %r43, 128;
+    add.s32 %r44, %r44, 128;
+    shr.s32 %r44, %r44, 8;
+    add.s32 %r44, %r44, 128;
+    setp.eq.u32 %p3, %r50, 1;
+    @%p3 bra L_I420;
+
+    // nv12, interleaved UV
+    mul.wide.u32 %rd7, %r4, 2;
+    add.u64 %rd7, %rd15, %rd7;
+    add.u64 %rd7, %rd11, %rd7;
+    st.global.u8 [%rd7], %r43;
+    st.global.u8 [%rd7+1], %r44;
+    bra L_DONE;
+
+L_I420:
+    cvt.u64.u32 %rd7, %r4;
+    add.u64 %rd7, %rd15, %rd7;
+    add.u64 %rd8, %rd11, %rd7;
+    st.global.u8 [%rd8], %r43;
+    add.u64 %rd8, %rd12, %rd7;
+    st.global.u8 [%rd8], %r44;
+    bra L_DONE;
+
+L_P010:
+    // 10 bit weights, same rounding; values in the high bits of 16 bit
+    // samples
+    add.u32 %r20, %r20, 128;
+    shr.u32 %r20, %r20, 8;
+    add.u32 %r20, %r20, 64;
+    shl.b32 %r20, %r20, 6;
+    add.u32 %r21, %r21, 128;
+    shr.u32 %r21, %r21, 8;
+    add.u32 %r21, %r21, 64;
+    shl.b32 %r21, %r21, 6;
+    add.u32 %r22, %r22, 128;
+    shr.u32 %r22, %r22, 8;
+    add.u32 %r22, %r22, 64;
+    shl.b32 %r22, %r22, 6;
+    add.u32 %r23, %r23, 128;
+    shr.u32 %r23, %r23, 8;
+    add.u32 %r23, %r23, 64;
+    shl.b32 %r23, %r23, 6;
+    mul.wide.u32 %rd4, %r10, 2;
+    mul.wide.u32 %rd5, %r11, 2;
+    add.u64 %rd6, %rd13, %rd4;
+    st.global.u16 [%rd6], %r20;
+    add.u64 %rd6, %rd13, %rd5;
+    st.global.u16 [%rd6], %r21;
+    add.u64 %rd6, %rd14, %rd4;
+    st.global.u16 [%rd6], %r22;
+    add.u64 %rd6, %rd14, %rd5;
+    st.global.u16 [%rd6], %r23;
+
+    add.s32 %r43, %r43, 128;
+    shr.s32 %r43, %r43, 8;
+    add.s32 %r43, %r43, 512;
+    shl.b32 %r43, %r43, 6;
+    add.s32 %r44, %r44, 128;
+    shr.s32 %r44, %r44, 8;
+    add.s32 %r44, %r44, 512;
+    shl.b32 %r44, %r44, 6;
+    mul.wide.u32 %rd7, %r4, 4;
+    add.u64 %rd7, %rd15, %rd7;
+    add.u64 %rd7, %rd11, %rd7;
+    st.global.u16 [%rd7], %r43;
+    st.global.u16 [%rd7+2], %r44;
+
+L_DONE:
+    ret;
+}
+)ptx";
+
+}  // namespace viz
+
+#endif  // __cuda_color_convert_ptx_h__
@@ -0,0 +1,115 @@
+#include "cuda_color_convert_reference.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace viz {
+
+namespace {
+
+struct Rgb {
+  int r;
+  int g;
+  int b;
+};
+
+Rgb Load(const uint8_t* src, size_t src_pitch, int x, int y) {
+  const uint8_t* pixel = src + y * src_pitch + x * 4;
+  return {pixel[2], pixel[1], pixel[0]};
+}
+
+// Fixed point BT.709 weights in 1/256 and the offsets of the limited
+// range, for 8 and 10 bit output.
+struct Coefficients {
+  Rgb y;
+  Rgb u;
+  Rgb v;
+  int luma_offset;
+  int chroma_offset;
+};
+
+constexpr Coefficients k8Bit = {
+    {47, 157, 16}, {-26, -86, 112}, {112, -102, -10}, 16, 128};
+constexpr Coefficients k10Bit = {
+    {187, 629, 63}, {-103, -347, 450}, {450, -409, -41}, 64, 512};
+
+// Rounds and shifts arithmetically, as the kernel does.
+int Scale(const Rgb& k, const Rgb& c, int offset) {
+  return ((k.r * c.r + k.g * c.g + k.b * c.b + 128) >> 8) + offset;
+}
+
+void Store16(uint8_t* dst, int value) {
+  const uint16_t sample = static_cast<uint16_t>(value << 6);
+  memcpy(dst, &sample, sizeof(sample));
+}
+
+}  // namespace
+
+void ConvertBGRAReference(const uint8_t* src,
+                          size_t src_pitch,
+                          int width,
+                          int height,
+                          const CudaFrameLayout& layout,
+                          uint8_t* dst) {
+  if (layout.format == CudaExportFormat::kBGRA) {
+    for (int y = 0; y < height; ++y)
+      memcpy(dst + y * layout.pitch[0], src + y * src_pitch, width * 4);
+    return;
+  }
+
+  const bool ten_bit = layout.format == CudaExportFormat::kP010;
+  const Coefficients& k = ten_bit ? k10Bit : k8Bit;
+  const int chroma_width = (width + 1) / 2;
+  const int chroma_height = (height + 1) / 2;
+
+  // Walks the frame the way the kernel does, one 2x2 block per chroma
+  // sample; clamped edge pixels write the same luma twice.
+  for (int cy = 0; cy < chroma_height; ++cy) {
+    for (int cx = 0; cx < chroma_width; ++cx) {
+      const int xs[2] = {2 * cx, std::min(2 * cx + 1, width - 1)};
+      const int ys[2] = {2 * cy, std::min(2 * cy + 1, height - 1)};
+
+      Rgb sum = {0, 0, 0};
+      for (int y : ys) {
+        for (int x : xs) {
+          const Rgb c = Load(src, src_pitch, x, y);
+          sum.r += c.r;
+          sum.g += c.g;
+          sum.b += c.b;
+          uint8_t* luma = dst + y * layout.pitch[0];
+          const int value = Scale(k.y, c, k.luma_offset);
+          if (ten_bit)
+            Store16(luma + x * 2, value);
+          else
+            luma[x] = static_cast<uint8_t>(value);
+        }
+      }
+
+      const Rgb mean = {(sum.r + 2) >> 2, (sum.g + 2) >> 2, (sum.b + 2) >> 2};
+      const int u = Scale(k.u, mean, k.chroma_offset);
+      const int v = Scale(k.v, mean, k.chroma_offset);
+
+      uint8_t* chroma = dst + layout.offset[1] + cy * layout.pitch[1];
+      switch (layout.format) {
+        case CudaExportFormat::kNV12:
+          chroma[cx * 2] = static_cast<uint8_t>(u);
+          chroma[cx * 2 + 1] = static_cast<uint8_t>(v);
+          break;
+        case CudaExportFormat::kI420:
+          chroma[cx] = static_cast<uint8_t>(u);
+          dst[layout.offset[2] + cy * layout.pitch[2] + cx] =
+              static_cast<uint8_t>(v);
+          break;
+        case CudaExportFormat::kP010:
+          Store16(chroma + cx * 4, u);
+          Store16(chroma + cx * 4 + 2, v);
+          break;
+        case CudaExportFormat::kBGRA:
+          break;
+      }
+    }
+  }
+}
+
+}  // namespace viz
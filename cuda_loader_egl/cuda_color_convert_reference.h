@@ -0,0 +1,35 @@
+#ifndef __cuda_color_convert_reference_h__
+#define __cuda_color_convert_reference_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cuda_color_convert.h"
+
+namespace viz {
+
+// BT.709 limited range in integer math, identical on the GPU and here. Per
+// pixel, with r, g, b in 0..255 and arithmetic shifts:
+//   Y8  = (( 47 r + 157 g +  16 b + 128) >> 8) +  16
+//   Y10 = ((187 r + 629 g +  63 b + 128) >> 8) +  64
+// Chroma takes the rounded mean of each 2x2 block first, (sum + 2) >> 2 per
+// channel, edge pixels repeated for odd sizes, then:
+//   U8  = ((-26 r -  86 g + 112 b + 128) >> 8) + 128
+//   V8  = ((112 r - 102 g -  10 b + 128) >> 8) + 128
+//   U10 = ((-103 r - 347 g + 450 b + 128) >> 8) + 512
+//   V10 = ((450 r - 409 g -  41 b + 128) >> 8) + 512
+// so white is Y 235 / 940 and the chroma extremes 16..240 / 64..960.
+//
+// Converts a BGRA frame into |dst|, laid out as |layout|, on the CPU. The
+// output is bit-exact with CudaColorConverter, so tests can check the
+// kernel's math without a GPU. kBGRA copies rows.
+void ConvertBGRAReference(const uint8_t* src,
+                          size_t src_pitch,
+                          int width,
+                          int height,
+                          const CudaFrameLayout& layout,
+                          uint8_t* dst);
+
+}  // namespace viz
+
+#endif  // __cuda_color_convert_reference_h__
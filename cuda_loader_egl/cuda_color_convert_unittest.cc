@@ -0,0 +1,244 @@
+#include "cuda_color_convert_reference.h"
+
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+#include "cuda_color_convert.h"
+#include "cuda_stub_driver_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace viz {
+
+namespace {
+
+struct Bgra {
+  uint8_t b, g, r, a;
+};
+
+constexpr Bgra kBlack = {0, 0, 0, 255};
+constexpr Bgra kWhite = {255, 255, 255, 255};
+constexpr Bgra kRed = {0, 0, 255, 255};
+constexpr Bgra kGreen = {0, 255, 0, 255};
+constexpr Bgra kBlue = {255, 0, 0, 255};
+
+// BT.709 limited range values of a solid color as the conversion rounds
+// them, each within one code value of the exact result.
+struct Golden {
+  Bgra color;
+  int y8, u8, v8;
+  int y10, u10, v10;
+};
+
+constexpr Golden kGolden[] = {
+    {kBlack, 16, 128, 128, 64, 512, 512},
+    {kWhite, 235, 128, 128, 940, 512, 512},
+    {kRed, 63, 102, 240, 250, 409, 960},
+    {kGreen, 172, 42, 26, 691, 166, 105},
+    {kBlue, 32, 240, 118, 127, 960, 471},
+};
+
+class CudaColorConvertTest : public testing::Test {
+ protected:
+  // |width| x |height| BGRA pixels, |pixels| row by row.
+  void SetFrame(int width, int height, const std::vector<Bgra>& pixels) {
+    ASSERT_EQ(static_cast<size_t>(width * height), pixels.size());
+    width_ = width;
+    height_ = height;
+    src_.resize(pixels.size() * 4);
+    memcpy(src_.data(), pixels.data(), src_.size());
+  }
+
+  void Convert(CudaExportFormat format) {
+    layout_ = GetCudaFrameLayout(format, width_, height_);
+    dst_.assign(layout_.size, 0xcd);
+    ConvertBGRAReference(src_.data(), width_ * 4, width_, height_, layout_,
+                         dst_.data());
+  }
+
+  int Y(int x, int y) const {
+    if (layout_.format == CudaExportFormat::kP010)
+      return Sample16(layout_.offset[0] + y * layout_.pitch[0] + x * 2);
+    return dst_[layout_.offset[0] + y * layout_.pitch[0] + x];
+  }
+
+  int U(int cx, int cy) const { return Chroma(cx, cy, 0); }
+  int V(int cx, int cy) const { return Chroma(cx, cy, 1); }
+
+ private:
+  int Chroma(int cx, int cy, int plane) const {
+    switch (layout_.format) {
+      case CudaExportFormat::kNV12:
+        return dst_[layout_.offset[1] + cy * layout_.pitch[1] + cx * 2 +
+                    plane];
+      case CudaExportFormat::kI420:
+        return dst_[layout_.offset[1 + plane] +
+                    cy * layout_.pitch[1 + plane] + cx];
+      case CudaExportFormat::kP010:
+        return Sample16(layout_.offset[1] + cy * layout_.pitch[1] + cx * 4 +
+                        plane * 2);
+      case CudaExportFormat::kBGRA:
+        break;
+    }
+    return -1;
+  }
+
+  // 10 bit value of a P010 sample; the low 6 bits must be clear.
+  int Sample16(size_t offset) const {
+    uint16_t sample;
+    memcpy(&sample, &dst_[offset], sizeof(sample));
+    EXPECT_EQ(0, sample & 0x3f);
+    return sample >> 6;
+  }
+
+  int width_ = 0;
+  int height_ = 0;
+  std::vector<uint8_t> src_;
+  CudaFrameLayout layout_;
+  std::vector<uint8_t> dst_;
+};
+
+TEST(CudaFrameLayoutTest, Planes) {
+  const CudaFrameLayout nv12 =
+      GetCudaFrameLayout(CudaExportFormat::kNV12, 5, 3);
+  EXPECT_EQ(2, nv12.planes);
+  EXPECT_EQ(5u, nv12.pitch[0]);
+  EXPECT_EQ(15u, nv12.offset[1]);
+  EXPECT_EQ(6u, nv12.pitch[1]);
+  EXPECT_EQ(27u, nv12.size);
+
+  const CudaFrameLayout i420 =
+      GetCudaFrameLayout(CudaExportFormat::kI420, 5, 3);
+  EXPECT_EQ(3, i420.planes);
+  EXPECT_EQ(15u, i420.offset[1]);
+  EXPECT_EQ(3u, i420.pitch[1]);
+  EXPECT_EQ(21u, i420.offset[2]);
+  EXPECT_EQ(27u, i420.size);
+
+  const CudaFrameLayout p010 =
+      GetCudaFrameLayout(CudaExportFormat::kP010, 5, 3);
+  EXPECT_EQ(10u, p010.pitch[0]);
+  EXPECT_EQ(30u, p010.offset[1]);
+  EXPECT_EQ(12u, p010.pitch[1]);
+  EXPECT_EQ(54u, p010.size);
+}
+
+TEST_F(CudaColorConvertTest, SolidColors) {
+  for (const Golden& golden : kGolden) {
+    SetFrame(2, 2, std::vector<Bgra>(4, golden.color));
+    for (CudaExportFormat format :
+         {CudaExportFormat::kNV12, CudaExportFormat::kI420}) {
+      Convert(format);
+      EXPECT_EQ(golden.y8, Y(1, 1));
+      EXPECT_EQ(golden.u8, U(0, 0));
+      EXPECT_EQ(golden.v8, V(0, 0));
+    }
+    Convert(CudaExportFormat::kP010);
+    EXPECT_EQ(golden.y10, Y(1, 1));
+    EXPECT_EQ(golden.u10, U(0, 0));
+    EXPECT_EQ(golden.v10, V(0, 0));
+  }
+}
+
+TEST_F(CudaColorConvertTest, ChromaOfEachBlock) {
+  // The first block is half red, half black; the last column has no
+  // neighbour and repeats itself.
+  SetFrame(3, 2, {kRed, kBlack, kBlue, kRed, kBlack, kBlue});
+  Convert(CudaExportFormat::kNV12);
+  EXPECT_EQ(63, Y(0, 1));
+  EXPECT_EQ(16, Y(1, 1));
+  EXPECT_EQ(32, Y(2, 1));
+  // Mean of the first block is r = 128.
+  EXPECT_EQ(115, U(0, 0));
+  EXPECT_EQ(184, V(0, 0));
+  EXPECT_EQ(240, U(1, 0));
+  EXPECT_EQ(118, V(1, 0));
+}
+
+// Rows and bytes per row of |plane| that a |width| x |height| frame covers.
+void CoveredPlane(const CudaFrameLayout& layout,
+                  int plane,
+                  int width,
+                  int height,
+                  size_t* rows,
+                  size_t* row_bytes) {
+  const size_t sample = layout.format == CudaExportFormat::kP010 ? 2 : 1;
+  const size_t chroma_width = (width + 1) / 2;
+  *rows = plane == 0 ? height : (height + 1) / 2;
+  if (plane == 0)
+    *row_bytes = width * sample;
+  else if (layout.format == CudaExportFormat::kI420)
+    *row_bytes = chroma_width;
+  else
+    *row_bytes = chroma_width * 2 * sample;
+}
+
+// Random frames through the PTX kernel, which has to agree with the
+// reference on every sample.
+void ExpectKernelMatchesReference() {
+  CudaColorConverter converter;
+  ASSERT_TRUE(converter.Init());
+  CUstream stream = nullptr;
+  ASSERT_EQ(CUDA_SUCCESS, cuStreamCreate(&stream, 0));
+
+  std::mt19937 random(39);
+  const struct {
+    int width, height;
+  } kSizes[] = {{1, 1}, {37, 23}, {641, 359}};
+  for (const auto& size : kSizes) {
+    // Padded rows, and a ring sized for something larger.
+    const size_t src_pitch = size.width * 4 + 12;
+    std::vector<uint8_t> src(src_pitch * size.height);
+    for (uint8_t& byte : src)
+      byte = static_cast<uint8_t>(random());
+    CUdeviceptr src_device;
+    ASSERT_EQ(CUDA_SUCCESS, cuMemAlloc(&src_device, src.size()));
+    ASSERT_EQ(CUDA_SUCCESS,
+              cuMemcpyHtoD(src_device, src.data(), src.size()));
+
+    for (CudaExportFormat format :
+         {CudaExportFormat::kNV12, CudaExportFormat::kI420,
+          CudaExportFormat::kP010}) {
+      const CudaFrameLayout layout =
+          GetCudaFrameLayout(format, size.width + 3, size.height + 2);
+      std::vector<uint8_t> expected(layout.size, 0xcd);
+      ConvertBGRAReference(src.data(), src_pitch, size.width, size.height,
+                           layout, expected.data());
+
+      CUdeviceptr dst_device;
+      ASSERT_EQ(CUDA_SUCCESS, cuMemAlloc(&dst_device, layout.size));
+      ASSERT_TRUE(converter.Convert(src_device, src_pitch, size.width,
+                                    size.height, dst_device, layout, stream));
+      ASSERT_EQ(CUDA_SUCCESS, cuStreamSynchronize(stream));
+      std::vector<uint8_t> actual(layout.size);
+      ASSERT_EQ(CUDA_SUCCESS,
+                cuMemcpyDtoH(actual.data(), dst_device, layout.size));
+      cuMemFree(dst_device);
+
+      for (int plane = 0; plane < layout.planes; ++plane) {
+        size_t rows, row_bytes;
+        CoveredPlane(layout, plane, size.width, size.height, &rows,
+                     &row_bytes);
+        for (size_t row = 0; row < rows; ++row) {
+          const size_t offset =
+              layout.offset[plane] + row * layout.pitch[plane];
+          ASSERT_EQ(0, memcmp(&expected[offset], &actual[offset], row_bytes))
+              << "format " << static_cast<int>(format) << ", " << size.width
+              << "x" << size.height << ", plane " << plane << ", row "
+              << row;
+        }
+      }
+    }
+    cuMemFree(src_device);
+  }
+  cuStreamDestroy(stream);
+}
+
+TEST(CudaColorConverterTest, MatchesReference) {
+  EXPECT_ON_CUDA_DEVICE(ExpectKernelMatchesReference());
+}
+
+}  // namespace
+
+}  // namespace viz
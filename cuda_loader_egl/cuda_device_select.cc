@@ -0,0 +1,243 @@
+#include "cuda_device_select.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ui/gl/gl_bindings.h"
+
+#ifndef EGL_DEVICE_UUID_EXT
+#define EGL_DEVICE_UUID_EXT 0x335C
+#endif
+
+namespace viz {
+
+namespace {
+
+typedef EGLBoolean(EGLAPIENTRY* PFNQUERYDEVICEBINARY)(EGLDeviceEXT device,
+                                                      EGLint name,
+                                                      EGLint max_size,
+                                                      void* value,
+                                                      EGLint* size);
+
+int HexValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+// Parses "GPU-xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx" (the prefix and dashes
+// are optional) into 16 bytes.
+bool ParseUuid(const char* spec, CUuuid* uuid) {
+  if (strncmp(spec, "GPU-", 4) == 0)
+    spec += 4;
+  int nibbles = 0;
+  for (const char* p = spec; *p; ++p) {
+    if (*p == '-')
+      continue;
+    int v = HexValue(*p);
+    if (v < 0 || nibbles >= 32)
+      return false;
+    unsigned char& byte = reinterpret_cast<unsigned char&>(
+        uuid->bytes[nibbles / 2]);
+    byte = (nibbles % 2) ? static_cast<unsigned char>(byte | v)
+                         : static_cast<unsigned char>(v << 4);
+    ++nibbles;
+  }
+  return nibbles == 32;
+}
+
+bool ParseOrdinal(const char* spec, int* ordinal) {
+  if (!*spec)
+    return false;
+  char* end = nullptr;
+  long v = strtol(spec, &end, 10);
+  if (*end || v < 0 || v > INT_MAX)
+    return false;
+  *ordinal = static_cast<int>(v);
+  return true;
+}
+
+bool FindByUuid(const CUuuid& uuid, CUdevice* device) {
+  if (!cuDeviceGetUuid)
+    return false;
+  int count = 0;
+  if (cuDeviceGetCount(&count) != CUDA_SUCCESS)
+    return false;
+  for (int i = 0; i < count; ++i) {
+    CUdevice candidate;
+    CUuuid candidate_uuid;
+    if (cuDeviceGet(&candidate, i) != CUDA_SUCCESS ||
+        cuDeviceGetUuid(&candidate_uuid, candidate) != CUDA_SUCCESS) {
+      continue;
+    }
+    if (memcmp(candidate_uuid.bytes, uuid.bytes, sizeof(uuid.bytes)) == 0) {
+      *device = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FindByPciBusId(const std::string& bus_id, CUdevice* device) {
+  if (bus_id.empty() || !cuDeviceGetPCIBusId)
+    return false;
+  int count = 0;
+  if (cuDeviceGetCount(&count) != CUDA_SUCCESS)
+    return false;
+  for (int i = 0; i < count; ++i) {
+    CUdevice candidate;
+    char candidate_bus_id[32] = {};
+    if (cuDeviceGet(&candidate, i) != CUDA_SUCCESS ||
+        cuDeviceGetPCIBusId(candidate_bus_id, sizeof(candidate_bus_id),
+                            candidate) != CUDA_SUCCESS) {
+      continue;
+    }
+    if (NormalizePciBusId(candidate_bus_id) == bus_id) {
+      *device = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SelectOverride(const char* spec, CUdevice* device) {
+  int ordinal = 0;
+  if (ParseOrdinal(spec, &ordinal))
+    return cuDeviceGet(device, ordinal) == CUDA_SUCCESS;
+
+  CUuuid uuid = {};
+  if (ParseUuid(spec, &uuid))
+    return FindByUuid(uuid, device);
+
+  return FindByPciBusId(NormalizePciBusId(spec), device);
+}
+
+// PCI bus id of the device behind a DRM node such as /dev/dri/card1, read
+// from the sysfs device link.
+std::string PciBusIdForDrmNode(const char* node) {
+  const char* name = strrchr(node, '/');
+  name = name ? name + 1 : node;
+  std::string link = std::string("/sys/class/drm/") + name + "/device";
+  char resolved[PATH_MAX];
+  if (!realpath(link.c_str(), resolved))
+    return std::string();
+  const char* base = strrchr(resolved, '/');
+  return NormalizePciBusId(base ? base + 1 : resolved);
+}
+
+}  // namespace
+
+std::string NormalizePciBusId(const char* bus_id) {
+  unsigned int domain = 0, bus = 0, dev = 0, func = 0;
+  if (sscanf(bus_id, "%x:%x:%x.%x", &domain, &bus, &dev, &func) != 4) {
+    // Some tools omit the domain.
+    domain = 0;
+    if (sscanf(bus_id, "%x:%x.%x", &bus, &dev, &func) != 3)
+      return std::string();
+  }
+  char out[32];
+  snprintf(out, sizeof(out), "%04x:%02x:%02x.%x", domain & 0xffff, bus & 0xff,
+           dev & 0x1f, func & 0x7);
+  return out;
+}
+
+bool QueryEglDeviceIdentity(EGLDisplay display, EglDeviceIdentity* identity) {
+  if (display == EGL_NO_DISPLAY) {
+    identity->unavailable = "no current egl display";
+    return false;
+  }
+
+  // A client extension; without it the entry points below may not even be
+  // bound.
+  const char* client_extensions =
+      eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (!client_extensions ||
+      !strstr(client_extensions, "EGL_EXT_device_query")) {
+    identity->unavailable = "no EGL_EXT_device_query";
+    return false;
+  }
+
+  EGLAttrib attrib = 0;
+  if (!eglQueryDisplayAttribEXT(display, EGL_DEVICE_EXT, &attrib) || !attrib) {
+    identity->unavailable = "display has no egl device";
+    return false;
+  }
+  EGLDeviceEXT egl_device = reinterpret_cast<EGLDeviceEXT>(attrib);
+
+  const char* extensions =
+      eglQueryDeviceStringEXT(egl_device, EGL_EXTENSIONS);
+  if (!extensions) {
+    identity->unavailable = "egl device has no extensions";
+    return false;
+  }
+
+  if (strstr(extensions, "EGL_EXT_device_persistent_id")) {
+    auto query_binary = reinterpret_cast<PFNQUERYDEVICEBINARY>(
+        eglGetProcAddress("eglQueryDeviceBinaryEXT"));
+    EGLint size = 0;
+    if (query_binary &&
+        query_binary(egl_device, EGL_DEVICE_UUID_EXT,
+                     sizeof(identity->uuid.bytes), identity->uuid.bytes,
+                     &size) &&
+        size == sizeof(identity->uuid.bytes)) {
+      identity->has_uuid = true;
+    }
+  }
+
+  if (strstr(extensions, "EGL_EXT_device_drm")) {
+    const char* node =
+        eglQueryDeviceStringEXT(egl_device, EGL_DRM_DEVICE_FILE_EXT);
+    if (node)
+      identity->pci_bus_id = PciBusIdForDrmNode(node);
+  }
+
+  if (!identity->has_uuid && identity->pci_bus_id.empty()) {
+    identity->unavailable = "egl device has neither uuid nor drm node";
+    return false;
+  }
+  return true;
+}
+
+bool SelectCudaDevice(const EglDeviceIdentity& identity,
+                      const char* override_spec,
+                      CUdevice* device,
+                      const char** reason) {
+  if (override_spec && *override_spec) {
+    // An explicit choice that does not resolve is a configuration error;
+    // falling back silently would hide it on exactly the hosts it matters.
+    *reason = "override";
+    return SelectOverride(override_spec, device);
+  }
+
+  if (identity.has_uuid && FindByUuid(identity.uuid, device)) {
+    *reason = "egl uuid";
+    return true;
+  }
+
+  if (FindByPciBusId(identity.pci_bus_id, device)) {
+    *reason = "egl pci bus id";
+    return true;
+  }
+
+  if (cuGLGetDevices) {
+    unsigned int count = 0;
+    CUdevice gl_device;
+    if (cuGLGetDevices(&count, &gl_device, 1, CU_GL_DEVICE_LIST_ALL) ==
+            CUDA_SUCCESS &&
+        count > 0) {
+      *device = gl_device;
+      *reason = "gl context";
+      return true;
+    }
+  }
+
+  *reason = "default";
+  return cuDeviceGet(device, 0) == CUDA_SUCCESS;
+}
+
+}  // namespace viz
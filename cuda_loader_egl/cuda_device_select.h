@@ -0,0 +1,48 @@
+#ifndef __cuda_device_select_h__
+#define __cuda_device_select_h__
+
+#include <string>
+
+#include "cuda_wrapper_include.h"
+
+namespace viz {
+
+// Environment variable that pins the export device. Accepts a CUDA ordinal
+// ("1"), a device UUID as printed by nvidia-smi ("GPU-xxxxxxxx-...") or a
+// PCI bus id ("0000:65:00.0").
+inline constexpr char kCudaExportDeviceEnv[] = "CUDA_EXPORT_DEVICE";
+
+// Identity of the GPU behind an EGL display, as far as the EGL
+// implementation is willing to tell.
+struct EglDeviceIdentity {
+  bool has_uuid = false;
+  CUuuid uuid = {};
+  // Normalized "dddd:bb:dd.f", empty when unknown.
+  std::string pci_bus_id;
+  // Why neither is known, for the log. ANGLE displays in particular often
+  // do not expose the EGL device at all.
+  const char* unavailable = nullptr;
+};
+
+// Reads the device UUID (EGL_EXT_device_persistent_id) and the PCI bus id
+// behind the DRM node (EGL_EXT_device_drm) of |display|. Returns false, with
+// |identity->unavailable| set, when neither is available.
+bool QueryEglDeviceIdentity(EGLDisplay display, EglDeviceIdentity* identity);
+
+// Picks the CUDA device to export from, using only the loaded driver entry
+// points. In order: |override_spec| when set, UUID match, PCI bus id match,
+// the devices cuGLGetDevices reports for the current GL context (only once
+// CU_DRVAPI_SYMBOLS_GL was required), ordinal 0.
+// |reason| receives a short description of the rule that matched.
+bool SelectCudaDevice(const EglDeviceIdentity& identity,
+                      const char* override_spec,
+                      CUdevice* device,
+                      const char** reason);
+
+// Canonical "dddd:bb:dd.f" form of a PCI bus id, or an empty string when
+// |bus_id| does not parse. CUDA and sysfs disagree on width and case.
+std::string NormalizePciBusId(const char* bus_id);
+
+}  // namespace viz
+
+#endif  // __cuda_device_select_h__
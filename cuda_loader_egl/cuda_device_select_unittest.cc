@@ -0,0 +1,127 @@
+#include "cuda_device_select.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cuda_stub_driver_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace viz {
+
+namespace {
+
+// The stub reports "cudastub" followed by the ordinal as device UUID and
+// 0000:1N:00.0 as PCI bus id of device N.
+CUuuid StubUuid(int ordinal) {
+  CUuuid uuid = {};
+  memcpy(uuid.bytes, "cudastub", 8);
+  uuid.bytes[15] = static_cast<char>(ordinal);
+  return uuid;
+}
+
+class CudaDeviceSelectTest : public testing::Test {
+ protected:
+  void SetUp() override { ASSERT_EQ(CUDA_SUCCESS, InitCudaStubDriver()); }
+
+  // Runs SelectCudaDevice and returns the ordinal it picked, or -1.
+  int Select(const EglDeviceIdentity& identity, const char* override_spec) {
+    CUdevice device = -1;
+    reason_ = nullptr;
+    if (!SelectCudaDevice(identity, override_spec, &device, &reason_))
+      return -1;
+    return static_cast<int>(device);
+  }
+
+  const char* reason_ = nullptr;
+};
+
+TEST_F(CudaDeviceSelectTest, OverrideByOrdinal) {
+  EXPECT_EQ(2, Select(EglDeviceIdentity(), "2"));
+  EXPECT_STREQ("override", reason_);
+}
+
+TEST_F(CudaDeviceSelectTest, OverrideByUuid) {
+  EXPECT_EQ(3, Select(EglDeviceIdentity(),
+                      "GPU-63756461-7374-7562-0000-000000000003"));
+  EXPECT_STREQ("override", reason_);
+}
+
+TEST_F(CudaDeviceSelectTest, OverrideByPciBusId) {
+  EXPECT_EQ(1, Select(EglDeviceIdentity(), "0000:11:00.0"));
+  EXPECT_EQ(2, Select(EglDeviceIdentity(), "12:00.0"));
+}
+
+TEST_F(CudaDeviceSelectTest, OverrideWinsOverEglIdentity) {
+  EglDeviceIdentity identity;
+  identity.has_uuid = true;
+  identity.uuid = StubUuid(3);
+  EXPECT_EQ(1, Select(identity, "1"));
+  EXPECT_STREQ("override", reason_);
+}
+
+// A pinned device that does not exist must not fall back to another one.
+TEST_F(CudaDeviceSelectTest, UnknownOverrideFails) {
+  EglDeviceIdentity identity;
+  identity.pci_bus_id = "0000:12:00.0";
+  EXPECT_EQ(-1, Select(identity, "7"));
+  EXPECT_EQ(-1, Select(identity, "GPU-00000000-0000-0000-0000-000000000000"));
+  EXPECT_EQ(-1, Select(identity, "0000:65:00.0"));
+  EXPECT_STREQ("override", reason_);
+}
+
+TEST_F(CudaDeviceSelectTest, EglUuidBeforePciBusId) {
+  EglDeviceIdentity identity;
+  identity.has_uuid = true;
+  identity.uuid = StubUuid(3);
+  identity.pci_bus_id = "0000:12:00.0";
+  EXPECT_EQ(3, Select(identity, nullptr));
+  EXPECT_STREQ("egl uuid", reason_);
+}
+
+TEST_F(CudaDeviceSelectTest, PciBusIdWhenUuidDoesNotMatch) {
+  EglDeviceIdentity identity;
+  identity.has_uuid = true;
+  identity.uuid = StubUuid(9);
+  identity.pci_bus_id = "0000:12:00.0";
+  EXPECT_EQ(2, Select(identity, ""));
+  EXPECT_STREQ("egl pci bus id", reason_);
+}
+
+// Needs a loader that has not resolved the GL group yet, so it starts from
+// a fresh process.
+void ExpectDefaultThenGlContext() {
+  setenv("CUDA_STUB_GL_DEVICE", "3", /*overwrite=*/1);
+  ASSERT_EQ(CUDA_SUCCESS, InitCudaStubDriver());
+
+  EglDeviceIdentity identity;
+  identity.unavailable = "no EGL_EXT_device_query";
+  CUdevice device = -1;
+  const char* reason = nullptr;
+
+  // cuGLGetDevices is only consulted once the GL group was required.
+  ASSERT_TRUE(SelectCudaDevice(identity, nullptr, &device, &reason));
+  EXPECT_EQ(0, device);
+  EXPECT_STREQ("default", reason);
+
+  ASSERT_EQ(CUDA_SUCCESS, cuDrvApiRequire(CU_DRVAPI_SYMBOLS_GL));
+  ASSERT_TRUE(SelectCudaDevice(identity, nullptr, &device, &reason));
+  EXPECT_EQ(3, device);
+  EXPECT_STREQ("gl context", reason);
+}
+
+TEST(CudaDeviceSelectFallbackTest, DefaultThenGlContext) {
+  EXPECT_IN_FRESH_PROCESS(ExpectDefaultThenGlContext());
+}
+
+TEST(NormalizePciBusIdTest, Forms) {
+  EXPECT_EQ("0000:65:00.0", NormalizePciBusId("0000:65:00.0"));
+  EXPECT_EQ("0000:65:00.0", NormalizePciBusId("00000000:65:00.0"));
+  EXPECT_EQ("0000:0a:1f.7", NormalizePciBusId("0000:0A:1F.7"));
+  EXPECT_EQ("0000:65:00.0", NormalizePciBusId("65:00.0"));
+  EXPECT_EQ("", NormalizePciBusId("GPU-1234"));
+  EXPECT_EQ("", NormalizePciBusId(""));
+}
+
+}  // namespace
+
+}  // namespace viz
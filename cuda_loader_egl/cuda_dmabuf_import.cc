@@ -0,0 +1,269 @@
+#include "cuda_dmabuf_import.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <vector>
+
+#include "ui/gl/gl_bindings.h"
+
+namespace viz {
+
+namespace {
+
+// NVIDIA's EGL imports dma-bufs from R470 (CUDA 11.4) on; older drivers
+// have the interop entry points but no image to register.
+constexpr int kMinDriverVersion = 11040;
+
+// BGRA in memory, the only format the capture path produces.
+constexpr EGLint kDrmFormatArgb8888 = 0x34325241;  // 'AR24'
+
+// DRM_FORMAT_MOD_LINEAR and DRM_FORMAT_MOD_INVALID; the latter means the
+// layout was agreed on implicitly.
+constexpr uint64_t kDrmFormatModLinear = 0;
+constexpr uint64_t kDrmFormatModInvalid = 0x00ffffffffffffffull;
+
+// How long the CPU fallback of WaitForGL() waits for the blit.
+constexpr GLuint64 kGLFenceTimeoutNs = 100 * 1000 * 1000;
+
+bool HasExtension(EGLDisplay display, const char* name) {
+  const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+  if (!extensions)
+    return false;
+  const size_t length = strlen(name);
+  for (const char* p = strstr(extensions, name); p;
+       p = strstr(p + length, name)) {
+    if ((p == extensions || p[-1] == ' ') &&
+        (p[length] == ' ' || p[length] == '\0')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+CudaDmaBufImportCache::CudaDmaBufImportCache(size_t max_entries)
+    : max_entries_(max_entries ? max_entries : 1) {}
+
+CudaDmaBufImportCache::~CudaDmaBufImportCache() {
+  Clear();
+}
+
+// static
+bool CudaDmaBufImportCache::IsSupported() {
+  // Resolved once; later calls only test the group bit.
+  if (cuDrvApiRequire(CU_DRVAPI_SYMBOLS_EGL) != CUDA_SUCCESS ||
+      !(cuDrvApiGetCapabilities() & CU_DRVAPI_CAP_EGL_INTEROP)) {
+    return false;
+  }
+  CUdrvapiInfo info = {};
+  cuDrvApiGetInfo(&info);
+  return info.driverVersion >= kMinDriverVersion;
+}
+
+bool CudaDmaBufImportCache::Init(EGLDisplay display) {
+  if (display == EGL_NO_DISPLAY ||
+      !HasExtension(display, "EGL_EXT_image_dma_buf_import")) {
+    fprintf(stdout,
+            "[CudaOffscreenHook] egl display cannot import dma-bufs\n");
+    return false;
+  }
+  EglFunctions egl;
+  egl.create_image = reinterpret_cast<PFNEGLCREATEIMAGEKHRPROC>(
+      eglGetProcAddress("eglCreateImageKHR"));
+  egl.destroy_image = reinterpret_cast<PFNEGLDESTROYIMAGEKHRPROC>(
+      eglGetProcAddress("eglDestroyImageKHR"));
+  if (!egl.create_image || !egl.destroy_image)
+    return false;
+  if (HasExtension(display, "EGL_KHR_fence_sync")) {
+    egl.create_sync = reinterpret_cast<PFNEGLCREATESYNCKHRPROC>(
+        eglGetProcAddress("eglCreateSyncKHR"));
+    egl.destroy_sync = reinterpret_cast<PFNEGLDESTROYSYNCKHRPROC>(
+        eglGetProcAddress("eglDestroySyncKHR"));
+  }
+  InitForTesting(
+      display, HasExtension(display, "EGL_EXT_image_dma_buf_import_modifiers"),
+      egl);
+  return true;
+}
+
+void CudaDmaBufImportCache::InitForTesting(EGLDisplay display,
+                                           bool has_modifiers,
+                                           const EglFunctions& egl) {
+  display_ = display;
+  has_modifiers_ = has_modifiers;
+  egl_ = egl;
+}
+
+bool CudaDmaBufImportCache::Import(const CudaExportDmaBufDesc& desc,
+                                   Mapping* mapping) {
+  struct stat st;
+  if (desc.fd < 0 || fstat(desc.fd, &st) != 0)
+    return false;
+
+  const Key key(st.st_dev, st.st_ino);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    const CudaExportDmaBufDesc& known = it->second.desc;
+    if (known.offset == desc.offset && known.stride == desc.stride &&
+        known.modifier == desc.modifier && known.width == desc.width &&
+        known.height == desc.height) {
+      it->second.last_use = ++use_counter_;
+      *mapping = it->second.mapping;
+      return true;
+    }
+    // Same buffer described differently: the pool was reallocated.
+    Release(&it->second);
+    entries_.erase(it);
+  }
+
+  Entry entry;
+  if (!ImportEntry(desc, &entry)) {
+    Release(&entry);
+    return false;
+  }
+  ++import_count_;
+  entry.last_use = ++use_counter_;
+
+  if (entries_.size() >= max_entries_)
+    EvictOldest();
+
+  fprintf(stdout,
+          "[CudaOffscreenHook] imported dma-buf ino=%llu size=%dx%d "
+          "modifier=0x%llx %s cached=%zu\n",
+          static_cast<unsigned long long>(st.st_ino), desc.width, desc.height,
+          static_cast<unsigned long long>(desc.modifier),
+          entry.mapping.array ? "array" : "pitch", entries_.size() + 1);
+  fflush(stdout);
+
+  *mapping = entry.mapping;
+  entries_.emplace(key, entry);
+  return true;
+}
+
+bool CudaDmaBufImportCache::WaitForGL(CUstream stream, EGLSyncKHR* fence) {
+  *fence = EGL_NO_SYNC_KHR;
+  if (cuEventCreateFromEGLSync && egl_.create_sync && egl_.destroy_sync)
+    *fence = egl_.create_sync(display_, EGL_SYNC_FENCE_KHR, nullptr);
+  if (*fence != EGL_NO_SYNC_KHR) {
+    // A fence that was never flushed does not signal.
+    glFlush();
+    CUevent event = nullptr;
+    CUresult status = cuEventCreateFromEGLSync(&event, *fence, 0);
+    if (status == CUDA_SUCCESS) {
+      status = cuStreamWaitEvent(stream, event, 0);
+      // The event goes away once the wait is over.
+      cuEventDestroy(event);
+    }
+    if (status == CUDA_SUCCESS)
+      return true;
+    ReleaseFence(*fence);
+    *fence = EGL_NO_SYNC_KHR;
+  }
+
+  GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  if (!sync)
+    return false;
+  const GLenum result =
+      glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, kGLFenceTimeoutNs);
+  glDeleteSync(sync);
+  return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+void CudaDmaBufImportCache::ReleaseFence(EGLSyncKHR fence) {
+  if (fence != EGL_NO_SYNC_KHR)
+    egl_.destroy_sync(display_, fence);
+}
+
+bool CudaDmaBufImportCache::ImportEntry(const CudaExportDmaBufDesc& desc,
+                                        Entry* entry) {
+  if (!egl_.create_image)
+    return false;
+
+  const bool pass_modifier = desc.modifier != kDrmFormatModInvalid;
+  if (pass_modifier && !has_modifiers_ &&
+      desc.modifier != kDrmFormatModLinear) {
+    fprintf(stdout, "[CudaOffscreenHook] unsupported dma-buf modifier 0x%llx\n",
+            static_cast<unsigned long long>(desc.modifier));
+    return false;
+  }
+
+  std::vector<EGLint> attribs = {
+      EGL_WIDTH, desc.width,
+      EGL_HEIGHT, desc.height,
+      EGL_LINUX_DRM_FOURCC_EXT, kDrmFormatArgb8888,
+      EGL_DMA_BUF_PLANE0_FD_EXT, desc.fd,
+      EGL_DMA_BUF_PLANE0_OFFSET_EXT, static_cast<EGLint>(desc.offset),
+      EGL_DMA_BUF_PLANE0_PITCH_EXT, static_cast<EGLint>(desc.stride),
+  };
+  if (pass_modifier && has_modifiers_) {
+    attribs.insert(attribs.end(),
+                   {EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT,
+                    static_cast<EGLint>(desc.modifier & 0xffffffff),
+                    EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT,
+                    static_cast<EGLint>(desc.modifier >> 32)});
+  }
+  attribs.push_back(EGL_NONE);
+
+  // EGL does not take the fd; it only has to stay open for this call.
+  entry->desc = desc;
+  entry->image = egl_.create_image(display_, EGL_NO_CONTEXT,
+                                   EGL_LINUX_DMA_BUF_EXT, nullptr,
+                                   attribs.data());
+  if (entry->image == EGL_NO_IMAGE_KHR) {
+    fprintf(stdout, "[CudaOffscreenHook] eglCreateImageKHR failed 0x%x\n",
+            eglGetError());
+    return false;
+  }
+
+  // Registered images stay mapped for as long as they are registered.
+  CUeglFrame frame;
+  if (CHECK_CU(cuGraphicsEGLRegisterImage(
+          &entry->resource, entry->image,
+          CU_GRAPHICS_REGISTER_FLAGS_READ_ONLY)) ||
+      CHECK_CU(cuGraphicsResourceGetMappedEglFrame(&frame, entry->resource,
+                                                   0, 0))) {
+    return false;
+  }
+  if (frame.frameType == CU_EGL_FRAME_TYPE_ARRAY) {
+    entry->mapping.array = frame.frame.pArray[0];
+  } else {
+    entry->mapping.ptr = reinterpret_cast<CUdeviceptr>(frame.frame.pPitch[0]);
+    entry->mapping.pitch = frame.pitch;
+  }
+  return true;
+}
+
+void CudaDmaBufImportCache::Clear() {
+  for (auto& it : entries_)
+    Release(&it.second);
+  entries_.clear();
+}
+
+void CudaDmaBufImportCache::Release(Entry* entry) {
+  if (entry->resource) {
+    cuGraphicsUnregisterResource(entry->resource);
+    entry->resource = nullptr;
+  }
+  if (entry->image != EGL_NO_IMAGE_KHR) {
+    egl_.destroy_image(display_, entry->image);
+    entry->image = EGL_NO_IMAGE_KHR;
+  }
+  entry->mapping = Mapping();
+}
+
+void CudaDmaBufImportCache::EvictOldest() {
+  auto oldest = entries_.begin();
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->second.last_use < oldest->second.last_use)
+      oldest = it;
+  }
+  if (oldest == entries_.end())
+    return;
+  Release(&oldest->second);
+  entries_.erase(oldest);
+}
+
+}  // namespace viz
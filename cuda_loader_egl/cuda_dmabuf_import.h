@@ -0,0 +1,120 @@
+#ifndef __cuda_dmabuf_import_h__
+#define __cuda_dmabuf_import_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <map>
+#include <utility>
+
+#include "cuda_wrapper_include.h"
+
+namespace viz {
+
+// Single plane BGRA DMA-BUF backing a captured frame. |fd| is only borrowed
+// for the duration of the call it is passed to.
+struct CudaExportDmaBufDesc {
+  int fd = -1;
+  uint32_t offset = 0;
+  uint32_t stride = 0;
+  uint64_t modifier = 0;
+  int width = 0;
+  int height = 0;
+};
+
+// Imports DMA-BUFs into CUDA, once per underlying buffer. CUDA has no
+// dma-buf handle type, so each buffer is wrapped in an EGLImage on the GL
+// context's display and registered with cuGraphicsEGLRegisterImage; EGL
+// takes care of the modifier and the driver hands back a mapped frame.
+// Buffers come from a pool and are handed over with a fresh fd number every
+// frame, so entries are keyed by the dma-buf inode rather than by fd.
+//
+// A CUDA context must be current on every call after Init().
+class CudaDmaBufImportCache {
+ public:
+  // The imported frame, a CUDA array or pitch linear device memory depending
+  // on how the driver lays out the EGLImage. Both stay valid until the
+  // buffer is evicted.
+  struct Mapping {
+    CUarray array = nullptr;
+    CUdeviceptr ptr = 0;
+    size_t pitch = 0;
+  };
+
+  // The EGL entry points used; tests without a GPU replace them.
+  struct EglFunctions {
+    PFNEGLCREATEIMAGEKHRPROC create_image = nullptr;
+    PFNEGLDESTROYIMAGEKHRPROC destroy_image = nullptr;
+    // Optional; without them WaitForGL() waits on the CPU.
+    PFNEGLCREATESYNCKHRPROC create_sync = nullptr;
+    PFNEGLDESTROYSYNCKHRPROC destroy_sync = nullptr;
+  };
+
+  // |max_entries| bounds the number of buffers kept imported; the least
+  // recently used one is released when a new buffer shows up.
+  explicit CudaDmaBufImportCache(size_t max_entries);
+  ~CudaDmaBufImportCache();
+
+  CudaDmaBufImportCache(const CudaDmaBufImportCache&) = delete;
+  CudaDmaBufImportCache& operator=(const CudaDmaBufImportCache&) = delete;
+
+  // True when the loaded driver is recent enough and has EGL interop.
+  static bool IsSupported();
+
+  // Imports into |display|, the display of the current GL context. False
+  // if it cannot import dma-bufs; without the modifiers extension only
+  // linear buffers are accepted.
+  bool Init(EGLDisplay display);
+  // Init() without asking |display| or the real EGL library.
+  void InitForTesting(EGLDisplay display,
+                      bool has_modifiers,
+                      const EglFunctions& egl);
+
+  // Returns the mapping of the buffer behind |desc|, importing it on first
+  // use.
+  bool Import(const CudaExportDmaBufDesc& desc, Mapping* mapping);
+
+  // Makes |stream| wait for the GL commands issued so far on the current
+  // context, such as the blit into a buffer about to be read. |*fence| is
+  // the EGL fence behind the wait and goes to ReleaseFence() once |stream|
+  // is done with the buffer. It is EGL_NO_SYNC_KHR when the driver cannot
+  // wait on EGL fences; the wait happened on the CPU then.
+  bool WaitForGL(CUstream stream, EGLSyncKHR* fence);
+  void ReleaseFence(EGLSyncKHR fence);
+
+  // Releases every imported buffer.
+  void Clear();
+
+  size_t size() const { return entries_.size(); }
+  // Number of EGLImages registered so far; the difference to the number of
+  // Import() calls is the hit count.
+  uint64_t import_count() const { return import_count_; }
+
+ private:
+  using Key = std::pair<dev_t, ino_t>;
+
+  struct Entry {
+    CudaExportDmaBufDesc desc;
+    EGLImageKHR image = EGL_NO_IMAGE_KHR;
+    CUgraphicsResource resource = nullptr;
+    Mapping mapping;
+    uint64_t last_use = 0;
+  };
+
+  bool ImportEntry(const CudaExportDmaBufDesc& desc, Entry* entry);
+  void Release(Entry* entry);
+  void EvictOldest();
+
+  const size_t max_entries_;
+  EGLDisplay display_ = EGL_NO_DISPLAY;
+  bool has_modifiers_ = false;
+  EglFunctions egl_;
+  uint64_t use_counter_ = 0;
+  uint64_t import_count_ = 0;
+  std::map<Key, Entry> entries_;
+};
+
+}  // namespace viz
+
+#endif  // __cuda_dmabuf_import_h__
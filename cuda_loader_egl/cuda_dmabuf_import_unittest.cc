@@ -0,0 +1,269 @@
+#include "cuda_dmabuf_import.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "cuda_stub_driver_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace viz {
+
+namespace {
+
+// I915_FORMAT_MOD_X_TILED
+constexpr uint64_t kTiledModifier = 0x0100000000000001ull;
+
+// Stands in for EGL: hands out distinct images and remembers what it was
+// asked for.
+struct FakeEgl {
+  std::vector<std::vector<EGLint>> created;
+  int destroyed = 0;
+  int syncs = 0;
+  int syncs_destroyed = 0;
+};
+
+FakeEgl* g_egl = nullptr;
+
+EGLImageKHR EGLAPIENTRY FakeCreateImage(EGLDisplay display,
+                                        EGLContext context,
+                                        EGLenum target,
+                                        EGLClientBuffer buffer,
+                                        const EGLint* attribs) {
+  if (target != EGL_LINUX_DMA_BUF_EXT || context != EGL_NO_CONTEXT)
+    return EGL_NO_IMAGE_KHR;
+  std::vector<EGLint> list;
+  for (const EGLint* attrib = attribs; *attrib != EGL_NONE; attrib += 2)
+    list.insert(list.end(), {attrib[0], attrib[1]});
+  g_egl->created.push_back(list);
+  return reinterpret_cast<EGLImageKHR>(g_egl->created.size());
+}
+
+EGLBoolean EGLAPIENTRY FakeDestroyImage(EGLDisplay display,
+                                        EGLImageKHR image) {
+  ++g_egl->destroyed;
+  return EGL_TRUE;
+}
+
+EGLSyncKHR EGLAPIENTRY FakeCreateSync(EGLDisplay display,
+                                      EGLenum type,
+                                      const EGLint* attribs) {
+  if (type != EGL_SYNC_FENCE_KHR)
+    return EGL_NO_SYNC_KHR;
+  return reinterpret_cast<EGLSyncKHR>(++g_egl->syncs);
+}
+
+EGLBoolean EGLAPIENTRY FakeDestroySync(EGLDisplay display, EGLSyncKHR sync) {
+  ++g_egl->syncs_destroyed;
+  return EGL_TRUE;
+}
+
+// Value of |name| in an attribute list, or -1.
+EGLint Attrib(const std::vector<EGLint>& list, EGLint name) {
+  for (size_t i = 0; i + 1 < list.size(); i += 2) {
+    if (list[i] == name)
+      return list[i + 1];
+  }
+  return -1;
+}
+
+class CudaDmaBufImportTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_EQ(CUDA_SUCCESS, InitCudaStubDriver());
+    ASSERT_TRUE(CudaDmaBufImportCache::IsSupported());
+    ASSERT_EQ(CUDA_SUCCESS, cuCtxCreate(&context_, 0, 0));
+    g_egl = &egl_;
+  }
+
+  void TearDown() override {
+    for (int fd : fds_)
+      close(fd);
+    cuCtxDestroy(context_);
+    g_egl = nullptr;
+  }
+
+  // |cache| with the fake EGL, as if the display had the modifiers
+  // extension or not.
+  void Init(CudaDmaBufImportCache* cache, bool has_modifiers) {
+    CudaDmaBufImportCache::EglFunctions egl;
+    egl.create_image = &FakeCreateImage;
+    egl.destroy_image = &FakeDestroyImage;
+    egl.create_sync = &FakeCreateSync;
+    egl.destroy_sync = &FakeDestroySync;
+    cache->InitForTesting(reinterpret_cast<EGLDisplay>(1), has_modifiers,
+                          egl);
+  }
+
+  // A memfd stands in for the dma-buf; only its inode matters.
+  CudaExportDmaBufDesc NewBuffer() {
+    CudaExportDmaBufDesc desc;
+    desc.fd = memfd_create("cuda_dmabuf_import_unittest", MFD_CLOEXEC);
+    fds_.push_back(desc.fd);
+    desc.offset = 256;
+    desc.stride = 1920 * 4;
+    desc.width = 1920;
+    desc.height = 1080;
+    return desc;
+  }
+
+  // The same buffer under another fd number, as the next frame brings it.
+  CudaExportDmaBufDesc Dup(const CudaExportDmaBufDesc& desc) {
+    CudaExportDmaBufDesc copy = desc;
+    copy.fd = dup(desc.fd);
+    fds_.push_back(copy.fd);
+    return copy;
+  }
+
+  CUcontext context_ = nullptr;
+  FakeEgl egl_;
+  std::vector<int> fds_;
+};
+
+TEST_F(CudaDmaBufImportTest, ImportsOncePerBuffer) {
+  CudaDmaBufImportCache cache(4);
+  Init(&cache, /*has_modifiers=*/true);
+  const CudaExportDmaBufDesc a = NewBuffer();
+  const CudaExportDmaBufDesc b = NewBuffer();
+
+  CudaDmaBufImportCache::Mapping first, again, other;
+  ASSERT_TRUE(cache.Import(a, &first));
+  ASSERT_TRUE(cache.Import(Dup(a), &again));
+  ASSERT_TRUE(cache.Import(b, &other));
+
+  // The stub maps EGL images as arrays.
+  EXPECT_NE(nullptr, first.array);
+  EXPECT_EQ(first.array, again.array);
+  EXPECT_NE(first.array, other.array);
+  EXPECT_EQ(2u, cache.import_count());
+  EXPECT_EQ(2u, cache.size());
+}
+
+TEST_F(CudaDmaBufImportTest, PassesLayoutToEgl) {
+  CudaDmaBufImportCache cache(4);
+  Init(&cache, /*has_modifiers=*/true);
+  const CudaExportDmaBufDesc desc = NewBuffer();
+  CudaDmaBufImportCache::Mapping mapping;
+  ASSERT_TRUE(cache.Import(desc, &mapping));
+
+  ASSERT_EQ(1u, egl_.created.size());
+  const std::vector<EGLint>& attribs = egl_.created[0];
+  EXPECT_EQ(1920, Attrib(attribs, EGL_WIDTH));
+  EXPECT_EQ(1080, Attrib(attribs, EGL_HEIGHT));
+  EXPECT_EQ(0x34325241, Attrib(attribs, EGL_LINUX_DRM_FOURCC_EXT));
+  EXPECT_EQ(desc.fd, Attrib(attribs, EGL_DMA_BUF_PLANE0_FD_EXT));
+  EXPECT_EQ(256, Attrib(attribs, EGL_DMA_BUF_PLANE0_OFFSET_EXT));
+  EXPECT_EQ(1920 * 4, Attrib(attribs, EGL_DMA_BUF_PLANE0_PITCH_EXT));
+  EXPECT_EQ(0, Attrib(attribs, EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT));
+  EXPECT_EQ(0, Attrib(attribs, EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT));
+}
+
+TEST_F(CudaDmaBufImportTest, TiledNeedsModifierExtension) {
+  CudaDmaBufImportCache without(4);
+  Init(&without, /*has_modifiers=*/false);
+  CudaExportDmaBufDesc linear = NewBuffer();
+  CudaExportDmaBufDesc tiled = NewBuffer();
+  tiled.modifier = kTiledModifier;
+
+  CudaDmaBufImportCache::Mapping mapping;
+  ASSERT_TRUE(without.Import(linear, &mapping));
+  EXPECT_EQ(-1, Attrib(egl_.created.back(),
+                       EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT));
+  EXPECT_FALSE(without.Import(tiled, &mapping));
+  EXPECT_EQ(1u, egl_.created.size());
+
+  CudaDmaBufImportCache with(4);
+  Init(&with, /*has_modifiers=*/true);
+  ASSERT_TRUE(with.Import(tiled, &mapping));
+  EXPECT_EQ(1, Attrib(egl_.created.back(),
+                      EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT));
+  EXPECT_EQ(0x01000000, Attrib(egl_.created.back(),
+                               EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT));
+}
+
+TEST_F(CudaDmaBufImportTest, EvictsLeastRecentlyUsed) {
+  CudaDmaBufImportCache cache(2);
+  Init(&cache, /*has_modifiers=*/true);
+  const CudaExportDmaBufDesc a = NewBuffer();
+  const CudaExportDmaBufDesc b = NewBuffer();
+  const CudaExportDmaBufDesc c = NewBuffer();
+
+  CudaDmaBufImportCache::Mapping mapping;
+  ASSERT_TRUE(cache.Import(a, &mapping));
+  ASSERT_TRUE(cache.Import(b, &mapping));
+  ASSERT_TRUE(cache.Import(a, &mapping));
+  ASSERT_TRUE(cache.Import(c, &mapping));
+  EXPECT_EQ(2u, cache.size());
+  EXPECT_EQ(1, egl_.destroyed);
+
+  // |a| survived, |b| has to come back in.
+  ASSERT_TRUE(cache.Import(a, &mapping));
+  EXPECT_EQ(3u, cache.import_count());
+  ASSERT_TRUE(cache.Import(b, &mapping));
+  EXPECT_EQ(4u, cache.import_count());
+
+  cache.Clear();
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_EQ(4, egl_.destroyed);
+}
+
+TEST_F(CudaDmaBufImportTest, ReimportsWhenLayoutChanges) {
+  CudaDmaBufImportCache cache(4);
+  Init(&cache, /*has_modifiers=*/true);
+  const CudaExportDmaBufDesc desc = NewBuffer();
+  CudaExportDmaBufDesc resized = Dup(desc);
+  resized.width = 1280;
+  resized.height = 720;
+  resized.stride = 1280 * 4;
+
+  CudaDmaBufImportCache::Mapping mapping;
+  ASSERT_TRUE(cache.Import(desc, &mapping));
+  ASSERT_TRUE(cache.Import(resized, &mapping));
+  EXPECT_EQ(2u, cache.import_count());
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_EQ(1, egl_.destroyed);
+}
+
+TEST_F(CudaDmaBufImportTest, FailedImageIsNotCached) {
+  CudaDmaBufImportCache cache(4);
+  // No EGL functions at all, as before Init().
+  CudaDmaBufImportCache::Mapping mapping;
+  EXPECT_FALSE(cache.Import(NewBuffer(), &mapping));
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_EQ(0u, cache.import_count());
+}
+
+TEST_F(CudaDmaBufImportTest, StreamWaitsOnEglFence) {
+  CudaDmaBufImportCache cache(4);
+  Init(&cache, /*has_modifiers=*/true);
+  CUstream stream = nullptr;
+  ASSERT_EQ(CUDA_SUCCESS, cuStreamCreate(&stream, 0));
+
+  EGLSyncKHR fence = EGL_NO_SYNC_KHR;
+  ASSERT_TRUE(cache.WaitForGL(stream, &fence));
+  EXPECT_NE(EGL_NO_SYNC_KHR, fence);
+  EXPECT_EQ(1, egl_.syncs);
+  EXPECT_EQ(0, egl_.syncs_destroyed);
+  cache.ReleaseFence(fence);
+  EXPECT_EQ(1, egl_.syncs_destroyed);
+  cuStreamDestroy(stream);
+}
+
+// Needs a loader that has not resolved anything yet.
+void ExpectUnsupportedBefore11040() {
+  setenv("CUDA_STUB_DRIVER_VERSION", "11030", /*overwrite=*/1);
+  ASSERT_EQ(CUDA_SUCCESS, InitCudaStubDriver());
+  // The interop entry points are there, the driver is too old for them.
+  EXPECT_EQ(CUDA_SUCCESS, cuDrvApiRequire(CU_DRVAPI_SYMBOLS_EGL));
+  EXPECT_FALSE(CudaDmaBufImportCache::IsSupported());
+}
+
+TEST(CudaDmaBufImportSupportTest, DriverVersion) {
+  EXPECT_IN_FRESH_PROCESS(ExpectUnsupportedBefore11040());
+}
+
+}  // namespace
+
+}  // namespace viz
@@ -14,325 +14,248 @@
  *
  */
 
-// With these flags defined, this source file will dynamically
-// load the corresponding functions.  Disabled by default.
-//#define CUDA_INIT_D3D9
-//#define CUDA_INIT_D3D10
-//#define CUDA_INIT_D3D11
-//#define CUDA_INIT_OPENGL
+// dladdr, used to report where the driver was loaded from
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "cuda_drvapi_dynlink.h"
 
 tcuInit                               *_cuInit;
 tcuDriverGetVersion                   *cuDriverGetVersion;
-tcuDeviceGet                          *cuDeviceGet;
-tcuDeviceGetCount                     *cuDeviceGetCount;
-tcuDeviceGetName                      *cuDeviceGetName;
-tcuDeviceComputeCapability            *cuDeviceComputeCapability;
-tcuDeviceTotalMem                     *cuDeviceTotalMem;
-tcuDeviceGetProperties                *cuDeviceGetProperties;
-tcuDeviceGetAttribute                 *cuDeviceGetAttribute;
-tcuCtxCreate                          *cuCtxCreate;
-tcuCtxDestroy                         *cuCtxDestroy;
-tcuCtxAttach                          *cuCtxAttach;
-tcuCtxDetach                          *cuCtxDetach;
-tcuCtxPushCurrent                     *cuCtxPushCurrent;
-tcuCtxPopCurrent                      *cuCtxPopCurrent;
-tcuCtxGetCurrent                      *cuCtxGetCurrent;
-tcuCtxSetCurrent                      *cuCtxSetCurrent;
-tcuCtxGetDevice                       *cuCtxGetDevice;
-tcuCtxSynchronize                     *cuCtxSynchronize;
-tcuModuleLoad                         *cuModuleLoad;
-tcuModuleLoadData                     *cuModuleLoadData;
-tcuModuleLoadDataEx                   *cuModuleLoadDataEx;
-tcuModuleLoadFatBinary                *cuModuleLoadFatBinary;
-tcuModuleUnload                       *cuModuleUnload;
-tcuModuleGetFunction                  *cuModuleGetFunction;
-tcuModuleGetGlobal                    *cuModuleGetGlobal;
-tcuModuleGetTexRef                    *cuModuleGetTexRef;
-tcuModuleGetSurfRef                   *cuModuleGetSurfRef;
-tcuMemGetInfo                         *cuMemGetInfo;
-tcuMemAlloc                           *cuMemAlloc;
-tcuMemAllocPitch                      *cuMemAllocPitch;
-tcuMemFree                            *cuMemFree;
-tcuMemGetAddressRange                 *cuMemGetAddressRange;
-tcuMemAllocHost                       *cuMemAllocHost;
-tcuMemFreeHost                        *cuMemFreeHost;
-tcuMemHostAlloc                       *cuMemHostAlloc;
-tcuMemHostGetFlags                    *cuMemHostGetFlags;
-
-tcuMemHostGetDevicePointer            *cuMemHostGetDevicePointer;
-tcuDeviceGetByPCIBusId                *cuDeviceGetByPCIBusId;
-tcuDeviceGetPCIBusId                  *cuDeviceGetPCIBusId;
-tcuIpcGetEventHandle                  *cuIpcGetEventHandle;
-tcuIpcOpenEventHandle                 *cuIpcOpenEventHandle;
-tcuIpcGetMemHandle                    *cuIpcGetMemHandle;
-tcuIpcOpenMemHandle                   *cuIpcOpenMemHandle;
-tcuIpcCloseMemHandle                  *cuIpcCloseMemHandle;
-
-tcuMemHostRegister                    *cuMemHostRegister;
-tcuMemHostUnregister                  *cuMemHostUnregister;
-tcuMemcpyHtoD                         *cuMemcpyHtoD;
-tcuMemcpyDtoH                         *cuMemcpyDtoH;
-tcuMemcpyDtoD                         *cuMemcpyDtoD;
-tcuMemcpyDtoA                         *cuMemcpyDtoA;
-tcuMemcpyAtoD                         *cuMemcpyAtoD;
-tcuMemcpyHtoA                         *cuMemcpyHtoA;
-tcuMemcpyAtoH                         *cuMemcpyAtoH;
-tcuMemcpyAtoA                         *cuMemcpyAtoA;
-tcuMemcpy2D                           *cuMemcpy2D;
-tcuMemcpy2DUnaligned                  *cuMemcpy2DUnaligned;
-tcuMemcpy3D                           *cuMemcpy3D;
-tcuMemcpyHtoDAsync                    *cuMemcpyHtoDAsync;
-tcuMemcpyDtoHAsync                    *cuMemcpyDtoHAsync;
-tcuMemcpyDtoDAsync                    *cuMemcpyDtoDAsync;
-tcuMemcpyHtoAAsync                    *cuMemcpyHtoAAsync;
-tcuMemcpyAtoHAsync                    *cuMemcpyAtoHAsync;
-tcuMemcpy2DAsync                      *cuMemcpy2DAsync;
-tcuMemcpy3DAsync                      *cuMemcpy3DAsync;
-tcuMemcpy                             *cuMemcpy;
-tcuMemcpyPeer                         *cuMemcpyPeer;
-tcuMemsetD8                           *cuMemsetD8;
-tcuMemsetD16                          *cuMemsetD16;
-tcuMemsetD32                          *cuMemsetD32;
-tcuMemsetD2D8                         *cuMemsetD2D8;
-tcuMemsetD2D16                        *cuMemsetD2D16;
-tcuMemsetD2D32                        *cuMemsetD2D32;
-tcuFuncSetBlockShape                  *cuFuncSetBlockShape;
-tcuFuncSetSharedSize                  *cuFuncSetSharedSize;
-tcuFuncGetAttribute                   *cuFuncGetAttribute;
-tcuFuncSetCacheConfig                 *cuFuncSetCacheConfig;
-tcuFuncSetSharedMemConfig             *cuFuncSetSharedMemConfig;
-tcuLaunchKernel                       *cuLaunchKernel;
-tcuArrayCreate                        *cuArrayCreate;
-tcuArrayGetDescriptor                 *cuArrayGetDescriptor;
-tcuArrayDestroy                       *cuArrayDestroy;
-tcuArray3DCreate                      *cuArray3DCreate;
-tcuArray3DGetDescriptor               *cuArray3DGetDescriptor;
-tcuTexRefCreate                       *cuTexRefCreate;
-tcuTexRefDestroy                      *cuTexRefDestroy;
-tcuTexRefSetArray                     *cuTexRefSetArray;
-tcuTexRefSetAddress                   *cuTexRefSetAddress;
-tcuTexRefSetAddress2D                 *cuTexRefSetAddress2D;
-tcuTexRefSetFormat                    *cuTexRefSetFormat;
-tcuTexRefSetAddressMode               *cuTexRefSetAddressMode;
-tcuTexRefSetFilterMode                *cuTexRefSetFilterMode;
-tcuTexRefSetFlags                     *cuTexRefSetFlags;
-tcuTexRefGetAddress                   *cuTexRefGetAddress;
-tcuTexRefGetArray                     *cuTexRefGetArray;
-tcuTexRefGetAddressMode               *cuTexRefGetAddressMode;
-tcuTexRefGetFilterMode                *cuTexRefGetFilterMode;
-tcuTexRefGetFormat                    *cuTexRefGetFormat;
-tcuTexRefGetFlags                     *cuTexRefGetFlags;
-tcuSurfRefSetArray                    *cuSurfRefSetArray;
-tcuSurfRefGetArray                    *cuSurfRefGetArray;
-tcuParamSetSize                       *cuParamSetSize;
-tcuParamSeti                          *cuParamSeti;
-tcuParamSetf                          *cuParamSetf;
-tcuParamSetv                          *cuParamSetv;
-tcuParamSetTexRef                     *cuParamSetTexRef;
-tcuLaunch                             *cuLaunch;
-tcuLaunchGrid                         *cuLaunchGrid;
-tcuLaunchGridAsync                    *cuLaunchGridAsync;
-tcuEventCreate                        *cuEventCreate;
-tcuEventRecord                        *cuEventRecord;
-tcuEventQuery                         *cuEventQuery;
-tcuEventSynchronize                   *cuEventSynchronize;
-tcuEventDestroy                       *cuEventDestroy;
-tcuEventElapsedTime                   *cuEventElapsedTime;
-tcuStreamCreate                       *cuStreamCreate;
-tcuStreamWaitEvent                    *cuStreamWaitEvent;
-tcuStreamAddCallback                  *cuStreamAddCallback;
-tcuStreamQuery                        *cuStreamQuery;
-tcuStreamSynchronize                  *cuStreamSynchronize;
-tcuStreamDestroy                      *cuStreamDestroy;
-tcuGraphicsUnregisterResource         *cuGraphicsUnregisterResource;
-tcuGraphicsSubResourceGetMappedArray  *cuGraphicsSubResourceGetMappedArray;
-tcuGraphicsResourceGetMappedPointer   *cuGraphicsResourceGetMappedPointer;
-tcuGraphicsResourceSetMapFlags        *cuGraphicsResourceSetMapFlags;
-tcuGraphicsMapResources               *cuGraphicsMapResources;
-tcuGraphicsUnmapResources             *cuGraphicsUnmapResources;
-tcuGetExportTable                     *cuGetExportTable;
-tcuCtxSetLimit                        *cuCtxSetLimit;
-tcuCtxGetLimit                        *cuCtxGetLimit;
-tcuCtxGetCacheConfig                  *cuCtxGetCacheConfig;
-tcuCtxSetCacheConfig                  *cuCtxSetCacheConfig;
-tcuCtxGetSharedMemConfig              *cuCtxGetSharedMemConfig;
-tcuCtxSetSharedMemConfig              *cuCtxSetSharedMemConfig;
-tcuCtxGetApiVersion                   *cuCtxGetApiVersion;
-
-tcuMipmappedArrayCreate               *cuMipmappedArrayCreate;
-tcuMipmappedArrayGetLevel             *cuMipmappedArrayGetLevel;
-tcuMipmappedArrayDestroy              *cuMipmappedArrayDestroy;
-
-tcuProfilerStop                       *cuProfilerStop;
-
-#ifdef CUDA_INIT_D3D9
-// D3D9/CUDA interop (CUDA 1.x compatible API). These functions
-// are deprecated; please use the ones below
-tcuD3D9Begin                          *cuD3D9Begin;
-tcuD3D9End                            *cuD3DEnd;
-tcuD3D9RegisterVertexBuffer           *cuD3D9RegisterVertexBuffer;
-tcuD3D9MapVertexBuffer                *cuD3D9MapVertexBuffer;
-tcuD3D9UnmapVertexBuffer              *cuD3D9UnmapVertexBuffer;
-tcuD3D9UnregisterVertexBuffer         *cuD3D9UnregisterVertexBuffer;
-
-// D3D9/CUDA interop (CUDA 2.x compatible)
-tcuD3D9GetDirect3DDevice              *cuD3D9GetDirect3DDevice;
-tcuD3D9RegisterResource               *cuD3D9RegisterResource;
-tcuD3D9UnregisterResource             *cuD3D9UnregisterResource;
-tcuD3D9MapResources                   *cuD3D9MapResources;
-tcuD3D9UnmapResources                 *cuD3D9UnmapResources;
-tcuD3D9ResourceSetMapFlags            *cuD3D9ResourceSetMapFlags;
-tcuD3D9ResourceGetSurfaceDimensions   *cuD3D9ResourceGetSurfaceDimensions;
-tcuD3D9ResourceGetMappedArray         *cuD3D9ResourceGetMappedArray;
-tcuD3D9ResourceGetMappedPointer       *cuD3D9ResourceGetMappedPointer;
-tcuD3D9ResourceGetMappedSize          *cuD3D9ResourceGetMappedSize;
-tcuD3D9ResourceGetMappedPitch         *cuD3D9ResourceGetMappedPitch;
-
-// D3D9/CUDA interop (CUDA 2.0+)
-tcuD3D9GetDevice                      *cuD3D9GetDevice;
-tcuD3D9CtxCreate                      *cuD3D9CtxCreate;
-tcuGraphicsD3D9RegisterResource       *cuGraphicsD3D9RegisterResource;
-#endif
-
-#ifdef CUDA_INIT_D3D10
-// D3D10/CUDA interop (CUDA 3.0+)
-tcuD3D10GetDevice                     *cuD3D10GetDevice;
-tcuD3D10CtxCreate                     *cuD3D10CtxCreate;
-tcuGraphicsD3D10RegisterResource      *cuGraphicsD3D10RegisterResource;
-#endif
-
+tcuGetProcAddress                     *__cuGetProcAddress;
+
+// one pointer per entry in cuda_drvapi_symbols.h
+#define CU_DRVAPI_SYMBOL_POINTER(name, ...) t##name *name;
+CU_DRVAPI_SYMBOL_TABLE(CU_DRVAPI_SYMBOL_POINTER)
+#undef CU_DRVAPI_SYMBOL_POINTER
+
+static unsigned int __CudaDrvCapabilities;
+static unsigned int __CudaResolvedGroups;
+static unsigned int __CudaFailedGroups;
+static int __CudaDrvVersion = 1000;
+static int __CudaApiVersion;
+
+// Outcome of the one and only library load, see cuInit_drvapi
+static int __CudaInitDone;
+static CUresult __CudaInitResult = CUDA_ERROR_NOT_INITIALIZED;
+
+// Set through cuDrvApiSetSearchPath, wins over CUDA_DRVAPI_LIBRARY
+static char *__CudaSearchPath;
+// File the driver was loaded from, empty until a load succeeded
+static char __CudaLibPath[4096];
+// Why each candidate failed to load, reported once if none did
+static char __CudaLoadErrors[2048];
+
+static void __cuDrvNoteLoadError(const char *error)
+{
+    size_t used = strlen(__CudaLoadErrors);
 
-#ifdef CUDA_INIT_D3D11
-// D3D11/CUDA interop (CUDA 3.0+)
-tcuD3D11GetDevice                     *cuD3D11GetDevice;
-tcuD3D11CtxCreate                     *cuD3D11CtxCreate;
-tcuGraphicsD3D11RegisterResource      *cuGraphicsD3D11RegisterResource;
-#endif
+    snprintf(__CudaLoadErrors + used, sizeof(__CudaLoadErrors) - used,
+             "%s%s", used ? "; " : "", error);
+}
 
-// GL/CUDA interop
-tcuGLCtxCreate                        *cuGLCtxCreate;
-tcuGraphicsGLRegisterBuffer           *cuGraphicsGLRegisterBuffer;
-tcuGraphicsGLRegisterImage            *cuGraphicsGLRegisterImage;
-#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
-tcuWGLGetDevice                       *cuWGLGetDevice;
+// Ask cuGetProcAddress for the stream semantics this code was built with
+#ifdef CUDA_API_PER_THREAD_DEFAULT_STREAM
+#define CU_DRVAPI_PROC_FLAGS CU_GET_PROC_ADDRESS_PER_THREAD_DEFAULT_STREAM
+#else
+#define CU_DRVAPI_PROC_FLAGS CU_GET_PROC_ADDRESS_LEGACY_STREAM
 #endif
 
-/// EGL
-tcuGraphicsEGLRegisterImage           *cuGraphicsEGLRegisterImage;
-tcuGraphicsResourceGetMappedEglFrame  *cuGraphicsResourceGetMappedEglFrame;
-
-#define STRINGIFY(X) #X
-
 #if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
 #include <Windows.h>
 
-#ifdef UNICODE
-static LPCWSTR __CudaLibName = L"nvcuda.dll";
-#else
-static LPCSTR __CudaLibName = "nvcuda.dll";
-#endif
+static const char *__CudaLibNames[] = { "nvcuda.dll", NULL };
+#define CUDA_DRVAPI_PATH_SEPARATOR ';'
 
 typedef HMODULE CUDADRIVER;
 
-static CUresult LOAD_LIBRARY(CUDADRIVER *pInstance)
+static CUDADRIVER CudaDrvLib;
+
+static SRWLOCK __CudaDrvLock = SRWLOCK_INIT;
+#define CUDA_DRVAPI_LOCK()   AcquireSRWLockExclusive(&__CudaDrvLock)
+#define CUDA_DRVAPI_UNLOCK() ReleaseSRWLockExclusive(&__CudaDrvLock)
+
+static int __cuDrvTryLoad(CUDADRIVER *pInstance, const char *name)
 {
-    *pInstance = LoadLibrary(__CudaLibName);
+    *pInstance = LoadLibraryA(name);
 
     if (*pInstance == NULL)
     {
-        printf("LoadLibrary \"%s\" failed!\n", __CudaLibName);
-        return CUDA_ERROR_UNKNOWN;
-    }
+        char error[sizeof(__CudaLibPath) + 32];
 
-    return CUDA_SUCCESS;
-}
-
-#define GET_PROC_EX(name, alias, required)                     \
-    alias = (t##name *)GetProcAddress(CudaDrvLib, #name);               \
-    if (alias == NULL && required) {                                    \
-        printf("Failed to find required function \"%s\" in %s\n",       \
-               #name, __CudaLibName);                                  \
-        return CUDA_ERROR_UNKNOWN;                                      \
+        snprintf(error, sizeof(error), "%s: error %lu", name, GetLastError());
+        __cuDrvNoteLoadError(error);
+        return 0;
     }
 
-#define GET_PROC_EX_V2(name, alias, required)                           \
-    alias = (t##name *)GetProcAddress(CudaDrvLib, STRINGIFY(name##_v2));\
-    if (alias == NULL && required) {                                    \
-        printf("Failed to find required function \"%s\" in %s\n",       \
-               STRINGIFY(name##_v2), __CudaLibName);                       \
-        return CUDA_ERROR_UNKNOWN;                                      \
+    if (GetModuleFileNameA(*pInstance, __CudaLibPath, sizeof(__CudaLibPath)) == 0)
+    {
+        snprintf(__CudaLibPath, sizeof(__CudaLibPath), "%s", name);
     }
 
-#define GET_PROC_EX_V3(name, alias, required)                           \
-    alias = (t##name *)GetProcAddress(CudaDrvLib, STRINGIFY(name##_v3));\
-    if (alias == NULL && required) {                                    \
-        printf("Failed to find required function \"%s\" in %s\n",       \
-               STRINGIFY(name##_v3), __CudaLibName);                       \
-        return CUDA_ERROR_UNKNOWN;                                      \
-    }
+    return 1;
+}
+
+// No cuGetProcAddress lookups on Windows, the loader only ever ran on Linux
+static void *__cuDrvGetProc(const char *name, const char *symbol)
+{
+    return (void *)GetProcAddress(CudaDrvLib, symbol);
+}
 
 #elif defined(__unix__) || defined (__QNX__) || defined(__APPLE__) || defined(__MACOSX)
 
 #include <dlfcn.h>
+#include <pthread.h>
 
 #if defined(__APPLE__) || defined(__MACOSX)
-static char __CudaLibName[] = "/usr/local/cuda/lib/libcuda.dylib";
+static const char *__CudaLibNames[] = { "/usr/local/cuda/lib/libcuda.dylib", NULL };
 #elif defined(__ANDROID__)
 #if defined (__aarch64__)
-static char __CudaLibName[] = "/system/vendor/lib64/libcuda.so";
+static const char *__CudaLibNames[] = { "/system/vendor/lib64/libcuda.so", NULL };
 #elif defined(__arm__)
-static char __CudaLibName[] = "/system/vendor/lib/libcuda.so";
+static const char *__CudaLibNames[] = { "/system/vendor/lib/libcuda.so", NULL };
 #endif
 #else
-static char __CudaLibName[] = "libcuda.so.1";
+// libcuda.so is only the development symlink, but some containers ship
+// nothing else
+static const char *__CudaLibNames[] = { "libcuda.so.1", "libcuda.so", NULL };
 #endif
+#define CUDA_DRVAPI_PATH_SEPARATOR ':'
 
 typedef void *CUDADRIVER;
 
-static CUresult LOAD_LIBRARY(CUDADRIVER *pInstance)
+static CUDADRIVER CudaDrvLib;
+
+static pthread_mutex_t __CudaDrvLock = PTHREAD_MUTEX_INITIALIZER;
+#define CUDA_DRVAPI_LOCK()   pthread_mutex_lock(&__CudaDrvLock)
+#define CUDA_DRVAPI_UNLOCK() pthread_mutex_unlock(&__CudaDrvLock)
+
+// Prefer cuGetProcAddress: given the unversioned name it hands out the
+// _v2/_v3 and _ptds/_ptsz variant matching the requested API version, which
+// plain dlsym cannot know about. Older drivers fall back to |symbol|.
+static void *__cuDrvGetProc(const char *name, const char *symbol)
 {
-    *pInstance = dlopen(__CudaLibName, RTLD_NOW);
+    void *pfn = NULL;
 
-    if (*pInstance == NULL)
+    if (__cuGetProcAddress &&
+        __cuGetProcAddress(name, &pfn, __CudaApiVersion,
+                           CU_DRVAPI_PROC_FLAGS) == CUDA_SUCCESS &&
+        pfn != NULL)
     {
-        printf("dlopen \"%s\" failed!\n", __CudaLibName);
-        return CUDA_ERROR_UNKNOWN;
+        return pfn;
     }
 
-    return CUDA_SUCCESS;
+    return dlsym(CudaDrvLib, symbol);
 }
 
-#define GET_PROC_EX(name, alias, required)                              \
-    alias = (t##name *)dlsym(CudaDrvLib, #name);                        \
-    if (alias == NULL && required) {                                    \
-        printf("Failed to find required function \"%s\" in %s\n",       \
-               #name, __CudaLibName);                                  \
-        return CUDA_ERROR_UNKNOWN;                                      \
-    }
+// Bare sonames only tell where the library came from once the dynamic
+// linker searched for them, so ask it back through one of the symbols.
+static int __cuDrvTryLoad(CUDADRIVER *pInstance, const char *name)
+{
+    Dl_info info;
+    void *sym;
 
-#define GET_PROC_EX_V2(name, alias, required)                           \
-    alias = (t##name *)dlsym(CudaDrvLib, STRINGIFY(name##_v2));         \
-    if (alias == NULL && required) {                                    \
-        printf("Failed to find required function \"%s\" in %s\n",       \
-               STRINGIFY(name##_v2), __CudaLibName);                    \
-        return CUDA_ERROR_UNKNOWN;                                      \
+    *pInstance = dlopen(name, RTLD_NOW);
+
+    if (*pInstance == NULL)
+    {
+        // dlerror() names the file already
+        __cuDrvNoteLoadError(dlerror());
+        return 0;
     }
 
-#define GET_PROC_EX_V3(name, alias, required)                           \
-    alias = (t##name *)dlsym(CudaDrvLib, STRINGIFY(name##_v3));         \
-    if (alias == NULL && required) {                                    \
-        printf("Failed to find required function \"%s\" in %s\n",       \
-               STRINGIFY(name##_v3), __CudaLibName);                    \
-        return CUDA_ERROR_UNKNOWN;                                      \
+    sym = dlsym(*pInstance, "cuInit");
+
+    if (sym != NULL && dladdr(sym, &info) && info.dli_fname != NULL)
+    {
+        snprintf(__CudaLibPath, sizeof(__CudaLibPath), "%s", info.dli_fname);
+    }
+    else
+    {
+        snprintf(__CudaLibPath, sizeof(__CudaLibPath), "%s", name);
     }
 
+    return 1;
+}
+
 #else
 #error unsupported platform
 #endif
 
+// Candidates, first hit wins:
+//   1. cuDrvApiSetSearchPath(), else CUDA_DRVAPI_LIBRARY, as a list
+//   2. the platform driver names in __CudaLibNames
+//   3. CUDA_DRVAPI_STUB_LIBRARY, e.g. the host memory stub built from
+//      cuda_stub_driver.c
+// The stub is never picked up implicitly, a node without the driver should
+// fail fast rather than export fake frames. Called once per process, see
+// cuInit_drvapi, so a miss costs one round of dlopen calls and no more.
+static CUresult LOAD_LIBRARY(CUDADRIVER *pInstance)
+{
+    const char *paths = __CudaSearchPath ? __CudaSearchPath : getenv("CUDA_DRVAPI_LIBRARY");
+    const char *stub = getenv("CUDA_DRVAPI_STUB_LIBRARY");
+    const char *p;
+    const char *end;
+    char candidate[sizeof(__CudaLibPath)];
+    size_t len;
+    int i;
+
+    for (p = paths; p != NULL && *p != '\0'; p = (*end != '\0') ? end + 1 : end)
+    {
+        end = strchr(p, CUDA_DRVAPI_PATH_SEPARATOR);
+
+        if (end == NULL)
+        {
+            end = p + strlen(p);
+        }
+
+        len = (size_t)(end - p);
+
+        if (len == 0 || len >= sizeof(candidate))
+        {
+            continue;
+        }
+
+        memcpy(candidate, p, len);
+        candidate[len] = '\0';
+
+        if (__cuDrvTryLoad(pInstance, candidate))
+        {
+            return CUDA_SUCCESS;
+        }
+    }
+
+    for (i = 0; __CudaLibNames[i] != NULL; i++)
+    {
+        if (__cuDrvTryLoad(pInstance, __CudaLibNames[i]))
+        {
+            return CUDA_SUCCESS;
+        }
+    }
+
+    if (stub != NULL && *stub != '\0' && __cuDrvTryLoad(pInstance, stub))
+    {
+        return CUDA_SUCCESS;
+    }
+
+    fprintf(stderr, "no CUDA driver library found (%s)\n", __CudaLoadErrors);
+    return CUDA_ERROR_UNKNOWN;
+}
+
+// Only for the bootstrap entry points, see __cuDrvResolveGroup for the rest
+#define GET_PROC_EX(name, alias, required)                              \
+    alias = (t##name *)__cuDrvGetProc(#name, #name);                    \
+    if (alias == NULL && required) {                                    \
+        fprintf(stderr,                                                 \
+                "Failed to find required function \"%s\" in %s\n",      \
+                #name, __CudaLibPath);                                  \
+        return CUDA_ERROR_UNKNOWN;                                      \
+    }
+
 #define CHECKED_CALL(call)              \
     do {                                \
         CUresult result = (call);       \
@@ -341,305 +264,287 @@ static CUresult LOAD_LIBRARY(CUDADRIVER *pInstance)
         }                               \
     } while(0)
 
-#define GET_PROC_REQUIRED(name) GET_PROC_EX(name,name,1)
 #define GET_PROC_OPTIONAL(name) GET_PROC_EX(name,name,0)
-#define GET_PROC(name)          GET_PROC_REQUIRED(name)
-#define GET_PROC_V2(name)       GET_PROC_EX_V2(name,name,1)
-#define GET_PROC_V3(name)       GET_PROC_EX_V3(name,name,1)
 
-// changed name from cuInit -> cuInit_drvapi to avoid symbol collision
-CUresult CUDAAPI cuInit_drvapi(unsigned int Flags, int cudaVersion)
+// One row of CU_DRVAPI_SYMBOL_TABLE, see cuda_drvapi_symbols.h
+typedef struct
 {
-    CUDADRIVER CudaDrvLib;
-    int driverVer = 1000;
+    const char *name;
+    void **proc;
+    unsigned int groups;
+    int minDriver;
+    int minApi;
+    int v2Since;
+    int v3Since;
+    int required;
+    unsigned int capability;
+} __CudaSymbol;
+
+#define CU_DRVAPI_SYMBOL_ENTRY(name, group, minDriver, minApi, v2Since, v3Since, required, capability) \
+    { #name, (void **)&name, CU_DRVAPI_SYMBOLS_##group, minDriver, minApi, v2Since, v3Since,          \
+      CU_DRVAPI_SYMBOL_##required, CU_DRVAPI_CAP_##capability },
+
+static const __CudaSymbol __CudaSymbols[CU_DRVAPI_SYMBOL_COUNT] =
+{
+    CU_DRVAPI_SYMBOL_TABLE(CU_DRVAPI_SYMBOL_ENTRY)
+};
 
-    CHECKED_CALL(LOAD_LIBRARY(&CudaDrvLib));
+#undef CU_DRVAPI_SYMBOL_ENTRY
 
-    // cuInit is required; alias it to _cuInit
-    GET_PROC_EX(cuInit, _cuInit, 1);
-    CHECKED_CALL(_cuInit(Flags));
+// Entry points are split into groups that are resolved the first time a
+// caller asks for them via cuDrvApiRequire, so a GPU process that only
+// copies textures never touches texture references or cuParam*, and newer
+// drivers that dropped those symbols keep working.
+static const unsigned int __CudaSymbolGroups[] =
+{
+    CU_DRVAPI_SYMBOLS_CORE,
+    CU_DRVAPI_SYMBOLS_IPC,
+    CU_DRVAPI_SYMBOLS_GL,
+    CU_DRVAPI_SYMBOLS_EGL,
+    CU_DRVAPI_SYMBOLS_EXTERNAL,
+    CU_DRVAPI_SYMBOLS_LEGACY,
+};
+
+#ifdef CUDA_DRVAPI_INSTRUMENT
+// cuda_drvapi_instrument.cc, returns the interposer standing in for |proc|
+extern void *__cuDrvInstrument(int index, void *proc);
+#endif
 
-    // available since 2.2. if not present, version 1.0 is assumed
-    GET_PROC_OPTIONAL(cuDriverGetVersion);
+// Symbols below their minimum driver or API version are left NULL, the
+// group still succeeds; only a missing REQUIRED one fails it.
+static CUresult __cuDrvResolveGroup(unsigned int group, int driverVer, int cudaVersion)
+{
+    char symbol[128];
+    const char *suffix;
+    void *proc;
+    int i;
 
-    if (cuDriverGetVersion)
+    for (i = 0; i < CU_DRVAPI_SYMBOL_COUNT; i++)
     {
-        CHECKED_CALL(cuDriverGetVersion(&driverVer));
-    }
+        const __CudaSymbol *entry = &__CudaSymbols[i];
 
-    // fetch all function pointers
-    GET_PROC(cuDeviceGet);
-    GET_PROC(cuDeviceGetCount);
-    GET_PROC(cuDeviceGetName);
-    GET_PROC(cuDeviceComputeCapability);
-    GET_PROC(cuDeviceGetProperties);
-    GET_PROC(cuDeviceGetAttribute);
-    GET_PROC(cuCtxDestroy);
-    GET_PROC(cuCtxAttach);
-    GET_PROC(cuCtxDetach);
-    GET_PROC(cuCtxPushCurrent);
-    GET_PROC(cuCtxPopCurrent);
-    GET_PROC(cuCtxGetDevice);
-    GET_PROC(cuCtxSynchronize);
-    GET_PROC(cuCtxSetLimit);
-    GET_PROC(cuCtxGetCacheConfig);
-    GET_PROC(cuCtxSetCacheConfig);
-    GET_PROC(cuCtxGetApiVersion);
-    GET_PROC(cuModuleLoad);
-    GET_PROC(cuModuleLoadData);
-    GET_PROC(cuModuleUnload);
-    GET_PROC(cuModuleGetFunction);
-    GET_PROC(cuModuleGetTexRef);
-    GET_PROC(cuMemFreeHost);
-    GET_PROC(cuMemHostAlloc);
-    GET_PROC(cuFuncSetBlockShape);
-    GET_PROC(cuFuncSetSharedSize);
-    GET_PROC(cuFuncGetAttribute);
-    GET_PROC(cuArrayDestroy);
-    GET_PROC(cuTexRefCreate);
-    GET_PROC(cuTexRefDestroy);
-    GET_PROC(cuTexRefSetArray);
-    GET_PROC(cuTexRefSetFormat);
-    GET_PROC(cuTexRefSetAddressMode);
-    GET_PROC(cuTexRefSetFilterMode);
-    GET_PROC(cuTexRefSetFlags);
-    GET_PROC(cuTexRefGetArray);
-    GET_PROC(cuTexRefGetAddressMode);
-    GET_PROC(cuTexRefGetFilterMode);
-    GET_PROC(cuTexRefGetFormat);
-    GET_PROC(cuTexRefGetFlags);
-    GET_PROC(cuParamSetSize);
-    GET_PROC(cuParamSeti);
-    GET_PROC(cuParamSetf);
-    GET_PROC(cuParamSetv);
-    GET_PROC(cuParamSetTexRef);
-    GET_PROC(cuLaunch);
-    GET_PROC(cuLaunchGrid);
-    GET_PROC(cuLaunchGridAsync);
-    GET_PROC(cuEventCreate);
-    GET_PROC(cuEventRecord);
-    GET_PROC(cuEventQuery);
-    GET_PROC(cuEventSynchronize);
-    GET_PROC(cuEventDestroy);
-    GET_PROC(cuEventElapsedTime);
-    GET_PROC(cuStreamCreate);
-    GET_PROC(cuStreamWaitEvent);
-    GET_PROC(cuStreamAddCallback);
-    GET_PROC(cuStreamQuery);
-    GET_PROC(cuStreamSynchronize);
-    GET_PROC(cuStreamDestroy);
-
-    // These are CUDA 5.0 new functions
-    if (driverVer >= 5000)
-    {
-        GET_PROC(cuMipmappedArrayCreate);
-        GET_PROC(cuMipmappedArrayDestroy);
-        GET_PROC(cuMipmappedArrayGetLevel);
+        if (!(entry->groups & group) || driverVer < entry->minDriver ||
+            cudaVersion < entry->minApi)
+        {
+            continue;
+        }
+
+        suffix = "";
+        if (entry->v3Since && cudaVersion >= entry->v3Since)
+        {
+            suffix = "_v3";
+        }
+        else if (entry->v2Since && cudaVersion >= entry->v2Since)
+        {
+            suffix = "_v2";
+        }
+        snprintf(symbol, sizeof(symbol), "%s%s", entry->name, suffix);
+
+        proc = __cuDrvGetProc(entry->name, symbol);
+
+        if (proc == NULL && entry->required)
+        {
+            fprintf(stderr, "Failed to find required function \"%s\" in %s\n",
+                    symbol, __CudaLibPath);
+            return CUDA_ERROR_UNKNOWN;
+        }
+
+#ifdef CUDA_DRVAPI_INSTRUMENT
+        if (proc != NULL)
+        {
+            proc = __cuDrvInstrument(i, proc);
+        }
+#endif
+
+        *entry->proc = proc;
     }
 
-    // These are CUDA 4.2 new functions
-    if (driverVer >= 4020)
+    return CUDA_SUCCESS;
+}
+
+// A capability is reported once every symbol tagged with it resolved
+static void __cuDrvUpdateCapabilities(void)
+{
+    unsigned int all = 0;
+    unsigned int missing = 0;
+    int i;
+
+    for (i = 0; i < CU_DRVAPI_SYMBOL_COUNT; i++)
     {
-        GET_PROC(cuFuncSetSharedMemConfig);
-        GET_PROC(cuCtxGetSharedMemConfig);
-        GET_PROC(cuCtxSetSharedMemConfig);
+        all |= __CudaSymbols[i].capability;
+
+        if (*__CudaSymbols[i].proc == NULL)
+        {
+            missing |= __CudaSymbols[i].capability;
+        }
     }
 
-    // These are CUDA 4.1 new functions
-    if (cudaVersion >= 4010)
+    __CudaDrvCapabilities = all & ~missing;
+}
+
+// caller holds __CudaDrvLock; cuInit_drvapi calls it for the core group
+// before its own result is known, everyone else only after it succeeded
+static CUresult __cuDrvApiRequireLocked(unsigned int groups)
+{
+    CUresult status = CUDA_SUCCESS;
+    size_t i;
+
+    if (CudaDrvLib == NULL)
     {
-        GET_PROC(cuDeviceGetByPCIBusId);
-        GET_PROC(cuDeviceGetPCIBusId);
-        GET_PROC(cuIpcGetEventHandle);
-        GET_PROC(cuIpcOpenEventHandle);
-        GET_PROC(cuIpcGetMemHandle);
-        GET_PROC(cuIpcOpenMemHandle);
-        GET_PROC(cuIpcCloseMemHandle);
+        return CUDA_ERROR_NOT_INITIALIZED;
     }
 
-    // These could be _v2 interfaces
-    if (cudaVersion >= 4000)
+    // a group that failed once fails fast, the driver will not change
+    if (groups & __CudaFailedGroups)
     {
-        GET_PROC_V2(cuCtxDestroy);
-        GET_PROC_V2(cuCtxPopCurrent);
-        GET_PROC_V2(cuCtxPushCurrent);
-        GET_PROC_V2(cuStreamDestroy);
-        GET_PROC_V2(cuEventDestroy);
+        return CUDA_ERROR_NOT_FOUND;
     }
 
-    if (cudaVersion >= 3020)
+    for (i = 0; i < sizeof(__CudaSymbolGroups) / sizeof(__CudaSymbolGroups[0]); i++)
     {
-        GET_PROC_V2(cuDeviceTotalMem);
-        GET_PROC_V2(cuCtxCreate);
-        GET_PROC_V2(cuModuleGetGlobal);
-        GET_PROC_V2(cuMemGetInfo);
-        GET_PROC_V2(cuMemAlloc);
-        GET_PROC_V2(cuMemAllocPitch);
-        GET_PROC_V2(cuMemFree);
-        GET_PROC_V2(cuMemGetAddressRange);
-        GET_PROC_V2(cuMemAllocHost);
-        GET_PROC_V2(cuMemHostGetDevicePointer);
-        GET_PROC_V2(cuMemcpyHtoD);
-        GET_PROC_V2(cuMemcpyDtoH);
-        GET_PROC_V2(cuMemcpyDtoD);
-        GET_PROC_V2(cuMemcpyDtoA);
-        GET_PROC_V2(cuMemcpyAtoD);
-        GET_PROC_V2(cuMemcpyHtoA);
-        GET_PROC_V2(cuMemcpyAtoH);
-        GET_PROC_V2(cuMemcpyAtoA);
-        GET_PROC_V2(cuMemcpy2D);
-        GET_PROC_V2(cuMemcpy2DUnaligned);
-        GET_PROC_V2(cuMemcpy3D);
-        GET_PROC_V2(cuMemcpyHtoDAsync);
-        GET_PROC_V2(cuMemcpyDtoHAsync);
-        GET_PROC_V2(cuMemcpyHtoAAsync);
-        GET_PROC_V2(cuMemcpyAtoHAsync);
-        GET_PROC_V2(cuMemcpy2DAsync);
-        GET_PROC_V2(cuMemcpy3DAsync);
-        GET_PROC_V2(cuMemsetD8);
-        GET_PROC_V2(cuMemsetD16);
-        GET_PROC_V2(cuMemsetD32);
-        GET_PROC_V2(cuMemsetD2D8);
-        GET_PROC_V2(cuMemsetD2D16);
-        GET_PROC_V2(cuMemsetD2D32);
-        GET_PROC_V2(cuArrayCreate);
-        GET_PROC_V2(cuArrayGetDescriptor);
-        GET_PROC_V2(cuArray3DCreate);
-        GET_PROC_V2(cuArray3DGetDescriptor);
-        GET_PROC_V2(cuTexRefSetAddress);
-        GET_PROC_V2(cuTexRefGetAddress);
-
-        if (cudaVersion >= 4010)
+        unsigned int group = __CudaSymbolGroups[i];
+
+        if (!(groups & group) || (__CudaResolvedGroups & group))
         {
-            GET_PROC_V3(cuTexRefSetAddress2D);
+            continue;
         }
-        else
+
+        if (__cuDrvResolveGroup(group, __CudaDrvVersion, __CudaApiVersion) != CUDA_SUCCESS)
         {
-            GET_PROC_V2(cuTexRefSetAddress2D);
+            __CudaFailedGroups |= group;
+            status = CUDA_ERROR_NOT_FOUND;
+            continue;
         }
+
+        __CudaResolvedGroups |= group;
+    }
+
+    __cuDrvUpdateCapabilities();
+    return status;
+}
+
+CUresult CUDAAPI cuDrvApiRequire(unsigned int groups)
+{
+    CUresult status;
+
+    CUDA_DRVAPI_LOCK();
+    if (!__CudaInitDone || __CudaInitResult != CUDA_SUCCESS)
+    {
+        // the library may be loaded, but a driver whose cuInit failed is
+        // not one to resolve entry points from
+        status = __CudaInitDone ? __CudaInitResult : CUDA_ERROR_NOT_INITIALIZED;
     }
     else
     {
-        // versions earlier than 3020
-        GET_PROC(cuDeviceTotalMem);
-        GET_PROC(cuCtxCreate);
-        GET_PROC(cuModuleGetGlobal);
-        GET_PROC(cuMemGetInfo);
-        GET_PROC(cuMemAlloc);
-        GET_PROC(cuMemAllocPitch);
-        GET_PROC(cuMemFree);
-        GET_PROC(cuMemGetAddressRange);
-        GET_PROC(cuMemAllocHost);
-        GET_PROC(cuMemHostGetDevicePointer);
-        GET_PROC(cuMemcpyHtoD);
-        GET_PROC(cuMemcpyDtoH);
-        GET_PROC(cuMemcpyDtoD);
-        GET_PROC(cuMemcpyDtoA);
-        GET_PROC(cuMemcpyAtoD);
-        GET_PROC(cuMemcpyHtoA);
-        GET_PROC(cuMemcpyAtoH);
-        GET_PROC(cuMemcpyAtoA);
-        GET_PROC(cuMemcpy2D);
-        GET_PROC(cuMemcpy2DUnaligned);
-        GET_PROC(cuMemcpy3D);
-        GET_PROC(cuMemcpyHtoDAsync);
-        GET_PROC(cuMemcpyDtoHAsync);
-        GET_PROC(cuMemcpyHtoAAsync);
-        GET_PROC(cuMemcpyAtoHAsync);
-        GET_PROC(cuMemcpy2DAsync);
-        GET_PROC(cuMemcpy3DAsync);
-        GET_PROC(cuMemsetD8);
-        GET_PROC(cuMemsetD16);
-        GET_PROC(cuMemsetD32);
-        GET_PROC(cuMemsetD2D8);
-        GET_PROC(cuMemsetD2D16);
-        GET_PROC(cuMemsetD2D32);
-        GET_PROC(cuArrayCreate);
-        GET_PROC(cuArrayGetDescriptor);
-        GET_PROC(cuArray3DCreate);
-        GET_PROC(cuArray3DGetDescriptor);
-        GET_PROC(cuTexRefSetAddress);
-        GET_PROC(cuTexRefSetAddress2D);
-        GET_PROC(cuTexRefGetAddress);
+        status = __cuDrvApiRequireLocked(groups);
     }
+    CUDA_DRVAPI_UNLOCK();
 
-    // The following functions are specific to CUDA versions
-    if (driverVer >= 4000)
+    return status;
+}
+
+// caller holds __CudaDrvLock
+static CUresult __cuDrvInitLocked(unsigned int Flags, int cudaVersion)
+{
+    int driverVer = 1000;
+
+    CHECKED_CALL(LOAD_LIBRARY(&CudaDrvLib));
+
+    // cuInit is required; alias it to _cuInit
+    GET_PROC_EX(cuInit, _cuInit, 1);
+    CHECKED_CALL(_cuInit(Flags));
+
+    // available since 2.2. if not present, version 1.0 is assumed
+    GET_PROC_OPTIONAL(cuDriverGetVersion);
+
+    if (cuDriverGetVersion)
     {
-        GET_PROC(cuCtxSetCurrent);
-        GET_PROC(cuCtxGetCurrent);
-        GET_PROC(cuMemHostRegister);
-        GET_PROC(cuMemHostUnregister);
-        GET_PROC(cuMemcpy);
-        GET_PROC(cuMemcpyPeer);
-        GET_PROC(cuLaunchKernel);
-        GET_PROC(cuProfilerStop);
+        CHECKED_CALL(cuDriverGetVersion(&driverVer));
     }
 
-    if (driverVer >= 3010)
+    // available since 11.3, every lookup after this one goes through it
+    if (driverVer >= 11030)
     {
-        GET_PROC(cuModuleGetSurfRef);
-        GET_PROC(cuSurfRefSetArray);
-        GET_PROC(cuSurfRefGetArray);
-        GET_PROC(cuCtxSetLimit);
-        GET_PROC(cuCtxGetLimit);
+        GET_PROC_EX(cuGetProcAddress, __cuGetProcAddress, 0);
     }
 
-    if (driverVer >= 3000)
-    {
-        GET_PROC(cuMemcpyDtoDAsync);
-        GET_PROC(cuFuncSetCacheConfig);
-#ifdef CUDA_INIT_D3D11
-        GET_PROC(cuD3D11GetDevice);
-        GET_PROC(cuD3D11CtxCreate);
-        GET_PROC(cuGraphicsD3D11RegisterResource);
-#endif
-        GET_PROC(cuGraphicsUnregisterResource);
-        GET_PROC(cuGraphicsSubResourceGetMappedArray);
+    __CudaDrvVersion = driverVer;
+    __CudaApiVersion = cudaVersion;
 
-        if (cudaVersion >= 3020)
-        {
-            GET_PROC_V2(cuGraphicsResourceGetMappedPointer);
-        }
-        else
-        {
-            GET_PROC(cuGraphicsResourceGetMappedPointer);
-        }
+    printf("CUDA driver %d.%d loaded from %s\n",
+           driverVer / 1000, (driverVer % 1000) / 10, __CudaLibPath);
+
+    // everything else is resolved on demand
+    return __cuDrvApiRequireLocked(CU_DRVAPI_SYMBOLS_CORE);
+}
 
-        GET_PROC(cuGraphicsResourceSetMapFlags);
-        GET_PROC(cuGraphicsMapResources);
-        GET_PROC(cuGraphicsUnmapResources);
-        GET_PROC(cuGetExportTable);
+// changed name from cuInit -> cuInit_drvapi to avoid symbol collision
+//
+// Runs once per process, any later call returns the first result, success
+// or failure, without touching the library again. The handle stays open for
+// the lifetime of the process since the function pointers point into it.
+CUresult CUDAAPI cuInit_drvapi(unsigned int Flags, int cudaVersion)
+{
+    CUresult status;
+
+    CUDA_DRVAPI_LOCK();
+    if (!__CudaInitDone)
+    {
+        __CudaInitResult = __cuDrvInitLocked(Flags, cudaVersion);
+        __CudaInitDone = 1;
     }
+    status = __CudaInitResult;
+    CUDA_DRVAPI_UNLOCK();
+
+    return status;
+}
+
+CUresult CUDAAPI cuDrvApiSetSearchPath(const char *paths)
+{
+    CUresult status = CUDA_SUCCESS;
 
-    if (driverVer >= 2030)
+    CUDA_DRVAPI_LOCK();
+    if (__CudaInitDone)
     {
-        GET_PROC(cuMemHostGetFlags);
-#ifdef CUDA_INIT_D3D10
-        GET_PROC(cuD3D10GetDevice);
-        GET_PROC(cuD3D10CtxCreate);
-        GET_PROC(cuGraphicsD3D10RegisterResource);
-#endif
-        GET_PROC(cuGraphicsGLRegisterBuffer);
-        GET_PROC(cuGraphicsGLRegisterImage);
+        status = CUDA_ERROR_INVALID_VALUE;
     }
+    else
+    {
+        free(__CudaSearchPath);
+        __CudaSearchPath = (paths != NULL && *paths != '\0') ? strdup(paths) : NULL;
+    }
+    CUDA_DRVAPI_UNLOCK();
+
+    return status;
+}
+
+unsigned int CUDAAPI cuDrvApiGetCapabilities(void)
+{
+    unsigned int capabilities;
+
+    CUDA_DRVAPI_LOCK();
+    capabilities = __CudaDrvCapabilities;
+    CUDA_DRVAPI_UNLOCK();
 
-    if (driverVer >= 2010)
+    return capabilities;
+}
+
+CUresult CUDAAPI cuDrvApiGetInfo(CUdrvapiInfo *info)
+{
+    if (info == NULL)
     {
-        GET_PROC(cuModuleLoadDataEx);
-        GET_PROC(cuModuleLoadFatBinary);
-        GET_PROC(cuGLCtxCreate);
-        GET_PROC(cuGraphicsGLRegisterBuffer);
-        GET_PROC(cuGraphicsGLRegisterImage);
-#  ifdef WIN32
-        GET_PROC(cuWGLGetDevice);
-#  endif
-#ifdef CUDA_INIT_D3D9
-        GET_PROC(cuD3D9GetDevice);
-        GET_PROC(cuD3D9CtxCreate);
-        GET_PROC(cuGraphicsD3D9RegisterResource);
-#endif
+        return CUDA_ERROR_INVALID_VALUE;
     }
 
+    CUDA_DRVAPI_LOCK();
+    info->initResult = __CudaInitResult;
+    info->driverVersion = __CudaInitDone ? __CudaDrvVersion : 0;
+    info->apiVersion = __CudaApiVersion;
+    info->capabilities = __CudaDrvCapabilities;
+    info->resolvedGroups = __CudaResolvedGroups;
+    info->failedGroups = __CudaFailedGroups;
+    info->libraryPath = __CudaLibPath[0] != '\0' ? __CudaLibPath : NULL;
+    CUDA_DRVAPI_UNLOCK();
+
     return CUDA_SUCCESS;
 }
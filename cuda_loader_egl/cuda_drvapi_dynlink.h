@@ -16,5 +16,6 @@
 
 #include "cuda_drvapi_dynlink_cuda.h"
 #include "cuda_drvapi_dynlink_gl.h"
+#include "cuda_drvapi_symbols.h"
 
 #endif //__cuda_drvapi_dynlink_h__
@@ -1391,6 +1391,7 @@ typedef CUresult  CUDAAPI tcuDeviceTotalMem(unsigned int *bytes, CUdevice dev);
 
 typedef CUresult  CUDAAPI tcuDeviceGetProperties(CUdevprop *prop, CUdevice dev);
 typedef CUresult  CUDAAPI tcuDeviceGetAttribute(int *pi, CUdevice_attribute attrib, CUdevice dev);
+typedef CUresult  CUDAAPI tcuDeviceGetUuid(CUuuid *uuid, CUdevice dev);
 typedef CUresult  CUDAAPI tcuGetErrorString(CUresult error, const char **pStr);
 
 /************************************
@@ -1406,6 +1407,9 @@ typedef CUresult  CUDAAPI tcuCtxDetach(CUcontext ctx);
 typedef CUresult  CUDAAPI tcuCtxPushCurrent(CUcontext ctx);
 typedef CUresult  CUDAAPI tcuCtxPopCurrent(CUcontext *pctx);
 
+typedef CUresult  CUDAAPI tcuDevicePrimaryCtxRetain(CUcontext *pctx, CUdevice dev);
+typedef CUresult  CUDAAPI tcuDevicePrimaryCtxRelease(CUdevice dev);
+
 typedef CUresult  CUDAAPI tcuCtxSetCurrent(CUcontext ctx);
 typedef CUresult  CUDAAPI tcuCtxGetCurrent(CUcontext *pctx);
 
@@ -1788,6 +1792,184 @@ typedef CUresult CUDAAPI tcuGraphicsResourceSetMapFlags(CUgraphicsResource resou
 typedef CUresult CUDAAPI tcuGraphicsMapResources(unsigned int count, CUgraphicsResource *resources, CUstream hStream);
 typedef CUresult CUDAAPI tcuGraphicsUnmapResources(unsigned int count, CUgraphicsResource *resources, CUstream hStream);
 
+/************************************
+ **
+ **    External resource interop (CUDA 10.0+)
+ **
+ ***********************************/
+typedef struct CUextMemory_st *CUexternalMemory;          /**< CUDA external memory */
+typedef struct CUextSemaphore_st *CUexternalSemaphore;    /**< CUDA external semaphore */
+
+typedef enum CUexternalMemoryHandleType_enum
+{
+    CU_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD        = 1, /**< Handle is an opaque file descriptor */
+    CU_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32     = 2, /**< Handle is an opaque shared NT handle */
+    CU_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32_KMT = 3, /**< Handle is an opaque, globally shared handle */
+    CU_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_HEAP       = 4, /**< Handle is a D3D12 heap object */
+    CU_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_RESOURCE   = 5  /**< Handle is a D3D12 committed resource */
+} CUexternalMemoryHandleType;
+
+#define CUDA_EXTERNAL_MEMORY_DEDICATED   0x1
+
+typedef struct CUDA_EXTERNAL_MEMORY_HANDLE_DESC_st
+{
+    CUexternalMemoryHandleType type;
+    union {
+        int fd;
+        struct {
+            void *handle;
+            const void *name;
+        } win32;
+    } handle;
+    unsigned long long size;
+    unsigned int flags;
+    unsigned int reserved[16];
+} CUDA_EXTERNAL_MEMORY_HANDLE_DESC;
+
+typedef struct CUDA_EXTERNAL_MEMORY_BUFFER_DESC_st
+{
+    unsigned long long offset;
+    unsigned long long size;
+    unsigned int flags;
+    unsigned int reserved[16];
+} CUDA_EXTERNAL_MEMORY_BUFFER_DESC;
+
+typedef struct CUDA_EXTERNAL_MEMORY_MIPMAPPED_ARRAY_DESC_st
+{
+    unsigned long long offset;
+    CUDA_ARRAY3D_DESCRIPTOR arrayDesc;
+    unsigned int numLevels;
+    unsigned int reserved[16];
+} CUDA_EXTERNAL_MEMORY_MIPMAPPED_ARRAY_DESC;
+
+typedef enum CUexternalSemaphoreHandleType_enum
+{
+    CU_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD        = 1, /**< Handle is an opaque file descriptor */
+    CU_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_WIN32     = 2, /**< Handle is an opaque shared NT handle */
+    CU_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_WIN32_KMT = 3, /**< Handle is an opaque, globally shared handle */
+    CU_EXTERNAL_SEMAPHORE_HANDLE_TYPE_D3D12_FENCE      = 4  /**< Handle is a shared NT handle referencing a D3D12 fence object */
+} CUexternalSemaphoreHandleType;
+
+typedef struct CUDA_EXTERNAL_SEMAPHORE_HANDLE_DESC_st
+{
+    CUexternalSemaphoreHandleType type;
+    union {
+        int fd;
+        struct {
+            void *handle;
+            const void *name;
+        } win32;
+    } handle;
+    unsigned int flags;
+    unsigned int reserved[16];
+} CUDA_EXTERNAL_SEMAPHORE_HANDLE_DESC;
+
+typedef struct CUDA_EXTERNAL_SEMAPHORE_SIGNAL_PARAMS_st
+{
+    struct {
+        struct {
+            unsigned long long value;
+        } fence;
+        unsigned int reserved[16];
+    } params;
+    unsigned int flags;
+    unsigned int reserved[16];
+} CUDA_EXTERNAL_SEMAPHORE_SIGNAL_PARAMS;
+
+typedef struct CUDA_EXTERNAL_SEMAPHORE_WAIT_PARAMS_st
+{
+    struct {
+        struct {
+            unsigned long long value;
+        } fence;
+        unsigned int reserved[16];
+    } params;
+    unsigned int flags;
+    unsigned int reserved[16];
+} CUDA_EXTERNAL_SEMAPHORE_WAIT_PARAMS;
+
+typedef CUresult CUDAAPI tcuImportExternalMemory(CUexternalMemory *extMem_out, const CUDA_EXTERNAL_MEMORY_HANDLE_DESC *memHandleDesc);
+typedef CUresult CUDAAPI tcuExternalMemoryGetMappedBuffer(CUdeviceptr *devPtr, CUexternalMemory extMem, const CUDA_EXTERNAL_MEMORY_BUFFER_DESC *bufferDesc);
+typedef CUresult CUDAAPI tcuExternalMemoryGetMappedMipmappedArray(CUmipmappedArray *mipmap, CUexternalMemory extMem, const CUDA_EXTERNAL_MEMORY_MIPMAPPED_ARRAY_DESC *mipmapDesc);
+typedef CUresult CUDAAPI tcuDestroyExternalMemory(CUexternalMemory extMem);
+typedef CUresult CUDAAPI tcuImportExternalSemaphore(CUexternalSemaphore *extSem_out, const CUDA_EXTERNAL_SEMAPHORE_HANDLE_DESC *semHandleDesc);
+typedef CUresult CUDAAPI tcuSignalExternalSemaphoresAsync(const CUexternalSemaphore *extSemArray, const CUDA_EXTERNAL_SEMAPHORE_SIGNAL_PARAMS *paramsArray, unsigned int numExtSems, CUstream stream);
+typedef CUresult CUDAAPI tcuWaitExternalSemaphoresAsync(const CUexternalSemaphore *extSemArray, const CUDA_EXTERNAL_SEMAPHORE_WAIT_PARAMS *paramsArray, unsigned int numExtSems, CUstream stream);
+typedef CUresult CUDAAPI tcuDestroyExternalSemaphore(CUexternalSemaphore extSem);
+
+/************************************
+ **
+ **    Symbol groups
+ **
+ ** cuInit_drvapi only resolves CU_DRVAPI_SYMBOLS_CORE. Everything else is
+ ** looked up the first time a caller passes its group to cuDrvApiRequire.
+ **
+ ***********************************/
+typedef enum CUdrvapiSymbolGroup_enum
+{
+    CU_DRVAPI_SYMBOLS_CORE     = 0x01, /**< Device, context, memory, stream, event and module */
+    CU_DRVAPI_SYMBOLS_IPC      = 0x02, /**< cuIpc* */
+    CU_DRVAPI_SYMBOLS_GL       = 0x04, /**< Graphics map/unmap and GL registration */
+    CU_DRVAPI_SYMBOLS_EGL      = 0x08, /**< Graphics map/unmap and EGL registration, optional */
+    CU_DRVAPI_SYMBOLS_EXTERNAL = 0x10, /**< External memory and semaphores, optional */
+    CU_DRVAPI_SYMBOLS_LEGACY   = 0x20  /**< Deprecated entry points, texture/surface references, cuParam* and cuLaunch* */
+} CUdrvapiSymbolGroup;
+
+#define CU_GET_PROC_ADDRESS_DEFAULT                   0
+#define CU_GET_PROC_ADDRESS_LEGACY_STREAM             (1 << 0)
+#define CU_GET_PROC_ADDRESS_PER_THREAD_DEFAULT_STREAM (1 << 1)
+
+typedef CUresult CUDAAPI tcuGetProcAddress(const char *symbol, void **pfn, int cudaVersion, unsigned long long flags);
+
+/************************************
+ **
+ **    Optional capabilities
+ **
+ ** Updated by cuDrvApiRequire once every entry point of a group resolved.
+ ** Callers pick the fastest path the installed driver supports.
+ **
+ ***********************************/
+typedef enum CUdrvapiCapability_enum
+{
+    CU_DRVAPI_CAP_IPC                = 0x01, /**< cuIpc* memory and event handles */
+    CU_DRVAPI_CAP_GL_INTEROP         = 0x02, /**< cuGraphicsGL* registration */
+    CU_DRVAPI_CAP_EGL_INTEROP        = 0x04, /**< cuGraphicsEGLRegisterImage and mapped EGL frames */
+    CU_DRVAPI_CAP_EXTERNAL_MEMORY    = 0x08, /**< cuImportExternalMemory and mappings */
+    CU_DRVAPI_CAP_EXTERNAL_SEMAPHORE = 0x10, /**< cuImportExternalSemaphore, signal and wait */
+    CU_DRVAPI_CAP_PRIMARY_CONTEXT    = 0x20  /**< cuDevicePrimaryCtxRetain and Release */
+} CUdrvapiCapability;
+
+/************************************
+ **
+ **    Loader state
+ **
+ ***********************************/
+typedef struct CUdrvapiInfo_st
+{
+    CUresult initResult;         /**< Result of the first cuInit_drvapi call */
+    int driverVersion;           /**< cuDriverGetVersion, 0 before init */
+    int apiVersion;              /**< API version the entry points are resolved for */
+    unsigned int capabilities;   /**< CUdrvapiCapability bits */
+    unsigned int resolvedGroups; /**< CUdrvapiSymbolGroup bits resolved so far */
+    unsigned int failedGroups;   /**< CUdrvapiSymbolGroup bits that failed to resolve */
+    const char *libraryPath;     /**< File the driver was loaded from, NULL before init or if none loaded */
+} CUdrvapiInfo;
+
+typedef struct CUdrvapiCallStats_st
+{
+    const char *name;            /**< Entry point, without _v2/_v3 suffix */
+    unsigned long long calls;    /**< Calls made through the loader */
+    unsigned long long totalNs;  /**< Wall time spent inside the driver */
+    unsigned long long maxNs;    /**< Slowest single call */
+} CUdrvapiCallStats;
+
+typedef struct CUdrvapiSlowCall_st
+{
+    const char *name;            /**< Entry point, without _v2/_v3 suffix */
+    unsigned long long ns;       /**< Wall time of the call */
+    int thread;                  /**< Loader assigned thread number, from 1 */
+} CUdrvapiSlowCall;
+
 /************************************
  **
  **    Export tables
@@ -1819,144 +2001,46 @@ typedef CUresult CUDAAPI tcuProfilerStop(void);
 /************************************
  ************************************/
 
+// The stub driver only wants the ABI above; it defines the entry points
+// itself and must not see them declared as pointers.
+#ifndef CUDA_DRVAPI_TYPES_ONLY
+
 // changed name from cuInit -> cuInit_drvapi to avoid symbol collision
+// idempotent and thread-safe, only the first call loads the driver
 extern CUresult CUDAAPI cuInit_drvapi(unsigned int, int cudaVersion);
 
+// colon separated list of libraries tried before the default driver names,
+// overrides CUDA_DRVAPI_LIBRARY; CUDA_ERROR_INVALID_VALUE once cuInit_drvapi
+// ran, the choice is made exactly once per process
+extern CUresult CUDAAPI cuDrvApiSetSearchPath(const char *paths);
+
+// resolves the CUdrvapiSymbolGroup bits in |groups| that are not resolved
+// yet; CUDA_ERROR_NOT_FOUND if a required symbol of one of them is missing
+extern CUresult CUDAAPI cuDrvApiRequire(unsigned int groups);
+
+// bitmask of CUdrvapiCapability, covers the groups required so far
+extern unsigned int CUDAAPI cuDrvApiGetCapabilities(void);
+
+// snapshot of the loader state, usable before and after cuInit_drvapi
+extern CUresult CUDAAPI cuDrvApiGetInfo(CUdrvapiInfo *info);
+
+// per entry point counters summed over all threads, only collected when the
+// loader is built with CUDA_DRVAPI_INSTRUMENT; fills at most |count| entries
+// for the symbols called so far and returns how many were written
+extern int CUDAAPI cuDrvApiGetCallStats(CUdrvapiCallStats *stats, int count);
+
+// slowest calls seen by any thread, slowest first; same contract as above
+extern int CUDAAPI cuDrvApiGetSlowestCalls(CUdrvapiSlowCall *calls, int count);
+
+// prints the counters and the slowest calls to stderr; a no-op without
+// CUDA_DRVAPI_INSTRUMENT
+extern void CUDAAPI cuDrvApiDumpCallStats(void);
+
+// resolved during cuInit_drvapi, everything else is declared by
+// cuda_drvapi_symbols.h
 extern tcuDriverGetVersion             *cuDriverGetVersion;
-extern tcuDeviceGet                    *cuDeviceGet;
-extern tcuDeviceGetCount               *cuDeviceGetCount;
-extern tcuDeviceGetName                *cuDeviceGetName;
-extern tcuDeviceComputeCapability      *cuDeviceComputeCapability;
-extern tcuDeviceGetProperties          *cuDeviceGetProperties;
-extern tcuDeviceGetAttribute           *cuDeviceGetAttribute;
-extern tcuGetErrorString               *cuGetErrorString;
-extern tcuCtxDestroy                   *cuCtxDestroy;
-extern tcuCtxAttach                    *cuCtxAttach;
-extern tcuCtxDetach                    *cuCtxDetach;
-extern tcuCtxPushCurrent               *cuCtxPushCurrent;
-extern tcuCtxPopCurrent                *cuCtxPopCurrent;
-
-extern tcuCtxSetCurrent                *cuCtxSetCurrent;
-extern tcuCtxGetCurrent                *cuCtxGetCurrent;
-
-extern tcuCtxGetDevice                 *cuCtxGetDevice;
-extern tcuCtxSynchronize               *cuCtxSynchronize;
-extern tcuModuleLoad                   *cuModuleLoad;
-extern tcuModuleLoadData               *cuModuleLoadData;
-extern tcuModuleLoadDataEx             *cuModuleLoadDataEx;
-extern tcuModuleLoadFatBinary          *cuModuleLoadFatBinary;
-extern tcuModuleUnload                 *cuModuleUnload;
-extern tcuModuleGetFunction            *cuModuleGetFunction;
-extern tcuModuleGetTexRef              *cuModuleGetTexRef;
-extern tcuModuleGetSurfRef             *cuModuleGetSurfRef;
-extern tcuMemFreeHost                  *cuMemFreeHost;
-extern tcuMemHostAlloc                 *cuMemHostAlloc;
-extern tcuMemHostGetFlags              *cuMemHostGetFlags;
-
-extern tcuMemHostRegister              *cuMemHostRegister;
-extern tcuMemHostUnregister            *cuMemHostUnregister;
-extern tcuMemcpy                       *cuMemcpy;
-extern tcuMemcpyPeer                   *cuMemcpyPeer;
-
-extern tcuDeviceTotalMem               *cuDeviceTotalMem;
-extern tcuCtxCreate                    *cuCtxCreate;
-extern tcuModuleGetGlobal              *cuModuleGetGlobal;
-extern tcuMemGetInfo                   *cuMemGetInfo;
-extern tcuMemAlloc                     *cuMemAlloc;
-extern tcuMemAllocPitch                *cuMemAllocPitch;
-extern tcuMemFree                      *cuMemFree;
-extern tcuMemGetAddressRange           *cuMemGetAddressRange;
-extern tcuMemAllocHost                 *cuMemAllocHost;
-extern tcuMemHostGetDevicePointer      *cuMemHostGetDevicePointer;
-extern tcuFuncSetBlockShape            *cuFuncSetBlockShape;
-extern tcuFuncSetSharedSize            *cuFuncSetSharedSize;
-extern tcuFuncGetAttribute             *cuFuncGetAttribute;
-extern tcuFuncSetCacheConfig           *cuFuncSetCacheConfig;
-extern tcuFuncSetSharedMemConfig       *cuFuncSetSharedMemConfig;
-extern tcuLaunchKernel                 *cuLaunchKernel;
-extern tcuArrayDestroy                 *cuArrayDestroy;
-extern tcuTexRefCreate                 *cuTexRefCreate;
-extern tcuTexRefDestroy                *cuTexRefDestroy;
-extern tcuTexRefSetArray               *cuTexRefSetArray;
-extern tcuTexRefSetFormat              *cuTexRefSetFormat;
-extern tcuTexRefSetAddressMode         *cuTexRefSetAddressMode;
-extern tcuTexRefSetFilterMode          *cuTexRefSetFilterMode;
-extern tcuTexRefSetFlags               *cuTexRefSetFlags;
-extern tcuTexRefGetArray               *cuTexRefGetArray;
-extern tcuTexRefGetAddressMode         *cuTexRefGetAddressMode;
-extern tcuTexRefGetFilterMode          *cuTexRefGetFilterMode;
-extern tcuTexRefGetFormat              *cuTexRefGetFormat;
-extern tcuTexRefGetFlags               *cuTexRefGetFlags;
-extern tcuSurfRefSetArray              *cuSurfRefSetArray;
-extern tcuSurfRefGetArray              *cuSurfRefGetArray;
-extern tcuParamSetSize                 *cuParamSetSize;
-extern tcuParamSeti                    *cuParamSeti;
-extern tcuParamSetf                    *cuParamSetf;
-extern tcuParamSetv                    *cuParamSetv;
-extern tcuParamSetTexRef               *cuParamSetTexRef;
-extern tcuLaunch                       *cuLaunch;
-extern tcuLaunchGrid                   *cuLaunchGrid;
-extern tcuLaunchGridAsync              *cuLaunchGridAsync;
-extern tcuEventCreate                  *cuEventCreate;
-extern tcuEventRecord                  *cuEventRecord;
-extern tcuEventQuery                   *cuEventQuery;
-extern tcuEventSynchronize             *cuEventSynchronize;
-extern tcuEventDestroy                 *cuEventDestroy;
-extern tcuEventElapsedTime             *cuEventElapsedTime;
-extern tcuStreamCreate                 *cuStreamCreate;
-extern tcuStreamQuery                  *cuStreamQuery;
-extern tcuStreamWaitEvent              *cuStreamWaitEvent;
-extern tcuStreamAddCallback            *cuStreamAddCallback;
-extern tcuStreamSynchronize            *cuStreamSynchronize;
-extern tcuStreamDestroy                *cuStreamDestroy;
-extern tcuGraphicsUnregisterResource         *cuGraphicsUnregisterResource;
-extern tcuGraphicsSubResourceGetMappedArray  *cuGraphicsSubResourceGetMappedArray;
-extern tcuGraphicsResourceSetMapFlags        *cuGraphicsResourceSetMapFlags;
-extern tcuGraphicsMapResources               *cuGraphicsMapResources;
-extern tcuGraphicsUnmapResources             *cuGraphicsUnmapResources;
-extern tcuGetExportTable                     *cuGetExportTable;
-extern tcuCtxSetLimit                        *cuCtxSetLimit;
-extern tcuCtxGetLimit                        *cuCtxGetLimit;
-
-// These functions could be using the CUDA 3.2 interface (_v2)
-extern tcuMemcpyHtoD                   *cuMemcpyHtoD;
-extern tcuMemcpyDtoH                   *cuMemcpyDtoH;
-extern tcuMemcpyDtoD                   *cuMemcpyDtoD;
-extern tcuMemcpyDtoA                   *cuMemcpyDtoA;
-extern tcuMemcpyAtoD                   *cuMemcpyAtoD;
-extern tcuMemcpyHtoA                   *cuMemcpyHtoA;
-extern tcuMemcpyAtoH                   *cuMemcpyAtoH;
-extern tcuMemcpyAtoA                   *cuMemcpyAtoA;
-extern tcuMemcpy2D                     *cuMemcpy2D;
-extern tcuMemcpy2DUnaligned            *cuMemcpy2DUnaligned;
-extern tcuMemcpy3D                     *cuMemcpy3D;
-extern tcuMemcpyHtoDAsync              *cuMemcpyHtoDAsync;
-extern tcuMemcpyDtoHAsync              *cuMemcpyDtoHAsync;
-extern tcuMemcpyDtoDAsync              *cuMemcpyDtoDAsync;
-extern tcuMemcpyHtoAAsync              *cuMemcpyHtoAAsync;
-extern tcuMemcpyAtoHAsync              *cuMemcpyAtoHAsync;
-extern tcuMemcpy2DAsync                *cuMemcpy2DAsync;
-extern tcuMemcpy3DAsync                *cuMemcpy3DAsync;
-extern tcuMemsetD8                     *cuMemsetD8;
-extern tcuMemsetD16                    *cuMemsetD16;
-extern tcuMemsetD32                    *cuMemsetD32;
-extern tcuMemsetD2D8                   *cuMemsetD2D8;
-extern tcuMemsetD2D16                  *cuMemsetD2D16;
-extern tcuMemsetD2D32                  *cuMemsetD2D32;
-extern tcuArrayCreate                  *cuArrayCreate;
-extern tcuArrayGetDescriptor           *cuArrayGetDescriptor;
-extern tcuArray3DCreate                *cuArray3DCreate;
-extern tcuArray3DGetDescriptor         *cuArray3DGetDescriptor;
-extern tcuTexRefSetAddress             *cuTexRefSetAddress;
-extern tcuTexRefSetAddress2D           *cuTexRefSetAddress2D;
-extern tcuTexRefGetAddress             *cuTexRefGetAddress;
-extern tcuGraphicsResourceGetMappedPointer   *cuGraphicsResourceGetMappedPointer;
-
-extern tcuMipmappedArrayCreate         *cuMipmappedArrayCreate;
-extern tcuMipmappedArrayGetLevel       *cuMipmappedArrayGetLevel;
-extern tcuMipmappedArrayDestroy        *cuMipmappedArrayDestroy;
-
-extern tcuProfilerStop                    *cuProfilerStop;
+
+#endif // CUDA_DRVAPI_TYPES_ONLY
 
 #ifdef __cplusplus
 }
@@ -22,8 +22,48 @@
 #include <EGL/egl.h>
 #include "EGL/eglext.h"
 
-struct CUeglFrame_st;
-typedef struct CUeglFrame_st CUeglFrame;
+/************************************
+ **
+ **    EGL frame types
+ **
+ ** Taken from cudaEGL.h, which cannot be included next to the dynlink
+ ** pointers because it declares the same names as functions.
+ **
+ ***********************************/
+
+#define CU_EGL_MAX_PLANES 3
+
+typedef enum CUeglFrameType_enum {
+    CU_EGL_FRAME_TYPE_ARRAY = 0,  /**< Frame type CUDA array */
+    CU_EGL_FRAME_TYPE_PITCH = 1,  /**< Frame type pointer */
+} CUeglFrameType;
+
+// Subset of CUeglColorFormat used here; values match cudaEGL.h
+typedef enum CUeglColorFormat_enum {
+    CU_EGL_COLOR_FORMAT_YUV420_PLANAR              = 0x00,
+    CU_EGL_COLOR_FORMAT_YUV420_SEMIPLANAR          = 0x01,
+    CU_EGL_COLOR_FORMAT_ARGB                       = 0x06,
+    CU_EGL_COLOR_FORMAT_RGBA                       = 0x07,
+    CU_EGL_COLOR_FORMAT_ABGR                       = 0x0E,
+    CU_EGL_COLOR_FORMAT_BGRA                       = 0x0F,
+    CU_EGL_COLOR_FORMAT_MAX                        = 0x48
+} CUeglColorFormat;
+
+typedef struct CUeglFrame_st {
+    union {
+        CUarray pArray[CU_EGL_MAX_PLANES];  /**< Array of CUarray corresponding to each plane*/
+        void*   pPitch[CU_EGL_MAX_PLANES];  /**< Array of Pointers corresponding to each plane*/
+    } frame;
+    unsigned int width;                 /**< Width of first plane */
+    unsigned int height;                /**< Height of first plane */
+    unsigned int depth;                 /**< Depth of first plane */
+    unsigned int pitch;                 /**< Pitch of first plane */
+    unsigned int planeCount;            /**< Number of planes */
+    unsigned int numChannels;           /**< Number of channels for the plane */
+    CUeglFrameType frameType;           /**< Array or Pitch */
+    CUeglColorFormat eglColorFormat;    /**< CUDA EGL Color Format*/
+    CUarray_format cuFormat;            /**< CUDA Array Format*/
+} CUeglFrame;
 
 /************************************
  **
@@ -36,9 +76,21 @@ typedef CUresult CUDAAPI tcuGLCtxCreate(CUcontext *pCtx, unsigned int Flags, CUd
 typedef CUresult CUDAAPI tcuGraphicsGLRegisterBuffer(CUgraphicsResource *pCudaResource, GLuint buffer, unsigned int Flags);
 typedef CUresult CUDAAPI tcuGraphicsGLRegisterImage(CUgraphicsResource *pCudaResource, GLuint image, GLenum target, unsigned int Flags);
 
+// CUDA devices backing the current OpenGL context (CUDA 4.1+)
+typedef enum CUGLDeviceList_enum
+{
+    CU_GL_DEVICE_LIST_ALL            = 0x01, /**< The CUDA devices for all GPUs used by the current OpenGL context */
+    CU_GL_DEVICE_LIST_CURRENT_FRAME  = 0x02, /**< The CUDA devices for the GPUs used by the current OpenGL context in its currently rendering frame */
+    CU_GL_DEVICE_LIST_NEXT_FRAME     = 0x03  /**< The CUDA devices for the GPUs to be used by the current OpenGL context in the next frame */
+} CUGLDeviceList;
+
+typedef CUresult CUDAAPI tcuGLGetDevices(unsigned int *pCudaDeviceCount, CUdevice *pCudaDevices, unsigned int cudaDeviceCount, CUGLDeviceList deviceList);
+
 typedef CUresult CUDAAPI tcuGraphicsEGLRegisterImage(
 		    CUgraphicsResource *pCudaResource, EGLImageKHR image, unsigned int flags);
 typedef CUresult CUDAAPI tcuGraphicsResourceGetMappedEglFrame(
 		    CUeglFrame *eglFrame, CUgraphicsResource resource, unsigned int index, unsigned int mipLevel);
+typedef CUresult CUDAAPI tcuEventCreateFromEGLSync(
+		    CUevent *phEvent, EGLSyncKHR eglSync, unsigned int flags);
 
 #endif // __cuda_drvapi_dynlink_cuda_gl_h__
@@ -0,0 +1,136 @@
+#include "cuda_drvapi_dynlink.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "cuda_stub_driver_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace viz {
+
+namespace {
+
+constexpr unsigned int kAllGroups =
+    CU_DRVAPI_SYMBOLS_CORE | CU_DRVAPI_SYMBOLS_IPC | CU_DRVAPI_SYMBOLS_GL |
+    CU_DRVAPI_SYMBOLS_EGL | CU_DRVAPI_SYMBOLS_EXTERNAL |
+    CU_DRVAPI_SYMBOLS_LEGACY;
+
+constexpr unsigned int kAllCapabilities =
+    CU_DRVAPI_CAP_IPC | CU_DRVAPI_CAP_GL_INTEROP | CU_DRVAPI_CAP_EGL_INTEROP |
+    CU_DRVAPI_CAP_EXTERNAL_MEMORY | CU_DRVAPI_CAP_EXTERNAL_SEMAPHORE |
+    CU_DRVAPI_CAP_PRIMARY_CONTEXT;
+
+// Entry points of the table that the loaded driver and API version should
+// have resolved but did not.
+std::string MissingSymbols() {
+  CUdrvapiInfo info = {};
+  cuDrvApiGetInfo(&info);
+  std::string missing;
+#define CHECK_SYMBOL(name, group, min_driver, min_api, ...)      \
+  if (info.driverVersion >= min_driver &&                        \
+      info.apiVersion >= min_api && name == nullptr) {           \
+    missing += #name " ";                                        \
+  }
+  CU_DRVAPI_SYMBOL_TABLE(CHECK_SYMBOL)
+#undef CHECK_SYMBOL
+  return missing;
+}
+
+TEST(CudaDrvApiTest, EveryGroupResolves) {
+  ASSERT_EQ(CUDA_SUCCESS, InitCudaStubDriver());
+  for (unsigned int group = 1; group & kAllGroups; group <<= 1)
+    EXPECT_EQ(CUDA_SUCCESS, cuDrvApiRequire(group)) << "group 0x" << group;
+
+  CUdrvapiInfo info = {};
+  ASSERT_EQ(CUDA_SUCCESS, cuDrvApiGetInfo(&info));
+  EXPECT_EQ(kAllGroups, info.resolvedGroups & kAllGroups);
+  EXPECT_EQ(0u, info.failedGroups);
+  EXPECT_EQ(kAllCapabilities, cuDrvApiGetCapabilities());
+  EXPECT_EQ("", MissingSymbols());
+}
+
+TEST(CudaDrvApiTest, LoadsOnce) {
+  ASSERT_EQ(CUDA_SUCCESS, InitCudaStubDriver());
+  CUdrvapiInfo info = {};
+  ASSERT_EQ(CUDA_SUCCESS, cuDrvApiGetInfo(&info));
+  ASSERT_NE(nullptr, info.libraryPath);
+  EXPECT_NE(nullptr, strstr(info.libraryPath, "libcuda_stub_driver.so"));
+
+  // The first result sticks, whatever comes later.
+  EXPECT_NE(CUDA_SUCCESS, cuDrvApiSetSearchPath("/nonexistent/libcuda.so"));
+  EXPECT_EQ(CUDA_SUCCESS, cuInit_drvapi(0, __CUDA_API_VERSION));
+  CUdrvapiInfo again = {};
+  cuDrvApiGetInfo(&again);
+  EXPECT_STREQ(info.libraryPath, again.libraryPath);
+}
+
+// The rest needs a loader that has not resolved anything yet, and a stub
+// reporting an older driver.
+
+void ExpectCuda9Driver() {
+  setenv("CUDA_STUB_DRIVER_VERSION", "9000", /*overwrite=*/1);
+  ASSERT_EQ(CUDA_SUCCESS, InitCudaStubDriver());
+  ASSERT_EQ(CUDA_SUCCESS, cuDrvApiRequire(kAllGroups));
+
+  CUdrvapiInfo info = {};
+  cuDrvApiGetInfo(&info);
+  EXPECT_EQ(9000, info.driverVersion);
+  // Below their minimum driver version: left NULL, the group still
+  // resolves and the capability is not reported.
+  EXPECT_EQ(nullptr, cuDeviceGetUuid);
+  EXPECT_EQ(nullptr, cuImportExternalMemory);
+  EXPECT_EQ(nullptr, cuImportExternalSemaphore);
+  EXPECT_EQ(0u, cuDrvApiGetCapabilities() & (CU_DRVAPI_CAP_EXTERNAL_MEMORY |
+                                             CU_DRVAPI_CAP_EXTERNAL_SEMAPHORE));
+  EXPECT_NE(0u, cuDrvApiGetCapabilities() & CU_DRVAPI_CAP_PRIMARY_CONTEXT);
+  EXPECT_EQ(0u, info.failedGroups);
+  EXPECT_EQ("", MissingSymbols());
+}
+
+TEST(CudaDrvApiVersionTest, Cuda9) {
+  EXPECT_IN_FRESH_PROCESS(ExpectCuda9Driver());
+}
+
+void ExpectCuda10Driver() {
+  setenv("CUDA_STUB_DRIVER_VERSION", "10000", /*overwrite=*/1);
+  ASSERT_EQ(CUDA_SUCCESS, InitCudaStubDriver());
+  ASSERT_EQ(CUDA_SUCCESS, cuDrvApiRequire(kAllGroups));
+
+  EXPECT_NE(nullptr, cuDeviceGetUuid);
+  EXPECT_NE(nullptr, cuImportExternalMemory);
+  EXPECT_EQ(kAllCapabilities, cuDrvApiGetCapabilities());
+  EXPECT_EQ("", MissingSymbols());
+}
+
+TEST(CudaDrvApiVersionTest, Cuda10) {
+  EXPECT_IN_FRESH_PROCESS(ExpectCuda10Driver());
+}
+
+void ExpectNothingResolvedAfterFailedInit() {
+  EXPECT_EQ(CUDA_ERROR_NOT_INITIALIZED,
+            cuDrvApiRequire(CU_DRVAPI_SYMBOLS_CORE));
+
+  // No device: the library loads, its cuInit fails.
+  setenv("CUDA_STUB_INIT_RESULT", "100", /*overwrite=*/1);
+  ASSERT_EQ(CUDA_ERROR_NO_DEVICE, InitCudaStubDriver());
+  for (unsigned int group = 1; group & kAllGroups; group <<= 1) {
+    EXPECT_EQ(CUDA_ERROR_NO_DEVICE, cuDrvApiRequire(group))
+        << "group 0x" << group;
+  }
+
+  CUdrvapiInfo info = {};
+  cuDrvApiGetInfo(&info);
+  EXPECT_EQ(CUDA_ERROR_NO_DEVICE, info.initResult);
+  EXPECT_EQ(0u, info.resolvedGroups);
+  EXPECT_EQ(0u, cuDrvApiGetCapabilities());
+}
+
+TEST(CudaDrvApiVersionTest, FailedInit) {
+  EXPECT_IN_FRESH_PROCESS(ExpectNothingResolvedAfterFailedInit());
+}
+
+}  // namespace
+
+}  // namespace viz
@@ -0,0 +1,290 @@
+// Per entry point call tracing for the dynlink loader.
+//
+// Built with CUDA_DRVAPI_INSTRUMENT defined (GN: cuda_loader_call_trace),
+// every pointer resolved from CU_DRVAPI_SYMBOL_TABLE is swapped for an
+// interposer with the exact same signature that times the real call. Callers
+// keep calling through the same globals, so the numbers are the same against
+// the real driver or the stub. Without the define only the query functions
+// are left, reporting nothing.
+//
+// Each thread counts into its own block: the owner is the only writer, so a
+// call costs two clock reads and a few relaxed stores, never a shared cache
+// line or a lock. Readers sum the blocks; a snapshot taken while calls are in
+// flight may be one call behind per thread.
+//
+// Setting CUDA_DRVAPI_TRACE_SIGNAL (USR1, USR2 or a number) makes that signal
+// request a dump, printed by the next thread that calls into the driver.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cuda_drvapi_dynlink.h"
+
+#if defined(CUDA_DRVAPI_INSTRUMENT)
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace {
+
+// Slowest calls remembered per thread; the dump merges them.
+constexpr int kSlowestPerThread = 8;
+constexpr int kSlowestDumped = 16;
+
+// A slow call is packed into one word so readers never see a torn pair:
+// symbol index in the top 16 bits, nanoseconds below (~78 hours).
+constexpr int kSlowCallIndexShift = 48;
+constexpr uint64_t kSlowCallNsMask = (uint64_t{1} << kSlowCallIndexShift) - 1;
+
+struct ThreadCounters {
+  std::atomic<uint64_t> calls[CU_DRVAPI_SYMBOL_COUNT] = {};
+  std::atomic<uint64_t> total_ns[CU_DRVAPI_SYMBOL_COUNT] = {};
+  std::atomic<uint64_t> max_ns[CU_DRVAPI_SYMBOL_COUNT] = {};
+  std::atomic<uint64_t> slowest[kSlowestPerThread] = {};
+
+  // Owner only: the entry of |slowest| to replace next and its duration.
+  int slowest_min_slot = 0;
+  uint64_t slowest_min_ns = 0;
+
+  int thread = 0;
+  ThreadCounters* next = nullptr;
+};
+
+std::atomic<void*> g_procs[CU_DRVAPI_SYMBOL_COUNT];
+// Blocks are never freed; a thread that exits keeps its counts in the totals.
+std::atomic<ThreadCounters*> g_threads{nullptr};
+std::atomic<int> g_thread_count{0};
+std::atomic<bool> g_dump_requested{false};
+thread_local ThreadCounters* t_counters = nullptr;
+
+#define CU_DRVAPI_SYMBOL_NAME(name, ...) #name,
+const char* const kSymbolNames[] = {
+    CU_DRVAPI_SYMBOL_TABLE(CU_DRVAPI_SYMBOL_NAME)};
+#undef CU_DRVAPI_SYMBOL_NAME
+
+ThreadCounters* CreateThreadCounters() {
+  ThreadCounters* counters = new ThreadCounters;
+  counters->thread = g_thread_count.fetch_add(1, std::memory_order_relaxed) + 1;
+  ThreadCounters* head = g_threads.load(std::memory_order_relaxed);
+  do {
+    counters->next = head;
+  } while (!g_threads.compare_exchange_weak(head, counters,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+  return counters;
+}
+
+// Single writer, so plain load and store instead of read-modify-write.
+void Bump(std::atomic<uint64_t>& counter, uint64_t delta) {
+  counter.store(counter.load(std::memory_order_relaxed) + delta,
+                std::memory_order_relaxed);
+}
+
+void RecordCall(int index, uint64_t ns) {
+  ThreadCounters* counters = t_counters;
+  if (!counters)
+    counters = t_counters = CreateThreadCounters();
+
+  Bump(counters->calls[index], 1);
+  Bump(counters->total_ns[index], ns);
+  if (ns > counters->max_ns[index].load(std::memory_order_relaxed))
+    counters->max_ns[index].store(ns, std::memory_order_relaxed);
+
+  ns = std::min(ns, kSlowCallNsMask);
+  if (ns <= counters->slowest_min_ns)
+    return;
+  counters->slowest[counters->slowest_min_slot].store(
+      (static_cast<uint64_t>(index) << kSlowCallIndexShift) | ns,
+      std::memory_order_relaxed);
+  counters->slowest_min_ns = UINT64_MAX;
+  for (int i = 0; i < kSlowestPerThread; ++i) {
+    const uint64_t slot_ns =
+        counters->slowest[i].load(std::memory_order_relaxed) & kSlowCallNsMask;
+    if (slot_ns < counters->slowest_min_ns) {
+      counters->slowest_min_ns = slot_ns;
+      counters->slowest_min_slot = i;
+    }
+  }
+}
+
+template <int kIndex, typename Signature>
+struct Interposer;
+
+template <int kIndex, typename R, typename... Args>
+struct Interposer<kIndex, R CUDAAPI(Args...)> {
+  static R CUDAAPI Call(Args... args) {
+    using Proc = R(CUDAAPI*)(Args...);
+    const auto start = std::chrono::steady_clock::now();
+    R result = reinterpret_cast<Proc>(
+        g_procs[kIndex].load(std::memory_order_relaxed))(args...);
+    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    RecordCall(kIndex, ns);
+    if (g_dump_requested.load(std::memory_order_relaxed) &&
+        g_dump_requested.exchange(false, std::memory_order_relaxed)) {
+      cuDrvApiDumpCallStats();
+    }
+    return result;
+  }
+};
+
+#define CU_DRVAPI_SYMBOL_INTERPOSER(name, ...)                    \
+  reinterpret_cast<void*>(                                        \
+      &Interposer<CU_DRVAPI_SYMBOL_INDEX_##name, t##name>::Call),
+void* const kInterposers[] = {
+    CU_DRVAPI_SYMBOL_TABLE(CU_DRVAPI_SYMBOL_INTERPOSER)};
+#undef CU_DRVAPI_SYMBOL_INTERPOSER
+
+void OnDumpSignal(int) {
+  g_dump_requested.store(true, std::memory_order_relaxed);
+}
+
+void InstallDumpSignal() {
+  const char* env = getenv("CUDA_DRVAPI_TRACE_SIGNAL");
+  if (!env || !*env)
+    return;
+
+  int signo = 0;
+  if (!strcmp(env, "USR1") || !strcmp(env, "SIGUSR1"))
+    signo = SIGUSR1;
+  else if (!strcmp(env, "USR2") || !strcmp(env, "SIGUSR2"))
+    signo = SIGUSR2;
+  else
+    signo = atoi(env);
+  if (signo <= 0) {
+    fprintf(stderr, "[cuda_drvapi] ignoring CUDA_DRVAPI_TRACE_SIGNAL=%s\n",
+            env);
+    return;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = OnDumpSignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(signo, &action, nullptr) != 0) {
+    fprintf(stderr, "[cuda_drvapi] cannot install dump handler for signal %d\n",
+            signo);
+  }
+}
+
+std::vector<CUdrvapiCallStats> CollectCallStats() {
+  std::vector<CUdrvapiCallStats> stats(CU_DRVAPI_SYMBOL_COUNT);
+  for (ThreadCounters* counters = g_threads.load(std::memory_order_acquire);
+       counters; counters = counters->next) {
+    for (int i = 0; i < CU_DRVAPI_SYMBOL_COUNT; ++i) {
+      stats[i].calls += counters->calls[i].load(std::memory_order_relaxed);
+      stats[i].totalNs += counters->total_ns[i].load(std::memory_order_relaxed);
+      stats[i].maxNs = std::max<unsigned long long>(
+          stats[i].maxNs, counters->max_ns[i].load(std::memory_order_relaxed));
+    }
+  }
+  std::vector<CUdrvapiCallStats> called;
+  for (int i = 0; i < CU_DRVAPI_SYMBOL_COUNT; ++i) {
+    if (!stats[i].calls)
+      continue;
+    stats[i].name = kSymbolNames[i];
+    called.push_back(stats[i]);
+  }
+  return called;
+}
+
+std::vector<CUdrvapiSlowCall> CollectSlowestCalls() {
+  std::vector<CUdrvapiSlowCall> calls;
+  for (ThreadCounters* counters = g_threads.load(std::memory_order_acquire);
+       counters; counters = counters->next) {
+    for (const auto& slot : counters->slowest) {
+      const uint64_t packed = slot.load(std::memory_order_relaxed);
+      if (!packed)
+        continue;
+      CUdrvapiSlowCall call;
+      call.name = kSymbolNames[packed >> kSlowCallIndexShift];
+      call.ns = packed & kSlowCallNsMask;
+      call.thread = counters->thread;
+      calls.push_back(call);
+    }
+  }
+  std::sort(calls.begin(), calls.end(),
+            [](const CUdrvapiSlowCall& a, const CUdrvapiSlowCall& b) {
+              return a.ns > b.ns;
+            });
+  return calls;
+}
+
+}  // namespace
+
+// Called by the loader, under its lock, for every symbol it resolves.
+extern "C" void* __cuDrvInstrument(int index, void* proc) {
+  static bool signal_installed = false;
+  if (!signal_installed) {
+    signal_installed = true;
+    InstallDumpSignal();
+  }
+  g_procs[index].store(proc, std::memory_order_relaxed);
+  return kInterposers[index];
+}
+
+extern "C" int CUDAAPI cuDrvApiGetCallStats(CUdrvapiCallStats* stats,
+                                            int count) {
+  const std::vector<CUdrvapiCallStats> called = CollectCallStats();
+  const int written = std::min<int>(count, called.size());
+  std::copy_n(called.begin(), written, stats);
+  return written;
+}
+
+extern "C" int CUDAAPI cuDrvApiGetSlowestCalls(CUdrvapiSlowCall* calls,
+                                               int count) {
+  const std::vector<CUdrvapiSlowCall> slowest = CollectSlowestCalls();
+  const int written = std::min<int>(count, slowest.size());
+  std::copy_n(slowest.begin(), written, calls);
+  return written;
+}
+
+extern "C" void CUDAAPI cuDrvApiDumpCallStats(void) {
+  std::vector<CUdrvapiCallStats> stats = CollectCallStats();
+  std::sort(stats.begin(), stats.end(),
+            [](const CUdrvapiCallStats& a, const CUdrvapiCallStats& b) {
+              return a.totalNs > b.totalNs;
+            });
+
+  fprintf(stderr, "[cuda_drvapi] call stats, %d threads\n",
+          g_thread_count.load(std::memory_order_relaxed));
+  fprintf(stderr, "[cuda_drvapi] %-36s %10s %12s %10s %10s\n", "entry point",
+          "calls", "total ms", "avg us", "max us");
+  for (const CUdrvapiCallStats& entry : stats) {
+    fprintf(stderr, "[cuda_drvapi] %-36s %10llu %12.3f %10.1f %10.1f\n",
+            entry.name, entry.calls, entry.totalNs / 1e6,
+            entry.totalNs / 1e3 / entry.calls, entry.maxNs / 1e3);
+  }
+
+  const std::vector<CUdrvapiSlowCall> slowest = CollectSlowestCalls();
+  const size_t shown = std::min<size_t>(slowest.size(), kSlowestDumped);
+  for (size_t i = 0; i < shown; ++i) {
+    fprintf(stderr, "[cuda_drvapi] slow #%zu %s %.1f us on thread %d\n", i + 1,
+            slowest[i].name, slowest[i].ns / 1e3, slowest[i].thread);
+  }
+  fflush(stderr);
+}
+
+#else
+
+extern "C" int CUDAAPI cuDrvApiGetCallStats(CUdrvapiCallStats* stats,
+                                            int count) {
+  return 0;
+}
+
+extern "C" int CUDAAPI cuDrvApiGetSlowestCalls(CUdrvapiSlowCall* calls,
+                                               int count) {
+  return 0;
+}
+
+extern "C" void CUDAAPI cuDrvApiDumpCallStats(void) {}
+
+#endif  // defined(CUDA_DRVAPI_INSTRUMENT)
@@ -0,0 +1,233 @@
+/*
+ * Every driver entry point the loader knows about, in one list.
+ *
+ * The pointer globals, their extern declarations, resolution and the
+ * capability bits are all generated from CU_DRVAPI_SYMBOL_TABLE, so adding an
+ * entry point means adding its typedef and one line here. The typedefs stay
+ * hand written in cuda_drvapi_dynlink_cuda.h and cuda_drvapi_dynlink_gl.h.
+ *
+ * X(name, group, minDriver, minApi, v2Since, v3Since, required, capability)
+ *
+ *   name        entry point, also the global holding the pointer
+ *   group       CUdrvapiSymbolGroup without the prefix; GRAPHICS resolves
+ *               with either GL or EGL
+ *   minDriver   cuDriverGetVersion() below which the symbol is left NULL
+ *   minApi      requested API version below which the symbol is left NULL
+ *   v2Since     API version from which the _v2 export is used, 0 for never
+ *   v3Since     same for _v3
+ *   required    REQUIRED fails the group when missing, OPTIONAL leaves NULL
+ *   capability  CUdrvapiCapability without the prefix, or NONE; the bit is
+ *               only reported when every symbol tagged with it resolved
+ *
+ * cuInit, cuDriverGetVersion and cuGetProcAddress are needed to bootstrap
+ * everything else and are resolved by hand in cuda_drvapi_dynlink.c.
+ */
+
+#ifndef __cuda_drvapi_symbols_h__
+#define __cuda_drvapi_symbols_h__
+
+#define CU_DRVAPI_SYMBOLS_GRAPHICS (CU_DRVAPI_SYMBOLS_GL | CU_DRVAPI_SYMBOLS_EGL)
+#define CU_DRVAPI_SYMBOL_REQUIRED 1
+#define CU_DRVAPI_SYMBOL_OPTIONAL 0
+#define CU_DRVAPI_CAP_NONE 0
+
+#define CU_DRVAPI_SYMBOL_TABLE(X)                                                          \
+    /* devices */                                                                          \
+    X(cuDeviceGet,                              CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuDeviceGetCount,                         CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuDeviceGetName,                          CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuDeviceGetAttribute,                     CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuDeviceTotalMem,                         CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuDeviceGetByPCIBusId,                    CORE,     0,     4010, 0,    0,    REQUIRED, NONE)              \
+    X(cuDeviceGetPCIBusId,                      CORE,     0,     4010, 0,    0,    REQUIRED, NONE)              \
+    /* only used to match the rendering GPU on multi-GPU hosts */                          \
+    X(cuDeviceGetUuid,                          CORE,     9020,  0,    0,    0,    OPTIONAL, NONE)              \
+    X(cuGetErrorString,                         CORE,     6000,  0,    0,    0,    OPTIONAL, NONE)              \
+    /* contexts */                                                                         \
+    X(cuCtxCreate,                              CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuCtxDestroy,                             CORE,     0,     0,    4000, 0,    REQUIRED, NONE)              \
+    X(cuCtxPushCurrent,                         CORE,     0,     0,    4000, 0,    REQUIRED, NONE)              \
+    X(cuCtxPopCurrent,                          CORE,     0,     0,    4000, 0,    REQUIRED, NONE)              \
+    /* shares the context the runtime API and other in-process users get */                \
+    X(cuDevicePrimaryCtxRetain,                 CORE,     7000,  0,    0,    0,    OPTIONAL, PRIMARY_CONTEXT)   \
+    X(cuDevicePrimaryCtxRelease,                CORE,     7000,  0,    11000, 0,   OPTIONAL, PRIMARY_CONTEXT)   \
+    X(cuCtxGetCurrent,                          CORE,     4000,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuCtxSetCurrent,                          CORE,     4000,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuCtxGetDevice,                           CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuCtxSynchronize,                         CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuCtxSetLimit,                            CORE,     3010,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuCtxGetLimit,                            CORE,     3010,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuCtxGetCacheConfig,                      CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuCtxSetCacheConfig,                      CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuCtxGetApiVersion,                       CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    /* modules and launches */                                                             \
+    X(cuModuleLoad,                             CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuModuleLoadData,                         CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuModuleLoadDataEx,                       CORE,     2010,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuModuleUnload,                           CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuModuleGetFunction,                      CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuModuleGetGlobal,                        CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuFuncGetAttribute,                       CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuFuncSetCacheConfig,                     CORE,     3000,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuLaunchKernel,                           CORE,     4000,  0,    0,    0,    REQUIRED, NONE)              \
+    /* memory */                                                                           \
+    X(cuMemGetInfo,                             CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemAlloc,                               CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemAllocPitch,                          CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemFree,                                CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemGetAddressRange,                     CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemAllocHost,                           CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemFreeHost,                            CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuMemHostAlloc,                           CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuMemHostGetDevicePointer,                CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemHostGetFlags,                        CORE,     2030,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuMemHostRegister,                        CORE,     4000,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuMemHostUnregister,                      CORE,     4000,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuMemcpy,                                 CORE,     4000,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuMemcpyPeer,                             CORE,     4000,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuMemcpyHtoD,                             CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpyDtoH,                             CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpyDtoD,                             CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpyDtoA,                             CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpyAtoD,                             CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpyHtoA,                             CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpyAtoH,                             CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpyAtoA,                             CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpy2D,                               CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpy2DUnaligned,                      CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpy3D,                               CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpyHtoDAsync,                        CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpyDtoHAsync,                        CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpyDtoDAsync,                        CORE,     3000,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuMemcpyHtoAAsync,                        CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpyAtoHAsync,                        CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpy2DAsync,                          CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemcpy3DAsync,                          CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemsetD8,                               CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemsetD16,                              CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemsetD32,                              CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemsetD2D8,                             CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemsetD2D16,                            CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuMemsetD2D32,                            CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuArrayCreate,                            CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuArrayGetDescriptor,                     CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuArrayDestroy,                           CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuArray3DCreate,                          CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuArray3DGetDescriptor,                   CORE,     0,     0,    3020, 0,    REQUIRED, NONE)              \
+    /* nothing here uses these; drivers may drop them */                                   \
+    X(cuMipmappedArrayCreate,                   CORE,     5000,  0,    0,    0,    OPTIONAL, NONE)              \
+    X(cuMipmappedArrayDestroy,                  CORE,     5000,  0,    0,    0,    OPTIONAL, NONE)              \
+    X(cuMipmappedArrayGetLevel,                 CORE,     5000,  0,    0,    0,    OPTIONAL, NONE)              \
+    /* events and streams */                                                               \
+    X(cuEventCreate,                            CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuEventRecord,                            CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuEventQuery,                             CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuEventSynchronize,                       CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuEventDestroy,                           CORE,     0,     0,    4000, 0,    REQUIRED, NONE)              \
+    X(cuEventElapsedTime,                       CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuStreamCreate,                           CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuStreamWaitEvent,                        CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuStreamAddCallback,                      CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuStreamQuery,                            CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuStreamSynchronize,                      CORE,     0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuStreamDestroy,                          CORE,     0,     0,    4000, 0,    REQUIRED, NONE)              \
+    /* nothing here uses these; drivers may drop them */                                   \
+    X(cuGetExportTable,                         CORE,     3000,  0,    0,    0,    OPTIONAL, NONE)              \
+    X(cuProfilerStop,                           CORE,     4000,  0,    0,    0,    OPTIONAL, NONE)              \
+    /* IPC */                                                                              \
+    X(cuIpcGetEventHandle,                      IPC,      0,     4010, 0,    0,    REQUIRED, NONE)              \
+    X(cuIpcOpenEventHandle,                     IPC,      0,     4010, 0,    0,    REQUIRED, NONE)              \
+    X(cuIpcGetMemHandle,                        IPC,      0,     4010, 0,    0,    REQUIRED, IPC)               \
+    X(cuIpcOpenMemHandle,                       IPC,      0,     4010, 0,    0,    REQUIRED, IPC)               \
+    X(cuIpcCloseMemHandle,                      IPC,      0,     4010, 0,    0,    REQUIRED, IPC)               \
+    /* map/unmap and unregister, shared by every graphics interop group */                 \
+    X(cuGraphicsUnregisterResource,             GRAPHICS, 3000,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuGraphicsSubResourceGetMappedArray,      GRAPHICS, 3000,  0,    0,    0,    REQUIRED, GL_INTEROP)        \
+    X(cuGraphicsResourceGetMappedPointer,       GRAPHICS, 3000,  0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuGraphicsResourceSetMapFlags,            GRAPHICS, 3000,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuGraphicsMapResources,                   GRAPHICS, 3000,  0,    0,    0,    REQUIRED, GL_INTEROP)        \
+    X(cuGraphicsUnmapResources,                 GRAPHICS, 3000,  0,    0,    0,    REQUIRED, NONE)              \
+    /* GL */                                                                               \
+    X(cuGLCtxCreate,                            GL,       2010,  0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuGraphicsGLRegisterBuffer,               GL,       2010,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuGraphicsGLRegisterImage,                GL,       2010,  0,    0,    0,    REQUIRED, GL_INTEROP)        \
+    X(cuGLGetDevices,                           GL,       2010,  0,    1,    0,    OPTIONAL, NONE)              \
+    /* EGL */                                                                              \
+    X(cuGraphicsEGLRegisterImage,               EGL,      0,     0,    0,    0,    OPTIONAL, EGL_INTEROP)       \
+    X(cuGraphicsResourceGetMappedEglFrame,      EGL,      0,     0,    0,    0,    OPTIONAL, EGL_INTEROP)       \
+    X(cuEventCreateFromEGLSync,                 EGL,      9000,  0,    0,    0,    OPTIONAL, NONE)              \
+    /* external memory and semaphores (CUDA 10.0) */                                       \
+    X(cuImportExternalMemory,                   EXTERNAL, 10000, 0,    0,    0,    OPTIONAL, EXTERNAL_MEMORY)   \
+    X(cuExternalMemoryGetMappedBuffer,          EXTERNAL, 10000, 0,    0,    0,    OPTIONAL, EXTERNAL_MEMORY)   \
+    X(cuExternalMemoryGetMappedMipmappedArray,  EXTERNAL, 10000, 0,    0,    0,    OPTIONAL, EXTERNAL_MEMORY)   \
+    X(cuDestroyExternalMemory,                  EXTERNAL, 10000, 0,    0,    0,    OPTIONAL, EXTERNAL_MEMORY)   \
+    X(cuImportExternalSemaphore,                EXTERNAL, 10000, 0,    0,    0,    OPTIONAL, EXTERNAL_SEMAPHORE) \
+    X(cuSignalExternalSemaphoresAsync,          EXTERNAL, 10000, 0,    0,    0,    OPTIONAL, EXTERNAL_SEMAPHORE) \
+    X(cuWaitExternalSemaphoresAsync,            EXTERNAL, 10000, 0,    0,    0,    OPTIONAL, EXTERNAL_SEMAPHORE) \
+    X(cuDestroyExternalSemaphore,               EXTERNAL, 10000, 0,    0,    0,    OPTIONAL, EXTERNAL_SEMAPHORE) \
+    /* deprecated entry points, texture/surface references and the pre-4.0 */              \
+    /* launch API, several of which are gone from current drivers */                       \
+    X(cuDeviceComputeCapability,                LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuDeviceGetProperties,                    LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuCtxGetSharedMemConfig,                  LEGACY,   4020,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuCtxSetSharedMemConfig,                  LEGACY,   4020,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuModuleLoadFatBinary,                    LEGACY,   2010,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuFuncSetSharedMemConfig,                 LEGACY,   4020,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuCtxAttach,                              LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuCtxDetach,                              LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuModuleGetTexRef,                        LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuModuleGetSurfRef,                       LEGACY,   3010,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuFuncSetBlockShape,                      LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuFuncSetSharedSize,                      LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuTexRefCreate,                           LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuTexRefDestroy,                          LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuTexRefSetArray,                         LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuTexRefSetAddress,                       LEGACY,   0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuTexRefSetAddress2D,                     LEGACY,   0,     0,    3020, 4010, REQUIRED, NONE)              \
+    X(cuTexRefSetFormat,                        LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuTexRefSetAddressMode,                   LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuTexRefSetFilterMode,                    LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuTexRefSetFlags,                         LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuTexRefGetAddress,                       LEGACY,   0,     0,    3020, 0,    REQUIRED, NONE)              \
+    X(cuTexRefGetArray,                         LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuTexRefGetAddressMode,                   LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuTexRefGetFilterMode,                    LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuTexRefGetFormat,                        LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuTexRefGetFlags,                         LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuSurfRefSetArray,                        LEGACY,   3010,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuSurfRefGetArray,                        LEGACY,   3010,  0,    0,    0,    REQUIRED, NONE)              \
+    X(cuParamSetSize,                           LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuParamSeti,                              LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuParamSetf,                              LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuParamSetv,                              LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuParamSetTexRef,                         LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuLaunch,                                 LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuLaunchGrid,                             LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)              \
+    X(cuLaunchGridAsync,                        LEGACY,   0,     0,    0,    0,    REQUIRED, NONE)
+
+// Dense index of every table entry, e.g. CU_DRVAPI_SYMBOL_INDEX_cuMemAlloc
+#define CU_DRVAPI_SYMBOL_INDEX(name, ...) CU_DRVAPI_SYMBOL_INDEX_##name,
+typedef enum CUdrvapiSymbolIndex_enum
+{
+    CU_DRVAPI_SYMBOL_TABLE(CU_DRVAPI_SYMBOL_INDEX)
+    CU_DRVAPI_SYMBOL_COUNT
+} CUdrvapiSymbolIndex;
+#undef CU_DRVAPI_SYMBOL_INDEX
+
+#ifndef CUDA_DRVAPI_TYPES_ONLY
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CU_DRVAPI_SYMBOL_EXTERN(name, ...) extern t##name *name;
+CU_DRVAPI_SYMBOL_TABLE(CU_DRVAPI_SYMBOL_EXTERN)
+#undef CU_DRVAPI_SYMBOL_EXTERN
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CUDA_DRVAPI_TYPES_ONLY
+
+#endif // __cuda_drvapi_symbols_h__
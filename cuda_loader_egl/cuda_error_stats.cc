@@ -0,0 +1,102 @@
+#include "cuda_error_stats.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <chrono>
+
+#include "drvapi_error_string.h"
+
+namespace viz {
+
+namespace {
+
+// A lost device fails every call of every frame; one line per site and
+// second is enough to see what broke.
+constexpr int64_t kReportIntervalUs = 1000000;
+
+std::atomic<CudaErrorSite*> g_sites{nullptr};
+std::atomic<uint64_t> g_total_errors{0};
+std::atomic<uint64_t> g_reported{0};
+std::atomic<uint64_t> g_suppressed{0};
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Register(CudaErrorSite* site) {
+  bool expected = false;
+  if (!site->registered.compare_exchange_strong(expected, true,
+                                                std::memory_order_acq_rel)) {
+    return;
+  }
+  CudaErrorSite* head = g_sites.load(std::memory_order_relaxed);
+  do {
+    site->next = head;
+  } while (!g_sites.compare_exchange_weak(head, site,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed));
+}
+
+}  // namespace
+
+void ReportCudaError(CUresult error, CudaErrorSite* site) {
+  Register(site);
+  site->errors.fetch_add(1, std::memory_order_relaxed);
+  site->last_error.store(error, std::memory_order_relaxed);
+  g_total_errors.fetch_add(1, std::memory_order_relaxed);
+
+  // Only the thread that moves last_report_us forward logs.
+  const int64_t now = NowUs();
+  int64_t last = site->last_report_us.load(std::memory_order_relaxed);
+  if ((last != 0 && now - last < kReportIntervalUs) ||
+      !site->last_report_us.compare_exchange_strong(
+          last, now, std::memory_order_relaxed)) {
+    site->suppressed.fetch_add(1, std::memory_order_relaxed);
+    g_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  g_reported.fetch_add(1, std::memory_order_relaxed);
+
+  const uint64_t errors = site->errors.load(std::memory_order_relaxed);
+  const uint64_t before = site->errors_at_report.exchange(errors);
+  const uint64_t swallowed = errors > before + 1 ? errors - before - 1 : 0;
+  if (swallowed) {
+    fprintf(stderr,
+            "checkCudaErrors() Driver API error = %04d \"%s\" from file <%s>, "
+            "line %i (%s), %" PRIu64 " more since last report, %" PRIu64
+            " total.\n",
+            error, getCudaDrvErrorString(error), site->file, site->line,
+            site->call, swallowed, errors);
+  } else {
+    fprintf(stderr,
+            "checkCudaErrors() Driver API error = %04d \"%s\" from file <%s>, "
+            "line %i (%s).\n",
+            error, getCudaDrvErrorString(error), site->file, site->line,
+            site->call);
+  }
+}
+
+CudaErrorStats GetCudaErrorStats() {
+  CudaErrorStats stats;
+  stats.total_errors = g_total_errors.load(std::memory_order_relaxed);
+  stats.reported = g_reported.load(std::memory_order_relaxed);
+  stats.suppressed = g_suppressed.load(std::memory_order_relaxed);
+  for (CudaErrorSite* site = g_sites.load(std::memory_order_acquire); site;
+       site = site->next) {
+    CudaErrorSiteStats entry;
+    entry.file = site->file;
+    entry.line = site->line;
+    entry.call = site->call;
+    entry.errors = site->errors.load(std::memory_order_relaxed);
+    entry.suppressed = site->suppressed.load(std::memory_order_relaxed);
+    entry.last_error =
+        static_cast<CUresult>(site->last_error.load(std::memory_order_relaxed));
+    stats.sites.push_back(entry);
+  }
+  return stats;
+}
+
+}  // namespace viz
@@ -0,0 +1,65 @@
+#ifndef __cuda_error_stats_h__
+#define __cuda_error_stats_h__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+#include "cuda_drvapi_dynlink.h"
+
+namespace viz {
+
+// Counters of one CHECK_CU expansion. Instances are function local statics
+// with constant initialization, so the success path never touches them and
+// needs no guard; a site is linked into the process wide list on its first
+// failure.
+struct CudaErrorSite {
+  const char* file;
+  int line;
+  const char* call;
+
+  std::atomic<uint64_t> errors{0};
+  std::atomic<uint64_t> suppressed{0};
+  std::atomic<int> last_error{0};
+  // steady clock, microseconds; 0 until the first report
+  std::atomic<int64_t> last_report_us{0};
+  // |errors| as of the last report, to tell how many were swallowed since
+  std::atomic<uint64_t> errors_at_report{0};
+  std::atomic<bool> registered{false};
+  CudaErrorSite* next = nullptr;
+
+  constexpr CudaErrorSite(const char* file, int line, const char* call)
+      : file(file), line(line), call(call) {}
+};
+
+struct CudaErrorSiteStats {
+  const char* file = nullptr;
+  int line = 0;
+  const char* call = nullptr;
+  uint64_t errors = 0;
+  // failures not logged because the site was rate limited
+  uint64_t suppressed = 0;
+  CUresult last_error = CUDA_SUCCESS;
+};
+
+struct CudaErrorStats {
+  uint64_t total_errors = 0;
+  uint64_t reported = 0;
+  uint64_t suppressed = 0;
+  // every site that failed at least once, most recently registered first
+  std::vector<CudaErrorSiteStats> sites;
+};
+
+// Counts a failed call and logs it to stderr, at most once per second per
+// site; the next line that makes it through carries the number of failures
+// swallowed in between. Safe to call from any thread.
+void ReportCudaError(CUresult error, CudaErrorSite* site);
+
+// Snapshot of all counters; sites are never removed so the pointers inside
+// stay valid for the lifetime of the process.
+CudaErrorStats GetCudaErrorStats();
+
+}  // namespace viz
+
+#endif  // __cuda_error_stats_h__
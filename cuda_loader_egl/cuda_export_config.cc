@@ -0,0 +1,147 @@
+#include "cuda_export_config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace viz {
+
+BASE_FEATURE(kCudaOffscreenExport,
+             "CudaOffscreenExport",
+             base::FEATURE_ENABLED_BY_DEFAULT);
+
+namespace {
+
+constexpr base::FeatureParam<CudaExportMode>::Option kModeOptions[] = {
+    {CudaExportMode::kOff, "off"},
+    {CudaExportMode::kCudaIpc, "cuda-ipc"},
+    {CudaExportMode::kCudaDmaBuf, "cuda-dmabuf"},
+    {CudaExportMode::kDmaBufOnly, "dmabuf"},
+};
+
+constexpr base::FeatureParam<CudaExportFormat>::Option kFormatOptions[] = {
+    {CudaExportFormat::kBGRA, "bgra"},
+    {CudaExportFormat::kNV12, "nv12"},
+    {CudaExportFormat::kI420, "i420"},
+    {CudaExportFormat::kP010, "p010"},
+};
+
+constexpr base::FeatureParam<CudaContextMode>::Option kContextOptions[] = {
+    {CudaContextMode::kPrimary, "primary"},
+    {CudaContextMode::kPrivate, "private"},
+};
+
+constexpr base::FeatureParam<CudaScaleFilter>::Option kScaleFilterOptions[] = {
+    {CudaScaleFilter::kBox, "box"},
+    {CudaScaleFilter::kBilinear, "bilinear"},
+};
+
+constexpr base::FeatureParam<CudaExportMode> kModeParam{
+    &kCudaOffscreenExport, "mode", CudaExportMode::kCudaIpc, &kModeOptions};
+constexpr base::FeatureParam<int> kRingDepthParam{&kCudaOffscreenExport,
+                                                  "ring_depth", 2};
+constexpr base::FeatureParam<CudaExportFormat> kFormatParam{
+    &kCudaOffscreenExport, "format", CudaExportFormat::kBGRA,
+    &kFormatOptions};
+constexpr base::FeatureParam<int> kMaxWidthParam{&kCudaOffscreenExport,
+                                                 "max_width", 3840};
+constexpr base::FeatureParam<int> kMaxHeightParam{&kCudaOffscreenExport,
+                                                  "max_height", 2160};
+constexpr base::FeatureParam<std::string> kDeviceParam{&kCudaOffscreenExport,
+                                                       "device", ""};
+constexpr base::FeatureParam<std::string> kDriverLibraryParam{
+    &kCudaOffscreenExport, "driver_library", ""};
+constexpr base::FeatureParam<CudaContextMode> kContextParam{
+    &kCudaOffscreenExport, "context", CudaContextMode::kPrimary,
+    &kContextOptions};
+constexpr base::FeatureParam<std::string> kRenditionsParam{
+    &kCudaOffscreenExport, "renditions", ""};
+constexpr base::FeatureParam<CudaScaleFilter> kScaleFilterParam{
+    &kCudaOffscreenExport, "scale_filter", CudaScaleFilter::kBox,
+    &kScaleFilterOptions};
+constexpr base::FeatureParam<std::string> kFrameClockParam{
+    &kCudaOffscreenExport, "frame_clock", ""};
+
+// "WxH,WxH"; malformed entries are skipped.
+std::vector<CudaExportRendition> ParseRenditions(const std::string& spec,
+                                                 size_t max_width,
+                                                 size_t max_height) {
+  std::vector<CudaExportRendition> renditions;
+  const char* entry = spec.c_str();
+  while (*entry && renditions.size() < kCudaExportMaxRenditions) {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    if (sscanf(entry, "%ux%u", &width, &height) == 2 && width && height) {
+      CudaExportRendition rendition;
+      rendition.width = std::min<size_t>(width, max_width);
+      rendition.height = std::min<size_t>(height, max_height);
+      renditions.push_back(rendition);
+    }
+    entry = strchr(entry, ',');
+    if (!entry)
+      break;
+    ++entry;
+  }
+  return renditions;
+}
+
+}  // namespace
+
+// static
+CudaExportConfig CudaExportConfig::FromFeatureList() {
+  CudaExportConfig config;
+  if (!base::FeatureList::IsEnabled(kCudaOffscreenExport)) {
+    config.mode = CudaExportMode::kOff;
+    return config;
+  }
+  config.frame_clock = kFrameClockParam.Get();
+
+  config.mode = kModeParam.Get();
+  config.ring_depth =
+      std::clamp(kRingDepthParam.Get(), 1, kCudaExportMaxRingDepth);
+  config.format = kFormatParam.Get();
+  config.max_width = static_cast<size_t>(std::max(kMaxWidthParam.Get(), 1));
+  config.max_height = static_cast<size_t>(std::max(kMaxHeightParam.Get(), 1));
+  config.device = kDeviceParam.Get();
+  config.driver_library = kDriverLibraryParam.Get();
+  config.context_mode = kContextParam.Get();
+  config.renditions = ParseRenditions(kRenditionsParam.Get(), config.max_width,
+                                      config.max_height);
+  config.scale_filter = kScaleFilterParam.Get();
+  return config;
+}
+
+const char* CudaExportModeName(CudaExportMode mode) {
+  for (const auto& option : kModeOptions) {
+    if (option.value == mode)
+      return option.name;
+  }
+  return "unknown";
+}
+
+const char* CudaExportFormatName(CudaExportFormat format) {
+  for (const auto& option : kFormatOptions) {
+    if (option.value == format)
+      return option.name;
+  }
+  return "unknown";
+}
+
+const char* CudaContextModeName(CudaContextMode mode) {
+  for (const auto& option : kContextOptions) {
+    if (option.value == mode)
+      return option.name;
+  }
+  return "unknown";
+}
+
+const char* CudaScaleFilterName(CudaScaleFilter filter) {
+  for (const auto& option : kScaleFilterOptions) {
+    if (option.value == filter)
+      return option.name;
+  }
+  return "unknown";
+}
+
+}  // namespace viz
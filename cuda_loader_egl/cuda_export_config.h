@@ -0,0 +1,106 @@
+#ifndef __cuda_export_config_h__
+#define __cuda_export_config_h__
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "base/feature_list.h"
+#include "base/metrics/field_trial_params.h"
+#include "cuda_shared_context.h"
+
+namespace viz {
+
+// Runtime configuration of the offscreen export path. Custom switches are
+// not forwarded to the GPU process, so the knobs ride on a feature that the
+// browser propagates to every child, e.g.
+//   --enable-features=CudaOffscreenExport:mode/cuda-ipc/ring_depth/3
+BASE_DECLARE_FEATURE(kCudaOffscreenExport);
+
+enum class CudaExportMode {
+  // Nothing is exported; the present hook only runs for the frame clock.
+  kOff,
+  // Every present is copied into a ring of CUDA IPC buffers.
+  kCudaIpc,
+  // Like kCudaIpc, but the source is the pooled DMA-BUF the capture path
+  // blits every frame into, imported through an EGLImage; no GL interop on
+  // the present path.
+  kCudaDmaBuf,
+  // Only the shared texture DMA-BUF is forwarded; no CUDA work in the GPU
+  // process.
+  kDmaBufOnly,
+};
+
+// Layout of the frames written into the ring; see CudaFrameLayout.
+enum class CudaExportFormat {
+  kBGRA,
+  // Converted on the GPU while exporting; kCudaIpc and kCudaDmaBuf only.
+  kNV12,
+  kI420,
+  kP010,
+};
+
+enum class CudaScaleFilter {
+  // Mean of the covered source pixels; the better choice for downscales
+  // by more than 2x.
+  kBox,
+  kBilinear,
+};
+
+// Upper bound for the number of IPC buffers; each one is a full frame of
+// device memory.
+inline constexpr int kCudaExportMaxRingDepth = 8;
+
+// Each rendition costs a ring and a kernel launch per present.
+inline constexpr size_t kCudaExportMaxRenditions = 4;
+
+// An extra, scaled copy of every frame with a ring of its own.
+struct CudaExportRendition {
+  size_t width = 0;
+  size_t height = 0;
+};
+
+struct CudaExportConfig {
+  CudaExportMode mode = CudaExportMode::kCudaIpc;
+  int ring_depth = 2;
+  CudaExportFormat format = CudaExportFormat::kBGRA;
+  size_t max_width = 3840;
+  size_t max_height = 2160;
+  // Same syntax as CUDA_EXPORT_DEVICE; empty means auto select.
+  std::string device;
+  // Libraries tried before libcuda.so.1, same syntax as CUDA_DRVAPI_LIBRARY;
+  // empty keeps the environment and the default search order.
+  std::string driver_library;
+  CudaContextMode context_mode = CudaContextMode::kPrimary;
+  // Scaled copies written from the same present, each clamped to
+  // max_width x max_height; "WxH,WxH" in the feature param.
+  std::vector<CudaExportRendition> renditions;
+  CudaScaleFilter scale_filter = CudaScaleFilter::kBox;
+  // Shared memory segment that receives the swap time of every present, see
+  // CudaFrameClock; stamped in every mode, including kOff.
+  std::string frame_clock;
+
+  // Reads the feature parameters, clamping anything out of range.
+  static CudaExportConfig FromFeatureList();
+
+  bool needs_cuda() const {
+    return mode == CudaExportMode::kCudaIpc ||
+           mode == CudaExportMode::kCudaDmaBuf;
+  }
+  bool uses_gl_interop() const { return mode == CudaExportMode::kCudaIpc; }
+  // Whether the offscreen present hook has anything to do; in kCudaDmaBuf
+  // mode it publishes the slot the capture path exported into.
+  bool needs_present_hook() const {
+    return needs_cuda() || !frame_clock.empty();
+  }
+};
+
+const char* CudaExportModeName(CudaExportMode mode);
+const char* CudaExportFormatName(CudaExportFormat format);
+const char* CudaContextModeName(CudaContextMode mode);
+const char* CudaScaleFilterName(CudaScaleFilter filter);
+
+}  // namespace viz
+
+#endif  // __cuda_export_config_h__
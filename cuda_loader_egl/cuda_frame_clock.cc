@@ -0,0 +1,149 @@
+#include "cuda_frame_clock.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace viz {
+
+// static
+std::unique_ptr<CudaFrameClock> CudaFrameClock::Open(const std::string& name) {
+  if (name.empty())
+    return nullptr;
+
+  const int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+  if (fd < 0) {
+    fprintf(stdout, "[CudaOffscreenHook] frame clock %s not found\n",
+            name.c_str());
+    fflush(stdout);
+    return nullptr;
+  }
+  struct stat st;
+  void* mapping = MAP_FAILED;
+  if (fstat(fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) >= sizeof(CudaFrameClockShm)) {
+    mapping = mmap(nullptr, sizeof(CudaFrameClockShm), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return nullptr;
+
+  auto* shm = static_cast<CudaFrameClockShm*>(mapping);
+  if (shm->magic != kCudaFrameClockMagic ||
+      shm->version != kCudaFrameClockVersion) {
+    fprintf(stdout, "[CudaOffscreenHook] frame clock %s has another layout\n",
+            name.c_str());
+    fflush(stdout);
+    munmap(mapping, sizeof(CudaFrameClockShm));
+    return nullptr;
+  }
+  fprintf(stdout, "[CudaOffscreenHook] frame clock %s\n", name.c_str());
+  fflush(stdout);
+  return std::unique_ptr<CudaFrameClock>(new CudaFrameClock(shm));
+}
+
+CudaFrameClock::CudaFrameClock(CudaFrameClockShm* shm)
+    : shm_(shm),
+      surface_id_(shm->surfaces.fetch_add(1, std::memory_order_relaxed) + 1) {}
+
+CudaFrameClock::~CudaFrameClock() {
+  RetractRings();
+  munmap(shm_, sizeof(CudaFrameClockShm));
+}
+
+uint64_t CudaFrameClock::Publish(int width,
+                                 int height,
+                                 base::TimeTicks swap_start,
+                                 int32_t slot,
+                                 uint64_t buffer_ino) {
+  // Every output device of the process writes into the same segment.
+  const uint64_t index = shm_->writes.fetch_add(1, std::memory_order_relaxed);
+  CudaFrameClockRecord& record =
+      shm_->records[index % kCudaFrameClockRecords];
+
+  // Seqlock style: readers retry or skip a record whose stamp changed
+  // while they read it.
+  record.stamp.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  record.sequence.store(++sequence_, std::memory_order_relaxed);
+  record.swap_us.store((swap_start - base::TimeTicks()).InMicroseconds(),
+                       std::memory_order_relaxed);
+  record.width.store(static_cast<uint32_t>(width), std::memory_order_relaxed);
+  record.height.store(static_cast<uint32_t>(height),
+                      std::memory_order_relaxed);
+  record.surface_id.store(surface_id_, std::memory_order_relaxed);
+  record.slot.store(slot, std::memory_order_relaxed);
+  record.buffer_ino.store(buffer_ino, std::memory_order_relaxed);
+  record.stamp.store(index + 1, std::memory_order_release);
+  return sequence_;
+}
+
+bool CudaFrameClock::PublishRing(const RingDesc& desc,
+                                 const uint8_t* handles,
+                                 size_t depth) {
+  depth = std::min(depth, kCudaFrameClockRingSlots);
+  for (CudaFrameClockRing& ring : shm_->rings) {
+    uint32_t expected = 0;
+    if (!ring.surface_id.compare_exchange_strong(expected,
+                                                 kCudaFrameClockRingBusy,
+                                                 std::memory_order_acquire)) {
+      continue;
+    }
+    ring.rendition = desc.rendition;
+    ring.format = desc.format;
+    ring.width = desc.width;
+    ring.height = desc.height;
+    ring.depth = static_cast<uint32_t>(depth);
+    ring.planes = desc.planes;
+    ring.slot_bytes = desc.slot_bytes;
+    ring.sequence_offset = desc.sequence_offset;
+    std::copy(std::begin(desc.offset), std::end(desc.offset), ring.offset);
+    std::copy(std::begin(desc.pitch), std::end(desc.pitch), ring.pitch);
+    memcpy(ring.handles, handles, depth * kCudaFrameClockHandleBytes);
+    ring.surface_id.store(surface_id_, std::memory_order_release);
+    return true;
+  }
+  fprintf(stdout, "[CudaOffscreenHook] frame clock has no free ring entry\n");
+  fflush(stdout);
+  return false;
+}
+
+void CudaFrameClock::RetractRings() {
+  for (CudaFrameClockRing& ring : shm_->rings) {
+    uint32_t expected = surface_id_;
+    if (!ring.surface_id.compare_exchange_strong(expected,
+                                                 kCudaFrameClockRingBusy,
+                                                 std::memory_order_acquire)) {
+      continue;
+    }
+    memset(ring.handles, 0, sizeof(ring.handles));
+    ring.surface_id.store(0, std::memory_order_release);
+  }
+}
+
+void CudaFrameClock::RecordExport(bool ok, base::TimeDelta elapsed) {
+  CudaFrameClockExportStats& stats = shm_->export_stats;
+  if (!ok) {
+    stats.failures.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  const int64_t us = std::max<int64_t>(elapsed.InMicroseconds(), 0);
+  size_t bucket = 0;
+  while (bucket < std::size(kCudaExportBucketsUs) &&
+         static_cast<uint64_t>(us) > kCudaExportBucketsUs[bucket]) {
+    ++bucket;
+  }
+  stats.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  stats.total_us.fetch_add(static_cast<uint64_t>(us),
+                           std::memory_order_relaxed);
+  stats.exports.fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace viz
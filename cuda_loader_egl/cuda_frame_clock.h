@@ -0,0 +1,173 @@
+#ifndef __cuda_frame_clock_h__
+#define __cuda_frame_clock_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include "base/time/time.h"
+
+namespace viz {
+
+// Shared memory the GPU process writes for the browser: a record of recent
+// offscreen swaps, so the browser can stamp each paint event with the swap
+// time of its frame (the paint event itself carries neither), the export
+// rings and the export timings for the metrics endpoint. The browser
+// creates the segment (fdpass createFrameClock()) and names it in the
+// frame_clock feature param; the layout below is mirrored in
+// fdpass/addon.cc.
+//
+// base::TimeTicks and process.hrtime() both read CLOCK_MONOTONIC on Linux,
+// so swap_us compares directly with timestamps taken in the browser.
+constexpr uint32_t kCudaFrameClockMagic = 0x4b4c4346;  // "FCLK"
+constexpr uint32_t kCudaFrameClockVersion = 5;
+constexpr size_t kCudaFrameClockRecords = 64;
+// Export rings of all output devices together, renditions included.
+constexpr size_t kCudaFrameClockRings = 16;
+// At least the largest export ring depth.
+constexpr size_t kCudaFrameClockRingSlots = 8;
+// sizeof(CUipcMemHandle)
+constexpr size_t kCudaFrameClockHandleBytes = 64;
+// CudaFrameClockRecord::slot of a present that was not exported.
+constexpr int32_t kCudaFrameClockNoSlot = -1;
+// Upper bounds of the export time buckets in microseconds; the last bucket
+// takes everything above.
+constexpr uint64_t kCudaExportBucketsUs[] = {250,  500,   1000,  2000,
+                                             4000, 8000,  16000, 33000};
+constexpr size_t kCudaExportBuckets = std::size(kCudaExportBucketsUs) + 1;
+
+struct CudaFrameClockRecord {
+  // Index of the write + 1 once the record is complete, 0 while it is
+  // being written.
+  std::atomic<uint64_t> stamp;
+  // Per output device present count, starting at 1.
+  std::atomic<uint64_t> sequence;
+  std::atomic<int64_t> swap_us;
+  std::atomic<uint32_t> width;
+  std::atomic<uint32_t> height;
+  // Writer of the record, see CudaFrameClock::surface_id().
+  std::atomic<uint32_t> surface_id;
+  // Ring slot the present was exported into, in the rings the same writer
+  // published; kCudaFrameClockNoSlot if it was not exported.
+  std::atomic<int32_t> slot;
+  // Inode of the dma-buf the capturer blitted the frame into, the buffer
+  // the browser's paint event hands out; 0 without a capture. Lets the
+  // browser tell which surface renders an output.
+  std::atomic<uint64_t> buffer_ino;
+};
+
+// One export ring: the CUDA IPC handle of every slot plus the layout of the
+// frames in it. Written once when the exporter allocated the ring and
+// cleared when it frees it, so consumers open each handle only once.
+struct CudaFrameClockRing {
+  // Owner of the entry, 0 while free; kCudaFrameClockRingBusy while it is
+  // being written or cleared. Readers check it before and after reading.
+  std::atomic<uint32_t> surface_id;
+  // 0 for the full size frame.
+  uint32_t rendition;
+  // CudaExportFormat
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  uint32_t planes;
+  uint32_t reserved;
+  uint64_t slot_bytes;
+  // Where each slot keeps the uint64_t sequence of the present whose frame
+  // it holds, 0 while a frame is being written into it. A consumer that
+  // reads it after copying the slot and finds the sequence of its frame
+  // knows the copy was not overwritten halfway.
+  uint64_t sequence_offset;
+  uint64_t offset[3];
+  uint64_t pitch[3];
+  uint8_t handles[kCudaFrameClockRingSlots][kCudaFrameClockHandleBytes];
+};
+constexpr uint32_t kCudaFrameClockRingBusy = 0xffffffff;
+
+// Time spent exporting presents into the CUDA rings, summed over every
+// output device of the GPU process; read by the browser's metrics endpoint.
+struct CudaFrameClockExportStats {
+  std::atomic<uint64_t> exports;
+  std::atomic<uint64_t> failures;
+  std::atomic<uint64_t> total_us;
+  // Not cumulative: each export counts in exactly one bucket.
+  std::atomic<uint64_t> buckets[kCudaExportBuckets];
+};
+
+struct CudaFrameClockShm {
+  uint32_t magic;
+  uint32_t version;
+  std::atomic<uint64_t> writes;
+  // Surface ids handed out so far.
+  std::atomic<uint32_t> surfaces;
+  uint32_t reserved;
+  CudaFrameClockExportStats export_stats;
+  CudaFrameClockRecord records[kCudaFrameClockRecords];
+  CudaFrameClockRing rings[kCudaFrameClockRings];
+};
+
+// Writer side, one per output device. Opening fails quietly when the
+// browser did not create the segment; Publish() is then never reached.
+class CudaFrameClock {
+ public:
+  // Layout of a ring for PublishRing().
+  struct RingDesc {
+    uint32_t rendition = 0;
+    uint32_t format = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t planes = 1;
+    uint64_t slot_bytes = 0;
+    uint64_t sequence_offset = 0;
+    uint64_t offset[3] = {};
+    uint64_t pitch[3] = {};
+  };
+
+  static std::unique_ptr<CudaFrameClock> Open(const std::string& name);
+  ~CudaFrameClock();
+
+  CudaFrameClock(const CudaFrameClock&) = delete;
+  CudaFrameClock& operator=(const CudaFrameClock&) = delete;
+
+  // Unique among the writers of the segment, never 0.
+  uint32_t surface_id() const { return surface_id_; }
+
+  // Sequence number the next Publish() returns.
+  uint64_t next_sequence() const { return sequence_ + 1; }
+
+  // Records a present of a |width| x |height| frame exported into |slot|
+  // and captured into the dma-buf |buffer_ino|; returns its sequence
+  // number.
+  uint64_t Publish(int width,
+                   int height,
+                   base::TimeTicks swap_start,
+                   int32_t slot = kCudaFrameClockNoSlot,
+                   uint64_t buffer_ino = 0);
+
+  // Makes the IPC handles of one ring of this writer visible, |depth| of
+  // them back to back in |handles|. False when every entry is taken.
+  bool PublishRing(const RingDesc& desc,
+                   const uint8_t* handles,
+                   size_t depth);
+
+  // Clears every ring this writer published, before its memory is freed.
+  void RetractRings();
+
+  // Accounts one export attempt that took |elapsed|.
+  void RecordExport(bool ok, base::TimeDelta elapsed);
+
+ private:
+  explicit CudaFrameClock(CudaFrameClockShm* shm);
+
+  CudaFrameClockShm* const shm_;
+  const uint32_t surface_id_;
+  uint64_t sequence_ = 0;
+};
+
+}  // namespace viz
+
+#endif  // __cuda_frame_clock_h__
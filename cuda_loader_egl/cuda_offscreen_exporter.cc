@@ -0,0 +1,619 @@
+#include "cuda_offscreen_exporter.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#include "cuda_device_select.h"
+#include "ui/gl/gl_bindings.h"
+
+namespace viz {
+
+namespace {
+
+// Buffers kept imported in kCudaDmaBuf mode. Chromium's shared texture pool
+// stays well below this, so a steady stream never re-imports.
+constexpr size_t kMaxImportedDmaBufs = 16;
+
+static_assert(sizeof(CUipcMemHandle) == kCudaFrameClockHandleBytes);
+static_assert(kCudaFrameClockRingSlots >= kCudaExportMaxRingDepth);
+
+// The binding to save and restore around touching a |target| texture, or 0
+// for targets the exporter does not know.
+GLenum TextureBindingFor(GLenum target) {
+  switch (target) {
+    case GL_TEXTURE_2D:
+      return GL_TEXTURE_BINDING_2D;
+    case GL_TEXTURE_RECTANGLE_ARB:
+      return GL_TEXTURE_BINDING_RECTANGLE_ARB;
+    case GL_TEXTURE_EXTERNAL_OES:
+      return GL_TEXTURE_BINDING_EXTERNAL_OES;
+    default:
+      return 0;
+  }
+}
+
+// Where a slot of |layout| keeps the sequence of the present it holds, see
+// CudaFrameClockRing::sequence_offset.
+size_t SlotSequenceOffset(const CudaFrameLayout& layout) {
+  return (layout.size + sizeof(uint64_t) - 1) / sizeof(uint64_t) *
+         sizeof(uint64_t);
+}
+
+}  // namespace
+
+CudaOffscreenExporter::CudaOffscreenExporter(const CudaExportConfig& config)
+    : config_(config),
+      layout_(GetCudaFrameLayout(config.format,
+                                 config.max_width,
+                                 config.max_height)),
+      frame_clock_(CudaFrameClock::Open(config.frame_clock)),
+      dmabufs_(kMaxImportedDmaBufs) {
+  for (const CudaExportRendition& size : config_.renditions) {
+    Rendition rendition;
+    rendition.size = size;
+    rendition.layout =
+        GetCudaFrameLayout(config_.format, size.width, size.height);
+    renditions_.push_back(rendition);
+  }
+}
+
+CudaOffscreenExporter::~CudaOffscreenExporter() {
+  if (cuda_init_) {
+    // Consumers must not open handles of memory that is about to go away.
+    if (frame_clock_)
+      frame_clock_->RetractRings();
+    {
+      ScopedCudaContext scoped_context(context_->context());
+      if (stream_)
+        cuStreamDestroy(stream_);
+      for (auto& it : textures_)
+        ReleaseTexture(&it.second);
+      textures_.clear();
+      dmabufs_.Clear();
+      FreeRing();
+      converter_.reset();
+      scaler_.reset();
+      if (staging_)
+        cuMemFree(staging_);
+    }
+    context_->Release();
+    context_ = nullptr;
+    // Only prints with cuda_loader_call_trace = true.
+    cuDrvApiDumpCallStats();
+  }
+
+  const CudaErrorStats errors = GetCudaErrorStats();
+  if (errors.total_errors) {
+    fprintf(stdout,
+            "[CudaOffscreenHook] cuda errors total=%llu logged=%llu "
+            "sites=%zu\n",
+            static_cast<unsigned long long>(errors.total_errors),
+            static_cast<unsigned long long>(errors.reported),
+            errors.sites.size());
+    fflush(stdout);
+  }
+}
+
+// Presents publish after the export, so a record that names a slot only
+// becomes visible once the slot holds the frame.
+void CudaOffscreenExporter::OnPresent(const CudaExportTextureDesc& desc,
+                                      base::TimeTicks swap_start) {
+  int32_t slot = captured_slot_;
+  const uint64_t buffer_ino = captured_ino_;
+  captured_slot_ = kCudaFrameClockNoSlot;
+  captured_ino_ = 0;
+  if (config_.uses_gl_interop() && EnsureCuda()) {
+    const base::TimeTicks export_start = base::TimeTicks::Now();
+    const bool ok = ExportTexture(desc, &slot);
+    if (frame_clock_)
+      frame_clock_->RecordExport(ok, base::TimeTicks::Now() - export_start);
+  }
+  if (frame_clock_)
+    frame_clock_->Publish(desc.width, desc.height, swap_start, slot,
+                          buffer_ino);
+}
+
+void CudaOffscreenExporter::OnCaptureDmaBuf(const CudaExportDmaBufDesc& desc) {
+  captured_slot_ = kCudaFrameClockNoSlot;
+  struct stat st;
+  captured_ino_ = frame_clock_ && fstat(desc.fd, &st) == 0 ? st.st_ino : 0;
+  if (!captures_dmabufs() || !EnsureCuda())
+    return;
+  const base::TimeTicks export_start = base::TimeTicks::Now();
+  const bool ok = ExportDmaBuf(desc, &captured_slot_);
+  if (frame_clock_)
+    frame_clock_->RecordExport(ok, base::TimeTicks::Now() - export_start);
+}
+
+bool CudaOffscreenExporter::ExportTexture(const CudaExportTextureDesc& desc,
+                                          int32_t* slot) {
+  ScopedCudaContext scoped_context(context_->context());
+  CachedTexture* cached = LookupTexture(desc);
+  if (!cached)
+    return false;
+
+  if (!CopyTexture(cached, &ring_[next_slot_])) {
+    // The GL name may have been deleted and handed out again with the same
+    // shape; drop the registration so the next present starts over.
+    ReleaseTexture(cached);
+    textures_.erase(desc.texture_id);
+    return false;
+  }
+  *slot = static_cast<int32_t>(next_slot_);
+  next_slot_ = (next_slot_ + 1) % ring_.size();
+  return true;
+}
+
+bool CudaOffscreenExporter::ExportDmaBuf(const CudaExportDmaBufDesc& desc,
+                                         int32_t* slot) {
+  ScopedCudaContext scoped_context(context_->context());
+  CudaDmaBufImportCache::Mapping mapping;
+  if (!dmabufs_.Import(desc, &mapping))
+    return false;
+
+  const size_t width =
+      std::min(static_cast<size_t>(desc.width), config_.max_width);
+  const size_t height =
+      std::min(static_cast<size_t>(desc.height), config_.max_height);
+
+  // EGL already applied the offset and the modifier.
+  CUDA_MEMCPY2D cpy = {};
+  if (mapping.array) {
+    cpy.srcMemoryType = CU_MEMORYTYPE_ARRAY;
+    cpy.srcArray = mapping.array;
+  } else {
+    cpy.srcMemoryType = CU_MEMORYTYPE_DEVICE;
+    cpy.srcDevice = mapping.ptr;
+    cpy.srcPitch = mapping.pitch;
+  }
+  // The blit into the buffer was only flushed, and CUDA reads it outside of
+  // GL's ordering.
+  EGLSyncKHR fence;
+  if (!dmabufs_.WaitForGL(stream_, &fence))
+    return false;
+  const bool ok = CopyToSlot(&cpy, width, height, &ring_[next_slot_]);
+  // The stream has to be done with the fence; CopyToSlot() only waited for
+  // it when everything could be queued.
+  if (!ok)
+    cuStreamSynchronize(stream_);
+  dmabufs_.ReleaseFence(fence);
+  if (!ok)
+    return false;
+  *slot = static_cast<int32_t>(next_slot_);
+  next_slot_ = (next_slot_ + 1) % ring_.size();
+  return true;
+}
+
+bool CudaOffscreenExporter::EnsureCuda() {
+  if (cuda_init_)
+    return true;
+  if (cuda_init_failed_)
+    return false;
+  if (!InitCuda()) {
+    cuda_init_failed_ = true;
+    fprintf(stdout, "[CudaOffscreenHook] export disabled for this process\n");
+    fflush(stdout);
+    return false;
+  }
+  return true;
+}
+
+bool CudaOffscreenExporter::InitCuda() {
+  if (!config_.driver_library.empty())
+    cuDrvApiSetSearchPath(config_.driver_library.c_str());
+
+  CUresult status = cuInit_drvapi(0, __CUDA_API_VERSION);
+  if (CUDA_SUCCESS != status) {
+    fprintf(stdout, "[CudaOffscreenHook] cuda init failed\n");
+    return false;
+  }
+
+  const unsigned int symbols =
+      CU_DRVAPI_SYMBOLS_IPC | (config_.uses_gl_interop()
+                                   ? CU_DRVAPI_SYMBOLS_GL
+                                   : CU_DRVAPI_SYMBOLS_EGL);
+  if (CHECK_CU(cuDrvApiRequire(symbols)))
+    return false;
+
+  int dev_count = 0;
+  CHECK_CU(cuDeviceGetCount(&dev_count));
+  fprintf(stdout, "[CudaOffscreenHook] cu dev count %d\n", dev_count);
+  if (!dev_count) {
+    fprintf(stdout, "[CudaOffscreenHook] no cuda device present\n");
+    return false;
+  }
+
+  // Export from the GPU that renders, otherwise interop either fails or
+  // silently bounces every frame across PCIe.
+  EglDeviceIdentity identity;
+  QueryEglDeviceIdentity(eglGetCurrentDisplay(), &identity);
+  CUdevice device = 0;
+  const char* reason = "";
+  const char* device_spec = !config_.device.empty()
+                                ? config_.device.c_str()
+                                : getenv(kCudaExportDeviceEnv);
+  if (!SelectCudaDevice(identity, device_spec, &device, &reason)) {
+    fprintf(stdout, "[CudaOffscreenHook] no cuda device for %s %s\n", reason,
+            device_spec ? device_spec : "");
+    return false;
+  }
+
+  char name[128] = {};
+  CHECK_CU(cuDeviceGetName(name, sizeof(name), device));
+
+  // Says why a fallback rule picked the device: with ANGLE the current
+  // display frequently cannot be queried for its EGL device.
+  fprintf(stdout,
+          "[CudaOffscreenHook] device_ordinal=%d device_count=%d "
+          "device_name=%s selected_by=%s egl_uuid=%s egl_pci=%s%s%s\n",
+          static_cast<int>(device), dev_count, name, reason,
+          identity.has_uuid ? "yes" : "no", identity.pci_bus_id.c_str(),
+          identity.unavailable ? " egl_identity_unavailable=" : "",
+          identity.unavailable ? identity.unavailable : "");
+
+  // Logged once; these strings never change for the lifetime of the context.
+  fprintf(stdout, "GL_VENDOR   : %s\n", glGetString(GL_VENDOR));
+  fprintf(stdout, "GL_RENDERER : %s\n", glGetString(GL_RENDERER));
+  fprintf(stdout, "GL_VERSION  : %s\n", glGetString(GL_VERSION));
+
+  if (captures_dmabufs() && (!CudaDmaBufImportCache::IsSupported() ||
+                             !dmabufs_.Init(eglGetCurrentDisplay()))) {
+    fprintf(stdout,
+            "[CudaOffscreenHook] cannot import dma-bufs through egl\n");
+    return false;
+  }
+
+  context_ = CudaSharedContext::Acquire(device, config_.context_mode);
+  if (!context_)
+    return false;
+
+  bool ring_ok;
+  {
+    ScopedCudaContext scoped_context(context_->context());
+    ring_ok = !CHECK_CU(cuStreamCreate(&stream_, 0)) && AllocateRing();
+    if (ring_ok && !InitConversion()) {
+      FreeRing();
+      ring_ok = false;
+    }
+    if (!ring_ok && stream_) {
+      cuStreamDestroy(stream_);
+      stream_ = nullptr;
+    }
+  }
+  if (!ring_ok) {
+    context_->Release();
+    context_ = nullptr;
+    return false;
+  }
+
+  cuda_init_ = true;
+  PublishRings();
+  CUdrvapiInfo info = {};
+  cuDrvApiGetInfo(&info);
+  fprintf(stdout,
+          "[CudaOffscreenHook] cuda init ok mode=%s ring_depth=%zu "
+          "format=%s slot_bytes=%zu max=%zux%zu driver=%d caps=0x%x lib=%s "
+          "context=%s\n",
+          CudaExportModeName(config_.mode), ring_.size(),
+          CudaExportFormatName(config_.format), layout_.size, config_.max_width,
+          config_.max_height, info.driverVersion, info.capabilities,
+          info.libraryPath ? info.libraryPath : "",
+          context_->is_primary() ? "primary" : "private");
+  for (const Rendition& rendition : renditions_) {
+    fprintf(stdout,
+            "[CudaOffscreenHook] rendition %zux%zu slot_bytes=%zu filter=%s\n",
+            rendition.size.width, rendition.size.height,
+            rendition.layout.size, CudaScaleFilterName(config_.scale_filter));
+  }
+  fflush(stdout);
+  return true;
+}
+
+// Called with the context current; frees whatever it got on failure.
+bool CudaOffscreenExporter::AllocateRing() {
+  bool ok = AllocateSlots(SlotSequenceOffset(layout_) + sizeof(uint64_t),
+                          &ring_);
+  for (Rendition& rendition : renditions_) {
+    ok = ok && AllocateSlots(
+                   SlotSequenceOffset(rendition.layout) + sizeof(uint64_t),
+                   &rendition.ring);
+    if (ok && config_.format != CudaExportFormat::kBGRA) {
+      const size_t scratch_size =
+          rendition.size.width * rendition.size.height * 4;
+      ok = !CHECK_CU(cuMemAlloc(&rendition.scratch, scratch_size));
+    }
+  }
+  if (!ok)
+    FreeRing();
+  return ok;
+}
+
+bool CudaOffscreenExporter::AllocateSlots(size_t size,
+                                          std::vector<RingSlot>* ring) {
+  ring->resize(config_.ring_depth);
+  for (RingSlot& slot : *ring) {
+    if (CHECK_CU(cuMemAlloc(&slot.memory, size)) ||
+        CHECK_CU(cuIpcGetMemHandle(&slot.ipc_handle, slot.memory))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Called with the context current; leaves nothing allocated on failure.
+bool CudaOffscreenExporter::InitConversion() {
+  if (!renditions_.empty()) {
+    scaler_ = std::make_unique<CudaScaler>();
+    if (!scaler_->Init()) {
+      fprintf(stdout, "[CudaOffscreenHook] cannot load the scaling kernels\n");
+      scaler_.reset();
+      return false;
+    }
+  }
+
+  if (config_.format == CudaExportFormat::kBGRA)
+    return true;
+
+  converter_ = std::make_unique<CudaColorConverter>();
+  if (!converter_->Init()) {
+    fprintf(stdout,
+            "[CudaOffscreenHook] cannot load the %s conversion kernel\n",
+            CudaExportFormatName(config_.format));
+    converter_.reset();
+    scaler_.reset();
+    return false;
+  }
+  if (CHECK_CU(cuMemAlloc(&staging_,
+                          config_.max_width * config_.max_height * 4))) {
+    staging_ = 0;
+    converter_.reset();
+    scaler_.reset();
+    return false;
+  }
+  return true;
+}
+
+void CudaOffscreenExporter::FreeRing() {
+  for (RingSlot& slot : ring_) {
+    if (slot.memory)
+      cuMemFree(slot.memory);
+  }
+  ring_.clear();
+  for (Rendition& rendition : renditions_) {
+    for (RingSlot& slot : rendition.ring) {
+      if (slot.memory)
+        cuMemFree(slot.memory);
+    }
+    rendition.ring.clear();
+    if (rendition.scratch)
+      cuMemFree(rendition.scratch);
+    rendition.scratch = 0;
+  }
+  next_slot_ = 0;
+}
+
+void CudaOffscreenExporter::PublishRings() {
+  if (!frame_clock_)
+    return;
+  PublishRing(0, config_.max_width, config_.max_height, layout_, ring_);
+  for (size_t i = 0; i < renditions_.size(); ++i) {
+    const Rendition& rendition = renditions_[i];
+    PublishRing(static_cast<uint32_t>(i + 1), rendition.size.width,
+                rendition.size.height, rendition.layout, rendition.ring);
+  }
+}
+
+void CudaOffscreenExporter::PublishRing(uint32_t rendition,
+                                        size_t width,
+                                        size_t height,
+                                        const CudaFrameLayout& layout,
+                                        const std::vector<RingSlot>& ring) {
+  uint8_t handles[kCudaExportMaxRingDepth][kCudaFrameClockHandleBytes];
+  for (size_t i = 0; i < ring.size(); ++i)
+    memcpy(handles[i], &ring[i].ipc_handle, kCudaFrameClockHandleBytes);
+
+  CudaFrameClock::RingDesc desc;
+  desc.rendition = rendition;
+  desc.format = static_cast<uint32_t>(config_.format);
+  desc.width = static_cast<uint32_t>(width);
+  desc.height = static_cast<uint32_t>(height);
+  desc.planes = static_cast<uint32_t>(layout.planes);
+  desc.slot_bytes = layout.size;
+  desc.sequence_offset = SlotSequenceOffset(layout);
+  for (int plane = 0; plane < 3; ++plane) {
+    desc.offset[plane] = layout.offset[plane];
+    desc.pitch[plane] = layout.pitch[plane];
+  }
+  frame_clock_->PublishRing(desc, &handles[0][0], ring.size());
+}
+
+CudaOffscreenExporter::CachedTexture* CudaOffscreenExporter::LookupTexture(
+    const CudaExportTextureDesc& desc) {
+  auto it = textures_.find(desc.texture_id);
+  if (it != textures_.end()) {
+    const CudaExportTextureDesc& known = it->second.desc;
+    if (known.target == desc.target &&
+        known.internal_format == desc.internal_format &&
+        known.width == desc.width && known.height == desc.height) {
+      return &it->second;
+    }
+    // Same name with a different shape: the backing was reallocated.
+    ReleaseTexture(&it->second);
+    textures_.erase(it);
+  }
+
+  // First present of this texture. CUDA only registers mipmap complete
+  // textures, so pin the level range once and restore the binding Skia
+  // expects on that target.
+  const GLenum binding = TextureBindingFor(desc.target);
+  if (binding) {
+    GLint prev_binding = 0;
+    glGetIntegerv(binding, &prev_binding);
+    glBindTexture(desc.target, desc.texture_id);
+    glTexParameteri(desc.target, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(desc.target, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(desc.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(desc.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(desc.target, static_cast<GLuint>(prev_binding));
+  }
+
+  fprintf(stdout,
+          "[CudaOffscreenHook] new texture %u size %dx%d internal format "
+          "0x%x\n",
+          desc.texture_id, desc.width, desc.height, desc.internal_format);
+  fflush(stdout);
+
+  CachedTexture cached;
+  cached.desc = desc;
+  if (CHECK_CU(cuGraphicsGLRegisterImage(&cached.resource, desc.texture_id,
+                                         desc.target,
+                                         CU_GRAPHICS_REGISTER_FLAGS_NONE))) {
+    return nullptr;
+  }
+  return &textures_.emplace(desc.texture_id, cached).first->second;
+}
+
+void CudaOffscreenExporter::ReleaseTexture(CachedTexture* cached) {
+  if (cached->resource) {
+    cuGraphicsUnregisterResource(cached->resource);
+    cached->resource = nullptr;
+  }
+}
+
+bool CudaOffscreenExporter::CopyTexture(CachedTexture* cached,
+                                        RingSlot* slot) {
+  if (CHECK_CU(cuGraphicsMapResources(1, &cached->resource, 0)))
+    return false;
+
+  CUarray cuda_array = nullptr;
+  bool ok = !CHECK_CU(cuGraphicsSubResourceGetMappedArray(
+      &cuda_array, cached->resource, 0, 0));
+
+  if (ok) {
+    const size_t width =
+        std::min(static_cast<size_t>(cached->desc.width), config_.max_width);
+    const size_t height =
+        std::min(static_cast<size_t>(cached->desc.height), config_.max_height);
+
+    CUDA_MEMCPY2D cpy = {};
+    cpy.srcMemoryType = CU_MEMORYTYPE_ARRAY;
+    cpy.srcArray = cuda_array;
+    ok = CopyToSlot(&cpy, width, height, slot);
+  }
+
+  CHECK_CU(cuGraphicsUnmapResources(1, &cached->resource, 0));
+  return ok;
+}
+
+bool CudaOffscreenExporter::CopyToSlot(CUDA_MEMCPY2D* cpy,
+                                       size_t width,
+                                       size_t height,
+                                       RingSlot* slot) {
+  // Renditions are scaled from the full size BGRA frame, wherever it ended
+  // up; everything is queued on |stream_| and waited for once, so the
+  // sequences can be copied from the stack. The slots read 0 while they are
+  // rewritten and the sequence of the present once they hold its frame.
+  const uint64_t writing = 0;
+  const uint64_t written = frame_clock_ ? frame_clock_->next_sequence() : 0;
+  if (!MarkSlots(slot, &writing))
+    return false;
+  bool ok;
+  CUdeviceptr bgra = slot->memory;
+  size_t bgra_pitch = layout_.pitch[0];
+  if (converter_) {
+    ok = ConvertToSlot(cpy, width, height, slot, stream_, &bgra, &bgra_pitch);
+  } else {
+    cpy->dstMemoryType = CU_MEMORYTYPE_DEVICE;
+    cpy->dstDevice = slot->memory;
+    cpy->dstPitch = layout_.pitch[0];
+    cpy->WidthInBytes = width * 4;
+    cpy->Height = height;
+    ok = !CHECK_CU(cuMemcpy2DAsync(cpy, stream_));
+  }
+  ok = ok && ScaleRenditions(bgra, bgra_pitch, width, height, stream_);
+  ok = ok && MarkSlots(slot, &written);
+  ok = ok && !CHECK_CU(cuStreamSynchronize(stream_));
+  return ok;
+}
+
+bool CudaOffscreenExporter::MarkSlots(RingSlot* slot,
+                                      const uint64_t* sequence) {
+  if (CHECK_CU(cuMemcpyHtoDAsync(slot->memory + SlotSequenceOffset(layout_),
+                                 sequence, sizeof(*sequence), stream_))) {
+    return false;
+  }
+  for (Rendition& rendition : renditions_) {
+    const CUdeviceptr memory = rendition.ring[next_slot_].memory;
+    if (CHECK_CU(cuMemcpyHtoDAsync(
+            memory + SlotSequenceOffset(rendition.layout), sequence,
+            sizeof(*sequence), stream_))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CudaOffscreenExporter::ConvertToSlot(CUDA_MEMCPY2D* cpy,
+                                          size_t width,
+                                          size_t height,
+                                          RingSlot* slot,
+                                          CUstream stream,
+                                          CUdeviceptr* bgra,
+                                          size_t* bgra_pitch) {
+  CUdeviceptr src = cpy->srcDevice;
+  size_t src_pitch = cpy->srcPitch;
+  if (cpy->srcMemoryType != CU_MEMORYTYPE_DEVICE) {
+    // A mapped texture is a CUDA array; one device local copy is cheaper
+    // than binding a texture object for every frame.
+    cpy->dstMemoryType = CU_MEMORYTYPE_DEVICE;
+    cpy->dstDevice = staging_;
+    cpy->dstPitch = config_.max_width * 4;
+    cpy->WidthInBytes = width * 4;
+    cpy->Height = height;
+    if (CHECK_CU(cuMemcpy2DAsync(cpy, stream)))
+      return false;
+    src = staging_;
+    src_pitch = cpy->dstPitch;
+  }
+  *bgra = src;
+  *bgra_pitch = src_pitch;
+  return converter_->Convert(src, src_pitch, static_cast<int>(width),
+                             static_cast<int>(height), slot->memory, layout_,
+                             stream);
+}
+
+bool CudaOffscreenExporter::ScaleRenditions(CUdeviceptr bgra,
+                                            size_t bgra_pitch,
+                                            size_t width,
+                                            size_t height,
+                                            CUstream stream) {
+  for (Rendition& rendition : renditions_) {
+    const int rendition_width = static_cast<int>(rendition.size.width);
+    const int rendition_height = static_cast<int>(rendition.size.height);
+    RingSlot& slot = rendition.ring[next_slot_];
+    if (!converter_) {
+      if (!scaler_->Scale(bgra, bgra_pitch, static_cast<int>(width),
+                          static_cast<int>(height), slot.memory,
+                          rendition.layout.pitch[0], rendition_width,
+                          rendition_height, config_.scale_filter, stream)) {
+        return false;
+      }
+      continue;
+    }
+    if (!scaler_->Scale(bgra, bgra_pitch, static_cast<int>(width),
+                        static_cast<int>(height), rendition.scratch,
+                        rendition.size.width * 4, rendition_width,
+                        rendition_height, config_.scale_filter, stream) ||
+        !converter_->Convert(rendition.scratch, rendition.size.width * 4,
+                             rendition_width, rendition_height, slot.memory,
+                             rendition.layout, stream)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace viz
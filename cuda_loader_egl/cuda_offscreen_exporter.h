@@ -0,0 +1,150 @@
+#ifndef __cuda_offscreen_exporter_h__
+#define __cuda_offscreen_exporter_h__
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
+#include "base/time/time.h"
+#include "cuda_color_convert.h"
+#include "cuda_dmabuf_import.h"
+#include "cuda_export_config.h"
+#include "cuda_frame_clock.h"
+#include "cuda_scale.h"
+#include "cuda_shared_context.h"
+#include "cuda_wrapper_include.h"
+
+namespace viz {
+
+// Everything the exporter needs to know about the offscreen GL texture. The
+// offscreen output device already knows all of it, so nothing here has to be
+// read back from GL on the present path.
+struct CudaExportTextureDesc {
+  GLuint texture_id = 0;
+  GLenum target = GL_TEXTURE_2D;
+  GLenum internal_format = 0;
+  int width = 0;
+  int height = 0;
+};
+
+// Copies the offscreen GL texture into a ring of CUDA IPC buffers, one slot
+// per present, and stamps every present into the frame clock if configured.
+// Must be used from the GPU thread that owns the current GL context. The
+// CUDA context is only current while a present is exported.
+class CudaOffscreenExporter {
+ public:
+  explicit CudaOffscreenExporter(const CudaExportConfig& config);
+  ~CudaOffscreenExporter();
+
+  CudaOffscreenExporter(const CudaOffscreenExporter&) = delete;
+  CudaOffscreenExporter& operator=(const CudaOffscreenExporter&) = delete;
+
+  void OnPresent(const CudaExportTextureDesc& desc, base::TimeTicks swap_start);
+
+  // Takes the DMA-BUF the capture path just blitted a frame into, ahead of
+  // the present of the same frame. The present stamps the buffer's inode
+  // into the frame clock. In kCudaDmaBuf mode the frame is also copied
+  // straight out of the buffer and the present publishes its slot; each
+  // pooled buffer is imported once and reused for every later frame it
+  // carries.
+  void OnCaptureDmaBuf(const CudaExportDmaBufDesc& desc);
+
+  // Whether OnCaptureDmaBuf() has anything to do.
+  bool wants_captures() const { return captures_dmabufs() || frame_clock_; }
+
+ private:
+  bool captures_dmabufs() const {
+    return config_.mode == CudaExportMode::kCudaDmaBuf;
+  }
+
+  // Per texture id state that is set up once and reused for every present
+  // until the texture is reallocated.
+  struct CachedTexture {
+    CudaExportTextureDesc desc;
+    CUgraphicsResource resource = nullptr;
+  };
+
+  struct RingSlot {
+    CUdeviceptr memory = 0;
+    CUipcMemHandle ipc_handle;
+  };
+
+  // Scaled copy of every present, written into its own ring at the same
+  // slot index as the full size frame.
+  struct Rendition {
+    CudaExportRendition size;
+    CudaFrameLayout layout;
+    std::vector<RingSlot> ring;
+    // Scaled BGRA ahead of the conversion, YUV formats only.
+    CUdeviceptr scratch = 0;
+  };
+
+  // The export part of OnPresent() and OnCaptureDmaBuf(), timed by them.
+  // |slot| receives the ring slot that now holds the frame.
+  bool ExportTexture(const CudaExportTextureDesc& desc, int32_t* slot);
+  bool ExportDmaBuf(const CudaExportDmaBufDesc& desc, int32_t* slot);
+  bool EnsureCuda();
+  bool InitCuda();
+  bool AllocateRing();
+  bool InitConversion();
+  CachedTexture* LookupTexture(const CudaExportTextureDesc& desc);
+  void ReleaseTexture(CachedTexture* cached);
+  bool CopyTexture(CachedTexture* cached, RingSlot* slot);
+  bool CopyToSlot(CUDA_MEMCPY2D* cpy, size_t width, size_t height,
+                  RingSlot* slot);
+  bool ConvertToSlot(CUDA_MEMCPY2D* cpy, size_t width, size_t height,
+                     RingSlot* slot, CUstream stream, CUdeviceptr* bgra,
+                     size_t* bgra_pitch);
+  bool ScaleRenditions(CUdeviceptr bgra, size_t bgra_pitch, size_t width,
+                       size_t height, CUstream stream);
+  // Queues a copy of |*sequence| behind the frame in |slot| and in the same
+  // slot of every rendition; |sequence| has to outlive the stream work.
+  bool MarkSlots(RingSlot* slot, const uint64_t* sequence);
+  bool AllocateSlots(size_t size, std::vector<RingSlot>* ring);
+  void FreeRing();
+  // Makes the IPC handles of every ring known through the frame clock, the
+  // full size one as rendition 0 and the scaled ones after it.
+  void PublishRings();
+  void PublishRing(uint32_t rendition,
+                   size_t width,
+                   size_t height,
+                   const CudaFrameLayout& layout,
+                   const std::vector<RingSlot>& ring);
+
+  const CudaExportConfig config_;
+  bool cuda_init_ = false;
+  // Set once InitCuda failed; the present path then returns right away
+  // instead of retrying and logging every frame.
+  bool cuda_init_failed_ = false;
+  // Shared with in-process consumers through CudaSharedContext.
+  CudaSharedContext* context_ = nullptr;
+  // Every copy, conversion and scale of a present is queued here and waited
+  // for once; created with the context.
+  CUstream stream_ = nullptr;
+  const CudaFrameLayout layout_;
+  std::vector<RingSlot> ring_;
+  // Set for the YUV formats.
+  std::unique_ptr<CudaColorConverter> converter_;
+  // BGRA copy of a mapped GL texture or dma-buf, the kernel only reads
+  // linear memory.
+  CUdeviceptr staging_ = 0;
+  std::vector<Rendition> renditions_;
+  // Set when there are renditions.
+  std::unique_ptr<CudaScaler> scaler_;
+  size_t next_slot_ = 0;
+  // Slot OnCaptureDmaBuf() exported the frame into and the inode of the
+  // buffer it came in, published by the next OnPresent().
+  int32_t captured_slot_ = kCudaFrameClockNoSlot;
+  uint64_t captured_ino_ = 0;
+
+  std::unique_ptr<CudaFrameClock> frame_clock_;
+
+  std::map<GLuint, CachedTexture> textures_;
+  CudaDmaBufImportCache dmabufs_;
+};
+
+}  // namespace viz
+
+#endif  // __cuda_offscreen_exporter_h__
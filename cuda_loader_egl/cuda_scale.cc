@@ -0,0 +1,66 @@
+#include "cuda_scale.h"
+
+#include "cuda_scale_ptx.h"
+
+namespace viz {
+
+namespace {
+
+constexpr unsigned int kBlockWidth = 32;
+constexpr unsigned int kBlockHeight = 8;
+
+}  // namespace
+
+CudaScaler::CudaScaler() = default;
+
+CudaScaler::~CudaScaler() {
+  if (module_)
+    CHECK_CU(cuModuleUnload(module_));
+}
+
+bool CudaScaler::Init() {
+  if (CHECK_CU(cuModuleLoadData(&module_, kScalePtx))) {
+    module_ = nullptr;
+    return false;
+  }
+  if (CHECK_CU(cuModuleGetFunction(&box_, module_, kScaleBoxKernelName)) ||
+      CHECK_CU(cuModuleGetFunction(&bilinear_, module_,
+                                   kScaleBilinearKernelName))) {
+    CHECK_CU(cuModuleUnload(module_));
+    module_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool CudaScaler::Scale(CUdeviceptr src,
+                       size_t src_pitch,
+                       int src_width,
+                       int src_height,
+                       CUdeviceptr dst,
+                       size_t dst_pitch,
+                       int dst_width,
+                       int dst_height,
+                       CudaScaleFilter filter,
+                       CUstream stream) {
+  if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0)
+    return false;
+
+  unsigned int src_pitch_arg = static_cast<unsigned int>(src_pitch);
+  unsigned int src_width_arg = static_cast<unsigned int>(src_width);
+  unsigned int src_height_arg = static_cast<unsigned int>(src_height);
+  unsigned int dst_pitch_arg = static_cast<unsigned int>(dst_pitch);
+  unsigned int dst_width_arg = static_cast<unsigned int>(dst_width);
+  unsigned int dst_height_arg = static_cast<unsigned int>(dst_height);
+  void* params[] = {&src,           &src_pitch_arg,  &src_width_arg,
+                    &src_height_arg, &dst,           &dst_pitch_arg,
+                    &dst_width_arg,  &dst_height_arg};
+
+  CUfunction kernel = filter == CudaScaleFilter::kBox ? box_ : bilinear_;
+  return !CHECK_CU(cuLaunchKernel(
+      kernel, (dst_width_arg + kBlockWidth - 1) / kBlockWidth,
+      (dst_height_arg + kBlockHeight - 1) / kBlockHeight, 1, kBlockWidth,
+      kBlockHeight, 1, 0, stream, params, nullptr));
+}
+
+}  // namespace viz
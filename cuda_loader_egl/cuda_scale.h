@@ -0,0 +1,46 @@
+#ifndef __cuda_scale_h__
+#define __cuda_scale_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cuda_export_config.h"
+#include "cuda_wrapper_include.h"
+
+namespace viz {
+
+// Scales BGRA device memory with the PTX kernels of cuda_scale_ptx.h. The
+// context it was created in must be current on every call. The filters are
+// spelled out next to ScaleBGRAReference() in cuda_scale_reference.h.
+class CudaScaler {
+ public:
+  CudaScaler();
+  ~CudaScaler();
+
+  CudaScaler(const CudaScaler&) = delete;
+  CudaScaler& operator=(const CudaScaler&) = delete;
+
+  // Loads the module; false if the driver cannot JIT it.
+  bool Init();
+
+  // Queues the scaling on |stream|.
+  bool Scale(CUdeviceptr src,
+             size_t src_pitch,
+             int src_width,
+             int src_height,
+             CUdeviceptr dst,
+             size_t dst_pitch,
+             int dst_width,
+             int dst_height,
+             CudaScaleFilter filter,
+             CUstream stream);
+
+ private:
+  CUmodule module_ = nullptr;
+  CUfunction box_ = nullptr;
+  CUfunction bilinear_ = nullptr;
+};
+
+}  // namespace viz
+
+#endif  // __cuda_scale_h__
@@ -0,0 +1,258 @@
+#ifndef __cuda_scale_ptx_h__
+#define __cuda_scale_ptx_h__
+
+namespace viz {
+
+// PTX of the BGRA scaling kernels, JIT compiled by the driver on load. Like
+// cuda_color_convert_ptx.h written by hand; both entries must stay bit-exact
+// with ScaleBGRAReference() in cuda_scale_reference.cc.
+//
+// scale_bgra_box(src, src_pitch, src_width, src_height,
+//                dst, dst_pitch, dst_width, dst_height)
+// scale_bgra_bilinear(same arguments)
+//
+// One thread per destination pixel, all four channels including alpha.
+constexpr char kScaleBoxKernelName[] = "scale_bgra_box";
+constexpr char kScaleBilinearKernelName[] = "scale_bgra_bilinear";
+constexpr char kScalePtx[] = R"ptx(
+.version 5.0
+.target sm_30
+.address_size 64
+
+.visible .entry scale_bgra_box(
+    .param .u64 p_src,
+    .param .u32 p_src_pitch,
+    .param .u32 p_src_width,
+    .param .u32 p_src_height,
+    .param .u64 p_dst,
+    .param .u32 p_dst_pitch,
+    .param .u32 p_dst_width,
+    .param .u32 p_dst_height)
+{
+    .reg .pred %p<4>;
+    .reg .b32 %r<64>;
+    .reg .b64 %rd<16>;
+
+    // destination pixel (x, y) = (%r4, %r5)
+    mov.u32 %r1, %ctaid.x;
+    mov.u32 %r2, %ntid.x;
+    mov.u32 %r3, %tid.x;
+    mad.lo.u32 %r4, %r1, %r2, %r3;
+    mov.u32 %r1, %ctaid.y;
+    mov.u32 %r2, %ntid.y;
+    mov.u32 %r3, %tid.y;
+    mad.lo.u32 %r5, %r1, %r2, %r3;
+
+    ld.param.u32 %r6, [p_src_width];
+    ld.param.u32 %r7, [p_src_height];
+    ld.param.u32 %r8, [p_dst_width];
+    ld.param.u32 %r9, [p_dst_height];
+    setp.ge.u32 %p1, %r4, %r8;
+    setp.ge.u32 %p2, %r5, %r9;
+    or.pred %p1, %p1, %p2;
+    @%p1 bra L_BOX_DONE;
+
+    // covered source columns [%r10, %r11) and rows [%r12, %r13), at least
+    // one of each
+    mul.lo.u32 %r10, %r4, %r6;
+    div.u32 %r10, %r10, %r8;
+    add.u32 %r11, %r4, 1;
+    mul.lo.u32 %r11, %r11, %r6;
+    div.u32 %r11, %r11, %r8;
+    add.u32 %r14, %r10, 1;
+    max.u32 %r11, %r11, %r14;
+    mul.lo.u32 %r12, %r5, %r7;
+    div.u32 %r12, %r12, %r9;
+    add.u32 %r13, %r5, 1;
+    mul.lo.u32 %r13, %r13, %r7;
+    div.u32 %r13, %r13, %r9;
+    add.u32 %r14, %r12, 1;
+    max.u32 %r13, %r13, %r14;
+
+    // channel sums b, g, r, a = %r20..%r23
+    ld.param.u64 %rd1, [p_src];
+    ld.param.u32 %r15, [p_src_pitch];
+    mov.u32 %r20, 0;
+    mov.u32 %r21, 0;
+    mov.u32 %r22, 0;
+    mov.u32 %r23, 0;
+    mov.u32 %r16, %r12;
+L_BOX_ROW:
+    mul.wide.u32 %rd2, %r16, %r15;
+    add.u64 %rd2, %rd1, %rd2;
+    mov.u32 %r17, %r10;
+L_BOX_COLUMN:
+    mul.wide.u32 %rd3, %r17, 4;
+    add.u64 %rd3, %rd2, %rd3;
+    ld.global.u32 %r18, [%rd3];
+    bfe.u32 %r19, %r18, 0, 8;
+    add.u32 %r20, %r20, %r19;
+    bfe.u32 %r19, %r18, 8, 8;
+    add.u32 %r21, %r21, %r19;
+    bfe.u32 %r19, %r18, 16, 8;
+    add.u32 %r22, %r22, %r19;
+    bfe.u32 %r19, %r18, 24, 8;
+    add.u32 %r23, %r23, %r19;
+    add.u32 %r17, %r17, 1;
+    setp.lt.u32 %p3, %r17, %r11;
+    @%p3 bra L_BOX_COLUMN;
+    add.u32 %r16, %r16, 1;
+    setp.lt.u32 %p3, %r16, %r13;
+    @%p3 bra L_BOX_ROW;
+
+    // rounded mean over the %r24 covered pixels
+    sub.u32 %r24, %r11, %r10;
+    sub.u32 %r25, %r13, %r12;
+    mul.lo.u32 %r24, %r24, %r25;
+    shr.u32 %r25, %r24, 1;
+    add.u32 %r20, %r20, %r25;
+    div.u32 %r20, %r20, %r24;
+    add.u32 %r21, %r21, %r25;
+    div.u32 %r21, %r21, %r24;
+    add.u32 %r22, %r22, %r25;
+    div.u32 %r22, %r22, %r24;
+    add.u32 %r23, %r23, %r25;
+    div.u32 %r23, %r23, %r24;
+    shl.b32 %r21, %r21, 8;
+    or.b32 %r20, %r20, %r21;
+    shl.b32 %r22, %r22, 16;
+    or.b32 %r20, %r20, %r22;
+    shl.b32 %r23, %r23, 24;
+    or.b32 %r20, %r20, %r23;
+
+    ld.param.u64 %rd4, [p_dst];
+    ld.param.u32 %r26, [p_dst_pitch];
+    mul.wide.u32 %rd5, %r5, %r26;
+    add.u64 %rd4, %rd4, %rd5;
+    mul.wide.u32 %rd5, %r4, 4;
+    add.u64 %rd4, %rd4, %rd5;
+    st.global.u32 [%rd4], %r20;
+
+L_BOX_DONE:
+    ret;
+}
+
+.visible .entry scale_bgra_bilinear(
+    .param .u64 p_src,
+    .param .u32 p_src_pitch,
+    .param .u32 p_src_width,
+    .param .u32 p_src_height,
+    .param .u64 p_dst,
+    .param .u32 p_dst_pitch,
+    .param .u32 p_dst_width,
+    .param .u32 p_dst_height)
+{
+    .reg .pred %p<4>;
+    .reg .b32 %r<64>;
+    .reg .b64 %rd<16>;
+
+    // destination pixel (x, y) = (%r4, %r5)
+    mov.u32 %r1, %ctaid.x;
+    mov.u32 %r2, %ntid.x;
+    mov.u32 %r3, %tid.x;
+    mad.lo.u32 %r4, %r1, %r2, %r3;
+    mov.u32 %r1, %ctaid.y;
+    mov.u32 %r2, %ntid.y;
+    mov.u32 %r3, %tid.y;
+    mad.lo.u32 %r5, %r1, %r2, %r3;
+
+    ld.param.u32 %r6, [p_src_width];
+    ld.param.u32 %r7, [p_src_height];
+    ld.param.u32 %r8, [p_dst_width];
+    ld.param.u32 %r9, [p_dst_height];
+    setp.ge.u32 %p1, %r4, %r8;
+    setp.ge.u32 %p2, %r5, %r9;
+    or.pred %p1, %p1, %p2;
+    @%p1 bra L_BILINEAR_DONE;
+
+    // source position of the pixel center in 1/256 pixels,
+    // ((2x + 1) * src * 128) / dst - 128 clamped at 0; 64 bit for 8k
+    shl.b32 %r10, %r4, 1;
+    add.u32 %r10, %r10, 1;
+    shl.b32 %r11, %r6, 7;
+    mul.wide.u32 %rd2, %r10, %r11;
+    cvt.u64.u32 %rd3, %r8;
+    div.u64 %rd2, %rd2, %rd3;
+    cvt.u32.u64 %r10, %rd2;
+    max.u32 %r10, %r10, 128;
+    sub.u32 %r10, %r10, 128;
+    shl.b32 %r12, %r5, 1;
+    add.u32 %r12, %r12, 1;
+    shl.b32 %r11, %r7, 7;
+    mul.wide.u32 %rd2, %r12, %r11;
+    cvt.u64.u32 %rd3, %r9;
+    div.u64 %rd2, %rd2, %rd3;
+    cvt.u32.u64 %r12, %rd2;
+    max.u32 %r12, %r12, 128;
+    sub.u32 %r12, %r12, 128;
+
+    // x0, x1, wx = %r14, %r16, %r15 and y0, y1, wy = %r17, %r19, %r18
+    shr.u32 %r14, %r10, 8;
+    and.b32 %r15, %r10, 255;
+    add.u32 %r16, %r14, 1;
+    sub.u32 %r13, %r6, 1;
+    min.u32 %r16, %r16, %r13;
+    shr.u32 %r17, %r12, 8;
+    and.b32 %r18, %r12, 255;
+    add.u32 %r19, %r17, 1;
+    sub.u32 %r13, %r7, 1;
+    min.u32 %r19, %r19, %r13;
+
+    ld.param.u64 %rd1, [p_src];
+    ld.param.u32 %r13, [p_src_pitch];
+    mul.wide.u32 %rd2, %r17, %r13;
+    add.u64 %rd2, %rd1, %rd2;
+    mul.wide.u32 %rd3, %r19, %r13;
+    add.u64 %rd3, %rd1, %rd3;
+    mul.wide.u32 %rd4, %r14, 4;
+    mul.wide.u32 %rd5, %r16, 4;
+    add.u64 %rd6, %rd2, %rd4;
+    ld.global.u32 %r20, [%rd6];
+    add.u64 %rd6, %rd2, %rd5;
+    ld.global.u32 %r21, [%rd6];
+    add.u64 %rd6, %rd3, %rd4;
+    ld.global.u32 %r22, [%rd6];
+    add.u64 %rd6, %rd3, %rd5;
+    ld.global.u32 %r23, [%rd6];
+
+    // 256 - wx = %r25, 256 - wy = %r26; channel at bit %r41 into %r40
+    mov.u32 %r24, 256;
+    sub.u32 %r25, %r24, %r15;
+    sub.u32 %r26, %r24, %r18;
+    mov.u32 %r40, 0;
+    mov.u32 %r41, 0;
+L_BILINEAR_CHANNEL:
+    bfe.u32 %r30, %r20, %r41, 8;
+    bfe.u32 %r31, %r21, %r41, 8;
+    bfe.u32 %r32, %r22, %r41, 8;
+    bfe.u32 %r33, %r23, %r41, 8;
+    mul.lo.u32 %r34, %r30, %r25;
+    mad.lo.u32 %r34, %r31, %r15, %r34;
+    mul.lo.u32 %r35, %r32, %r25;
+    mad.lo.u32 %r35, %r33, %r15, %r35;
+    mul.lo.u32 %r34, %r34, %r26;
+    mad.lo.u32 %r34, %r35, %r18, %r34;
+    add.u32 %r34, %r34, 32768;
+    shr.u32 %r34, %r34, 16;
+    shl.b32 %r34, %r34, %r41;
+    or.b32 %r40, %r40, %r34;
+    add.u32 %r41, %r41, 8;
+    setp.lt.u32 %p3, %r41, 32;
+    @%p3 bra L_BILINEAR_CHANNEL;
+
+    ld.param.u64 %rd4, [p_dst];
+    ld.param.u32 %r26, [p_dst_pitch];
+    mul.wide.u32 %rd5, %r5, %r26;
+    add.u64 %rd4, %rd4, %rd5;
+    mul.wide.u32 %rd5, %r4, 4;
+    add.u64 %rd4, %rd4, %rd5;
+    st.global.u32 [%rd4], %r40;
+
+L_BILINEAR_DONE:
+    ret;
+}
+)ptx";
+
+}  // namespace viz
+
+#endif  // __cuda_scale_ptx_h__
@@ -0,0 +1,105 @@
+#include "cuda_scale_reference.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace viz {
+
+namespace {
+
+uint32_t LoadPixel(const uint8_t* src, size_t src_pitch, int x, int y) {
+  uint32_t pixel;
+  memcpy(&pixel, src + y * src_pitch + x * 4, sizeof(pixel));
+  return pixel;
+}
+
+void StorePixel(uint8_t* dst, size_t dst_pitch, int x, int y, uint32_t pixel) {
+  memcpy(dst + y * dst_pitch + x * 4, &pixel, sizeof(pixel));
+}
+
+uint32_t Channel(uint32_t pixel, int shift) {
+  return (pixel >> shift) & 0xff;
+}
+
+// Pixel center in 1/256 source pixels.
+uint32_t SourcePosition(int dst, int src_size, int dst_size) {
+  const uint64_t scaled = static_cast<uint64_t>(2 * dst + 1) *
+                          (static_cast<uint32_t>(src_size) << 7) /
+                          static_cast<uint32_t>(dst_size);
+  return std::max(static_cast<uint32_t>(scaled), 128u) - 128;
+}
+
+uint32_t BoxPixel(const uint8_t* src,
+                  size_t src_pitch,
+                  int x_begin,
+                  int x_end,
+                  int y_begin,
+                  int y_end) {
+  uint32_t sums[4] = {};
+  for (int y = y_begin; y < y_end; ++y) {
+    for (int x = x_begin; x < x_end; ++x) {
+      const uint32_t pixel = LoadPixel(src, src_pitch, x, y);
+      for (int c = 0; c < 4; ++c)
+        sums[c] += Channel(pixel, c * 8);
+    }
+  }
+  const uint32_t count = (x_end - x_begin) * (y_end - y_begin);
+  uint32_t out = 0;
+  for (int c = 0; c < 4; ++c)
+    out |= ((sums[c] + count / 2) / count) << (c * 8);
+  return out;
+}
+
+}  // namespace
+
+void ScaleBGRAReference(const uint8_t* src,
+                        size_t src_pitch,
+                        int src_width,
+                        int src_height,
+                        uint8_t* dst,
+                        size_t dst_pitch,
+                        int dst_width,
+                        int dst_height,
+                        CudaScaleFilter filter) {
+  for (int y = 0; y < dst_height; ++y) {
+    for (int x = 0; x < dst_width; ++x) {
+      if (filter == CudaScaleFilter::kBox) {
+        const int x_begin = x * src_width / dst_width;
+        const int x_end =
+            std::max((x + 1) * src_width / dst_width, x_begin + 1);
+        const int y_begin = y * src_height / dst_height;
+        const int y_end =
+            std::max((y + 1) * src_height / dst_height, y_begin + 1);
+        StorePixel(dst, dst_pitch, x, y,
+                   BoxPixel(src, src_pitch, x_begin, x_end, y_begin, y_end));
+        continue;
+      }
+
+      const uint32_t sx = SourcePosition(x, src_width, dst_width);
+      const uint32_t sy = SourcePosition(y, src_height, dst_height);
+      const int x0 = sx >> 8;
+      const int x1 = std::min(x0 + 1, src_width - 1);
+      const int y0 = sy >> 8;
+      const int y1 = std::min(y0 + 1, src_height - 1);
+      const uint32_t wx = sx & 255;
+      const uint32_t wy = sy & 255;
+      const uint32_t p00 = LoadPixel(src, src_pitch, x0, y0);
+      const uint32_t p01 = LoadPixel(src, src_pitch, x1, y0);
+      const uint32_t p10 = LoadPixel(src, src_pitch, x0, y1);
+      const uint32_t p11 = LoadPixel(src, src_pitch, x1, y1);
+
+      uint32_t out = 0;
+      for (int shift = 0; shift < 32; shift += 8) {
+        const uint32_t top =
+            Channel(p00, shift) * (256 - wx) + Channel(p01, shift) * wx;
+        const uint32_t bottom =
+            Channel(p10, shift) * (256 - wx) + Channel(p11, shift) * wx;
+        out |= ((top * (256 - wy) + bottom * wy + 32768) >> 16) << shift;
+      }
+      StorePixel(dst, dst_pitch, x, y, out);
+    }
+  }
+}
+
+}  // namespace viz
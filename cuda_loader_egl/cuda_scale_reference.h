@@ -0,0 +1,33 @@
+#ifndef __cuda_scale_reference_h__
+#define __cuda_scale_reference_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cuda_export_config.h"
+
+namespace viz {
+
+// Scales a BGRA image on the CPU, all four channels. The output is
+// bit-exact with CudaScaler so tests can check the kernels' math without a
+// GPU.
+//
+//   kBox       each destination pixel is the rounded mean of the source
+//              pixels it covers, [x * src / dst, (x + 1) * src / dst) per
+//              axis, at least one
+//   kBilinear  pixel centers mapped with 8 fractional bits,
+//              ((2x + 1) * src * 128) / dst - 128 clamped at 0, and the
+//              four neighbours weighted in 8.8 fixed point, rounded once
+void ScaleBGRAReference(const uint8_t* src,
+                        size_t src_pitch,
+                        int src_width,
+                        int src_height,
+                        uint8_t* dst,
+                        size_t dst_pitch,
+                        int dst_width,
+                        int dst_height,
+                        CudaScaleFilter filter);
+
+}  // namespace viz
+
+#endif  // __cuda_scale_reference_h__
@@ -0,0 +1,135 @@
+#include "cuda_scale_reference.h"
+
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+#include "cuda_scale.h"
+#include "cuda_stub_driver_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace viz {
+
+namespace {
+
+// A pixel with every channel at |value| but alpha, which stays opaque, so
+// a channel mixed up with another one shows.
+uint32_t Gray(uint8_t value) {
+  return 0xff000000u | value << 16 | value << 8 | value;
+}
+
+std::vector<uint32_t> Scale(const std::vector<uint32_t>& src,
+                            int src_width,
+                            int src_height,
+                            int dst_width,
+                            int dst_height,
+                            CudaScaleFilter filter) {
+  std::vector<uint32_t> dst(dst_width * dst_height, 0xcdcdcdcdu);
+  ScaleBGRAReference(reinterpret_cast<const uint8_t*>(src.data()),
+                     src_width * 4, src_width, src_height,
+                     reinterpret_cast<uint8_t*>(dst.data()), dst_width * 4,
+                     dst_width, dst_height, filter);
+  return dst;
+}
+
+TEST(CudaScaleTest, BoxAveragesCoveredPixels) {
+  const std::vector<uint32_t> src = {Gray(10), Gray(20), Gray(30), Gray(40),
+                                     Gray(50), Gray(60), Gray(70), Gray(81)};
+  // (10 + 20 + 50 + 60 + 2) / 4 and (30 + 40 + 70 + 81 + 2) / 4
+  EXPECT_EQ(std::vector<uint32_t>({Gray(35), Gray(55)}),
+            Scale(src, 4, 2, 2, 1, CudaScaleFilter::kBox));
+}
+
+TEST(CudaScaleTest, BoxUnevenAndUpscaled) {
+  // 3 to 2 covers [0, 1) and [1, 3).
+  EXPECT_EQ(std::vector<uint32_t>({Gray(9), Gray(150)}),
+            Scale({Gray(9), Gray(100), Gray(200)}, 3, 1, 2, 1,
+                  CudaScaleFilter::kBox));
+  // Every destination pixel covers at least one source pixel.
+  EXPECT_EQ(std::vector<uint32_t>(4, Gray(77)),
+            Scale({Gray(77)}, 1, 1, 2, 2, CudaScaleFilter::kBox));
+}
+
+TEST(CudaScaleTest, BilinearWeights) {
+  // Centers at -0.25 (clamped to 0), 0.25, 0.75 and 1.25 (the edge pixel
+  // repeated) of the two source pixels.
+  EXPECT_EQ(std::vector<uint32_t>({Gray(0), Gray(64), Gray(191), Gray(255)}),
+            Scale({Gray(0), Gray(255)}, 2, 1, 4, 1,
+                  CudaScaleFilter::kBilinear));
+}
+
+TEST(CudaScaleTest, ChannelsStayApart) {
+  const uint32_t pixel = 0x80402010u;
+  for (CudaScaleFilter filter :
+       {CudaScaleFilter::kBox, CudaScaleFilter::kBilinear}) {
+    EXPECT_EQ(std::vector<uint32_t>(2, pixel),
+              Scale(std::vector<uint32_t>(8, pixel), 4, 2, 2, 1, filter));
+  }
+}
+
+// Random frames through the PTX kernels, which have to agree with the
+// reference on every pixel.
+void ExpectKernelsMatchReference() {
+  CudaScaler scaler;
+  ASSERT_TRUE(scaler.Init());
+  CUstream stream = nullptr;
+  ASSERT_EQ(CUDA_SUCCESS, cuStreamCreate(&stream, 0));
+
+  std::mt19937 random(40);
+  const struct {
+    int src_width, src_height, dst_width, dst_height;
+  } kSizes[] = {{1, 1, 3, 5}, {101, 77, 40, 31}, {13, 9, 30, 21},
+                {641, 359, 213, 119}};
+  for (const auto& size : kSizes) {
+    // Padded rows on both sides.
+    const size_t src_pitch = size.src_width * 4 + 12;
+    const size_t dst_pitch = size.dst_width * 4 + 20;
+    std::vector<uint8_t> src(src_pitch * size.src_height);
+    for (uint8_t& byte : src)
+      byte = static_cast<uint8_t>(random());
+    CUdeviceptr src_device;
+    ASSERT_EQ(CUDA_SUCCESS, cuMemAlloc(&src_device, src.size()));
+    ASSERT_EQ(CUDA_SUCCESS,
+              cuMemcpyHtoD(src_device, src.data(), src.size()));
+    const size_t dst_size = dst_pitch * size.dst_height;
+    CUdeviceptr dst_device;
+    ASSERT_EQ(CUDA_SUCCESS, cuMemAlloc(&dst_device, dst_size));
+
+    for (CudaScaleFilter filter :
+         {CudaScaleFilter::kBox, CudaScaleFilter::kBilinear}) {
+      std::vector<uint8_t> expected(dst_size);
+      ScaleBGRAReference(src.data(), src_pitch, size.src_width,
+                         size.src_height, expected.data(), dst_pitch,
+                         size.dst_width, size.dst_height, filter);
+      ASSERT_TRUE(scaler.Scale(src_device, src_pitch, size.src_width,
+                               size.src_height, dst_device, dst_pitch,
+                               size.dst_width, size.dst_height, filter,
+                               stream));
+      ASSERT_EQ(CUDA_SUCCESS, cuStreamSynchronize(stream));
+      std::vector<uint8_t> actual(dst_size);
+      ASSERT_EQ(CUDA_SUCCESS,
+                cuMemcpyDtoH(actual.data(), dst_device, dst_size));
+
+      for (int row = 0; row < size.dst_height; ++row) {
+        const size_t offset = row * dst_pitch;
+        ASSERT_EQ(0, memcmp(&expected[offset], &actual[offset],
+                            size.dst_width * 4))
+            << "filter " << static_cast<int>(filter) << ", "
+            << size.src_width << "x" << size.src_height << " to "
+            << size.dst_width << "x" << size.dst_height << ", row " << row;
+      }
+    }
+    cuMemFree(dst_device);
+    cuMemFree(src_device);
+  }
+  cuStreamDestroy(stream);
+}
+
+TEST(CudaScalerTest, MatchesReference) {
+  EXPECT_ON_CUDA_DEVICE(ExpectKernelsMatchReference());
+}
+
+}  // namespace
+
+}  // namespace viz
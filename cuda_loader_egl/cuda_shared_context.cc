@@ -0,0 +1,116 @@
+#include "cuda_shared_context.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "base/no_destructor.h"
+#include "base/synchronization/lock.h"
+#include "cuda_wrapper_include.h"
+
+namespace viz {
+
+namespace {
+
+// Live contexts, at most one per device. Lookups and reference counts go
+// through the same lock so a context cannot be handed out while its last
+// reference is being dropped.
+struct Registry {
+  base::Lock lock;
+  std::vector<CudaSharedContext*> contexts;
+};
+
+Registry& GetRegistry() {
+  static base::NoDestructor<Registry> registry;
+  return *registry;
+}
+
+}  // namespace
+
+// static
+CudaSharedContext* CudaSharedContext::Acquire(CUdevice device,
+                                              CudaContextMode mode) {
+  Registry& registry = GetRegistry();
+  base::AutoLock lock(registry.lock);
+  for (CudaSharedContext* shared : registry.contexts) {
+    if (shared->device_ == device) {
+      shared->refs_++;
+      return shared;
+    }
+  }
+
+  CUcontext context = nullptr;
+  bool primary = false;
+  if (mode == CudaContextMode::kPrimary) {
+    if (cuDrvApiGetCapabilities() & CU_DRVAPI_CAP_PRIMARY_CONTEXT) {
+      primary = !CHECK_CU(cuDevicePrimaryCtxRetain(&context, device));
+    } else {
+      fprintf(stdout,
+              "[CudaOffscreenHook] driver has no primary context, using a "
+              "private one\n");
+    }
+  }
+  if (!primary) {
+    if (CHECK_CU(cuCtxCreate(&context, 0, device)))
+      return nullptr;
+    // cuCtxCreate leaves the new context current on the calling thread.
+    CUcontext popped = nullptr;
+    CHECK_CU(cuCtxPopCurrent(&popped));
+  }
+
+  CudaSharedContext* shared = new CudaSharedContext(context, device, primary);
+  registry.contexts.push_back(shared);
+  return shared;
+}
+
+// static
+CudaSharedContext* CudaSharedContext::AcquireExisting(CUdevice device) {
+  Registry& registry = GetRegistry();
+  base::AutoLock lock(registry.lock);
+  for (CudaSharedContext* shared : registry.contexts) {
+    if (shared->device_ == device) {
+      shared->refs_++;
+      return shared;
+    }
+  }
+  return nullptr;
+}
+
+void CudaSharedContext::Release() {
+  Registry& registry = GetRegistry();
+  base::AutoLock lock(registry.lock);
+  if (--refs_)
+    return;
+  registry.contexts.erase(
+      std::find(registry.contexts.begin(), registry.contexts.end(), this));
+  delete this;
+}
+
+CudaSharedContext::CudaSharedContext(CUcontext context,
+                                     CUdevice device,
+                                     bool primary)
+    : context_(context), device_(device), primary_(primary) {}
+
+CudaSharedContext::~CudaSharedContext() {
+  if (primary_)
+    CHECK_CU(cuDevicePrimaryCtxRelease(device_));
+  else
+    CHECK_CU(cuCtxDestroy(context_));
+}
+
+ScopedCudaContext::ScopedCudaContext(CUcontext context) {
+  CUcontext current = nullptr;
+  if (cuCtxGetCurrent(&current) == CUDA_SUCCESS && current == context)
+    return;
+  pushed_ = !CHECK_CU(cuCtxPushCurrent(context));
+}
+
+ScopedCudaContext::~ScopedCudaContext() {
+  if (!pushed_)
+    return;
+  CUcontext popped = nullptr;
+  CHECK_CU(cuCtxPopCurrent(&popped));
+}
+
+}  // namespace viz
@@ -0,0 +1,71 @@
+#ifndef __cuda_shared_context_h__
+#define __cuda_shared_context_h__
+
+#include "cuda_drvapi_dynlink.h"
+
+namespace viz {
+
+enum class CudaContextMode {
+  // Retains the device's primary context, the one the runtime API and most
+  // libraries use: no extra VRAM reservation and no context switch against
+  // other CUDA users in the GPU process.
+  kPrimary,
+  // A context of our own, for drivers without primary context entry points
+  // or to isolate the exporter from a misbehaving neighbour.
+  kPrivate,
+};
+
+// One CUDA context per device, shared by the exporter and any in-process
+// consumer of its buffers, e.g. an encoder. Never left current on a thread;
+// users make it current around their work with ScopedCudaContext.
+class CudaSharedContext {
+ public:
+  CudaSharedContext(const CudaSharedContext&) = delete;
+  CudaSharedContext& operator=(const CudaSharedContext&) = delete;
+
+  // Returns the context of |device|, creating it on first use. |mode| only
+  // matters for the first caller; kPrimary falls back to a private context
+  // when the driver cannot retain the primary one. nullptr on failure.
+  // Every non-null result must be paired with Release().
+  static CudaSharedContext* Acquire(CUdevice device, CudaContextMode mode);
+
+  // Like Acquire() but never creates: shares the context someone already
+  // works in on |device|, or returns nullptr.
+  static CudaSharedContext* AcquireExisting(CUdevice device);
+
+  // Drops one reference; the last one releases or destroys the context.
+  void Release();
+
+  CUcontext context() const { return context_; }
+  CUdevice device() const { return device_; }
+  bool is_primary() const { return primary_; }
+
+ private:
+  CudaSharedContext(CUcontext context, CUdevice device, bool primary);
+  ~CudaSharedContext();
+
+  const CUcontext context_;
+  const CUdevice device_;
+  const bool primary_;
+  // Guarded by the registry lock.
+  int refs_ = 1;
+};
+
+// Makes |context| current on this thread for the lifetime of the object and
+// restores what was current before. Nothing is pushed when |context| already
+// is current, so nesting costs one cuCtxGetCurrent.
+class ScopedCudaContext {
+ public:
+  explicit ScopedCudaContext(CUcontext context);
+  ~ScopedCudaContext();
+
+  ScopedCudaContext(const ScopedCudaContext&) = delete;
+  ScopedCudaContext& operator=(const ScopedCudaContext&) = delete;
+
+ private:
+  bool pushed_ = false;
+};
+
+}  // namespace viz
+
+#endif  // __cuda_shared_context_h__
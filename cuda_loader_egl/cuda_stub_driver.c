@@ -0,0 +1,1653 @@
+/*
+ * Host memory backed stand-in for libcuda.so.1.
+ *
+ * Lets the loader, the export hook and its consumers run on machines
+ * without an NVIDIA GPU:
+ *
+ *   CUDA_DRVAPI_LIBRARY=/path/to/libcuda_stub_driver.so ./run-x11
+ *
+ * Device memory is memfd backed and mapped into the process, so a
+ * CUdeviceptr is a plain host address and IPC handles can be opened from
+ * another process through /proc/<pid>/fd. Graphics resources are host arrays
+ * of a configurable size, external memory is an mmap of the imported fd.
+ * Kernels, modules and texture references are not emulated.
+ *
+ * Tunables, read once by cuInit:
+ *   CUDA_STUB_DRIVER_VERSION   reported driver version (default 12020)
+ *   CUDA_STUB_DEVICE_COUNT     number of devices (default 1)
+ *   CUDA_STUB_GL_DEVICE        device cuGLGetDevices reports (default 0)
+ *   CUDA_STUB_LATENCY_US       fixed cost of every copy (default 0)
+ *   CUDA_STUB_BANDWIDTH_MBPS   copy bandwidth, 0 for unlimited (default 0)
+ *   CUDA_STUB_GRAPHICS_SIZE    WxH of registered GL/EGL images (1920x1080)
+ *   CUDA_STUB_INIT_RESULT      CUresult cuInit fails with (default 0)
+ *
+ * Async work completes on the host right away; the stream only remembers
+ * when the emulated device would be done, and synchronization sleeps until
+ * then. Copy scheduling therefore shows up in timings the same way it would
+ * on hardware.
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CUDA_DRVAPI_TYPES_ONLY
+#include "cuda_drvapi_dynlink.h"
+
+#define STUB_EXPORT __attribute__((visibility("default")))
+
+// Not in the 7.0 era headers; same value as the real driver
+#define CUDA_STUB_ERROR_NOT_SUPPORTED ((CUresult)801)
+
+#define STUB_IPC_MAGIC 0x43535442u /* "CSTB" */
+#define STUB_MAX_DEVICES 8
+#define STUB_CTX_STACK_DEPTH 16
+
+/************************************
+ **
+ **    State
+ **
+ ***********************************/
+
+struct CUctx_st
+{
+    CUdevice device;
+};
+
+struct CUstream_st
+{
+    // monotonic time in ns at which the emulated device drains the stream
+    uint64_t ready_at;
+};
+
+struct CUevent_st
+{
+    uint64_t time;
+    int recorded;
+};
+
+struct CUarray_st
+{
+    CUDA_ARRAY_DESCRIPTOR desc;
+    size_t pitch;
+    unsigned char *data;
+};
+
+enum StubResourceKind
+{
+    STUB_RESOURCE_GL_IMAGE,
+    STUB_RESOURCE_EGL_IMAGE
+};
+
+struct CUgraphicsResource_st
+{
+    enum StubResourceKind kind;
+    CUarray array;
+    int mapped;
+    unsigned long long map_count;
+};
+
+struct CUextMemory_st
+{
+    void *base;
+    size_t size;
+};
+
+struct CUextSemaphore_st
+{
+    int fd;
+    unsigned long long value;
+};
+
+enum StubAllocKind
+{
+    STUB_ALLOC_DEVICE,    // memfd, owned
+    STUB_ALLOC_IPC,       // mapping of another process' allocation
+    STUB_ALLOC_EXTERNAL,  // view into external memory, unmapped by destroy
+    STUB_ALLOC_HOST       // cuMemAllocHost/cuMemHostAlloc
+};
+
+struct StubAlloc
+{
+    enum StubAllocKind kind;
+    void *base;
+    size_t size;
+    int fd;
+    struct StubAlloc *next;
+};
+
+typedef struct IpcPayload_st
+{
+    uint32_t magic;
+    int32_t pid;
+    int32_t fd;
+    uint64_t size;
+} IpcPayload;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct StubAlloc *g_allocs;
+static struct CUstream_st g_default_stream;
+
+static int g_initialized;
+static int g_driver_version = 12020;
+static int g_device_count = 1;
+static int g_gl_device;
+static uint64_t g_latency_ns;
+static uint64_t g_bandwidth_bps;
+static size_t g_graphics_width = 1920;
+static size_t g_graphics_height = 1080;
+
+// primary contexts live as long as the process, only the count changes
+static struct CUctx_st g_primary_ctx[STUB_MAX_DEVICES];
+static int g_primary_refs[STUB_MAX_DEVICES];
+
+static __thread CUcontext g_ctx_stack[STUB_CTX_STACK_DEPTH];
+static __thread int g_ctx_depth;
+
+/************************************
+ **
+ **    Helpers
+ **
+ ***********************************/
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t)
+{
+    uint64_t now = now_ns();
+    struct timespec ts;
+
+    if (t <= now)
+        return;
+    ts.tv_sec = (time_t)((t - now) / 1000000000ull);
+    ts.tv_nsec = (long)((t - now) % 1000000000ull);
+    nanosleep(&ts, NULL);
+}
+
+static uint64_t copy_cost_ns(size_t bytes)
+{
+    uint64_t cost = g_latency_ns;
+
+    if (g_bandwidth_bps)
+        cost += (uint64_t)bytes * 1000000000ull / g_bandwidth_bps;
+    return cost;
+}
+
+static uint64_t env_u64(const char *name, uint64_t fallback)
+{
+    const char *value = getenv(name);
+    char *end = NULL;
+    unsigned long long v;
+
+    if (value == NULL || *value == '\0')
+        return fallback;
+    v = strtoull(value, &end, 10);
+    return (end && *end == '\0') ? (uint64_t)v : fallback;
+}
+
+static struct CUstream_st *stream_of(CUstream stream)
+{
+    return stream ? stream : &g_default_stream;
+}
+
+// Schedules |bytes| worth of copy on |stream|; the host side already ran.
+static void stream_enqueue(CUstream stream, size_t bytes)
+{
+    struct CUstream_st *s = stream_of(stream);
+    uint64_t start = now_ns();
+
+    pthread_mutex_lock(&g_lock);
+    if (s->ready_at > start)
+        start = s->ready_at;
+    s->ready_at = start + copy_cost_ns(bytes);
+    pthread_mutex_unlock(&g_lock);
+}
+
+static uint64_t stream_ready_at(CUstream stream)
+{
+    uint64_t t;
+
+    pthread_mutex_lock(&g_lock);
+    t = stream_of(stream)->ready_at;
+    pthread_mutex_unlock(&g_lock);
+    return t;
+}
+
+static CUcontext current_ctx(void)
+{
+    return g_ctx_depth ? g_ctx_stack[g_ctx_depth - 1] : NULL;
+}
+
+#define STUB_REQUIRE_INIT()                      \
+    do {                                         \
+        if (!g_initialized)                      \
+            return CUDA_ERROR_NOT_INITIALIZED;   \
+    } while (0)
+
+#define STUB_REQUIRE_CONTEXT()                   \
+    do {                                         \
+        STUB_REQUIRE_INIT();                     \
+        if (current_ctx() == NULL)               \
+            return CUDA_ERROR_INVALID_CONTEXT;   \
+    } while (0)
+
+static void alloc_register(enum StubAllocKind kind, void *base, size_t size, int fd)
+{
+    struct StubAlloc *a = (struct StubAlloc *)calloc(1, sizeof(*a));
+
+    a->kind = kind;
+    a->base = base;
+    a->size = size;
+    a->fd = fd;
+    pthread_mutex_lock(&g_lock);
+    a->next = g_allocs;
+    g_allocs = a;
+    pthread_mutex_unlock(&g_lock);
+}
+
+// Detaches the allocation starting at |base|, NULL if there is none.
+static struct StubAlloc *alloc_take(void *base)
+{
+    struct StubAlloc **p;
+    struct StubAlloc *found = NULL;
+
+    pthread_mutex_lock(&g_lock);
+    for (p = &g_allocs; *p; p = &(*p)->next)
+    {
+        if ((*p)->base == base)
+        {
+            found = *p;
+            *p = found->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+    return found;
+}
+
+static int alloc_find(const void *ptr, struct StubAlloc *out)
+{
+    struct StubAlloc *a;
+    int found = 0;
+
+    pthread_mutex_lock(&g_lock);
+    for (a = g_allocs; a; a = a->next)
+    {
+        if ((const unsigned char *)ptr >= (unsigned char *)a->base &&
+            (const unsigned char *)ptr < (unsigned char *)a->base + a->size)
+        {
+            *out = *a;
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+    return found;
+}
+
+static void alloc_release(struct StubAlloc *a)
+{
+    switch (a->kind)
+    {
+    case STUB_ALLOC_DEVICE:
+        munmap(a->base, a->size);
+        close(a->fd);
+        break;
+    case STUB_ALLOC_IPC:
+        munmap(a->base, a->size);
+        break;
+    case STUB_ALLOC_EXTERNAL:
+        break;
+    case STUB_ALLOC_HOST:
+        free(a->base);
+        break;
+    }
+    free(a);
+}
+
+static size_t format_bytes(CUarray_format format)
+{
+    switch (format)
+    {
+    case CU_AD_FORMAT_UNSIGNED_INT8:
+    case CU_AD_FORMAT_SIGNED_INT8:
+        return 1;
+    case CU_AD_FORMAT_UNSIGNED_INT16:
+    case CU_AD_FORMAT_SIGNED_INT16:
+    case CU_AD_FORMAT_HALF:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+static CUarray array_new(const CUDA_ARRAY_DESCRIPTOR *desc)
+{
+    CUarray array = (CUarray)calloc(1, sizeof(*array));
+    size_t height = desc->Height ? desc->Height : 1;
+
+    array->desc = *desc;
+    array->pitch = desc->Width * format_bytes(desc->Format) * desc->NumChannels;
+    array->data = (unsigned char *)calloc(height, array->pitch);
+    return array;
+}
+
+static void array_free(CUarray array)
+{
+    if (array)
+    {
+        free(array->data);
+        free(array);
+    }
+}
+
+struct CopyEnd
+{
+    unsigned char *ptr;
+    size_t pitch;
+    size_t limit_width;   // bytes per row available, 0 if unknown
+    size_t limit_height;  // rows available, 0 if unknown
+};
+
+static CUresult copy_end(CUmemorytype type, const void *host, CUdeviceptr device,
+                         CUarray array, size_t pitch, size_t x, size_t y,
+                         struct CopyEnd *end)
+{
+    memset(end, 0, sizeof(*end));
+    switch (type)
+    {
+    case CU_MEMORYTYPE_HOST:
+        end->ptr = (unsigned char *)host;
+        end->pitch = pitch;
+        break;
+    case CU_MEMORYTYPE_DEVICE:
+    case CU_MEMORYTYPE_UNIFIED:
+        end->ptr = (unsigned char *)(uintptr_t)device;
+        end->pitch = pitch;
+        break;
+    case CU_MEMORYTYPE_ARRAY:
+        if (array == NULL)
+            return CUDA_ERROR_INVALID_VALUE;
+        end->ptr = array->data;
+        end->pitch = array->pitch;
+        end->limit_width = array->pitch;
+        end->limit_height = array->desc.Height ? array->desc.Height : 1;
+        break;
+    default:
+        return CUDA_ERROR_INVALID_VALUE;
+    }
+    if (end->ptr == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (end->limit_width && end->limit_width < x)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (end->limit_height && end->limit_height < y)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (end->limit_width)
+        end->limit_width -= x;
+    if (end->limit_height)
+        end->limit_height -= y;
+    end->ptr += y * end->pitch + x;
+    return CUDA_SUCCESS;
+}
+
+static CUresult copy_2d(const CUDA_MEMCPY2D *p)
+{
+    struct CopyEnd src, dst;
+    CUresult status;
+    size_t row;
+
+    if (p == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    status = copy_end(p->srcMemoryType, p->srcHost, p->srcDevice, p->srcArray,
+                      p->srcPitch, p->srcXInBytes, p->srcY, &src);
+    if (status != CUDA_SUCCESS)
+        return status;
+    status = copy_end(p->dstMemoryType, p->dstHost, p->dstDevice, p->dstArray,
+                      p->dstPitch, p->dstXInBytes, p->dstY, &dst);
+    if (status != CUDA_SUCCESS)
+        return status;
+
+    if ((src.limit_width && p->WidthInBytes > src.limit_width) ||
+        (dst.limit_width && p->WidthInBytes > dst.limit_width) ||
+        (src.limit_height && p->Height > src.limit_height) ||
+        (dst.limit_height && p->Height > dst.limit_height))
+        return CUDA_ERROR_INVALID_VALUE;
+    if (p->Height > 1 && ((src.pitch < p->WidthInBytes) || (dst.pitch < p->WidthInBytes)))
+        return CUDA_ERROR_INVALID_VALUE;
+
+    for (row = 0; row < p->Height; row++)
+        memcpy(dst.ptr + row * dst.pitch, src.ptr + row * src.pitch, p->WidthInBytes);
+    return CUDA_SUCCESS;
+}
+
+/************************************
+ **
+ **    Initialization
+ **
+ ***********************************/
+
+STUB_EXPORT CUresult CUDAAPI cuInit(unsigned int Flags)
+{
+    const char *size;
+    CUresult result;
+
+    if (Flags != 0)
+        return CUDA_ERROR_INVALID_VALUE;
+    result = (CUresult)env_u64("CUDA_STUB_INIT_RESULT", CUDA_SUCCESS);
+    if (result != CUDA_SUCCESS)
+        return result;
+
+    pthread_mutex_lock(&g_lock);
+    g_driver_version = (int)env_u64("CUDA_STUB_DRIVER_VERSION", 12020);
+    g_device_count = (int)env_u64("CUDA_STUB_DEVICE_COUNT", 1);
+    if (g_device_count > STUB_MAX_DEVICES)
+        g_device_count = STUB_MAX_DEVICES;
+    g_gl_device = (int)env_u64("CUDA_STUB_GL_DEVICE", 0);
+    if (g_gl_device >= g_device_count)
+        g_gl_device = 0;
+    g_latency_ns = env_u64("CUDA_STUB_LATENCY_US", 0) * 1000ull;
+    g_bandwidth_bps = env_u64("CUDA_STUB_BANDWIDTH_MBPS", 0) * 1000000ull;
+    size = getenv("CUDA_STUB_GRAPHICS_SIZE");
+    if (size)
+    {
+        unsigned long w = 0, h = 0;
+        if (sscanf(size, "%lux%lu", &w, &h) == 2 && w && h)
+        {
+            g_graphics_width = w;
+            g_graphics_height = h;
+        }
+    }
+    g_initialized = 1;
+    pthread_mutex_unlock(&g_lock);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDriverGetVersion(int *driverVersion)
+{
+    if (driverVersion == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *driverVersion = g_driver_version;
+    return CUDA_SUCCESS;
+}
+
+// Hands out the _v2 variant when there is one, like the real driver does
+// for any API version past 3.2. Stream flags are ignored: the stub has no
+// per-thread default stream.
+STUB_EXPORT CUresult CUDAAPI cuGetProcAddress(const char *symbol, void **pfn,
+                                              int cudaVersion,
+                                              unsigned long long flags)
+{
+    static void *self;
+    char versioned[128];
+    Dl_info info;
+
+    (void)cudaVersion;
+    (void)flags;
+    if (symbol == NULL || pfn == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+
+    if (self == NULL && dladdr((void *)cuGetProcAddress, &info) && info.dli_fname)
+        self = dlopen(info.dli_fname, RTLD_NOW | RTLD_NOLOAD);
+    if (self == NULL)
+        return CUDA_ERROR_NOT_FOUND;
+
+    snprintf(versioned, sizeof(versioned), "%s_v2", symbol);
+    *pfn = dlsym(self, versioned);
+    if (*pfn == NULL)
+        *pfn = dlsym(self, symbol);
+    return *pfn ? CUDA_SUCCESS : CUDA_ERROR_NOT_FOUND;
+}
+
+/************************************
+ **
+ **    Devices
+ **
+ ***********************************/
+
+STUB_EXPORT CUresult CUDAAPI cuDeviceGetCount(int *count)
+{
+    STUB_REQUIRE_INIT();
+    if (count == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *count = g_device_count;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDeviceGet(CUdevice *device, int ordinal)
+{
+    STUB_REQUIRE_INIT();
+    if (device == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (ordinal < 0 || ordinal >= g_device_count)
+        return CUDA_ERROR_INVALID_DEVICE;
+    *device = ordinal;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDeviceGetName(char *name, int len, CUdevice dev)
+{
+    STUB_REQUIRE_INIT();
+    if (name == NULL || len <= 0)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (dev < 0 || dev >= g_device_count)
+        return CUDA_ERROR_INVALID_DEVICE;
+    snprintf(name, (size_t)len, "CUDA Stub Device %d", dev);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDeviceGetUuid(CUuuid *uuid, CUdevice dev)
+{
+    STUB_REQUIRE_INIT();
+    if (uuid == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (dev < 0 || dev >= g_device_count)
+        return CUDA_ERROR_INVALID_DEVICE;
+    memset(uuid->bytes, 0, sizeof(uuid->bytes));
+    memcpy(uuid->bytes, "cudastub", 8);
+    uuid->bytes[15] = (char)dev;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDeviceGetPCIBusId(char *pciBusId, int len, CUdevice dev)
+{
+    STUB_REQUIRE_INIT();
+    if (pciBusId == NULL || len <= 0)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (dev < 0 || dev >= g_device_count)
+        return CUDA_ERROR_INVALID_DEVICE;
+    snprintf(pciBusId, (size_t)len, "0000:%02X:00.0", 0x10 + dev);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDeviceGetByPCIBusId(CUdevice *dev, const char *pciBusId)
+{
+    unsigned int domain = 0, bus = 0, device = 0, func = 0;
+
+    STUB_REQUIRE_INIT();
+    if (dev == NULL || pciBusId == NULL ||
+        sscanf(pciBusId, "%x:%x:%x.%x", &domain, &bus, &device, &func) != 4)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (bus < 0x10 || (int)(bus - 0x10) >= g_device_count)
+        return CUDA_ERROR_INVALID_DEVICE;
+    *dev = (CUdevice)(bus - 0x10);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDeviceComputeCapability(int *major, int *minor, CUdevice dev)
+{
+    STUB_REQUIRE_INIT();
+    if (major == NULL || minor == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *major = 8;
+    *minor = 6;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDeviceTotalMem_v2(size_t *bytes, CUdevice dev)
+{
+    STUB_REQUIRE_INIT();
+    if (bytes == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *bytes = (size_t)8 << 30;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDeviceGetAttribute(int *pi, CUdevice_attribute attrib, CUdevice dev)
+{
+    STUB_REQUIRE_INIT();
+    if (pi == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (dev < 0 || dev >= g_device_count)
+        return CUDA_ERROR_INVALID_DEVICE;
+    switch (attrib)
+    {
+    case CU_DEVICE_ATTRIBUTE_MULTIPROCESSOR_COUNT:
+        *pi = 1;
+        break;
+    case CU_DEVICE_ATTRIBUTE_PCI_BUS_ID:
+        *pi = 0x10 + dev;
+        break;
+    case CU_DEVICE_ATTRIBUTE_UNIFIED_ADDRESSING:
+        *pi = 1;
+        break;
+    default:
+        *pi = 0;
+        break;
+    }
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDeviceGetProperties(CUdevprop *prop, CUdevice dev)
+{
+    STUB_REQUIRE_INIT();
+    if (prop == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    memset(prop, 0, sizeof(*prop));
+    return CUDA_SUCCESS;
+}
+
+/************************************
+ **
+ **    Contexts
+ **
+ ***********************************/
+
+STUB_EXPORT CUresult CUDAAPI cuCtxCreate_v2(CUcontext *pctx, unsigned int flags, CUdevice dev)
+{
+    CUcontext ctx;
+
+    STUB_REQUIRE_INIT();
+    if (pctx == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (dev < 0 || dev >= g_device_count)
+        return CUDA_ERROR_INVALID_DEVICE;
+    if (g_ctx_depth == STUB_CTX_STACK_DEPTH)
+        return CUDA_ERROR_OUT_OF_MEMORY;
+    ctx = (CUcontext)calloc(1, sizeof(*ctx));
+    ctx->device = dev;
+    g_ctx_stack[g_ctx_depth++] = ctx;
+    *pctx = ctx;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuCtxDestroy_v2(CUcontext ctx)
+{
+    int i, j;
+
+    STUB_REQUIRE_INIT();
+    if (ctx == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (ctx >= g_primary_ctx && ctx < g_primary_ctx + STUB_MAX_DEVICES)
+        return CUDA_ERROR_INVALID_CONTEXT;
+    // drop it from this thread's stack wherever it is
+    for (i = 0, j = 0; i < g_ctx_depth; i++)
+    {
+        if (g_ctx_stack[i] != ctx)
+            g_ctx_stack[j++] = g_ctx_stack[i];
+    }
+    g_ctx_depth = j;
+    free(ctx);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuCtxPushCurrent_v2(CUcontext ctx)
+{
+    STUB_REQUIRE_INIT();
+    if (ctx == NULL)
+        return CUDA_ERROR_INVALID_CONTEXT;
+    if (g_ctx_depth == STUB_CTX_STACK_DEPTH)
+        return CUDA_ERROR_OUT_OF_MEMORY;
+    g_ctx_stack[g_ctx_depth++] = ctx;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuCtxPopCurrent_v2(CUcontext *pctx)
+{
+    STUB_REQUIRE_INIT();
+    if (g_ctx_depth == 0)
+        return CUDA_ERROR_INVALID_CONTEXT;
+    g_ctx_depth--;
+    if (pctx)
+        *pctx = g_ctx_stack[g_ctx_depth];
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDevicePrimaryCtxRetain(CUcontext *pctx, CUdevice dev)
+{
+    STUB_REQUIRE_INIT();
+    if (pctx == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (dev < 0 || dev >= g_device_count)
+        return CUDA_ERROR_INVALID_DEVICE;
+    pthread_mutex_lock(&g_lock);
+    g_primary_ctx[dev].device = dev;
+    g_primary_refs[dev]++;
+    pthread_mutex_unlock(&g_lock);
+    *pctx = &g_primary_ctx[dev];
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDevicePrimaryCtxRelease_v2(CUdevice dev)
+{
+    CUresult status = CUDA_SUCCESS;
+
+    STUB_REQUIRE_INIT();
+    if (dev < 0 || dev >= g_device_count)
+        return CUDA_ERROR_INVALID_DEVICE;
+    pthread_mutex_lock(&g_lock);
+    if (g_primary_refs[dev] == 0)
+        status = CUDA_ERROR_INVALID_CONTEXT;
+    else
+        g_primary_refs[dev]--;
+    pthread_mutex_unlock(&g_lock);
+    return status;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDevicePrimaryCtxRelease(CUdevice dev)
+{
+    return cuDevicePrimaryCtxRelease_v2(dev);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuCtxSetCurrent(CUcontext ctx)
+{
+    STUB_REQUIRE_INIT();
+    if (ctx == NULL)
+    {
+        if (g_ctx_depth)
+            g_ctx_depth--;
+        return CUDA_SUCCESS;
+    }
+    if (g_ctx_depth == 0)
+        g_ctx_depth = 1;
+    g_ctx_stack[g_ctx_depth - 1] = ctx;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuCtxGetCurrent(CUcontext *pctx)
+{
+    STUB_REQUIRE_INIT();
+    if (pctx == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *pctx = current_ctx();
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuCtxGetDevice(CUdevice *device)
+{
+    STUB_REQUIRE_CONTEXT();
+    if (device == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *device = current_ctx()->device;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuCtxSynchronize(void)
+{
+    STUB_REQUIRE_CONTEXT();
+    sleep_until(stream_ready_at(NULL));
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuCtxGetApiVersion(CUcontext ctx, unsigned int *version)
+{
+    STUB_REQUIRE_INIT();
+    if (version == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *version = 3020;
+    return CUDA_SUCCESS;
+}
+
+/************************************
+ **
+ **    Memory
+ **
+ ***********************************/
+
+STUB_EXPORT CUresult CUDAAPI cuMemAlloc_v2(CUdeviceptr *dptr, size_t bytesize)
+{
+    void *base;
+    int fd;
+
+    STUB_REQUIRE_CONTEXT();
+    if (dptr == NULL || bytesize == 0)
+        return CUDA_ERROR_INVALID_VALUE;
+
+    fd = memfd_create("cuda-stub", MFD_CLOEXEC);
+    if (fd < 0)
+        return CUDA_ERROR_OUT_OF_MEMORY;
+    if (ftruncate(fd, (off_t)bytesize) != 0)
+    {
+        close(fd);
+        return CUDA_ERROR_OUT_OF_MEMORY;
+    }
+    base = mmap(NULL, bytesize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        close(fd);
+        return CUDA_ERROR_OUT_OF_MEMORY;
+    }
+    alloc_register(STUB_ALLOC_DEVICE, base, bytesize, fd);
+    *dptr = (CUdeviceptr)(uintptr_t)base;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemAllocPitch_v2(CUdeviceptr *dptr, size_t *pPitch,
+                                                size_t WidthInBytes, size_t Height,
+                                                unsigned int ElementSizeBytes)
+{
+    size_t pitch = (WidthInBytes + 511) & ~(size_t)511;
+
+    if (pPitch == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *pPitch = pitch;
+    return cuMemAlloc_v2(dptr, pitch * Height);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemFree_v2(CUdeviceptr dptr)
+{
+    struct StubAlloc *a;
+
+    STUB_REQUIRE_INIT();
+    if (dptr == 0)
+        return CUDA_SUCCESS;
+    a = alloc_take((void *)(uintptr_t)dptr);
+    if (a == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    alloc_release(a);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemGetInfo_v2(size_t *free_bytes, size_t *total)
+{
+    STUB_REQUIRE_CONTEXT();
+    if (free_bytes)
+        *free_bytes = (size_t)7 << 30;
+    if (total)
+        *total = (size_t)8 << 30;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemGetAddressRange_v2(CUdeviceptr *pbase, size_t *psize, CUdeviceptr dptr)
+{
+    struct StubAlloc a;
+
+    STUB_REQUIRE_INIT();
+    if (!alloc_find((void *)(uintptr_t)dptr, &a))
+        return CUDA_ERROR_NOT_FOUND;
+    if (pbase)
+        *pbase = (CUdeviceptr)(uintptr_t)a.base;
+    if (psize)
+        *psize = a.size;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemAllocHost_v2(void **pp, size_t bytesize)
+{
+    STUB_REQUIRE_CONTEXT();
+    if (pp == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *pp = calloc(1, bytesize);
+    if (*pp == NULL)
+        return CUDA_ERROR_OUT_OF_MEMORY;
+    alloc_register(STUB_ALLOC_HOST, *pp, bytesize, -1);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemHostAlloc(void **pp, size_t bytesize, unsigned int Flags)
+{
+    return cuMemAllocHost_v2(pp, bytesize);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemFreeHost(void *p)
+{
+    struct StubAlloc *a = alloc_take(p);
+
+    if (a == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    alloc_release(a);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemHostGetDevicePointer_v2(CUdeviceptr *pdptr, void *p, unsigned int Flags)
+{
+    if (pdptr == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *pdptr = (CUdeviceptr)(uintptr_t)p;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemHostGetFlags(unsigned int *pFlags, void *p)
+{
+    if (pFlags == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *pFlags = 0;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemHostRegister(void *p, size_t bytesize, unsigned int Flags)
+{
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemHostUnregister(void *p)
+{
+    return CUDA_SUCCESS;
+}
+
+static CUresult copy_linear(void *dst, const void *src, size_t bytes, CUstream stream, int async)
+{
+    STUB_REQUIRE_CONTEXT();
+    if ((dst == NULL || src == NULL) && bytes)
+        return CUDA_ERROR_INVALID_VALUE;
+    memmove(dst, src, bytes);
+    if (async)
+        stream_enqueue(stream, bytes);
+    else
+        sleep_until(now_ns() + copy_cost_ns(bytes));
+    return CUDA_SUCCESS;
+}
+
+#define DPTR(x) ((void *)(uintptr_t)(x))
+
+STUB_EXPORT CUresult CUDAAPI cuMemcpy(CUdeviceptr dst, CUdeviceptr src, size_t ByteCount)
+{
+    return copy_linear(DPTR(dst), DPTR(src), ByteCount, NULL, 0);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemcpyPeer(CUdeviceptr dstDevice, CUcontext dstContext,
+                                          CUdeviceptr srcDevice, CUcontext srcContext,
+                                          size_t ByteCount)
+{
+    return copy_linear(DPTR(dstDevice), DPTR(srcDevice), ByteCount, NULL, 0);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemcpyHtoD_v2(CUdeviceptr dstDevice, const void *srcHost, size_t ByteCount)
+{
+    return copy_linear(DPTR(dstDevice), srcHost, ByteCount, NULL, 0);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemcpyDtoH_v2(void *dstHost, CUdeviceptr srcDevice, size_t ByteCount)
+{
+    return copy_linear(dstHost, DPTR(srcDevice), ByteCount, NULL, 0);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemcpyDtoD_v2(CUdeviceptr dstDevice, CUdeviceptr srcDevice, size_t ByteCount)
+{
+    return copy_linear(DPTR(dstDevice), DPTR(srcDevice), ByteCount, NULL, 0);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemcpyHtoDAsync_v2(CUdeviceptr dstDevice, const void *srcHost,
+                                                  size_t ByteCount, CUstream hStream)
+{
+    return copy_linear(DPTR(dstDevice), srcHost, ByteCount, hStream, 1);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemcpyDtoHAsync_v2(void *dstHost, CUdeviceptr srcDevice,
+                                                  size_t ByteCount, CUstream hStream)
+{
+    return copy_linear(dstHost, DPTR(srcDevice), ByteCount, hStream, 1);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemcpyDtoDAsync_v2(CUdeviceptr dstDevice, CUdeviceptr srcDevice,
+                                                  size_t ByteCount, CUstream hStream)
+{
+    return copy_linear(DPTR(dstDevice), DPTR(srcDevice), ByteCount, hStream, 1);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemcpyDtoDAsync(CUdeviceptr dstDevice, CUdeviceptr srcDevice,
+                                               size_t ByteCount, CUstream hStream)
+{
+    return cuMemcpyDtoDAsync_v2(dstDevice, srcDevice, ByteCount, hStream);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemcpy2D_v2(const CUDA_MEMCPY2D *pCopy)
+{
+    CUresult status;
+
+    STUB_REQUIRE_CONTEXT();
+    status = copy_2d(pCopy);
+    if (status == CUDA_SUCCESS)
+        sleep_until(now_ns() + copy_cost_ns(pCopy->WidthInBytes * pCopy->Height));
+    return status;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemcpy2DUnaligned_v2(const CUDA_MEMCPY2D *pCopy)
+{
+    return cuMemcpy2D_v2(pCopy);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemcpy2DAsync_v2(const CUDA_MEMCPY2D *pCopy, CUstream hStream)
+{
+    CUresult status;
+
+    STUB_REQUIRE_CONTEXT();
+    status = copy_2d(pCopy);
+    if (status == CUDA_SUCCESS)
+        stream_enqueue(hStream, pCopy->WidthInBytes * pCopy->Height);
+    return status;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemsetD8_v2(CUdeviceptr dstDevice, unsigned char uc, size_t N)
+{
+    STUB_REQUIRE_CONTEXT();
+    memset(DPTR(dstDevice), uc, N);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuMemsetD32_v2(CUdeviceptr dstDevice, unsigned int ui, size_t N)
+{
+    unsigned int *p = (unsigned int *)DPTR(dstDevice);
+    size_t i;
+
+    STUB_REQUIRE_CONTEXT();
+    for (i = 0; i < N; i++)
+        p[i] = ui;
+    return CUDA_SUCCESS;
+}
+
+/************************************
+ **
+ **    Arrays
+ **
+ ***********************************/
+
+STUB_EXPORT CUresult CUDAAPI cuArrayCreate_v2(CUarray *pHandle, const CUDA_ARRAY_DESCRIPTOR *pAllocateArray)
+{
+    STUB_REQUIRE_CONTEXT();
+    if (pHandle == NULL || pAllocateArray == NULL || pAllocateArray->Width == 0 ||
+        pAllocateArray->NumChannels == 0)
+        return CUDA_ERROR_INVALID_VALUE;
+    *pHandle = array_new(pAllocateArray);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuArrayGetDescriptor_v2(CUDA_ARRAY_DESCRIPTOR *pArrayDescriptor, CUarray hArray)
+{
+    if (pArrayDescriptor == NULL || hArray == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *pArrayDescriptor = hArray->desc;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuArrayDestroy(CUarray hArray)
+{
+    if (hArray == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    array_free(hArray);
+    return CUDA_SUCCESS;
+}
+
+/************************************
+ **
+ **    Streams and events
+ **
+ ***********************************/
+
+STUB_EXPORT CUresult CUDAAPI cuStreamCreate(CUstream *phStream, unsigned int Flags)
+{
+    STUB_REQUIRE_CONTEXT();
+    if (phStream == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *phStream = (CUstream)calloc(1, sizeof(**phStream));
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuStreamDestroy_v2(CUstream hStream)
+{
+    if (hStream == NULL)
+        return CUDA_ERROR_INVALID_HANDLE;
+    // pending work still completes on the emulated device
+    free(hStream);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuStreamQuery(CUstream hStream)
+{
+    return now_ns() >= stream_ready_at(hStream) ? CUDA_SUCCESS : CUDA_ERROR_NOT_READY;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuStreamSynchronize(CUstream hStream)
+{
+    sleep_until(stream_ready_at(hStream));
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuStreamWaitEvent(CUstream hStream, CUevent hEvent, unsigned int Flags)
+{
+    struct CUstream_st *s = stream_of(hStream);
+
+    if (hEvent == NULL)
+        return CUDA_ERROR_INVALID_HANDLE;
+    pthread_mutex_lock(&g_lock);
+    if (hEvent->recorded && hEvent->time > s->ready_at)
+        s->ready_at = hEvent->time;
+    pthread_mutex_unlock(&g_lock);
+    return CUDA_SUCCESS;
+}
+
+// Runs the callback on the calling thread once the stream drained, which
+// keeps ordering without a driver thread.
+STUB_EXPORT CUresult CUDAAPI cuStreamAddCallback(CUstream hStream, CUstreamCallback callback,
+                                                 void *userData, unsigned int flags)
+{
+    if (callback == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    sleep_until(stream_ready_at(hStream));
+    callback(hStream, CUDA_SUCCESS, userData);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuEventCreate(CUevent *phEvent, unsigned int Flags)
+{
+    STUB_REQUIRE_CONTEXT();
+    if (phEvent == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *phEvent = (CUevent)calloc(1, sizeof(**phEvent));
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuEventDestroy_v2(CUevent hEvent)
+{
+    if (hEvent == NULL)
+        return CUDA_ERROR_INVALID_HANDLE;
+    free(hEvent);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuEventRecord(CUevent hEvent, CUstream hStream)
+{
+    uint64_t ready_at, now = now_ns();
+
+    if (hEvent == NULL)
+        return CUDA_ERROR_INVALID_HANDLE;
+    ready_at = stream_ready_at(hStream);
+    hEvent->time = ready_at > now ? ready_at : now;
+    hEvent->recorded = 1;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuEventQuery(CUevent hEvent)
+{
+    if (hEvent == NULL)
+        return CUDA_ERROR_INVALID_HANDLE;
+    return now_ns() >= hEvent->time ? CUDA_SUCCESS : CUDA_ERROR_NOT_READY;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuEventSynchronize(CUevent hEvent)
+{
+    if (hEvent == NULL)
+        return CUDA_ERROR_INVALID_HANDLE;
+    sleep_until(hEvent->time);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuEventElapsedTime(float *pMilliseconds, CUevent hStart, CUevent hEnd)
+{
+    if (pMilliseconds == NULL || hStart == NULL || hEnd == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (!hStart->recorded || !hEnd->recorded)
+        return CUDA_ERROR_INVALID_HANDLE;
+    *pMilliseconds = (float)((double)((int64_t)(hEnd->time - hStart->time)) / 1e6);
+    return CUDA_SUCCESS;
+}
+
+/************************************
+ **
+ **    IPC
+ **
+ ***********************************/
+
+STUB_EXPORT CUresult CUDAAPI cuIpcGetMemHandle(CUipcMemHandle *pHandle, CUdeviceptr dptr)
+{
+    IpcPayload payload;
+    struct StubAlloc a;
+
+    STUB_REQUIRE_CONTEXT();
+    if (pHandle == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (!alloc_find(DPTR(dptr), &a) || a.kind != STUB_ALLOC_DEVICE || a.base != DPTR(dptr))
+        return CUDA_ERROR_INVALID_VALUE;
+
+    memset(pHandle, 0, sizeof(*pHandle));
+    payload.magic = STUB_IPC_MAGIC;
+    payload.pid = (int32_t)getpid();
+    payload.fd = a.fd;
+    payload.size = a.size;
+    memcpy(pHandle->reserved, &payload, sizeof(payload));
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuIpcOpenMemHandle(CUdeviceptr *pdptr, CUipcMemHandle handle, unsigned int Flags)
+{
+    IpcPayload payload;
+    char path[64];
+    void *base;
+    int fd;
+
+    STUB_REQUIRE_CONTEXT();
+    if (pdptr == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    memcpy(&payload, handle.reserved, sizeof(payload));
+    if (payload.magic != STUB_IPC_MAGIC || payload.size == 0)
+        return CUDA_ERROR_INVALID_HANDLE;
+    // the real driver refuses handles from the same process as well
+    if (payload.pid == (int32_t)getpid())
+        return CUDA_ERROR_INVALID_CONTEXT;
+
+    snprintf(path, sizeof(path), "/proc/%d/fd/%d", payload.pid, payload.fd);
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return CUDA_ERROR_INVALID_HANDLE;
+    base = mmap(NULL, payload.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return CUDA_ERROR_OUT_OF_MEMORY;
+    alloc_register(STUB_ALLOC_IPC, base, payload.size, -1);
+    *pdptr = (CUdeviceptr)(uintptr_t)base;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuIpcCloseMemHandle(CUdeviceptr dptr)
+{
+    struct StubAlloc *a = alloc_take(DPTR(dptr));
+
+    if (a == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (a->kind != STUB_ALLOC_IPC)
+    {
+        // not ours to close, put it back
+        alloc_register(a->kind, a->base, a->size, a->fd);
+        free(a);
+        return CUDA_ERROR_INVALID_VALUE;
+    }
+    alloc_release(a);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuIpcGetEventHandle(CUipcEventHandle *pHandle, CUevent event)
+{
+    return CUDA_STUB_ERROR_NOT_SUPPORTED;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuIpcOpenEventHandle(CUevent *phEvent, CUipcEventHandle handle)
+{
+    return CUDA_STUB_ERROR_NOT_SUPPORTED;
+}
+
+/************************************
+ **
+ **    Graphics interop
+ **
+ ***********************************/
+
+// BGRA image of the configured size; the first 8 bytes carry the map count
+// so a consumer can tell frames apart.
+static CUgraphicsResource resource_new(enum StubResourceKind kind)
+{
+    CUgraphicsResource resource = (CUgraphicsResource)calloc(1, sizeof(*resource));
+    CUDA_ARRAY_DESCRIPTOR desc;
+    size_t x, y;
+
+    desc.Width = g_graphics_width;
+    desc.Height = g_graphics_height;
+    desc.Format = CU_AD_FORMAT_UNSIGNED_INT8;
+    desc.NumChannels = 4;
+    resource->kind = kind;
+    resource->array = array_new(&desc);
+    for (y = 0; y < desc.Height; y++)
+        for (x = 0; x < resource->array->pitch; x++)
+            resource->array->data[y * resource->array->pitch + x] = (unsigned char)(x ^ y);
+    return resource;
+}
+
+static void resource_stamp(CUgraphicsResource resource)
+{
+    resource->map_count++;
+    memcpy(resource->array->data, &resource->map_count, sizeof(resource->map_count));
+}
+
+STUB_EXPORT CUresult CUDAAPI cuGraphicsGLRegisterImage(CUgraphicsResource *pCudaResource, GLuint image,
+                                                       GLenum target, unsigned int Flags)
+{
+    STUB_REQUIRE_CONTEXT();
+    if (pCudaResource == NULL || image == 0)
+        return CUDA_ERROR_INVALID_VALUE;
+    *pCudaResource = resource_new(STUB_RESOURCE_GL_IMAGE);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuGraphicsGLRegisterBuffer(CUgraphicsResource *pCudaResource, GLuint buffer,
+                                                        unsigned int Flags)
+{
+    return CUDA_STUB_ERROR_NOT_SUPPORTED;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuGLCtxCreate_v2(CUcontext *pCtx, unsigned int Flags, CUdevice device)
+{
+    return cuCtxCreate_v2(pCtx, Flags, device);
+}
+
+STUB_EXPORT CUresult CUDAAPI cuGLGetDevices_v2(unsigned int *pCudaDeviceCount, CUdevice *pCudaDevices,
+                                               unsigned int cudaDeviceCount, CUGLDeviceList deviceList)
+{
+    STUB_REQUIRE_INIT();
+    if (pCudaDeviceCount == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *pCudaDeviceCount = 1;
+    if (pCudaDevices && cudaDeviceCount)
+        pCudaDevices[0] = g_gl_device;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuGraphicsEGLRegisterImage(CUgraphicsResource *pCudaResource, EGLImageKHR image,
+                                                        unsigned int flags)
+{
+    STUB_REQUIRE_CONTEXT();
+    if (pCudaResource == NULL || image == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *pCudaResource = resource_new(STUB_RESOURCE_EGL_IMAGE);
+    // EGL registrations are mapped for as long as they exist
+    (*pCudaResource)->mapped = 1;
+    resource_stamp(*pCudaResource);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuGraphicsResourceGetMappedEglFrame(CUeglFrame *eglFrame, CUgraphicsResource resource,
+                                                                 unsigned int index, unsigned int mipLevel)
+{
+    if (eglFrame == NULL || resource == NULL || index || mipLevel)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (resource->kind != STUB_RESOURCE_EGL_IMAGE)
+        return CUDA_ERROR_INVALID_HANDLE;
+    memset(eglFrame, 0, sizeof(*eglFrame));
+    eglFrame->frame.pArray[0] = resource->array;
+    eglFrame->width = (unsigned int)resource->array->desc.Width;
+    eglFrame->height = (unsigned int)resource->array->desc.Height;
+    eglFrame->depth = 1;
+    eglFrame->pitch = (unsigned int)resource->array->pitch;
+    eglFrame->planeCount = 1;
+    eglFrame->numChannels = 4;
+    eglFrame->frameType = CU_EGL_FRAME_TYPE_ARRAY;
+    eglFrame->eglColorFormat = CU_EGL_COLOR_FORMAT_BGRA;
+    eglFrame->cuFormat = CU_AD_FORMAT_UNSIGNED_INT8;
+    return CUDA_SUCCESS;
+}
+
+// There is no GPU behind the fence, so it counts as signaled already
+STUB_EXPORT CUresult CUDAAPI cuEventCreateFromEGLSync(CUevent *phEvent, EGLSyncKHR eglSync, unsigned int flags)
+{
+    STUB_REQUIRE_CONTEXT();
+    if (phEvent == NULL || eglSync == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    *phEvent = (CUevent)calloc(1, sizeof(**phEvent));
+    (*phEvent)->time = now_ns();
+    (*phEvent)->recorded = 1;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuGraphicsUnregisterResource(CUgraphicsResource resource)
+{
+    if (resource == NULL)
+        return CUDA_ERROR_INVALID_HANDLE;
+    array_free(resource->array);
+    free(resource);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuGraphicsMapResources(unsigned int count, CUgraphicsResource *resources,
+                                                    CUstream hStream)
+{
+    unsigned int i;
+
+    STUB_REQUIRE_CONTEXT();
+    if (resources == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    for (i = 0; i < count; i++)
+    {
+        if (resources[i] == NULL)
+            return CUDA_ERROR_INVALID_HANDLE;
+        if (resources[i]->mapped)
+            return CUDA_ERROR_ALREADY_MAPPED;
+    }
+    for (i = 0; i < count; i++)
+    {
+        resources[i]->mapped = 1;
+        resource_stamp(resources[i]);
+    }
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuGraphicsUnmapResources(unsigned int count, CUgraphicsResource *resources,
+                                                      CUstream hStream)
+{
+    unsigned int i;
+
+    STUB_REQUIRE_CONTEXT();
+    if (resources == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    for (i = 0; i < count; i++)
+    {
+        if (resources[i] == NULL)
+            return CUDA_ERROR_INVALID_HANDLE;
+        if (!resources[i]->mapped)
+            return CUDA_ERROR_NOT_MAPPED;
+    }
+    for (i = 0; i < count; i++)
+        resources[i]->mapped = 0;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuGraphicsSubResourceGetMappedArray(CUarray *pArray, CUgraphicsResource resource,
+                                                                 unsigned int arrayIndex, unsigned int mipLevel)
+{
+    if (pArray == NULL || resource == NULL || arrayIndex || mipLevel)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (!resource->mapped)
+        return CUDA_ERROR_NOT_MAPPED;
+    *pArray = resource->array;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuGraphicsResourceGetMappedPointer_v2(CUdeviceptr *pDevPtr, size_t *pSize,
+                                                                   CUgraphicsResource resource)
+{
+    return CUDA_ERROR_NOT_MAPPED_AS_POINTER;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuGraphicsResourceSetMapFlags(CUgraphicsResource resource, unsigned int flags)
+{
+    if (resource == NULL)
+        return CUDA_ERROR_INVALID_HANDLE;
+    return resource->mapped ? CUDA_ERROR_ALREADY_MAPPED : CUDA_SUCCESS;
+}
+
+/************************************
+ **
+ **    External memory and semaphores
+ **
+ ***********************************/
+
+STUB_EXPORT CUresult CUDAAPI cuImportExternalMemory(CUexternalMemory *extMem_out,
+                                                    const CUDA_EXTERNAL_MEMORY_HANDLE_DESC *memHandleDesc)
+{
+    CUexternalMemory mem;
+    void *base;
+
+    STUB_REQUIRE_CONTEXT();
+    if (extMem_out == NULL || memHandleDesc == NULL || memHandleDesc->size == 0)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (memHandleDesc->type != CU_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD)
+        return CUDA_STUB_ERROR_NOT_SUPPORTED;
+
+    base = mmap(NULL, memHandleDesc->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                memHandleDesc->handle.fd, 0);
+    if (base == MAP_FAILED)
+        base = mmap(NULL, memHandleDesc->size, PROT_READ, MAP_SHARED,
+                    memHandleDesc->handle.fd, 0);
+    if (base == MAP_FAILED)
+        return CUDA_ERROR_INVALID_HANDLE;
+
+    // ownership of the fd moves to the driver on success
+    close(memHandleDesc->handle.fd);
+
+    mem = (CUexternalMemory)calloc(1, sizeof(*mem));
+    mem->base = base;
+    mem->size = memHandleDesc->size;
+    *extMem_out = mem;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuExternalMemoryGetMappedBuffer(CUdeviceptr *devPtr, CUexternalMemory extMem,
+                                                             const CUDA_EXTERNAL_MEMORY_BUFFER_DESC *bufferDesc)
+{
+    unsigned char *ptr;
+
+    if (devPtr == NULL || extMem == NULL || bufferDesc == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (bufferDesc->offset + bufferDesc->size > extMem->size || bufferDesc->size == 0)
+        return CUDA_ERROR_INVALID_VALUE;
+    ptr = (unsigned char *)extMem->base + bufferDesc->offset;
+    // freed with cuMemFree like a real mapping; the pages go with the import
+    alloc_register(STUB_ALLOC_EXTERNAL, ptr, bufferDesc->size, -1);
+    *devPtr = (CUdeviceptr)(uintptr_t)ptr;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuExternalMemoryGetMappedMipmappedArray(CUmipmappedArray *mipmap, CUexternalMemory extMem,
+                                                                     const CUDA_EXTERNAL_MEMORY_MIPMAPPED_ARRAY_DESC *mipmapDesc)
+{
+    return CUDA_STUB_ERROR_NOT_SUPPORTED;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDestroyExternalMemory(CUexternalMemory extMem)
+{
+    if (extMem == NULL)
+        return CUDA_ERROR_INVALID_HANDLE;
+    munmap(extMem->base, extMem->size);
+    free(extMem);
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuImportExternalSemaphore(CUexternalSemaphore *extSem_out,
+                                                       const CUDA_EXTERNAL_SEMAPHORE_HANDLE_DESC *semHandleDesc)
+{
+    STUB_REQUIRE_CONTEXT();
+    if (extSem_out == NULL || semHandleDesc == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (semHandleDesc->type != CU_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD)
+        return CUDA_STUB_ERROR_NOT_SUPPORTED;
+    *extSem_out = (CUexternalSemaphore)calloc(1, sizeof(**extSem_out));
+    (*extSem_out)->fd = semHandleDesc->handle.fd;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuSignalExternalSemaphoresAsync(const CUexternalSemaphore *extSemArray,
+                                                             const CUDA_EXTERNAL_SEMAPHORE_SIGNAL_PARAMS *paramsArray,
+                                                             unsigned int numExtSems, CUstream stream)
+{
+    unsigned int i;
+
+    if (extSemArray == NULL || paramsArray == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    for (i = 0; i < numExtSems; i++)
+        extSemArray[i]->value = paramsArray[i].params.fence.value;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuWaitExternalSemaphoresAsync(const CUexternalSemaphore *extSemArray,
+                                                           const CUDA_EXTERNAL_SEMAPHORE_WAIT_PARAMS *paramsArray,
+                                                           unsigned int numExtSems, CUstream stream)
+{
+    if (extSemArray == NULL || paramsArray == NULL)
+        return CUDA_ERROR_INVALID_VALUE;
+    return CUDA_SUCCESS;
+}
+
+STUB_EXPORT CUresult CUDAAPI cuDestroyExternalSemaphore(CUexternalSemaphore extSem)
+{
+    if (extSem == NULL)
+        return CUDA_ERROR_INVALID_HANDLE;
+    if (extSem->fd >= 0)
+        close(extSem->fd);
+    free(extSem);
+    return CUDA_SUCCESS;
+}
+
+/************************************
+ **
+ **    Not emulated
+ **
+ ** Present so the core and legacy symbol groups resolve; every call reports
+ ** CUDA_ERROR_NOT_SUPPORTED. The empty parameter list accepts whatever the
+ ** caller passes.
+ **
+ ***********************************/
+
+#define STUB_NOT_SUPPORTED(name) \
+    STUB_EXPORT CUresult CUDAAPI name() { return CUDA_STUB_ERROR_NOT_SUPPORTED; }
+
+STUB_NOT_SUPPORTED(cuCtxSetLimit)
+STUB_NOT_SUPPORTED(cuCtxGetLimit)
+STUB_NOT_SUPPORTED(cuCtxGetCacheConfig)
+STUB_NOT_SUPPORTED(cuCtxSetCacheConfig)
+STUB_NOT_SUPPORTED(cuCtxGetSharedMemConfig)
+STUB_NOT_SUPPORTED(cuCtxSetSharedMemConfig)
+STUB_NOT_SUPPORTED(cuModuleLoad)
+STUB_NOT_SUPPORTED(cuModuleLoadData)
+STUB_NOT_SUPPORTED(cuModuleLoadDataEx)
+STUB_NOT_SUPPORTED(cuModuleLoadFatBinary)
+STUB_NOT_SUPPORTED(cuModuleUnload)
+STUB_NOT_SUPPORTED(cuModuleGetFunction)
+STUB_NOT_SUPPORTED(cuModuleGetGlobal_v2)
+STUB_NOT_SUPPORTED(cuFuncGetAttribute)
+STUB_NOT_SUPPORTED(cuFuncSetCacheConfig)
+STUB_NOT_SUPPORTED(cuFuncSetSharedMemConfig)
+STUB_NOT_SUPPORTED(cuLaunchKernel)
+STUB_NOT_SUPPORTED(cuMipmappedArrayCreate)
+STUB_NOT_SUPPORTED(cuMipmappedArrayDestroy)
+STUB_NOT_SUPPORTED(cuMipmappedArrayGetLevel)
+STUB_NOT_SUPPORTED(cuArray3DCreate_v2)
+STUB_NOT_SUPPORTED(cuArray3DGetDescriptor_v2)
+STUB_NOT_SUPPORTED(cuMemcpyDtoA_v2)
+STUB_NOT_SUPPORTED(cuMemcpyAtoD_v2)
+STUB_NOT_SUPPORTED(cuMemcpyHtoA_v2)
+STUB_NOT_SUPPORTED(cuMemcpyAtoH_v2)
+STUB_NOT_SUPPORTED(cuMemcpyAtoA_v2)
+STUB_NOT_SUPPORTED(cuMemcpyHtoAAsync_v2)
+STUB_NOT_SUPPORTED(cuMemcpyAtoHAsync_v2)
+STUB_NOT_SUPPORTED(cuMemcpy3D_v2)
+STUB_NOT_SUPPORTED(cuMemcpy3DAsync_v2)
+STUB_NOT_SUPPORTED(cuMemsetD16_v2)
+STUB_NOT_SUPPORTED(cuMemsetD2D8_v2)
+STUB_NOT_SUPPORTED(cuMemsetD2D16_v2)
+STUB_NOT_SUPPORTED(cuMemsetD2D32_v2)
+STUB_NOT_SUPPORTED(cuGetExportTable)
+STUB_NOT_SUPPORTED(cuProfilerStop)
+STUB_NOT_SUPPORTED(cuGetErrorString)
+
+/* the legacy group */
+STUB_NOT_SUPPORTED(cuCtxAttach)
+STUB_NOT_SUPPORTED(cuCtxDetach)
+STUB_NOT_SUPPORTED(cuModuleGetTexRef)
+STUB_NOT_SUPPORTED(cuModuleGetSurfRef)
+STUB_NOT_SUPPORTED(cuFuncSetBlockShape)
+STUB_NOT_SUPPORTED(cuFuncSetSharedSize)
+STUB_NOT_SUPPORTED(cuTexRefCreate)
+STUB_NOT_SUPPORTED(cuTexRefDestroy)
+STUB_NOT_SUPPORTED(cuTexRefSetArray)
+STUB_NOT_SUPPORTED(cuTexRefSetAddress_v2)
+STUB_NOT_SUPPORTED(cuTexRefSetAddress2D_v3)
+STUB_NOT_SUPPORTED(cuTexRefSetFormat)
+STUB_NOT_SUPPORTED(cuTexRefSetAddressMode)
+STUB_NOT_SUPPORTED(cuTexRefSetFilterMode)
+STUB_NOT_SUPPORTED(cuTexRefSetFlags)
+STUB_NOT_SUPPORTED(cuTexRefGetAddress_v2)
+STUB_NOT_SUPPORTED(cuTexRefGetArray)
+STUB_NOT_SUPPORTED(cuTexRefGetAddressMode)
+STUB_NOT_SUPPORTED(cuTexRefGetFilterMode)
+STUB_NOT_SUPPORTED(cuTexRefGetFormat)
+STUB_NOT_SUPPORTED(cuTexRefGetFlags)
+STUB_NOT_SUPPORTED(cuSurfRefSetArray)
+STUB_NOT_SUPPORTED(cuSurfRefGetArray)
+STUB_NOT_SUPPORTED(cuParamSetSize)
+STUB_NOT_SUPPORTED(cuParamSeti)
+STUB_NOT_SUPPORTED(cuParamSetf)
+STUB_NOT_SUPPORTED(cuParamSetv)
+STUB_NOT_SUPPORTED(cuParamSetTexRef)
+STUB_NOT_SUPPORTED(cuLaunch)
+STUB_NOT_SUPPORTED(cuLaunchGrid)
+STUB_NOT_SUPPORTED(cuLaunchGridAsync)
@@ -0,0 +1,37 @@
+#include "cuda_stub_driver_test_util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "base/files/file_path.h"
+#include "base/path_service.h"
+
+namespace viz {
+
+CUresult InitCudaStubDriver() {
+  setenv("CUDA_STUB_DEVICE_COUNT", "4", /*overwrite=*/0);
+
+  base::FilePath dir;
+  if (!base::PathService::Get(base::DIR_EXE, &dir))
+    return CUDA_ERROR_FILE_NOT_FOUND;
+  // Fails once the loader ran, which leaves the library it picked in place.
+  cuDrvApiSetSearchPath(dir.Append("libcuda_stub_driver.so").value().c_str());
+  return cuInit_drvapi(0, __CUDA_API_VERSION);
+}
+
+CUresult InitCudaDevice(CUcontext* context) {
+  CUresult result = cuInit_drvapi(0, __CUDA_API_VERSION);
+  if (result != CUDA_SUCCESS)
+    return result;
+  CUdrvapiInfo info = {};
+  cuDrvApiGetInfo(&info);
+  if (!info.libraryPath || strstr(info.libraryPath, "cuda_stub_driver"))
+    return CUDA_ERROR_NO_DEVICE;
+  CUdevice device;
+  result = cuDeviceGet(&device, 0);
+  if (result != CUDA_SUCCESS)
+    return result;
+  return cuCtxCreate(context, 0, device);
+}
+
+}  // namespace viz
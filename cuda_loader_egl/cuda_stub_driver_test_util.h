@@ -0,0 +1,67 @@
+#ifndef __cuda_stub_driver_test_util_h__
+#define __cuda_stub_driver_test_util_h__
+
+#include <sys/wait.h>
+
+#include "cuda_drvapi_dynlink.h"
+
+namespace viz {
+
+// Loads the stub driver that :cuda_stub_driver builds next to the test
+// binary and resolves the core entry points. The stub reads its CUDA_STUB_*
+// variables once; unset, tests get four devices so that device selection
+// has something to choose from.
+//
+// The loader initializes once per process. A test that needs another stub
+// configuration, or a loader that has not resolved anything yet, sets the
+// variables and runs its body in a fresh process with EXPECT_IN_FRESH_PROCESS.
+CUresult InitCudaStubDriver();
+
+// Loads the system's CUDA driver instead and creates a context on its first
+// device. Fails without a GPU, and when CUDA_DRVAPI_LIBRARY points the
+// loader at the stub, which cannot run kernels.
+CUresult InitCudaDevice(CUcontext* context);
+
+// Exit code of a fresh process that found no device to run on.
+constexpr int kNoCudaDeviceExitCode = 77;
+
+}  // namespace viz
+
+// Runs |statement| in a re-executed copy of the test binary and fails the
+// test if any expectation failed there.
+#define EXPECT_IN_FRESH_PROCESS(statement)                               \
+  do {                                                                   \
+    GTEST_FLAG_SET(death_test_style, "threadsafe");                      \
+    EXPECT_EXIT(                                                         \
+        {                                                                \
+          statement;                                                     \
+          exit(::testing::Test::HasFailure() ? 1 : 0);                   \
+        },                                                               \
+        ::testing::ExitedWithCode(0), "");                               \
+  } while (0)
+
+// EXPECT_IN_FRESH_PROCESS on a real GPU: |statement| runs with a context of
+// InitCudaDevice() current, and the test is skipped when there is none.
+#define EXPECT_ON_CUDA_DEVICE(statement)                                 \
+  do {                                                                   \
+    int exit_code = -1;                                                  \
+    GTEST_FLAG_SET(death_test_style, "threadsafe");                      \
+    EXPECT_EXIT(                                                         \
+        {                                                                \
+          CUcontext context = nullptr;                                   \
+          if (::viz::InitCudaDevice(&context) != CUDA_SUCCESS)           \
+            exit(::viz::kNoCudaDeviceExitCode);                          \
+          statement;                                                     \
+          exit(::testing::Test::HasFailure() ? 1 : 0);                   \
+        },                                                               \
+        [&exit_code](int status) {                                       \
+          exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;      \
+          return exit_code == 0 ||                                       \
+                 exit_code == ::viz::kNoCudaDeviceExitCode;              \
+        },                                                               \
+        "");                                                             \
+    if (exit_code == ::viz::kNoCudaDeviceExitCode)                       \
+      GTEST_SKIP() << "needs a CUDA device";                             \
+  } while (0)
+
+#endif  // __cuda_stub_driver_test_util_h__
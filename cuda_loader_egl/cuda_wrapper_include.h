@@ -1,29 +1,35 @@
+#ifndef __cuda_wrapper_include_h__
+#define __cuda_wrapper_include_h__
+
 // includes
 #include "cuda_drvapi_dynlink.h"
 #include "drvapi_error_string.h"
-
-// missing extern function signatures
-extern tcuIpcGetMemHandle *cuIpcGetMemHandle;
-extern tcuIpcOpenMemHandle *cuIpcOpenMemHandle;
-extern tcuIpcCloseMemHandle *cuIpcCloseMemHandle;
-extern tcuGraphicsGLRegisterImage *cuGraphicsGLRegisterImage;
-extern tcuGraphicsEGLRegisterImage *cuGraphicsEGLRegisterImage;
+#include "cuda_error_stats.h"
 
 typedef CUresult CUDAAPI tcuStreamCreate(CUstream *phStream, unsigned int flags);
 typedef CUresult CUDAAPI tcuStreamSynchronize(CUstream hStream);
 typedef CUresult CUDAAPI tcuStreamDestroy_v2(CUstream hStream);
 
 // helpers
-#define checkCudaErrors(err, func_call)  __checkCudaErrors(err, __FILE__, __LINE__, func_call)
+//
+// Every expansion owns a viz::CudaErrorSite; failures are counted there and
+// logged rate limited, see cuda_error_stats.h. Evaluates to 0 on success and
+// -1 on error.
+#define checkCudaErrors(err, func_call)                                   \
+    ([&]() -> int {                                                       \
+        static viz::CudaErrorSite __site(__FILE__, __LINE__, func_call);  \
+        return __checkCudaErrors((err), &__site);                         \
+    }())
 #define CHECK_CU(x) checkCudaErrors((x), #x)
 
-inline static int __checkCudaErrors(CUresult err, const char *file, const int line, const char *func_call)
+inline static int __checkCudaErrors(CUresult err, viz::CudaErrorSite *site)
 {
     if (CUDA_SUCCESS != err)
     {
-        fprintf(stderr, "checkCudaErrors() Driver API error = %04d \"%s\" from file <%s>, line %i (%s).\n",
-                err, getCudaDrvErrorString(err), file, line, func_call);
+        viz::ReportCudaError(err, site);
         return -1;
     }
     return 0;
 }
+
+#endif // __cuda_wrapper_include_h__
@@ -18,321 +18,201 @@
 
 #ifdef  __cuda_cuda_h__ // check to see if CUDA_H is included above
 
-// Error Code string definitions here
-typedef struct
-{
-    char const *error_string;
-    int  error_id;
-} s_CudaErrorStr;
-
-/**
- * Error codes
- */
-static s_CudaErrorStr sCudaDrvErrorString[] =
-{
-    /**
-     * The API call returned with no errors. In the case of query calls, this
-     * can also mean that the operation being queried is complete (see
-     * ::cuEventQuery() and ::cuStreamQuery()).
-     */
-    { "CUDA_SUCCESS", 0 },
-
-    /**
-     * This indicates that one or more of the parameters passed to the API call
-     * is not within an acceptable range of values.
-     */
-    { "CUDA_ERROR_INVALID_VALUE", 1 },
-
-    /**
-     * The API call failed because it was unable to allocate enough memory to
-     * perform the requested operation.
-     */
-    { "CUDA_ERROR_OUT_OF_MEMORY", 2 },
-
-    /**
-     * This indicates that the CUDA driver has not been initialized with
-     * ::cuInit() or that initialization has failed.
-     */
-    { "CUDA_ERROR_NOT_INITIALIZED", 3 },
-
-    /**
-     * This indicates that the CUDA driver is in the process of shutting down.
-     */
-    { "CUDA_ERROR_DEINITIALIZED", 4 },
-
-    /**
-     * This indicates profiling APIs are called while application is running
-     * in visual profiler mode.
-    */
-    { "CUDA_ERROR_PROFILER_DISABLED", 5 },
-    /**
-     * This indicates profiling has not been initialized for this context.
-     * Call cuProfilerInitialize() to resolve this.
-    */
-    { "CUDA_ERROR_PROFILER_NOT_INITIALIZED", 6 },
-    /**
-     * This indicates profiler has already been started and probably
-     * cuProfilerStart() is incorrectly called.
-    */
-    { "CUDA_ERROR_PROFILER_ALREADY_STARTED", 7 },
-    /**
-     * This indicates profiler has already been stopped and probably
-     * cuProfilerStop() is incorrectly called.
-    */
-    { "CUDA_ERROR_PROFILER_ALREADY_STOPPED", 8 },
-    /**
-     * This indicates that no CUDA-capable devices were detected by the installed
-     * CUDA driver.
-     */
-    { "CUDA_ERROR_NO_DEVICE (no CUDA-capable devices were detected)", 100 },
-
-    /**
-     * This indicates that the device ordinal supplied by the user does not
-     * correspond to a valid CUDA device.
-     */
-    { "CUDA_ERROR_INVALID_DEVICE (device specified is not a valid CUDA device)", 101 },
-
-
-    /**
-     * This indicates that the device kernel image is invalid. This can also
-     * indicate an invalid CUDA module.
-     */
-    { "CUDA_ERROR_INVALID_IMAGE", 200 },
-
-    /**
-     * This most frequently indicates that there is no context bound to the
-     * current thread. This can also be returned if the context passed to an
-     * API call is not a valid handle (such as a context that has had
-     * ::cuCtxDestroy() invoked on it). This can also be returned if a user
-     * mixes different API versions (i.e. 3010 context with 3020 API calls).
-     * See ::cuCtxGetApiVersion() for more details.
-     */
-    { "CUDA_ERROR_INVALID_CONTEXT", 201 },
-
-    /**
-     * This indicated that the context being supplied as a parameter to the
-     * API call was already the active context.
-     * \deprecated
-     * This error return is deprecated as of CUDA 3.2. It is no longer an
-     * error to attempt to push the active context via ::cuCtxPushCurrent().
-     */
-    { "CUDA_ERROR_CONTEXT_ALREADY_CURRENT", 202 },
-
-    /**
-     * This indicates that a map or register operation has failed.
-     */
-    { "CUDA_ERROR_MAP_FAILED", 205 },
-
-    /**
-     * This indicates that an unmap or unregister operation has failed.
-     */
-    { "CUDA_ERROR_UNMAP_FAILED", 206 },
-
-    /**
-     * This indicates that the specified array is currently mapped and thus
-     * cannot be destroyed.
-     */
-    { "CUDA_ERROR_ARRAY_IS_MAPPED", 207 },
-
-    /**
-     * This indicates that the resource is already mapped.
-     */
-    { "CUDA_ERROR_ALREADY_MAPPED", 208 },
-
-    /**
-     * This indicates that there is no kernel image available that is suitable
-     * for the device. This can occur when a user specifies code generation
-     * options for a particular CUDA source file that do not include the
-     * corresponding device configuration.
-     */
-    { "CUDA_ERROR_NO_BINARY_FOR_GPU", 209 },
-
-    /**
-     * This indicates that a resource has already been acquired.
-     */
-    { "CUDA_ERROR_ALREADY_ACQUIRED", 210 },
-
-    /**
-     * This indicates that a resource is not mapped.
-     */
-    { "CUDA_ERROR_NOT_MAPPED", 211 },
-
-    /**
-     * This indicates that a mapped resource is not available for access as an
-     * array.
-     */
-    { "CUDA_ERROR_NOT_MAPPED_AS_ARRAY", 212 },
-
-    /**
-     * This indicates that a mapped resource is not available for access as a
-     * pointer.
-     */
-    { "CUDA_ERROR_NOT_MAPPED_AS_POINTER", 213 },
-
-    /**
-     * This indicates that an uncorrectable ECC error was detected during
-     * execution.
-     */
-    { "CUDA_ERROR_ECC_UNCORRECTABLE", 214 },
-
-    /**
-     * This indicates that the ::CUlimit passed to the API call is not
-     * supported by the active device.
-     */
-    { "CUDA_ERROR_UNSUPPORTED_LIMIT", 215 },
-
-    /**
-     * This indicates that the ::CUcontext passed to the API call can
-     * only be bound to a single CPU thread at a time but is already
-     * bound to a CPU thread.
-     */
-    { "CUDA_ERROR_CONTEXT_ALREADY_IN_USE", 216 },
-
-    /**
-     * This indicates that the device kernel source is invalid.
-     */
-    { "CUDA_ERROR_INVALID_SOURCE", 300 },
-
-    /**
-     * This indicates that the file specified was not found.
-     */
-    { "CUDA_ERROR_FILE_NOT_FOUND", 301 },
-
-    /**
-     * This indicates that a link to a shared object failed to resolve.
-     */
-    { "CUDA_ERROR_SHARED_OBJECT_SYMBOL_NOT_FOUND", 302 },
+// Error names, indexed by value. Codes come in bands of one hundred
+// (0 generic, 100 device, 200 context/image, ... 900 stream capture), each
+// band is a dense array from its base upwards, so a lookup is a division and
+// an index instead of a scan. Names follow current drivers, which report
+// codes the 7.0 era enum in cuda_drvapi_dynlink_cuda.h does not know about
+// (and call 700 CUDA_ERROR_ILLEGAL_ADDRESS rather than LAUNCH_FAILED).
 
-    /**
-     * This indicates that initialization of a shared object failed.
-     */
-    { "CUDA_ERROR_SHARED_OBJECT_INIT_FAILED", 303 },
-
-    /**
-     * This indicates that an OS call failed.
-     */
-    { "CUDA_ERROR_OPERATING_SYSTEM", 304 },
-
-
-    /**
-     * This indicates that a resource handle passed to the API call was not
-     * valid. Resource handles are opaque types like ::CUstream and ::CUevent.
-     */
-    { "CUDA_ERROR_INVALID_HANDLE", 400 },
-
-
-    /**
-     * This indicates that a named symbol was not found. Examples of symbols
-     * are global/constant variable names, texture names }, and surface names.
-     */
-    { "CUDA_ERROR_NOT_FOUND", 500 },
+#define CU_DRV_ERROR_GAP5 NULL, NULL, NULL, NULL, NULL
+#define CU_DRV_ERROR_GAP10 CU_DRV_ERROR_GAP5, CU_DRV_ERROR_GAP5
 
+static const char *const sCudaDrvErrorBand0[] =
+{
+    "CUDA_SUCCESS",                                   /* 0 */
+    "CUDA_ERROR_INVALID_VALUE",
+    "CUDA_ERROR_OUT_OF_MEMORY",
+    "CUDA_ERROR_NOT_INITIALIZED",
+    "CUDA_ERROR_DEINITIALIZED",
+    "CUDA_ERROR_PROFILER_DISABLED",                   /* 5 */
+    "CUDA_ERROR_PROFILER_NOT_INITIALIZED",
+    "CUDA_ERROR_PROFILER_ALREADY_STARTED",
+    "CUDA_ERROR_PROFILER_ALREADY_STOPPED",
+    NULL,
+    CU_DRV_ERROR_GAP10,                               /* 10 */
+    CU_DRV_ERROR_GAP10,                               /* 20 */
+    NULL, NULL, NULL, NULL,                           /* 30 */
+    "CUDA_ERROR_STUB_LIBRARY",                        /* 34 */
+    CU_DRV_ERROR_GAP10,
+    NULL,
+    "CUDA_ERROR_DEVICE_UNAVAILABLE",                  /* 46 */
+};
 
-    /**
-     * This indicates that asynchronous operations issued previously have not
-     * completed yet. This result is not actually an error, but must be indicated
-     * differently than ::CUDA_SUCCESS (which indicates completion). Calls that
-     * may return this value include ::cuEventQuery() and ::cuStreamQuery().
-     */
-    { "CUDA_ERROR_NOT_READY", 600 },
+static const char *const sCudaDrvErrorBand1[] =
+{
+    "CUDA_ERROR_NO_DEVICE",                           /* 100 */
+    "CUDA_ERROR_INVALID_DEVICE",
+    "CUDA_ERROR_DEVICE_NOT_LICENSED",
+};
 
+static const char *const sCudaDrvErrorBand2[] =
+{
+    "CUDA_ERROR_INVALID_IMAGE",                       /* 200 */
+    "CUDA_ERROR_INVALID_CONTEXT",
+    "CUDA_ERROR_CONTEXT_ALREADY_CURRENT",
+    NULL,
+    NULL,
+    "CUDA_ERROR_MAP_FAILED",                          /* 205 */
+    "CUDA_ERROR_UNMAP_FAILED",
+    "CUDA_ERROR_ARRAY_IS_MAPPED",
+    "CUDA_ERROR_ALREADY_MAPPED",
+    "CUDA_ERROR_NO_BINARY_FOR_GPU",
+    "CUDA_ERROR_ALREADY_ACQUIRED",                    /* 210 */
+    "CUDA_ERROR_NOT_MAPPED",
+    "CUDA_ERROR_NOT_MAPPED_AS_ARRAY",
+    "CUDA_ERROR_NOT_MAPPED_AS_POINTER",
+    "CUDA_ERROR_ECC_UNCORRECTABLE",
+    "CUDA_ERROR_UNSUPPORTED_LIMIT",                   /* 215 */
+    "CUDA_ERROR_CONTEXT_ALREADY_IN_USE",
+    "CUDA_ERROR_PEER_ACCESS_UNSUPPORTED",
+    "CUDA_ERROR_INVALID_PTX",
+    "CUDA_ERROR_INVALID_GRAPHICS_CONTEXT",
+    "CUDA_ERROR_NVLINK_UNCORRECTABLE",                /* 220 */
+    "CUDA_ERROR_JIT_COMPILER_NOT_FOUND",
+    "CUDA_ERROR_UNSUPPORTED_PTX_VERSION",
+    "CUDA_ERROR_JIT_COMPILATION_DISABLED",
+    "CUDA_ERROR_UNSUPPORTED_EXEC_AFFINITY",
+    "CUDA_ERROR_UNSUPPORTED_DEVSIDE_SYNC",            /* 225 */
+};
 
-    /**
-     * An exception occurred on the device while executing a kernel. Common
-     * causes include dereferencing an invalid device pointer and accessing
-     * out of bounds shared memory. The context cannot be used }, so it must
-     * be destroyed (and a new one should be created). All existing device
-     * memory allocations from this context are invalid and must be
-     * reconstructed if the program is to continue using CUDA.
-     */
-    { "CUDA_ERROR_LAUNCH_FAILED", 700 },
+static const char *const sCudaDrvErrorBand3[] =
+{
+    "CUDA_ERROR_INVALID_SOURCE",                      /* 300 */
+    "CUDA_ERROR_FILE_NOT_FOUND",
+    "CUDA_ERROR_SHARED_OBJECT_SYMBOL_NOT_FOUND",
+    "CUDA_ERROR_SHARED_OBJECT_INIT_FAILED",
+    "CUDA_ERROR_OPERATING_SYSTEM",
+};
 
-    /**
-     * This indicates that a launch did not occur because it did not have
-     * appropriate resources. This error usually indicates that the user has
-     * attempted to pass too many arguments to the device kernel, or the
-     * kernel launch specifies too many threads for the kernel's register
-     * count. Passing arguments of the wrong size (i.e. a 64-bit pointer
-     * when a 32-bit int is expected) is equivalent to passing too many
-     * arguments and can also result in this error.
-     */
-    { "CUDA_ERROR_LAUNCH_OUT_OF_RESOURCES", 701 },
+static const char *const sCudaDrvErrorBand4[] =
+{
+    "CUDA_ERROR_INVALID_HANDLE",                      /* 400 */
+    "CUDA_ERROR_ILLEGAL_STATE",
+    "CUDA_ERROR_LOSSY_QUERY",
+};
 
-    /**
-     * This indicates that the device kernel took too long to execute. This can
-     * only occur if timeouts are enabled - see the device attribute
-     * ::CU_DEVICE_ATTRIBUTE_KERNEL_EXEC_TIMEOUT for more information. The
-     * context cannot be used (and must be destroyed similar to
-     * ::CUDA_ERROR_LAUNCH_FAILED). All existing device memory allocations from
-     * this context are invalid and must be reconstructed if the program is to
-     * continue using CUDA.
-     */
-    { "CUDA_ERROR_LAUNCH_TIMEOUT", 702 },
+static const char *const sCudaDrvErrorBand5[] =
+{
+    "CUDA_ERROR_NOT_FOUND",                           /* 500 */
+};
 
-    /**
-     * This error indicates a kernel launch that uses an incompatible texturing
-     * mode.
-     */
-    { "CUDA_ERROR_LAUNCH_INCOMPATIBLE_TEXTURING", 703 },
+static const char *const sCudaDrvErrorBand6[] =
+{
+    "CUDA_ERROR_NOT_READY",                           /* 600 */
+};
 
-    /**
-     * This error indicates that a call to ::cuCtxEnablePeerAccess() is
-     * trying to re-enable peer access to a context which has already
-     * had peer access to it enabled.
-     */
-    { "CUDA_ERROR_PEER_ACCESS_ALREADY_ENABLED", 704 },
+static const char *const sCudaDrvErrorBand7[] =
+{
+    "CUDA_ERROR_ILLEGAL_ADDRESS",                     /* 700 */
+    "CUDA_ERROR_LAUNCH_OUT_OF_RESOURCES",
+    "CUDA_ERROR_LAUNCH_TIMEOUT",
+    "CUDA_ERROR_LAUNCH_INCOMPATIBLE_TEXTURING",
+    "CUDA_ERROR_PEER_ACCESS_ALREADY_ENABLED",
+    "CUDA_ERROR_PEER_ACCESS_NOT_ENABLED",             /* 705 */
+    "CUDA_ERROR_PEER_MEMORY_ALREADY_REGISTERED",
+    "CUDA_ERROR_PEER_MEMORY_NOT_REGISTERED",
+    "CUDA_ERROR_PRIMARY_CONTEXT_ACTIVE",
+    "CUDA_ERROR_CONTEXT_IS_DESTROYED",
+    "CUDA_ERROR_ASSERT",                              /* 710 */
+    "CUDA_ERROR_TOO_MANY_PEERS",
+    "CUDA_ERROR_HOST_MEMORY_ALREADY_REGISTERED",
+    "CUDA_ERROR_HOST_MEMORY_NOT_REGISTERED",
+    "CUDA_ERROR_HARDWARE_STACK_ERROR",
+    "CUDA_ERROR_ILLEGAL_INSTRUCTION",                 /* 715 */
+    "CUDA_ERROR_MISALIGNED_ADDRESS",
+    "CUDA_ERROR_INVALID_ADDRESS_SPACE",
+    "CUDA_ERROR_INVALID_PC",
+    "CUDA_ERROR_LAUNCH_FAILED",
+    "CUDA_ERROR_COOPERATIVE_LAUNCH_TOO_LARGE",        /* 720 */
+};
 
-    /**
-     * This error indicates that ::cuCtxDisablePeerAccess() is
-     * trying to disable peer access which has not been enabled yet
-     * via ::cuCtxEnablePeerAccess().
-     */
-    { "CUDA_ERROR_PEER_ACCESS_NOT_ENABLED", 705 },
+static const char *const sCudaDrvErrorBand8[] =
+{
+    "CUDA_ERROR_NOT_PERMITTED",                       /* 800 */
+    "CUDA_ERROR_NOT_SUPPORTED",
+    "CUDA_ERROR_SYSTEM_NOT_READY",
+    "CUDA_ERROR_SYSTEM_DRIVER_MISMATCH",
+    "CUDA_ERROR_COMPAT_NOT_SUPPORTED_ON_DEVICE",
+    "CUDA_ERROR_MPS_CONNECTION_FAILED",               /* 805 */
+    "CUDA_ERROR_MPS_RPC_FAILURE",
+    "CUDA_ERROR_MPS_SERVER_NOT_READY",
+    "CUDA_ERROR_MPS_MAX_CLIENTS_REACHED",
+    "CUDA_ERROR_MPS_MAX_CONNECTIONS_REACHED",
+    "CUDA_ERROR_MPS_CLIENT_TERMINATED",               /* 810 */
+    "CUDA_ERROR_CDP_NOT_SUPPORTED",
+    "CUDA_ERROR_CDP_VERSION_MISMATCH",
+};
 
-    /**
-     * This error indicates that the primary context for the specified device
-     * has already been initialized.
-     */
-    { "CUDA_ERROR_PRIMARY_CONTEXT_ACTIVE", 708 },
+static const char *const sCudaDrvErrorBand9[] =
+{
+    "CUDA_ERROR_STREAM_CAPTURE_UNSUPPORTED",          /* 900 */
+    "CUDA_ERROR_STREAM_CAPTURE_INVALIDATED",
+    "CUDA_ERROR_STREAM_CAPTURE_MERGE",
+    "CUDA_ERROR_STREAM_CAPTURE_UNMATCHED",
+    "CUDA_ERROR_STREAM_CAPTURE_UNJOINED",
+    "CUDA_ERROR_STREAM_CAPTURE_ISOLATION",            /* 905 */
+    "CUDA_ERROR_STREAM_CAPTURE_IMPLICIT",
+    "CUDA_ERROR_CAPTURED_EVENT",
+    "CUDA_ERROR_STREAM_CAPTURE_WRONG_THREAD",
+    "CUDA_ERROR_TIMEOUT",
+    "CUDA_ERROR_GRAPH_EXEC_UPDATE_FAILURE",           /* 910 */
+    "CUDA_ERROR_EXTERNAL_DEVICE",
+    "CUDA_ERROR_INVALID_CLUSTER_SIZE",
+};
 
-    /**
-     * This error indicates that the context current to the calling thread
-     * has been destroyed using ::cuCtxDestroy }, or is a primary context which
-     * has not yet been initialized.
-     */
-    { "CUDA_ERROR_CONTEXT_IS_DESTROYED", 709 },
+#undef CU_DRV_ERROR_GAP10
+#undef CU_DRV_ERROR_GAP5
 
-    /**
-     * A device-side assert triggered during kernel execution. The context
-     * cannot be used anymore, and must be destroyed. All existing device
-     * memory allocations from this context are invalid and must be
-     * reconstructed if the program is to continue using CUDA.
-     */
-    { "CUDA_ERROR_ASSERT", 710 },
+#define CU_DRV_ERROR_BAND(band) { band, sizeof(band) / sizeof(band[0]) }
 
-    /**
-     * This indicates that an unknown internal error has occurred.
-     */
-    { "CUDA_ERROR_UNKNOWN", 999 },
-    { NULL, -1 }
+static const struct
+{
+    const char *const *names;
+    unsigned int count;
+} sCudaDrvErrorBands[] =
+{
+    CU_DRV_ERROR_BAND(sCudaDrvErrorBand0),
+    CU_DRV_ERROR_BAND(sCudaDrvErrorBand1),
+    CU_DRV_ERROR_BAND(sCudaDrvErrorBand2),
+    CU_DRV_ERROR_BAND(sCudaDrvErrorBand3),
+    CU_DRV_ERROR_BAND(sCudaDrvErrorBand4),
+    CU_DRV_ERROR_BAND(sCudaDrvErrorBand5),
+    CU_DRV_ERROR_BAND(sCudaDrvErrorBand6),
+    CU_DRV_ERROR_BAND(sCudaDrvErrorBand7),
+    CU_DRV_ERROR_BAND(sCudaDrvErrorBand8),
+    CU_DRV_ERROR_BAND(sCudaDrvErrorBand9),
 };
 
-// This is just a linear search through the array, since the error_id's are not
-// always ocurring consecutively
+#undef CU_DRV_ERROR_BAND
+
+// Never fails and never allocates; unknown codes map to a fixed string so
+// the result can go straight into a log line.
 inline static const char *getCudaDrvErrorString(CUresult error_id)
 {
-    int index = 0;
+    unsigned int code = (unsigned int)error_id;
+    unsigned int band = code / 100;
+    unsigned int index = code % 100;
+    const char *name = NULL;
+
+    if (code == 999)
+        return "CUDA_ERROR_UNKNOWN";
 
-    while (sCudaDrvErrorString[index].error_id != error_id &&
-           sCudaDrvErrorString[index].error_id != -1)
-    {
-        index++;
-    }
+    if (band < sizeof(sCudaDrvErrorBands) / sizeof(sCudaDrvErrorBands[0]) &&
+        index < sCudaDrvErrorBands[band].count)
+        name = sCudaDrvErrorBands[band].names[index];
 
-    if (sCudaDrvErrorString[index].error_id == error_id)
-        return (const char *)sCudaDrvErrorString[index].error_string;
-    else
-        return (const char *)"CUDA_ERROR not found!";
+    return name ? name : "CUDA_ERROR not found!";
 }
 
 #endif // __cuda_cuda_h__
@@ -1,12 +1,22 @@
 #include <napi.h>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include <cstring>
 #include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
 
+#include "histogram.h"
+
 namespace {
 
 int connect_unix_socket(const std::string &path) {
@@ -26,90 +36,531 @@ int connect_unix_socket(const std::string &path) {
   return fd;
 }
 
-static int g_sock = -1;
-static std::string g_sock_path;
-
-bool ensure_connected(const std::string &path, int &saved_errno) {
-  if (g_sock >= 0 && path == g_sock_path) return true;
-  if (g_sock >= 0) { ::close(g_sock); g_sock = -1; }
-  g_sock = connect_unix_socket(path);
-  saved_errno = errno;
-  if (g_sock >= 0) g_sock_path = path;
-  return g_sock >= 0;
+// True if the peer of a cached connection has gone away. Consumers never
+// write to the socket, so any readable event is a hangup or an error.
+bool peer_closed(int sock) {
+  pollfd pfd{};
+  pfd.fd = sock;
+  pfd.events = POLLIN | POLLRDHUP;
+  return ::poll(&pfd, 1, 0) > 0 && pfd.revents != 0;
 }
 
-Napi::Value SendFd(const Napi::CallbackInfo &info) {
-  Napi::Env env = info.Env();
-  if (info.Length() < 2) {
-    Napi::TypeError::New(env, "Expected (socketPath: string, fd: number)").ThrowAsJavaScriptException();
-    return env.Null();
+// Frame clock: the GPU process records the swap time, sequence number and
+// export ring slot of every offscreen present here, and the CUDA IPC handles
+// of its rings once (CudaFrameClock in
+// cuda_loader_egl/cuda_frame_clock.h, keep the layout in sync). The browser
+// owns the segment: it creates it before the GPU process starts and unlinks
+// it on exit.
+constexpr uint32_t kFrameClockMagic = 0x4b4c4346;  // "FCLK"
+constexpr uint32_t kFrameClockVersion = 5;
+constexpr size_t kFrameClockRecords = 64;
+constexpr size_t kFrameClockRings = 16;
+constexpr size_t kFrameClockRingSlots = 8;
+constexpr size_t kFrameClockHandleBytes = 64;
+constexpr uint32_t kFrameClockRingBusy = 0xffffffff;
+// CudaExportFormat, in order
+constexpr const char *kExportFormatNames[] = {"bgra", "nv12", "i420", "p010"};
+constexpr uint64_t kExportBucketsUs[] = {250, 500, 1000, 2000, 4000, 8000, 16000, 33000};
+constexpr size_t kExportBuckets = sizeof(kExportBucketsUs) / sizeof(kExportBucketsUs[0]) + 1;
+
+struct FrameClockRecord {
+  std::atomic<uint64_t> stamp;
+  std::atomic<uint64_t> sequence;
+  std::atomic<int64_t> swap_us;
+  std::atomic<uint32_t> width;
+  std::atomic<uint32_t> height;
+  std::atomic<uint32_t> surface_id;
+  std::atomic<int32_t> slot;
+  std::atomic<uint64_t> buffer_ino;
+};
+
+struct FrameClockRing {
+  std::atomic<uint32_t> surface_id;
+  uint32_t rendition;
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  uint32_t planes;
+  uint32_t reserved;
+  uint64_t slot_bytes;
+  uint64_t sequence_offset;
+  uint64_t offset[3];
+  uint64_t pitch[3];
+  uint8_t handles[kFrameClockRingSlots][kFrameClockHandleBytes];
+};
+
+struct FrameClockExportStats {
+  std::atomic<uint64_t> exports;
+  std::atomic<uint64_t> failures;
+  std::atomic<uint64_t> total_us;
+  std::atomic<uint64_t> buckets[kExportBuckets];
+};
+
+struct FrameClockShm {
+  uint32_t magic;
+  uint32_t version;
+  std::atomic<uint64_t> writes;
+  std::atomic<uint32_t> surfaces;
+  uint32_t reserved;
+  FrameClockExportStats export_stats;
+  FrameClockRecord records[kFrameClockRecords];
+  FrameClockRing rings[kFrameClockRings];
+};
+
+// All state lives in the addon instance, one per JS context that loads the
+// module, so the main thread and worker threads each get their own socket
+// connections, frame clock mappings and histograms. The frame clock itself
+// is shared memory and reads the same from every instance.
+class FdPass : public Napi::Addon<FdPass> {
+ public:
+  FdPass(Napi::Env env, Napi::Object exports) {
+    DefineAddon(exports, {
+      InstanceMethod("sendFd", &FdPass::SendFd),
+      InstanceMethod("dupFd", &FdPass::DupFd),
+      InstanceMethod("closeFd", &FdPass::CloseFd),
+      InstanceMethod("probe", &FdPass::Probe),
+      InstanceMethod("close", &FdPass::Close),
+      InstanceMethod("createFrameClock", &FdPass::CreateFrameClock),
+      InstanceMethod("openFrameClock", &FdPass::OpenFrameClock),
+      InstanceMethod("frameClockLatest", &FdPass::FrameClockLatest),
+      InstanceMethod("frameClockRing", &FdPass::FrameClockRing),
+      InstanceMethod("closeFrameClock", &FdPass::CloseFrameClock),
+      InstanceMethod("frameClockExportStats", &FdPass::GetFrameClockExportStats),
+      InstanceMethod("histogramCreate", &FdPass::HistogramCreate),
+      InstanceMethod("histogramRecord", &FdPass::HistogramRecord),
+      InstanceMethod("histogramSnapshot", &FdPass::HistogramSnapshot),
+      InstanceMethod("histogramDestroy", &FdPass::HistogramDestroy)
+    });
+  }
+
+  // Runs when the context goes away, e.g. a terminated worker.
+  ~FdPass() {
+    close_all_sockets();
+    close_frame_clock();
+    for (auto &entry : clock_readers_) ::munmap(const_cast<FrameClockShm *>(entry.second), sizeof(FrameClockShm));
   }
 
-  std::string sock_path = info[0].As<Napi::String>().Utf8Value();
-  int send_fd = info[1].As<Napi::Number>().Int32Value();
+ private:
+  int ensure_connected(const std::string &path, int &saved_errno) {
+    auto it = socks_.find(path);
+    if (it != socks_.end()) return it->second;
+    int sock = connect_unix_socket(path);
+    saved_errno = errno;
+    if (sock >= 0) socks_[path] = sock;
+    return sock;
+  }
 
-  int saved_errno = 0;
-  if (!ensure_connected(sock_path, saved_errno)) {
-    Napi::Error::New(env, std::string("Failed to connect to UNIX socket: ") + std::strerror(saved_errno)).ThrowAsJavaScriptException();
-    return env.Null();
+  void close_socket(const std::string &path) {
+    auto it = socks_.find(path);
+    if (it == socks_.end()) return;
+    ::close(it->second);
+    socks_.erase(it);
   }
 
-  // Compose a minimal payload; some UNIXes require at least 1 byte with SCM_RIGHTS
-  char dummy = 0;
+  void close_all_sockets() {
+    for (auto &entry : socks_) ::close(entry.second);
+    socks_.clear();
+  }
+
+  Napi::Value SendFd(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 2) {
+      Napi::TypeError::New(env, "Expected (socketPath: string, fd: number)").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    std::string sock_path = info[0].As<Napi::String>().Utf8Value();
+    int send_fd = info[1].As<Napi::Number>().Int32Value();
+
+    int saved_errno = 0;
+    int sock = ensure_connected(sock_path, saved_errno);
+    if (sock < 0) {
+      Napi::Error::New(env, std::string("Failed to connect to UNIX socket: ") + std::strerror(saved_errno)).ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    // Compose a minimal payload; some UNIXes require at least 1 byte with SCM_RIGHTS
+    char dummy = 0;
 
-  // Allocate control buffer with CMSG_SPACE to satisfy alignment
-  char control[CMSG_SPACE(sizeof(int))];
+    // Allocate control buffer with CMSG_SPACE to satisfy alignment
+    char control[CMSG_SPACE(sizeof(int))];
 
-  struct iovec iov;
-  iov.iov_base = &dummy;
-  iov.iov_len = 1;
+    struct iovec iov;
+    iov.iov_base = &dummy;
+    iov.iov_len = 1;
 
-  struct msghdr msg;
-  std::memset(&msg, 0, sizeof(msg));
-  msg.msg_iov = &iov;
-  msg.msg_iovlen = 1;
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
 
-  std::memset(control, 0, sizeof(control));
-  msg.msg_control = control;
-  msg.msg_controllen = sizeof(control);
+    std::memset(control, 0, sizeof(control));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
 
-  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-  cmsg->cmsg_level = SOL_SOCKET;
-  cmsg->cmsg_type = SCM_RIGHTS;
-  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
-  *reinterpret_cast<int *>(CMSG_DATA(cmsg)) = send_fd;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    *reinterpret_cast<int *>(CMSG_DATA(cmsg)) = send_fd;
+
+    auto do_send = [&]() -> bool {
+      ssize_t n = ::sendmsg(sock, &msg, 0);
+      if (n < 0) { saved_errno = errno; return false; }
+      return true;
+    };
+
+    if (!do_send()) {
+      // Try one reconnect once on failure
+      close_socket(sock_path);
+      sock = ensure_connected(sock_path, saved_errno);
+      if (sock < 0 || !do_send()) {
+        Napi::Error::New(env, std::string("sendmsg failed: ") + std::strerror(saved_errno)).ThrowAsJavaScriptException();
+        return env.Null();
+      }
+    }
 
-  auto do_send = [&]() -> bool {
-    ssize_t n = ::sendmsg(g_sock, &msg, 0);
-    if (n < 0) { saved_errno = errno; return false; }
-    return true;
-  };
+    return env.Undefined();
+  }
 
-  if (!do_send()) {
-    // Try one reconnect once on failure
-    ::close(g_sock); g_sock = -1;
-    if (!ensure_connected(sock_path, saved_errno) || !do_send()) {
-      Napi::Error::New(env, std::string("sendmsg failed: ") + std::strerror(saved_errno)).ThrowAsJavaScriptException();
+  // dupFd(fd) returns a close-on-exec duplicate, so a frame fd outlives the
+  // texture it came from while another thread sends it. The caller closes it.
+  Napi::Value DupFd(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1) {
+      Napi::TypeError::New(env, "Expected (fd: number)").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    int fd = ::fcntl(info[0].As<Napi::Number>().Int32Value(), F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) {
+      Napi::Error::New(env, std::string("dup failed: ") + std::strerror(errno)).ThrowAsJavaScriptException();
       return env.Null();
     }
+    return Napi::Number::New(env, fd);
   }
 
-  return env.Undefined();
-}
+  // closeFd(fd) closes an fd from dupFd(), possibly in another thread than
+  // the one that duplicated it (fs.closeSync() warns about that in workers).
+  Napi::Value CloseFd(const Napi::CallbackInfo &info) {
+    if (info.Length() > 0) ::close(info[0].As<Napi::Number>().Int32Value());
+    return info.Env().Undefined();
+  }
 
-Napi::Value Close(const Napi::CallbackInfo &info) {
-  if (g_sock >= 0) { ::close(g_sock); g_sock = -1; g_sock_path.clear(); }
-  return info.Env().Undefined();
-}
+  // probe(socketPath) reports whether a consumer is listening, without sending
+  // anything: a cached connection is checked for hangup, otherwise a new one is
+  // attempted and kept for the next sendFd().
+  Napi::Value Probe(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString()) {
+      Napi::TypeError::New(env, "Expected (socketPath: string)").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    std::string sock_path = info[0].As<Napi::String>().Utf8Value();
+    auto it = socks_.find(sock_path);
+    if (it != socks_.end() && peer_closed(it->second)) close_socket(sock_path);
+    int saved_errno = 0;
+    return Napi::Boolean::New(env, ensure_connected(sock_path, saved_errno) >= 0);
+  }
 
-Napi::Object Init(Napi::Env env, Napi::Object exports) {
-  exports.Set("sendFd", Napi::Function::New(env, SendFd));
-  exports.Set("close", Napi::Function::New(env, Close));
-  return exports;
-}
+  // close() drops every connection, close(socketPath) only that one.
+  Napi::Value Close(const Napi::CallbackInfo &info) {
+    if (info.Length() > 0 && info[0].IsString()) {
+      close_socket(info[0].As<Napi::String>().Utf8Value());
+    } else {
+      close_all_sockets();
+    }
+    return info.Env().Undefined();
+  }
 
-} // namespace
+  void close_frame_clock() {
+    if (!clock_) return;
+    if (latest_clock_ == clock_) latest_clock_ = nullptr;
+    ::munmap(clock_, sizeof(FrameClockShm));
+    ::shm_unlink(clock_name_.c_str());
+    clock_ = nullptr;
+    clock_name_.clear();
+  }
+
+  Napi::Value CreateFrameClock(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString()) {
+      Napi::TypeError::New(env, "Expected (name: string)").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    std::string name = info[0].As<Napi::String>().Utf8Value();
+    close_frame_clock();
 
-NODE_API_MODULE(fdpass, Init)
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+      Napi::Error::New(env, std::string("shm_open failed: ") + std::strerror(errno)).ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    void *mapping = MAP_FAILED;
+    if (::ftruncate(fd, sizeof(FrameClockShm)) == 0) {
+      mapping = ::mmap(nullptr, sizeof(FrameClockShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    int saved_errno = errno;
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      ::shm_unlink(name.c_str());
+      Napi::Error::New(env, std::string("frame clock mapping failed: ") + std::strerror(saved_errno)).ThrowAsJavaScriptException();
+      return env.Null();
+    }
 
+    // The segment starts zeroed: no writes, every stamp 0
+    clock_ = static_cast<FrameClockShm *>(mapping);
+    clock_->magic = kFrameClockMagic;
+    clock_->version = kFrameClockVersion;
+    clock_name_ = name;
+    latest_clock_ = clock_;
+    return env.Undefined();
+  }
+
+  // Read-only mappings of frame clocks other instances created.
+  const FrameClockShm *frame_clock_reader(const std::string &name) {
+    auto it = clock_readers_.find(name);
+    if (it != clock_readers_.end()) return it->second;
+    int fd = ::shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) return nullptr;
+    void *mapping = ::mmap(nullptr, sizeof(FrameClockShm), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return nullptr;
+    const FrameClockShm *shm = static_cast<const FrameClockShm *>(mapping);
+    if (shm->magic != kFrameClockMagic || shm->version != kFrameClockVersion) {
+      ::munmap(mapping, sizeof(FrameClockShm));
+      return nullptr;
+    }
+    clock_readers_[name] = shm;
+    return shm;
+  }
+
+  // openFrameClock(name) makes frameClockLatest() of this instance read a
+  // frame clock created elsewhere, e.g. by the main thread. Returns false if
+  // there is none by that name.
+  Napi::Value OpenFrameClock(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString()) {
+      Napi::TypeError::New(env, "Expected (name: string)").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    const FrameClockShm *shm = frame_clock_reader(info[0].As<Napi::String>().Utf8Value());
+    if (shm) latest_clock_ = shm;
+    return Napi::Boolean::New(env, shm != nullptr);
+  }
+
+  // frameClockLatest(key, beforeUs) returns { sequence, swapUs, surfaceId,
+  // slot } of the newest present at or before beforeUs (CLOCK_MONOTONIC
+  // microseconds) that matches key, or null. key is { bufferIno } (the
+  // inode of the dma-buf the frame was captured into), { surfaceId } or
+  // { width, height }, tried in that order. slot is null unless the present
+  // was exported into a ring of that surface.
+  Napi::Value FrameClockLatest(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    const FrameClockShm *clock = latest_clock_;
+    if (!clock || info.Length() < 2 || !info[0].IsObject()) return env.Null();
+    Napi::Object key = info[0].As<Napi::Object>();
+    auto key_value = [&key](const char *name) -> uint64_t {
+      Napi::Value value = key.Get(name);
+      return value.IsNumber() ? value.As<Napi::Number>().Int64Value() : 0;
+    };
+    uint64_t buffer_ino = key_value("bufferIno");
+    uint32_t surface = static_cast<uint32_t>(key_value("surfaceId"));
+    uint32_t width = static_cast<uint32_t>(key_value("width"));
+    uint32_t height = static_cast<uint32_t>(key_value("height"));
+    int64_t before_us = info[1].As<Napi::Number>().Int64Value();
+
+    uint64_t writes = clock->writes.load(std::memory_order_acquire);
+    for (uint64_t i = writes; i > 0 && writes - i < kFrameClockRecords; --i) {
+      const FrameClockRecord &record = clock->records[(i - 1) % kFrameClockRecords];
+      // Skip records still being written or already reused by a newer write
+      uint64_t stamp = record.stamp.load(std::memory_order_acquire);
+      if (stamp != i) continue;
+      uint64_t sequence = record.sequence.load(std::memory_order_relaxed);
+      int64_t swap_us = record.swap_us.load(std::memory_order_relaxed);
+      uint32_t w = record.width.load(std::memory_order_relaxed);
+      uint32_t h = record.height.load(std::memory_order_relaxed);
+      uint32_t surface_id = record.surface_id.load(std::memory_order_relaxed);
+      int32_t slot = record.slot.load(std::memory_order_relaxed);
+      uint64_t ino = record.buffer_ino.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (record.stamp.load(std::memory_order_relaxed) != stamp) continue;
+      if (swap_us > before_us) continue;
+      bool match;
+      if (buffer_ino) match = ino == buffer_ino;
+      else if (surface) match = surface_id == surface;
+      else match = w == width && h == height;
+      if (!match) continue;
+
+      Napi::Object result = Napi::Object::New(env);
+      result.Set("sequence", Napi::Number::New(env, static_cast<double>(sequence)));
+      result.Set("swapUs", Napi::Number::New(env, static_cast<double>(swap_us)));
+      result.Set("surfaceId", Napi::Number::New(env, surface_id));
+      result.Set("slot", slot >= 0 ? Napi::Number::New(env, slot) : env.Null());
+      return result;
+    }
+    return env.Null();
+  }
+
+  // frameClockRing(surfaceId, rendition) returns the export ring that
+  // surface published, { format, width, height, depth, planes, slotBytes,
+  // sequenceOffset, offsets, pitches, handles } with one hex CUDA IPC memory
+  // handle per slot, or null. rendition 0 is the full size frame.
+  Napi::Value FrameClockRing(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    const FrameClockShm *clock = latest_clock_;
+    if (!clock || info.Length() < 2) return env.Null();
+    uint32_t surface_id = info[0].As<Napi::Number>().Uint32Value();
+    uint32_t rendition = info[1].As<Napi::Number>().Uint32Value();
+    if (surface_id == 0 || surface_id == kFrameClockRingBusy) return env.Null();
+
+    static const char kHex[] = "0123456789abcdef";
+    for (const ::FrameClockRing &entry : clock->rings) {
+      if (entry.surface_id.load(std::memory_order_acquire) != surface_id || entry.rendition != rendition) continue;
+      // Copy first, then check the owner did not change meanwhile
+      ::FrameClockRing ring;
+      std::memcpy(static_cast<void *>(&ring), static_cast<const void *>(&entry), sizeof(ring));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (entry.surface_id.load(std::memory_order_relaxed) != surface_id) return env.Null();
+
+      uint32_t depth = std::min<uint32_t>(ring.depth, kFrameClockRingSlots);
+      uint32_t planes = std::min<uint32_t>(ring.planes, 3);
+      Napi::Object result = Napi::Object::New(env);
+      result.Set("format", ring.format < std::size(kExportFormatNames)
+                               ? Napi::Value(Napi::String::New(env, kExportFormatNames[ring.format]))
+                               : env.Null());
+      result.Set("width", Napi::Number::New(env, ring.width));
+      result.Set("height", Napi::Number::New(env, ring.height));
+      result.Set("depth", Napi::Number::New(env, depth));
+      result.Set("planes", Napi::Number::New(env, planes));
+      result.Set("slotBytes", Napi::Number::New(env, static_cast<double>(ring.slot_bytes)));
+      result.Set("sequenceOffset", Napi::Number::New(env, static_cast<double>(ring.sequence_offset)));
+      Napi::Array offsets = Napi::Array::New(env, planes);
+      Napi::Array pitches = Napi::Array::New(env, planes);
+      for (uint32_t i = 0; i < planes; ++i) {
+        offsets.Set(i, Napi::Number::New(env, static_cast<double>(ring.offset[i])));
+        pitches.Set(i, Napi::Number::New(env, static_cast<double>(ring.pitch[i])));
+      }
+      result.Set("offsets", offsets);
+      result.Set("pitches", pitches);
+      Napi::Array handles = Napi::Array::New(env, depth);
+      for (uint32_t i = 0; i < depth; ++i) {
+        std::string hex(kFrameClockHandleBytes * 2, '0');
+        for (size_t b = 0; b < kFrameClockHandleBytes; ++b) {
+          hex[b * 2] = kHex[ring.handles[i][b] >> 4];
+          hex[b * 2 + 1] = kHex[ring.handles[i][b] & 15];
+        }
+        handles.Set(i, Napi::String::New(env, hex));
+      }
+      result.Set("handles", handles);
+      return result;
+    }
+    return env.Null();
+  }
+
+  // frameClockExportStats(name) returns the GPU process' CUDA export timings,
+  // { exports, failures, totalUs, bucketsUs, buckets } with non-cumulative
+  // bucket counts (the last one unbounded), or null without a frame clock.
+  Napi::Value GetFrameClockExportStats(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString()) {
+      Napi::TypeError::New(env, "Expected (name: string)").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    const FrameClockShm *shm = frame_clock_reader(info[0].As<Napi::String>().Utf8Value());
+    if (!shm) return env.Null();
+
+    const FrameClockExportStats &stats = shm->export_stats;
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("exports", Napi::Number::New(env, static_cast<double>(stats.exports.load(std::memory_order_relaxed))));
+    result.Set("failures", Napi::Number::New(env, static_cast<double>(stats.failures.load(std::memory_order_relaxed))));
+    result.Set("totalUs", Napi::Number::New(env, static_cast<double>(stats.total_us.load(std::memory_order_relaxed))));
+    Napi::Array bounds = Napi::Array::New(env, kExportBuckets - 1);
+    Napi::Array buckets = Napi::Array::New(env, kExportBuckets);
+    for (size_t i = 0; i < kExportBuckets; ++i) {
+      if (i + 1 < kExportBuckets) bounds.Set(static_cast<uint32_t>(i), Napi::Number::New(env, static_cast<double>(kExportBucketsUs[i])));
+      buckets.Set(static_cast<uint32_t>(i), Napi::Number::New(env, static_cast<double>(stats.buckets[i].load(std::memory_order_relaxed))));
+    }
+    result.Set("bucketsUs", bounds);
+    result.Set("buckets", buckets);
+    return result;
+  }
+
+  Napi::Value CloseFrameClock(const Napi::CallbackInfo &info) {
+    close_frame_clock();
+    return info.Env().Undefined();
+  }
+
+  fdpass::Histogram *histogram_arg(const Napi::CallbackInfo &info) {
+    if (info.Length() < 1) return nullptr;
+    uint32_t id = info[0].As<Napi::Number>().Uint32Value();
+    return id < histograms_.size() ? histograms_[id].get() : nullptr;
+  }
+
+  Napi::Value HistogramCreate(const Napi::CallbackInfo &info) {
+    size_t id = 0;
+    while (id < histograms_.size() && histograms_[id]) ++id;
+    if (id == histograms_.size()) histograms_.emplace_back();
+    histograms_[id] = std::make_unique<fdpass::Histogram>();
+    return Napi::Number::New(info.Env(), static_cast<double>(id));
+  }
+
+  // histogramRecord(id, valueUs); values are clamped to [0, 2^32 - 1].
+  Napi::Value HistogramRecord(const Napi::CallbackInfo &info) {
+    fdpass::Histogram *histogram = histogram_arg(info);
+    if (histogram && info.Length() > 1) histogram->Record(info[1].As<Napi::Number>().Int64Value());
+    return info.Env().Undefined();
+  }
+
+  // histogramSnapshot(id, reset = true) returns { count, min, max, mean,
+  // stddev, p50, p90, p99, p999 } and by default starts a new interval.
+  Napi::Value HistogramSnapshot(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    fdpass::Histogram *histogram = histogram_arg(info);
+    if (!histogram) {
+      Napi::TypeError::New(env, "Unknown histogram").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    const fdpass::Histogram::Snapshot s = histogram->Take();
+    if (info.Length() < 2 || info[1].ToBoolean().Value()) histogram->Reset();
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("count", Napi::Number::New(env, static_cast<double>(s.count)));
+    result.Set("min", Napi::Number::New(env, static_cast<double>(s.min)));
+    result.Set("max", Napi::Number::New(env, static_cast<double>(s.max)));
+    result.Set("mean", Napi::Number::New(env, s.mean));
+    result.Set("stddev", Napi::Number::New(env, s.stddev));
+    result.Set("p50", Napi::Number::New(env, static_cast<double>(s.p50)));
+    result.Set("p90", Napi::Number::New(env, static_cast<double>(s.p90)));
+    result.Set("p99", Napi::Number::New(env, static_cast<double>(s.p99)));
+    result.Set("p999", Napi::Number::New(env, static_cast<double>(s.p999)));
+    return result;
+  }
+
+  Napi::Value HistogramDestroy(const Napi::CallbackInfo &info) {
+    if (info.Length() > 0) {
+      uint32_t id = info[0].As<Napi::Number>().Uint32Value();
+      if (id < histograms_.size()) histograms_[id].reset();
+    }
+    return info.Env().Undefined();
+  }
+
+  // One connection per socket path, so several outputs sending to different
+  // consumers do not reconnect on every frame.
+  std::map<std::string, int> socks_;
+
+  // The frame clock this instance created, if any, and the one
+  // frameClockLatest() reads (created or opened).
+  FrameClockShm *clock_ = nullptr;
+  std::string clock_name_;
+  const FrameClockShm *latest_clock_ = nullptr;
+  std::map<std::string, const FrameClockShm *> clock_readers_;
+
+  // Latency histograms, addressed from JS by index. Creating one allocates
+  // its buckets once; recording and snapshots never allocate.
+  std::vector<std::unique_ptr<fdpass::Histogram>> histograms_;
+};
+
+} // namespace
 
+NODE_API_ADDON(FdPass)
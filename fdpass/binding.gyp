@@ -9,7 +9,8 @@
         "<!@(node -p \"require('node-addon-api').include\")"
       ],
       "libraries": [
-        "-lEGL"
+        "-lEGL",
+        "-lrt"
       ],
       "defines": [
         "NAPI_DISABLE_CPP_EXCEPTIONS"
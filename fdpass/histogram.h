@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace fdpass {
+
+// Log-linear (HdrHistogram style) histogram of microsecond values with two
+// significant digits: every value up to 2^32 - 1 us lands in a bucket at
+// most 1/128 wide relative to it. All storage is inline, so recording never
+// allocates; count, min, max, sum and sum of squares are exact.
+class Histogram {
+ public:
+  struct Snapshot {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    double mean;
+    double stddev;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+  };
+
+  Histogram() { Reset(); }
+
+  void Record(int64_t value) {
+    const uint64_t v = value < 0 ? 0
+                       : static_cast<uint64_t>(value) > kMaxValue ? kMaxValue
+                       : static_cast<uint64_t>(value);
+    counts_[CountsIndex(v)]++;
+    total_++;
+    if (v < min_) min_ = v;
+    if (v > max_) max_ = v;
+    sum_ += static_cast<double>(v);
+    sum_sq_ += static_cast<double>(v) * static_cast<double>(v);
+  }
+
+  void Reset() {
+    std::memset(counts_, 0, sizeof(counts_));
+    total_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+    sum_ = 0;
+    sum_sq_ = 0;
+  }
+
+  Snapshot Take() const {
+    Snapshot s{};
+    s.count = total_;
+    if (total_ == 0) return s;
+    s.min = min_;
+    s.max = max_;
+    s.mean = sum_ / static_cast<double>(total_);
+    const double variance = sum_sq_ / static_cast<double>(total_) - s.mean * s.mean;
+    s.stddev = variance > 0 ? std::sqrt(variance) : 0;
+    s.p50 = ValueAtPercentile(50);
+    s.p90 = ValueAtPercentile(90);
+    s.p99 = ValueAtPercentile(99);
+    s.p999 = ValueAtPercentile(99.9);
+    return s;
+  }
+
+  // Highest value equivalent to the bucket holding the given percentile,
+  // capped at the exact maximum.
+  uint64_t ValueAtPercentile(double percentile) const {
+    uint64_t target = static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(total_)));
+    if (target < 1) target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < kCountsLen; ++i) {
+      seen += counts_[i];
+      if (seen >= target) {
+        const uint64_t value = HighestEquivalent(i);
+        return value < max_ ? value : max_;
+      }
+    }
+    return max_;
+  }
+
+ private:
+  static constexpr int kSubBucketHalfCountMagnitude = 7;
+  static constexpr uint64_t kSubBucketHalfCount = 1ull << kSubBucketHalfCountMagnitude;
+  static constexpr uint64_t kSubBucketMask = (kSubBucketHalfCount << 1) - 1;
+  static constexpr uint64_t kMaxValue = (1ull << 32) - 1;
+  // Buckets needed for kMaxValue: 32 - (kSubBucketHalfCountMagnitude + 1) + 1.
+  static constexpr int kBucketCount = 25;
+  static constexpr int kCountsLen = (kBucketCount + 1) * static_cast<int>(kSubBucketHalfCount);
+
+  static int CountsIndex(uint64_t v) {
+    const int bucket = 63 - __builtin_clzll(v | kSubBucketMask) - kSubBucketHalfCountMagnitude;
+    const uint64_t sub_bucket = v >> bucket;
+    return static_cast<int>(((static_cast<uint64_t>(bucket) + 1) << kSubBucketHalfCountMagnitude) +
+                            (sub_bucket - kSubBucketHalfCount));
+  }
+
+  static uint64_t HighestEquivalent(int index) {
+    int bucket = (index >> kSubBucketHalfCountMagnitude) - 1;
+    uint64_t sub_bucket = static_cast<uint64_t>(index & (kSubBucketHalfCount - 1)) + kSubBucketHalfCount;
+    if (bucket < 0) {
+      sub_bucket -= kSubBucketHalfCount;
+      bucket = 0;
+    }
+    return (sub_bucket << bucket) + (1ull << bucket) - 1;
+  }
+
+  uint64_t counts_[kCountsLen];
+  uint64_t total_;
+  uint64_t min_;
+  uint64_t max_;
+  double sum_;
+  double sum_sq_;
+};
+
+} // namespace fdpass
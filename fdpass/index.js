@@ -17,6 +17,89 @@ async function sendFd (socketPath, fd) {
   })
 }
 
+// Close-on-exec duplicate of fd, for handing a frame fd to another thread;
+// close it there with closeFd().
+function dupFd (fd) {
+  return addon.dupFd(fd)
+}
+
+function closeFd (fd) {
+  return addon.closeFd(fd)
+}
+
+// Whether a consumer accepts connections on socketPath; cheap enough to poll.
+function probe (socketPath) {
+  return addon.probe(socketPath)
+}
+
+// Without a path closes every cached socket connection.
+function close (socketPath) {
+  return socketPath === undefined ? addon.close() : addon.close(socketPath)
+}
+
+// Shared memory the GPU process stamps with the swap time of every offscreen
+// present; create it before the GPU process starts.
+function createFrameClock (name) {
+  return addon.createFrameClock(name)
+}
+
+// Lets frameClockLatest() in this thread read the frame clock another thread
+// created; false if there is none by that name.
+function openFrameClock (name) {
+  return addon.openFrameClock(name)
+}
+
+// { sequence, swapUs, surfaceId, slot } of the newest present at or before
+// beforeUs (CLOCK_MONOTONIC microseconds, like process.hrtime) that matches
+// key, or null. key is { bufferIno } (inode of the dma-buf the frame was
+// captured into, as fs.fstatSync() reports it for the paint fd),
+// { surfaceId } or { width, height }. slot is the export ring slot the
+// present was copied into, null if it was not exported.
+function frameClockLatest (key, beforeUs) {
+  return addon.frameClockLatest(key, beforeUs)
+}
+
+// Export ring of a surface, { format, width, height, depth, planes,
+// slotBytes, sequenceOffset, offsets, pitches, handles } with the hex CUDA
+// IPC memory handle of each slot, or null. rendition 0 is the full size
+// frame.
+function frameClockRing (surfaceId, rendition) {
+  return addon.frameClockRing(surfaceId, rendition)
+}
+
+// CUDA export timings the GPU process keeps in the frame clock, or null.
+function frameClockExportStats (name) {
+  return addon.frameClockExportStats(name)
+}
+
+function closeFrameClock () {
+  return addon.closeFrameClock()
+}
+
+// Native HDR histogram of microsecond values (two significant digits, up to
+// 2^32 - 1 us). record() never allocates; snapshot() returns
+// { count, min, max, mean, stddev, p50, p90, p99, p999 } and resets unless
+// told otherwise.
+class Histogram {
+  constructor () {
+    this.id = addon.histogramCreate()
+  }
+
+  record (valueUs) {
+    addon.histogramRecord(this.id, valueUs)
+  }
+
+  snapshot (reset = true) {
+    return addon.histogramSnapshot(this.id, reset)
+  }
+
+  destroy () {
+    if (this.id === null) return
+    addon.histogramDestroy(this.id)
+    this.id = null
+  }
+}
+
 function createEGLImageFromDMABuf (opts) {
   // Returns a BigInt representing the EGLImageKHR handle
   return addon.createEGLImageFromDMABuf(opts)
@@ -26,6 +109,6 @@ function destroyEGLImage (imageHandle) {
   return addon.destroyEGLImage(imageHandle)
 }
 
-module.exports = { sendFd, createEGLImageFromDMABuf, destroyEGLImage }
+module.exports = { sendFd, dupFd, closeFd, probe, close, createFrameClock, openFrameClock, frameClockLatest, frameClockRing, closeFrameClock, frameClockExportStats, Histogram, createEGLImageFromDMABuf, destroyEGLImage }
 
 
@@ -0,0 +1,445 @@
+// Worker thread that forwards painted frames to their consumers. The main
+// thread only duplicates the frame fd and pushes it into the frame ring;
+// this thread looks up the viz swap of the frame, passes the fd over the
+// output's UNIX socket and sends the metadata over ZMQ, so GC pauses,
+// navigation or window management on the main event loop no longer delay
+// frames that were already painted. Consumer presence (fd socket probes,
+// ZMQ peers) and consumer requests found in metadata replies go back to the
+// main thread as messages, which decides what to paint.
+const { parentPort, workerData } = require('node:worker_threads')
+const fs = require('node:fs')
+const zmq = require('zeromq')
+const { FrameRing } = require('./frame-ring')
+const { parseRequest } = require('./consumer-request')
+const { attachMetrics } = require('./metrics')
+
+const FD_SOCKET_WARN_INTERVAL_MS = 3000
+// How often an output checks whether its fd consumer is (still) there. A
+// probe is one poll() or connect() on a UNIX socket.
+const CONSUMER_PROBE_INTERVAL_MS = 250
+// Latency stages measured here, each from the viz swap.
+const LATENCY_STAGES = ['paint', 'fdSent', 'metadataSent', 'received']
+
+const { exportMode, frameClock, statsPort } = workerData
+const ring = new FrameRing(workerData.ring)
+const metrics = workerData.metrics ? attachMetrics(workerData.metrics.buffer, workerData.metrics.names) : null
+
+let fdpass = null
+try {
+  fdpass = require('fdpass')
+} catch {}
+if (fdpass && frameClock && typeof fdpass.openFrameClock === 'function') {
+  try { fdpass.openFrameClock(frameClock) } catch {}
+}
+
+// console.* in a worker is relayed through the main thread
+function log (fd, text) {
+  try { fs.writeSync(fd, text + '\n') } catch {}
+}
+
+// The fds in the ring are duplicates made by the main thread's fdpass
+function closeFd (fd) {
+  if (fdpass) fdpass.closeFd(fd)
+}
+
+// CLOCK_MONOTONIC in microseconds, the clock of the viz swap stamps.
+function nowUs () {
+  return Number(process.hrtime.bigint() / 1000n)
+}
+
+// The sending half of one output, see Output in output.js for the rest.
+class OutputForwarder {
+  constructor (index, config) {
+    this.index = index
+    this.name = config.name
+    this.width = config.width
+    this.height = config.height
+    this.throttle = config.throttle
+    this.fdSocket = config.fdSocket
+    this.zmqEndpoint = config.zmqEndpoint
+    this.metrics = metrics ? metrics.outputs[index] : null
+    this.closed = false
+
+    this.zmqClient = new zmq.Request()
+    this.zmqConnectPromise = null
+    this.zmqQueue = Promise.resolve()
+    this.connectedEndpoints = new Set()
+    this.eventsLoopStarted = false
+    // Serialize all FD sends to preserve ordering across frames
+    this.fdQueue = Promise.resolve()
+    this.lastFdSocketWarnMs = 0
+    this.fdConsumer = false
+    this.fdConnectedOnce = false
+    this.zmqConnectedOnce = false
+    this.fdPending = 0
+    this.zmqPending = 0
+    this.probeTimer = null
+    this.lastSwapSequence = null
+    this.surfaceId = null
+    this.ring = null
+    this.histograms = {}
+    if (fdpass && typeof fdpass.Histogram === 'function') {
+      for (const name of LATENCY_STAGES) this.histograms[name] = new fdpass.Histogram()
+    }
+    this.totals = { fdsSent: 0, fdErrors: 0, metadataSent: 0, metadataErrors: 0, repeated: 0, reconnects: 0 }
+  }
+
+  start () {
+    if (!this.throttle) return
+    // Connect up front so the ZMQ events report the peer while paused
+    this.ensureZmqConnected().catch(() => {})
+    this.probeTimer = setInterval(() => this.probeConsumer(), CONSUMER_PROBE_INTERVAL_MS)
+    this.probeConsumer()
+  }
+
+  stop () {
+    this.closed = true
+    if (this.probeTimer) clearInterval(this.probeTimer)
+    this.probeTimer = null
+    try { this.zmqClient.close() } catch {}
+    for (const histogram of Object.values(this.histograms)) histogram.destroy()
+    this.histograms = {}
+    if (fdpass) {
+      try { fdpass.close(this.fdSocket) } catch {}
+    }
+  }
+
+  notify (type, fields) {
+    parentPort.postMessage({ type, index: this.index, ...fields })
+  }
+
+  sendsFds () {
+    return exportMode !== 'off' && !!fdpass
+  }
+
+  probeConsumer () {
+    if (!this.sendsFds()) return
+    let present
+    try {
+      present = fdpass.probe(this.fdSocket)
+    } catch {
+      present = false
+    }
+    this.setFdConsumer(present)
+  }
+
+  setFdConsumer (present) {
+    if (present === this.fdConsumer) return
+    if (present && this.fdConnectedOnce) this.count('reconnects')
+    if (present) this.fdConnectedOnce = true
+    this.fdConsumer = present
+    this.notify('consumer', { present })
+  }
+
+  count (name, n = 1) {
+    this.totals[name] += n
+    if (this.metrics) this.metrics.add(name, n)
+  }
+
+  gauge (name, value) {
+    if (this.metrics) this.metrics.set(name, value)
+  }
+
+  record (name, us) {
+    const histogram = this.histograms[name]
+    if (histogram) histogram.record(us)
+    if (this.metrics) this.metrics.observe(name, us)
+  }
+
+  recordLatency (stage, frame, atUs) {
+    if (frame.swapUs == null || atUs == null) return
+    this.record(stage, atUs - frame.swapUs)
+  }
+
+  // Swap sequence and time of the frame painted at paintUs, from the frame
+  // clock the GPU process writes; null without one. The GPU process stamps
+  // each present with the dma-buf it was captured into, which is the one
+  // behind the paint fd, so that finds the frame of this output's own
+  // surface. Frames without a match fall back to the surface found last,
+  // and to the output size until there is one.
+  swapOf (fd, paintUs) {
+    if (!fdpass || typeof fdpass.frameClockLatest !== 'function') return null
+    try {
+      const bufferIno = fs.fstatSync(fd).ino
+      const swap = bufferIno ? fdpass.frameClockLatest({ bufferIno }, paintUs) : null
+      if (swap) {
+        this.surfaceId = swap.surfaceId
+        return swap
+      }
+      const key = this.surfaceId !== null
+        ? { surfaceId: this.surfaceId }
+        : { width: this.width, height: this.height }
+      return fdpass.frameClockLatest(key, paintUs)
+    } catch {
+      return null
+    }
+  }
+
+  // Export rings of the surface that rendered a frame, the full size one
+  // first and then one per rendition. A surface publishes all of them at
+  // once and never changes them, so they are looked up again only when the
+  // surface changes (or they were not published yet).
+  ringsOf (surfaceId) {
+    if (!fdpass || typeof fdpass.frameClockRing !== 'function') return null
+    if (this.ring && this.ring.surfaceId === surfaceId) return this.ring.rings
+    const rings = []
+    try {
+      for (let rendition = 0; ; rendition++) {
+        const ring = fdpass.frameClockRing(surfaceId, rendition)
+        if (!ring) break
+        rings.push(ring)
+      }
+    } catch {}
+    if (!rings.length) return null
+    this.ring = { surfaceId, rings }
+    return rings
+  }
+
+  // Where the GPU process exported the frame: the CUDA IPC handle of its
+  // ring slot and the layout inside it, and the same for every scaled copy,
+  // which shares the slot index; null if it was not exported. The ring is
+  // reused, so a consumer copies the slot and then checks that the uint64
+  // at sequenceOffset in it still equals the frame's swapSequence.
+  exportOf (swap) {
+    if (!swap || swap.slot == null) return null
+    const rings = this.ringsOf(swap.surfaceId)
+    if (!rings || swap.slot >= rings[0].handles.length) return null
+    const slotOf = (ring) => ({
+      slot: swap.slot,
+      handle: ring.handles[swap.slot],
+      format: ring.format,
+      width: ring.width,
+      height: ring.height,
+      planes: ring.planes,
+      offsets: ring.offsets,
+      pitches: ring.pitches,
+      slotBytes: ring.slotBytes,
+      sequenceOffset: ring.sequenceOffset
+    })
+    return {
+      surfaceId: swap.surfaceId,
+      ...slotOf(rings[0]),
+      renditions: rings.slice(1).map((ring, i) => ({ rendition: i + 1, ...slotOf(ring) }))
+    }
+  }
+
+  // One frame from the ring; owns its fd from here on.
+  async forward ({ fd, seq, paintUs, json }) {
+    try {
+      // Stage stamps in CLOCK_MONOTONIC microseconds; the consumer adds its
+      // own receive time in the reply.
+      const swap = this.swapOf(fd, paintUs)
+      if (swap) {
+        // Painted again without a new swap in between
+        if (swap.sequence === this.lastSwapSequence) this.count('repeated')
+        this.lastSwapSequence = swap.sequence
+      }
+      const frame = {
+        seq,
+        swapSequence: swap ? swap.sequence : null,
+        swapUs: swap ? swap.swapUs : null,
+        export: this.exportOf(swap),
+        paintUs,
+        fdSentUs: null,
+        metadataSentUs: null
+      }
+      this.recordLatency('paint', frame, paintUs)
+      // Ensure FD is sent in strict order before enqueueing JSON
+      if (await this.enqueueSendFd(fd)) {
+        frame.fdSentUs = nowUs()
+        this.recordLatency('fdSent', frame, frame.fdSentUs)
+      }
+      this.enqueueZmqSend(json, frame).catch(err => {
+        if (!this.closed) log(2, `[${this.name}] metadata send error: ${err && (err.message || err)}`)
+      })
+    } catch (err) {
+      log(2, `[${this.name}] exception: ${err && (err.stack || err)}`)
+    }
+  }
+
+  warnFdSocketNotReady () {
+    const now = Date.now()
+    if (now - this.lastFdSocketWarnMs >= FD_SOCKET_WARN_INTERVAL_MS) {
+      log(2, `[${this.name}] FD socket not ready yet: ${this.fdSocket}`)
+      this.lastFdSocketWarnMs = now
+    }
+  }
+
+  // Sends and then closes the duplicated fd.
+  enqueueSendFd (fd) {
+    const task = async () => {
+      try {
+        await fdpass.sendFd(this.fdSocket, fd)
+        this.count('fdsSent')
+        this.setFdConsumer(true)
+        return true
+      } catch (err) {
+        this.count('fdErrors')
+        this.setFdConsumer(false)
+        const msg = String(err && (err.message || err))
+        if (/Failed to connect to UNIX socket|No such file or directory/i.test(msg)) {
+          this.warnFdSocketNotReady()
+          return false
+        }
+        throw err
+      } finally {
+        closeFd(fd)
+      }
+    }
+    this.gauge('fdQueue', ++this.fdPending)
+    const next = this.fdQueue.then(task, task)
+    this.fdQueue = next.catch(() => {})
+    const done = () => this.gauge('fdQueue', --this.fdPending)
+    next.then(done, done)
+    return next
+  }
+
+  async ensureZmqConnected () {
+    if (!this.zmqConnectPromise) {
+      if (!this.eventsLoopStarted) {
+        this.eventsLoopStarted = true
+        ;(async () => {
+          try {
+            const eventsSource = this.zmqClient.events
+            if (eventsSource && typeof eventsSource[Symbol.asyncIterator] === 'function') {
+              for await (const ev of eventsSource) {
+                const type = ev && (ev.type || ev.event || ev[0])
+                const address = ev && (ev.address || ev.addr || ev.endpoint || ev[1])
+                if (type === 'connect') {
+                  if (this.zmqConnectedOnce) this.count('reconnects')
+                  this.zmqConnectedOnce = true
+                  this.connectedEndpoints.add(address)
+                } else if (type === 'disconnect') {
+                  this.connectedEndpoints.delete(address)
+                } else {
+                  continue
+                }
+                this.gauge('peers', this.connectedEndpoints.size)
+                this.notify('peers', { count: this.connectedEndpoints.size })
+              }
+            }
+          } catch (err) {
+            if (!this.closed) log(2, `[${this.name}] ZMQ events error: ${err && (err.message || err)}`)
+          }
+        })()
+      }
+      this.zmqConnectPromise = (async () => {
+        await this.zmqClient.connect(this.zmqEndpoint)
+      })().catch(err => {
+        log(2, `[${this.name}] ZMQ connect error: ${err && (err.message || err)}`)
+        this.zmqConnectPromise = null
+        throw err
+      })
+    }
+    return this.zmqConnectPromise
+  }
+
+  hasPeer () {
+    return this.connectedEndpoints.size > 0
+  }
+
+  // json is the texture JSON object as pushed by the main thread; the frame
+  // object is spliced in rather than parsing and serializing it again.
+  enqueueZmqSend (json, frame) {
+    const task = async () => {
+      await this.ensureZmqConnected()
+      if (!this.hasPeer()) {
+        return undefined
+      }
+      frame.metadataSentUs = nowUs()
+      this.recordLatency('metadataSent', frame, frame.metadataSentUs)
+      const message = json.length > 2
+        ? `${json.slice(0, -1)},"frame":${JSON.stringify(frame)}}`
+        : `{"frame":${JSON.stringify(frame)}}`
+      try {
+        await this.zmqClient.send(message)
+        const [reply] = await this.zmqClient.receive()
+        this.count('metadataSent')
+        // REQ/REP is lockstep, so the reply belongs to this frame
+        const request = parseRequest(reply)
+        if (request) {
+          if (Number.isFinite(request.receivedUs)) this.recordLatency('received', frame, request.receivedUs)
+          if (request.fps !== undefined || request.pull !== undefined) this.notify('control', { request })
+        }
+        return reply
+      } catch (err) {
+        this.count('metadataErrors')
+        throw err
+      }
+    }
+    this.gauge('metadataQueue', ++this.zmqPending)
+    const next = this.zmqQueue.then(task, task)
+    this.zmqQueue = next.catch(() => {})
+    const done = () => this.gauge('metadataQueue', --this.zmqPending)
+    next.then(done, done)
+    return next
+  }
+
+  // Totals and histogram snapshots of this half, merged into the main
+  // thread's stats of the same output.
+  takeStats () {
+    const histograms = {}
+    for (const [name, histogram] of Object.entries(this.histograms)) histograms[name] = histogram.snapshot()
+    return { totals: { ...this.totals }, histograms }
+  }
+}
+
+const outputs = new Map()
+let draining = false
+
+parentPort.on('message', (message) => {
+  switch (message.type) {
+    case 'start': {
+      const previous = outputs.get(message.index)
+      if (previous) previous.stop()
+      const output = new OutputForwarder(message.index, message.config)
+      outputs.set(message.index, output)
+      output.start()
+      break
+    }
+    case 'stop': {
+      const output = outputs.get(message.index)
+      if (output) output.stop()
+      outputs.delete(message.index)
+      break
+    }
+    case 'stats': {
+      // The main thread's half of every output's stats; completed here and
+      // handed to the stats logger
+      const batch = message.outputs.map((stats) => {
+        const output = outputs.get(stats.index)
+        if (!output) return stats
+        const own = output.takeStats()
+        return {
+          ...stats,
+          totals: { ...stats.totals, ...own.totals },
+          histograms: { ...stats.histograms, ...own.histograms }
+        }
+      })
+      if (statsPort) statsPort.postMessage(batch)
+      break
+    }
+  }
+  // Outputs are started before they paint, so frames pushed while this
+  // thread was still loading find their output once the first message is in
+  if (!draining) {
+    draining = true
+    drain()
+  }
+})
+
+async function drain () {
+  for (;;) {
+    let frame
+    while ((frame = ring.pop()) !== null) {
+      const output = outputs.get(frame.index)
+      if (output && !output.closed) {
+        output.forward(frame)
+      } else {
+        // An output stopped after the frame was painted
+        closeFd(frame.fd)
+      }
+    }
+    await ring.wait()
+  }
+}
@@ -0,0 +1,87 @@
+// Single producer, single consumer ring of painted frames in a
+// SharedArrayBuffer: the main thread pushes the duplicated fd, sequence
+// number, paint time and texture JSON of a frame, the forwarding thread pops
+// them. Neither side ever takes a lock or waits on the other; the consumer
+// sleeps on the head index with Atomics.waitAsync() when the ring is empty.
+
+// A power of two, so the indices can wrap around at 2^31
+const SLOTS = 64
+// Texture JSON of one frame; a frame that does not fit is dropped.
+const SLOT_BYTES = 4096
+
+// Int32 control words: head (next slot written), tail (next slot read)
+const HEAD = 0
+const TAIL = 1
+const CONTROL_BYTES = 16
+// Per slot: output index, fd, JSON length
+const META_FIELDS = 3
+// Per slot: paint sequence, paint time in CLOCK_MONOTONIC microseconds
+const TIME_FIELDS = 2
+
+const META_OFFSET = CONTROL_BYTES
+const TIME_OFFSET = META_OFFSET + SLOTS * META_FIELDS * Int32Array.BYTES_PER_ELEMENT
+const DATA_OFFSET = TIME_OFFSET + SLOTS * TIME_FIELDS * Float64Array.BYTES_PER_ELEMENT
+const BUFFER_BYTES = DATA_OFFSET + SLOTS * SLOT_BYTES
+
+class FrameRing {
+  // Without a buffer allocates a new one; pass .buffer to the other thread.
+  constructor (buffer = new SharedArrayBuffer(BUFFER_BYTES)) {
+    this.buffer = buffer
+    this.control = new Int32Array(buffer, 0, CONTROL_BYTES / Int32Array.BYTES_PER_ELEMENT)
+    this.meta = new Int32Array(buffer, META_OFFSET, SLOTS * META_FIELDS)
+    this.times = new Float64Array(buffer, TIME_OFFSET, SLOTS * TIME_FIELDS)
+    this.data = Buffer.from(buffer, DATA_OFFSET, SLOTS * SLOT_BYTES)
+  }
+
+  // Producer side. False if the ring is full or the JSON does not fit; the
+  // fd then still belongs to the caller.
+  push (index, fd, seq, paintUs, json) {
+    const head = Atomics.load(this.control, HEAD)
+    if (((head - Atomics.load(this.control, TAIL)) | 0) >= SLOTS) return false
+    // Checked up front: write() would stop at the slot end and leave a
+    // truncated frame behind.
+    const length = Buffer.byteLength(json)
+    if (length > SLOT_BYTES) return false
+    const slot = head & (SLOTS - 1)
+    this.data.write(json, slot * SLOT_BYTES, length)
+    this.meta[slot * META_FIELDS] = index
+    this.meta[slot * META_FIELDS + 1] = fd
+    this.meta[slot * META_FIELDS + 2] = length
+    this.times[slot * TIME_FIELDS] = seq
+    this.times[slot * TIME_FIELDS + 1] = paintUs
+    // Publishes the slot; the store is sequentially consistent
+    Atomics.store(this.control, HEAD, (head + 1) | 0)
+    Atomics.notify(this.control, HEAD)
+    return true
+  }
+
+  // Consumer side. The oldest frame as { index, fd, seq, paintUs, json }, or
+  // null if the ring is empty.
+  pop () {
+    const tail = Atomics.load(this.control, TAIL)
+    if (Atomics.load(this.control, HEAD) === tail) return null
+    const slot = tail & (SLOTS - 1)
+    const frame = {
+      index: this.meta[slot * META_FIELDS],
+      fd: this.meta[slot * META_FIELDS + 1],
+      seq: this.times[slot * TIME_FIELDS],
+      paintUs: this.times[slot * TIME_FIELDS + 1],
+      json: this.data.toString('utf8', slot * SLOT_BYTES, slot * SLOT_BYTES + this.meta[slot * META_FIELDS + 2])
+    }
+    Atomics.store(this.control, TAIL, (tail + 1) | 0)
+    return frame
+  }
+
+  depth () {
+    return (Atomics.load(this.control, HEAD) - Atomics.load(this.control, TAIL)) | 0
+  }
+
+  // Resolves once the ring is not empty, right away if it already is not.
+  async wait () {
+    const tail = Atomics.load(this.control, TAIL)
+    const result = Atomics.waitAsync(this.control, HEAD, tail)
+    if (result.async) await result.value
+  }
+}
+
+module.exports = { FrameRing }
@@ -1,10 +1,11 @@
 // Modules to control application life and create native browser window
 const { app, BrowserWindow } = require('electron')
 const fs = require('node:fs')
-const zmq = require('zeromq')
-
-let ZMQ_ENDPOINT = null
-let FD_SOCK_PATH = null 
+const path = require('node:path')
+const { Worker, MessageChannel } = require('node:worker_threads')
+const { Output } = require('./output')
+const { FrameRing } = require('./frame-ring')
+const { createMetrics } = require('./metrics')
 
 function getCliPort (argv) {
   const args = Array.isArray(argv) ? argv.slice(2) : []
@@ -16,23 +17,127 @@ function getCliPort (argv) {
   return null
 }
 
-const CLI_PORT = getCliPort(process.argv)
-if (CLI_PORT != null) {
-  ZMQ_ENDPOINT = `tcp://127.0.0.1:${CLI_PORT}`
-  FD_SOCK_PATH = `/tmp/electron-hwaccel/${CLI_PORT}.sock`
-  try { fs.mkdirSync('/tmp/electron-hwaccel', { recursive: true }) } catch {}
+function getCliOption (argv, name) {
+  const args = Array.isArray(argv) ? argv.slice(2) : []
+  const idx = args.indexOf(name)
+  if (idx !== -1 && args[idx + 1]) return args[idx + 1]
+  return null
 }
 
-if (!ZMQ_ENDPOINT || !FD_SOCK_PATH) {
-  console.error('ZMQ_ENDPOINT or FD_SOCK_PATH not set')
+const CLI_PORT = getCliPort(process.argv)
+
+// Export strategy of the offscreen hook. The GPU process does not see custom
+// switches, so these are handed over as CudaOffscreenExport feature params.
+const EXPORT_MODES = ['off', 'cuda-ipc', 'cuda-dmabuf', 'dmabuf']
+const EXPORT_FORMATS = ['bgra', 'nv12', 'i420', 'p010']
+const EXPORT_MODE = getCliOption(process.argv, '--export-mode') || 'cuda-ipc'
+const EXPORT_FORMAT = getCliOption(process.argv, '--export-format') || 'bgra'
+const EXPORT_RING_DEPTH = parseInt(getCliOption(process.argv, '--export-ring-depth') || '2', 10)
+const EXPORT_DEVICE = getCliOption(process.argv, '--export-device')
+const CUDA_DRIVER_LIBRARY = getCliOption(process.argv, '--cuda-driver-library')
+const CUDA_CONTEXTS = ['primary', 'private']
+const CUDA_CONTEXT = getCliOption(process.argv, '--cuda-context') || 'primary'
+const SCALE_FILTERS = ['box', 'bilinear']
+const EXPORT_RENDITIONS = getCliOption(process.argv, '--export-renditions')
+const EXPORT_SCALE_FILTER = getCliOption(process.argv, '--export-scale-filter') || 'box'
+
+if (!EXPORT_MODES.includes(EXPORT_MODE) || !EXPORT_FORMATS.includes(EXPORT_FORMAT) ||
+    !Number.isInteger(EXPORT_RING_DEPTH) || EXPORT_RING_DEPTH < 1 ||
+    !CUDA_CONTEXTS.includes(CUDA_CONTEXT) || !SCALE_FILTERS.includes(EXPORT_SCALE_FILTER) ||
+    (EXPORT_RENDITIONS && !/^\d+x\d+(,\d+x\d+)*$/.test(EXPORT_RENDITIONS))) {
+  console.error(`invalid export options: --export-mode ${EXPORT_MODES.join('|')} --export-format ${EXPORT_FORMATS.join('|')} --export-ring-depth N --cuda-context ${CUDA_CONTEXTS.join('|')} --export-renditions WxH,WxH --export-scale-filter ${SCALE_FILTERS.join('|')}`)
   process.exit(1)
 }
 
-const zmqClient = new zmq.Request()
-let zmqConnectPromise = null
-let zmqQueue = Promise.resolve()
-const connectedEndpoints = new Set()
-let eventsLoopStarted = false
+// Outputs come from --config <file.json>, or a single default output on
+// port -p. Every output gets its own window, fd socket and metadata channel;
+// all of them share this process and one GPU process.
+const CONFIG_PATH = getCliOption(process.argv, '--config')
+const FD_SOCK_DIR = '/tmp/electron-hwaccel'
+const DEFAULT_OUTPUT = {
+  url: 'https://app.singular.live/output/6W76ei5ZNekKkYhe8nw5o8/Output?aspect=16:9',
+  width: 1920,
+  height: 1080,
+  fps: 60
+}
+const STATS_INTERVAL_MS = 3000
+// Outputs stop painting while no consumer is connected unless told otherwise,
+// per output with "throttle": false or for all of them with --always-paint.
+const ALWAYS_PAINT = process.argv.includes('--always-paint')
+// ZMQ REP endpoint on which the consumer of the single -p output negotiates
+// its frame rate or pulls frames; config outputs set "controlEndpoint".
+const CONTROL_ENDPOINT = getCliOption(process.argv, '--control-endpoint')
+// Prometheus endpoint: a port on 127.0.0.1, or a UNIX socket path.
+const METRICS_LISTEN = getCliOption(process.argv, '--metrics')
+
+function resolveOutput (entry, index) {
+  const output = { ...DEFAULT_OUTPUT, throttle: !ALWAYS_PAINT, ...entry }
+  const port = output.port
+  if (port != null && !(Number.isInteger(port) && port > 0 && port <= 65535)) {
+    throw new Error(`output ${index}: invalid port ${port}`)
+  }
+  if (!output.zmqEndpoint && port != null) output.zmqEndpoint = `tcp://127.0.0.1:${port}`
+  if (!output.fdSocket && port != null) output.fdSocket = `${FD_SOCK_DIR}/${port}.sock`
+  if (!output.name) output.name = port != null ? String(port) : String(index)
+  if (!output.zmqEndpoint || !output.fdSocket) {
+    throw new Error(`output ${output.name}: needs port, or zmqEndpoint and fdSocket`)
+  }
+  if (typeof output.url !== 'string' || !output.url) {
+    throw new Error(`output ${output.name}: invalid url`)
+  }
+  for (const key of ['width', 'height']) {
+    if (!Number.isInteger(output[key]) || output[key] < 1) {
+      throw new Error(`output ${output.name}: invalid ${key} ${output[key]}`)
+    }
+  }
+  if (!Number.isInteger(output.fps) || output.fps < 1 || output.fps > 240) {
+    throw new Error(`output ${output.name}: invalid fps ${output.fps}`)
+  }
+  if (output.controlEndpoint != null && (typeof output.controlEndpoint !== 'string' || !output.controlEndpoint)) {
+    throw new Error(`output ${output.name}: invalid controlEndpoint`)
+  }
+  if (typeof output.throttle !== 'boolean') {
+    throw new Error(`output ${output.name}: throttle must be true or false`)
+  }
+  return output
+}
+
+function loadOutputs () {
+  let entries
+  if (CONFIG_PATH) {
+    const config = JSON.parse(fs.readFileSync(CONFIG_PATH, 'utf8'))
+    entries = Array.isArray(config) ? config : config.outputs
+    if (!Array.isArray(entries) || entries.length === 0) {
+      throw new Error(`${CONFIG_PATH}: expected a non-empty "outputs" array`)
+    }
+  } else if (CLI_PORT != null) {
+    entries = [{ port: CLI_PORT, controlEndpoint: CONTROL_ENDPOINT }]
+  } else {
+    throw new Error('pass -p <port> or --config <file.json>')
+  }
+
+  const outputs = entries.map(resolveOutput)
+  for (const key of ['name', 'fdSocket', 'zmqEndpoint', 'controlEndpoint']) {
+    const seen = new Set()
+    for (const output of outputs) {
+      if (output[key] == null) continue
+      if (seen.has(output[key])) throw new Error(`duplicate ${key} ${output[key]}`)
+      seen.add(output[key])
+    }
+  }
+  return outputs
+}
+
+let OUTPUT_CONFIGS
+try {
+  OUTPUT_CONFIGS = loadOutputs()
+} catch (err) {
+  console.error(`invalid output configuration: ${err.message}`)
+  process.exit(1)
+}
+for (const output of OUTPUT_CONFIGS) {
+  try { fs.mkdirSync(path.dirname(output.fdSocket), { recursive: true }) } catch {}
+}
 
 let fdpass = null
 try {
@@ -41,183 +146,182 @@ try {
   console.warn('fdpass addon not available; falling back to JSON-only payloads')
 }
 
-let paintCount = 0
-let lastStatsTime = Date.now()
-let statsInterval = null
-let paintDurTotalUs = 0
-let paintDurMinUs = Infinity
-let paintDurMaxUs = 0
-let lastFdSocketWarnMs = 0
-
-function warnFdSocketNotReady (socketPath) {
-  const now = Date.now()
-  if (now - lastFdSocketWarnMs >= 3000) {
-    console.warn(`FD socket not ready yet: ${socketPath}`)
-    lastFdSocketWarnMs = now
-  }
-}
-
-// Serialize all FD sends to preserve ordering across frames
-let fdQueue = Promise.resolve()
-function enqueueSendFd (socketPath, fd) {
-  const task = async () => {
-    if (!fdpass) return
-    try {
-      await fdpass.sendFd(socketPath, fd)
-    } catch (err) {
-      const msg = String(err && (err.message || err))
-      if (/Failed to connect to UNIX socket|No such file or directory/i.test(msg)) {
-        warnFdSocketNotReady(socketPath)
-        return
-      }
-      throw err
-    }
-  }
-  const next = fdQueue.then(task, task)
-  fdQueue = next.catch(() => {})
-  return next
-}
-
-async function ensureZmqConnected () {
-  if (!zmqConnectPromise) {
-    if (!eventsLoopStarted) {
-      eventsLoopStarted = true
-      ;(async () => {
-        try {
-          const eventsSource = zmqClient.events
-          if (eventsSource && typeof eventsSource[Symbol.asyncIterator] === 'function') {
-            for await (const ev of eventsSource) {
-              const type = ev && (ev.type || ev.event || ev[0])
-              const address = ev && (ev.address || ev.addr || ev.endpoint || ev[1])
-              if (type === 'connect') connectedEndpoints.add(address)
-              else if (type === 'disconnect') connectedEndpoints.delete(address)
-            }
-          }
-        } catch (err) {
-          console.error('ZMQ events error:', err)
-        }
-      })()
-    }
-    zmqConnectPromise = (async () => {
-      await zmqClient.connect(ZMQ_ENDPOINT)
-    })().catch(err => {
-      console.error('ZMQ connect error:', err)
-      zmqConnectPromise = null
-      throw err
-    })
+// The GPU process stamps every offscreen swap into this segment so frame
+// metadata can carry the viz swap time; it has to exist before the GPU
+// process starts.
+let FRAME_CLOCK = null
+if (fdpass && typeof fdpass.createFrameClock === 'function') {
+  const name = `/electron-hwaccel-clock-${process.pid}`
+  try {
+    fdpass.createFrameClock(name)
+    FRAME_CLOCK = name
+  } catch (err) {
+    console.warn(`frame clock unavailable, no swap timestamps: ${err.message}`)
   }
-  return zmqConnectPromise
 }
 
-function hasPeer () {
-  return connectedEndpoints.size > 0
-}
+const outputs = []
+let statsInterval = null
+let statsLogger = null
+// Frame forwarding runs on its own thread, fed through a lock-free ring, so
+// the main event loop only paints and hands frames over.
+let forwarder = null
+let frameRing = null
 
-function enqueueZmqSend (payload) {
-  const task = async () => {
-    await ensureZmqConnected()
-    if (!hasPeer()) {
-      return undefined
+// One slot per configured output, kept across output restarts
+const metrics = METRICS_LISTEN ? createMetrics(OUTPUT_CONFIGS.map(output => output.name)) : null
+let metricsServer = null
+
+function startMetricsServer () {
+  if (!metrics || metricsServer) return
+  const port = /^\d+$/.test(METRICS_LISTEN) ? parseInt(METRICS_LISTEN, 10) : null
+  metricsServer = new Worker(path.join(__dirname, 'metrics-server.js'), {
+    workerData: {
+      buffer: metrics.buffer,
+      names: metrics.names,
+      listen: port !== null ? port : METRICS_LISTEN,
+      frameClock: FRAME_CLOCK
     }
-    const message = typeof payload === 'string' ? payload : JSON.stringify(payload)
-    await zmqClient.send(message)
-    const [reply] = await zmqClient.receive()
-    return reply
-  }
-  const next = zmqQueue.then(task, task)
-  zmqQueue = next.catch(() => {})
-  return next
+  })
+  metricsServer.unref()
+  console.log(`metrics on ${port !== null ? `http://127.0.0.1:${port}/metrics` : `unix:${METRICS_LISTEN}`}`)
 }
 
 app.commandLine.appendSwitch('enable-gpu');
 app.commandLine.appendSwitch('no-sandbox');
 
-app.commandLine.appendSwitch('use-angle', 'gl-egl');
+// run-headless picks SwiftShader for software rendering
+if (!app.commandLine.hasSwitch('use-angle')) app.commandLine.appendSwitch('use-angle', 'gl-egl')
 
 app.commandLine.appendSwitch('high-dpi-support', 1);
 app.commandLine.appendSwitch('force-device-scale-factor', 1);
 
-function createWindow () {
+function cudaExportFeature () {
+  const params = {
+    mode: EXPORT_MODE,
+    ring_depth: EXPORT_RING_DEPTH,
+    format: EXPORT_FORMAT,
+    context: CUDA_CONTEXT
+  }
+  if (EXPORT_DEVICE) params.device = EXPORT_DEVICE
+  if (CUDA_DRIVER_LIBRARY) params.driver_library = CUDA_DRIVER_LIBRARY
+  if (FRAME_CLOCK) params.frame_clock = FRAME_CLOCK
+  if (EXPORT_RENDITIONS) {
+    params.renditions = EXPORT_RENDITIONS
+    params.scale_filter = EXPORT_SCALE_FILTER
+  }
+  const encoded = Object.entries(params)
+    .map(([k, v]) => `${k}/${encodeURIComponent(String(v))}`)
+    .join('/')
+  return `CudaOffscreenExport:${encoded}`
+}
 
-  const width = 1920;
-  const height = 1080;
+// appendSwitch replaces a switch that is already there, so features given
+// on the command line are kept next to ours (which wins over a stale
+// CudaOffscreenExport of their own).
+function mergeFeatures (existing, feature) {
+  const name = feature.split(':')[0]
+  const kept = (existing || '').split(',')
+    .filter(entry => entry && entry.split(':')[0] !== name)
+  return [...kept, feature].join(',')
+}
 
-  const osr = new BrowserWindow({
-    width,
-    height,
-    webPreferences: {
-      offscreen: {
-        useSharedTexture: true
-      },
-      sandbox: false,
-      show: false
-    }
+app.commandLine.appendSwitch('enable-features',
+  mergeFeatures(app.commandLine.getSwitchValue('enable-features'), cudaExportFeature()))
+
+// The forwarding thread completes each stats snapshot with its own
+// counters and passes it straight on to the logger thread.
+function startForwarder () {
+  if (forwarder) return
+  const { port1, port2 } = new MessageChannel()
+  statsLogger = new Worker(path.join(__dirname, 'stats-logger.js'), {
+    workerData: { port: port1 },
+    transferList: [port1]
+  })
+  statsLogger.unref()
+  frameRing = new FrameRing()
+  forwarder = new Worker(path.join(__dirname, 'forwarder.js'), {
+    workerData: {
+      ring: frameRing.buffer,
+      exportMode: EXPORT_MODE,
+      frameClock: FRAME_CLOCK,
+      metrics: metrics ? { buffer: metrics.buffer, names: metrics.names } : null,
+      statsPort: port2
+    },
+    transferList: [port2]
+  })
+  forwarder.on('message', (event) => {
+    const output = outputs[event.index]
+    if (output) output.onForwarderEvent(event)
   })
+  forwarder.on('error', (err) => console.error('frame forwarder failed:', err))
+}
 
-  osr.setBounds({ x: 0, y: 0, width, height });
-  osr.setSize(width, height);
-
-  osr.webContents.setFrameRate(60);
-  osr.webContents.invalidate();	
-
-  osr.loadURL("https://app.singular.live/output/6W76ei5ZNekKkYhe8nw5o8/Output?aspect=16:9")
-  osr.webContents.on('paint', async (e, dirty, img) => {
-    const t0 = process.hrtime.bigint()
-    paintCount++
-    try {
-      const texJson = typeof e.texture?.toJSON === 'function' ? e.texture.toJSON() : e.texture
-      const fd = texJson?.textureInfo?.planes?.[0]?.fd
-      if (fdpass && typeof fd === 'number') {
-        const sockPath = FD_SOCK_PATH
-        // Ensure FD is sent in strict order before enqueueing JSON
-        await enqueueSendFd(sockPath, fd)
-        // await here seems to long TODO: why?
-        enqueueZmqSend(texJson)
-        
-      }
-    } catch (err) {
-      console.error('exception:', err);
-    } finally {
-      e.texture.release()
-      const dtUs = Number(process.hrtime.bigint() - t0) / 1000
-      paintDurTotalUs += dtUs
-      if (dtUs < paintDurMinUs) paintDurMinUs = dtUs
-      if (dtUs > paintDurMaxUs) paintDurMaxUs = dtUs
-    }
+function stopForwarder () {
+  if (!forwarder) return
+  forwarder.terminate()
+  forwarder = null
+  statsLogger.terminate()
+  statsLogger = null
+}
+
+function startOutputs () {
+  startMetricsServer()
+  startForwarder()
+  OUTPUT_CONFIGS.forEach((config, i) => {
+    const output = new Output(config, {
+      index: i,
+      fdpass,
+      exportMode: EXPORT_MODE,
+      forwarder,
+      ring: frameRing,
+      metrics: metrics ? metrics.outputs[i] : null
+    })
+    output.start()
+    outputs.push(output)
+    console.log(`[${output.name}] ${output.width}x${output.height}@${output.fps} ${output.url} fd=${output.fdSocket} zmq=${output.zmqEndpoint}${output.controlEndpoint ? ` control=${output.controlEndpoint}` : ''}`)
   })
 
-  // Start paint statistics reporting
-  statsInterval = setInterval(() => {
-    const now = Date.now()
-    const elapsed = (now - lastStatsTime) / 1000 // seconds
-    const paintsPerSecond = paintCount / elapsed
-    const avgUs = paintCount > 0 ? (paintDurTotalUs / paintCount) : 0
-    const minUs = Number.isFinite(paintDurMinUs) ? paintDurMinUs : 0
-    const maxUs = paintDurMaxUs
-    console.log(`Paint stats: ${paintCount} paints in ${elapsed.toFixed(1)}s = ${paintsPerSecond.toFixed(1)} paints/sec, peers=${connectedEndpoints.size}, paint_us min=${minUs.toFixed(1)} max=${maxUs.toFixed(1)} avg=${avgUs.toFixed(1)}`)
-    paintCount = 0
-    lastStatsTime = now
-    paintDurTotalUs = 0
-    paintDurMinUs = Infinity
-    paintDurMaxUs = 0
-  }, 3000)
+  // Start paint statistics reporting; the main thread only takes the
+  // snapshots, formatting and printing happen on the logger thread.
+  if (!statsInterval) {
+    statsInterval = setInterval(() => {
+      forwarder.postMessage({ type: 'stats', outputs: outputs.map(output => output.takeStats()) })
+    }, STATS_INTERVAL_MS)
+  }
 }
 
 app.whenReady().then(() => {
-  createWindow()
+  startOutputs()
 
   app.on('activate', function () {
 
-    if (BrowserWindow.getAllWindows().length === 0) createWindow()
+    if (BrowserWindow.getAllWindows().length === 0) {
+      stopOutputs()
+      startOutputs()
+    }
   })
 })
 
+function stopOutputs () {
+  for (const output of outputs) output.stop()
+  outputs.length = 0
+}
+
 app.on('window-all-closed', function () {
   if (statsInterval) {
     clearInterval(statsInterval)
+    statsInterval = null
+  }
+  if (metricsServer) {
+    metricsServer.terminate()
+    metricsServer = null
   }
-  if (fdpass && typeof fdpass.close === 'function') {
-    try { fdpass.close() } catch {}
+  stopOutputs()
+  // Its fdpass instance closes the fd sockets as the thread goes away
+  stopForwarder()
+  if (FRAME_CLOCK) {
+    try { fdpass.closeFrameClock() } catch {}
   }
   if (process.platform !== 'darwin') app.quit()
 })
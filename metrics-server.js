@@ -0,0 +1,46 @@
+// Worker thread serving the shared metrics buffer in Prometheus text format
+// on a loopback port or a UNIX socket.
+const { workerData } = require('node:worker_threads')
+const fs = require('node:fs')
+const http = require('node:http')
+const { renderMetrics } = require('./metrics')
+
+const { buffer, names, listen, frameClock } = workerData
+
+let fdpass = null
+if (frameClock) {
+  try {
+    fdpass = require('fdpass')
+  } catch {}
+}
+
+function exportStats () {
+  if (!fdpass || typeof fdpass.frameClockExportStats !== 'function') return null
+  try {
+    return fdpass.frameClockExportStats(frameClock)
+  } catch {
+    return null
+  }
+}
+
+const server = http.createServer((req, res) => {
+  if (req.method !== 'GET' || (req.url !== '/metrics' && req.url !== '/')) {
+    res.writeHead(404)
+    res.end()
+    return
+  }
+  res.writeHead(200, { 'Content-Type': 'text/plain; version=0.0.4' })
+  res.end(renderMetrics(buffer, names, exportStats()))
+})
+
+server.on('error', (err) => {
+  fs.writeSync(2, `metrics endpoint ${listen}: ${err.message}\n`)
+})
+
+if (typeof listen === 'number') {
+  server.listen(listen, '127.0.0.1')
+} else {
+  // A socket left behind by a previous instance would fail the bind
+  try { fs.unlinkSync(listen) } catch {}
+  server.listen(listen)
+}
@@ -0,0 +1,161 @@
+// Per-output pipeline metrics kept in a SharedArrayBuffer. The main thread
+// and the forwarding thread update them on the render path with plain
+// stores, each only the metrics of its own half of the pipeline, so every
+// value has a single writer; the metrics server thread renders the same
+// memory for each scrape, so scraping never waits on or interrupts
+// rendering.
+
+const PREFIX = 'electron_hwaccel_'
+
+// [key used by Output, metric name, help]
+const COUNTERS = [
+  ['paints', 'frames_rendered_total', 'Paint events received from the offscreen window.'],
+  ['fdsSent', 'frames_sent_total', 'Frame fds passed to the consumer.'],
+  ['dropped', 'frames_dropped_total', 'Painted frames not forwarded because of the requested cadence or a full forwarding ring.'],
+  ['repeated', 'frames_repeated_total', 'Forwarded frames carrying the same viz swap as the one before.'],
+  ['fdErrors', 'fd_send_errors_total', 'Failed fd sends.'],
+  ['metadataSent', 'metadata_sent_total', 'Metadata messages acknowledged by the consumer.'],
+  ['metadataErrors', 'metadata_send_errors_total', 'Failed metadata sends.'],
+  ['reconnects', 'reconnects_total', 'Consumer reconnects on the fd or metadata channel.'],
+  ['pauses', 'paint_pauses_total', 'Times painting stopped for lack of a consumer.']
+]
+
+const GAUGES = [
+  ['fdQueue', 'fd_queue_depth', 'Frame fds waiting to be sent.'],
+  ['metadataQueue', 'metadata_queue_depth', 'Metadata messages waiting to be sent.'],
+  ['peers', 'metadata_peers', 'Connected metadata consumers.'],
+  ['painting', 'painting', '1 while the window is painting.'],
+  ['fps', 'target_fps', 'Configured or consumer requested frame rate.']
+]
+
+// [key, metric name, help, stage label]; the swap latency stages share one
+// metric family.
+const HISTOGRAMS = [
+  ['handler', 'paint_handler_seconds', 'Duration of the paint handler.', null],
+  ['interval', 'frame_interval_seconds', 'Interval between forwarded frames.', null],
+  ['paint', 'swap_latency_seconds', 'Time from the viz swap to a pipeline stage.', 'paint'],
+  ['fdSent', 'swap_latency_seconds', 'Time from the viz swap to a pipeline stage.', 'fd_sent'],
+  ['metadataSent', 'swap_latency_seconds', 'Time from the viz swap to a pipeline stage.', 'metadata_sent'],
+  ['received', 'swap_latency_seconds', 'Time from the viz swap to a pipeline stage.', 'received']
+]
+
+// Upper bounds in microseconds; one more slot counts everything above.
+const BUCKETS_US = [250, 500, 1000, 2000, 4000, 8000, 16000, 33000, 50000, 100000, 250000, 1000000]
+// Per histogram: the buckets, then sum (us) and count.
+const HISTOGRAM_SLOTS = BUCKETS_US.length + 3
+
+const OFFSETS = {}
+let slots = 0
+for (const [key] of COUNTERS) OFFSETS[key] = slots++
+for (const [key] of GAUGES) OFFSETS[key] = slots++
+for (const [key] of HISTOGRAMS) {
+  OFFSETS[key] = slots
+  slots += HISTOGRAM_SLOTS
+}
+const SLOTS_PER_OUTPUT = slots
+
+// The metrics of one output, a view into the shared buffer.
+class OutputMetrics {
+  constructor (values, base) {
+    this.values = values
+    this.base = base
+  }
+
+  add (key, n = 1) {
+    const offset = OFFSETS[key]
+    if (offset !== undefined) this.values[this.base + offset] += n
+  }
+
+  set (key, value) {
+    const offset = OFFSETS[key]
+    if (offset !== undefined) this.values[this.base + offset] = value
+  }
+
+  observe (key, us) {
+    const offset = OFFSETS[key]
+    if (offset === undefined) return
+    let bucket = 0
+    while (bucket < BUCKETS_US.length && us > BUCKETS_US[bucket]) bucket++
+    const at = this.base + offset
+    this.values[at + bucket]++
+    this.values[at + BUCKETS_US.length + 1] += us
+    this.values[at + BUCKETS_US.length + 2]++
+  }
+}
+
+function createMetrics (names) {
+  return attachMetrics(new SharedArrayBuffer(names.length * SLOTS_PER_OUTPUT * Float64Array.BYTES_PER_ELEMENT), names)
+}
+
+// The metrics of createMetrics() in another thread, from its buffer and names.
+function attachMetrics (buffer, names) {
+  const values = new Float64Array(buffer)
+  return {
+    buffer,
+    names,
+    outputs: names.map((name, i) => new OutputMetrics(values, i * SLOTS_PER_OUTPUT))
+  }
+}
+
+function escapeLabel (value) {
+  return String(value).replace(/\\/g, '\\\\').replace(/"/g, '\\"').replace(/\n/g, '\\n')
+}
+
+function histogramLines (lines, name, labels, boundsSeconds, counts, sumSeconds, count) {
+  const prefix = labels ? `${labels},` : ''
+  const suffix = labels ? `{${labels}}` : ''
+  let cumulative = 0
+  for (let i = 0; i < counts.length; i++) {
+    cumulative += counts[i]
+    const le = i < boundsSeconds.length ? String(boundsSeconds[i]) : '+Inf'
+    lines.push(`${name}_bucket{${prefix}le="${le}"} ${cumulative}`)
+  }
+  lines.push(`${name}_sum${suffix} ${sumSeconds}`)
+  lines.push(`${name}_count${suffix} ${count}`)
+}
+
+// Prometheus text exposition of every output, plus the GPU process export
+// timings from fdpass.frameClockExportStats() when there are any.
+function renderMetrics (buffer, names, exportStats) {
+  const values = new Float64Array(buffer)
+  const lines = []
+  const labelsOf = names.map(name => `output="${escapeLabel(name)}"`)
+
+  for (const [key, metric, help] of COUNTERS) {
+    lines.push(`# HELP ${PREFIX}${metric} ${help}`, `# TYPE ${PREFIX}${metric} counter`)
+    names.forEach((name, i) => lines.push(`${PREFIX}${metric}{${labelsOf[i]}} ${values[i * SLOTS_PER_OUTPUT + OFFSETS[key]]}`))
+  }
+  for (const [key, metric, help] of GAUGES) {
+    lines.push(`# HELP ${PREFIX}${metric} ${help}`, `# TYPE ${PREFIX}${metric} gauge`)
+    names.forEach((name, i) => lines.push(`${PREFIX}${metric}{${labelsOf[i]}} ${values[i * SLOTS_PER_OUTPUT + OFFSETS[key]]}`))
+  }
+
+  const boundsSeconds = BUCKETS_US.map(us => us / 1e6)
+  let family = null
+  for (const [key, metric, help, stage] of HISTOGRAMS) {
+    if (metric !== family) {
+      lines.push(`# HELP ${PREFIX}${metric} ${help}`, `# TYPE ${PREFIX}${metric} histogram`)
+      family = metric
+    }
+    names.forEach((name, i) => {
+      const at = i * SLOTS_PER_OUTPUT + OFFSETS[key]
+      const labels = stage ? `${labelsOf[i]},stage="${stage}"` : labelsOf[i]
+      const counts = values.subarray(at, at + BUCKETS_US.length + 1)
+      histogramLines(lines, PREFIX + metric, labels, boundsSeconds, counts,
+        values[at + BUCKETS_US.length + 1] / 1e6, values[at + BUCKETS_US.length + 2])
+    })
+  }
+
+  if (exportStats) {
+    lines.push(`# HELP ${PREFIX}cuda_export_failures_total Presents the GPU process failed to export.`,
+      `# TYPE ${PREFIX}cuda_export_failures_total counter`,
+      `${PREFIX}cuda_export_failures_total ${exportStats.failures}`)
+    lines.push(`# HELP ${PREFIX}cuda_export_seconds Time the GPU process spent exporting a present into the CUDA rings.`,
+      `# TYPE ${PREFIX}cuda_export_seconds histogram`)
+    histogramLines(lines, `${PREFIX}cuda_export_seconds`, '', exportStats.bucketsUs.map(us => us / 1e6),
+      exportStats.buckets, exportStats.totalUs / 1e6, exportStats.exports)
+  }
+  return lines.join('\n') + '\n'
+}
+
+module.exports = { createMetrics, attachMetrics, renderMetrics }
@@ -0,0 +1,351 @@
+// One render channel: an offscreen BrowserWindow, the UNIX socket its frame
+// fds are passed over, the ZMQ channel carrying their metadata and an
+// optional control endpoint. All channels live in the same Electron app and
+// so share one GPU process.
+//
+// This is the main thread half: the window, painting and the frame cadence.
+// Painted frames go through the frame ring to the forwarding thread
+// (forwarder.js), which sends them and reports consumer presence back.
+const { BrowserWindow } = require('electron')
+const zmq = require('zeromq')
+const { parseRequest } = require('./consumer-request')
+
+// Frame rate of a paused window; painting is stopped as well, this only
+// keeps the compositor from ticking at the full rate underneath.
+const STANDBY_FPS = 1
+// Upper bound of outstanding pulled frames.
+const MAX_PENDING_PULLS = 240
+// Histograms kept on the main thread: the paint handler duration and the
+// interval between forwarded frames. The swap latency stages are measured
+// by the forwarding thread.
+const HISTOGRAMS = ['handler', 'interval']
+
+class Output {
+  constructor (config, { index, fdpass, exportMode, forwarder, ring, metrics = null }) {
+    this.index = index
+    this.config = config
+    this.name = config.name
+    this.url = config.url
+    this.width = config.width
+    this.height = config.height
+    this.fps = config.fps
+    this.frameIntervalNs = BigInt(Math.round(1e9 / config.fps))
+    this.throttle = config.throttle !== false
+    this.fdSocket = config.fdSocket
+    this.zmqEndpoint = config.zmqEndpoint
+    this.controlEndpoint = config.controlEndpoint || null
+    this.fdpass = fdpass
+    this.exportMode = exportMode
+    // The forwarding thread (a Worker) and the frame ring feeding it
+    this.forwarder = forwarder
+    this.ring = ring
+    // Shared memory counters for the metrics endpoint, see metrics.js
+    this.metrics = metrics
+
+    this.window = null
+    // Consumer presence on both channels as last reported by the forwarding
+    // thread; painting runs only while both are there (the fd side counts as
+    // present when no fds are exported).
+    this.fdConsumer = false
+    this.peers = 0
+    this.consumerPresent = true
+    this.painting = false
+    // Frame cadence requested by the consumer: push forwards one frame per
+    // frameIntervalNs, pull only the frames asked for.
+    this.nextFrameDueNs = 0n
+    this.pullMode = false
+    this.pullsPending = 0
+    this.controlSocket = null
+    // Counts every paint event; gaps seen by the consumer are frames that
+    // were painted but not forwarded.
+    this.paintSequence = 0
+    this.lastForwardUs = null
+    // Native, so recording on the paint path never allocates; without the
+    // addon only the counters are reported.
+    this.histograms = {}
+    if (fdpass && typeof fdpass.Histogram === 'function') {
+      for (const name of HISTOGRAMS) this.histograms[name] = new fdpass.Histogram()
+    }
+
+    // Totals since start
+    this.totals = { paints: 0, pauses: 0, dropped: 0 }
+    this.resetInterval()
+  }
+
+  resetInterval () {
+    this.interval = {
+      start: Date.now(),
+      paints: 0
+    }
+  }
+
+  start () {
+    const { width, height } = this
+    const osr = new BrowserWindow({
+      width,
+      height,
+      webPreferences: {
+        offscreen: {
+          useSharedTexture: true
+        },
+        sandbox: false,
+        show: false
+      }
+    })
+    this.window = osr
+
+    osr.setBounds({ x: 0, y: 0, width, height })
+    osr.setSize(width, height)
+
+    osr.webContents.setFrameRate(this.fps)
+    osr.webContents.invalidate()
+    this.painting = true
+    this.gauge('painting', 1)
+    this.gauge('fps', this.fps)
+
+    osr.loadURL(this.url)
+    osr.webContents.on('paint', (e, dirty, img) => this.onPaint(e))
+    osr.on('closed', () => { this.window = null })
+
+    this.forwarder.postMessage({ type: 'start', index: this.index, config: this.config })
+    if (this.controlEndpoint) this.serveControl()
+  }
+
+  sendsFds () {
+    return this.exportMode !== 'off' && !!this.fdpass && typeof this.fdpass.dupFd === 'function'
+  }
+
+  hasConsumer () {
+    return (!this.sendsFds() || this.fdConsumer) && this.hasPeer()
+  }
+
+  hasPeer () {
+    return this.peers > 0
+  }
+
+  // Consumer presence and requests reported by the forwarding thread.
+  onForwarderEvent (event) {
+    switch (event.type) {
+      case 'consumer':
+        this.fdConsumer = event.present
+        break
+      case 'peers':
+        this.peers = event.count
+        break
+      case 'control':
+        this.applyControl(event.request)
+        return
+      default:
+        return
+    }
+    this.updatePainting()
+  }
+
+  count (name, n = 1) {
+    this.totals[name] += n
+    if (this.metrics) this.metrics.add(name, n)
+  }
+
+  gauge (name, value) {
+    if (this.metrics) this.metrics.set(name, value)
+  }
+
+  // Paints only while a consumer is connected (when throttling) and, in
+  // pull mode, while pulled frames are outstanding. Resuming forces a full
+  // repaint.
+  updatePainting () {
+    const osr = this.window
+    if (!osr || osr.isDestroyed()) return
+    const consumer = !this.throttle || this.hasConsumer()
+    if (consumer !== this.consumerPresent) {
+      this.consumerPresent = consumer
+      if (consumer) {
+        console.log(`[${this.name}] consumer connected`)
+      } else {
+        this.count('pauses')
+        console.log(`[${this.name}] no consumer, painting paused`)
+      }
+    }
+    const wanted = consumer && (!this.pullMode || this.pullsPending > 0)
+    if (wanted === this.painting) return
+    this.painting = wanted
+    this.gauge('painting', wanted ? 1 : 0)
+    const contents = osr.webContents
+    if (wanted) {
+      contents.setFrameRate(this.fps)
+      contents.startPainting()
+      contents.invalidate()
+    } else {
+      contents.stopPainting()
+      contents.setFrameRate(STANDBY_FPS)
+    }
+  }
+
+  setTargetFps (fps) {
+    if (fps === this.fps) return
+    this.fps = fps
+    this.frameIntervalNs = BigInt(Math.round(1e9 / fps))
+    this.nextFrameDueNs = 0n
+    this.gauge('fps', fps)
+    if (this.painting && this.window && !this.window.isDestroyed()) {
+      this.window.webContents.setFrameRate(fps)
+    }
+    console.log(`[${this.name}] frame rate set to ${fps} fps`)
+  }
+
+  // Whether a painted frame is forwarded. Chromium paints on its own clock
+  // and on page invalidations, so push mode lets through at most one frame
+  // per interval, the first one within half an interval of its due time.
+  takeFrame () {
+    if (this.pullMode) {
+      if (this.pullsPending === 0) return false
+      this.pullsPending--
+      if (this.pullsPending === 0) this.updatePainting()
+      return true
+    }
+    const now = process.hrtime.bigint()
+    const period = this.frameIntervalNs
+    // Resync after a stall instead of bursting to catch up
+    if (this.nextFrameDueNs === 0n || now - this.nextFrameDueNs > period) this.nextFrameDueNs = now
+    if (now + period / 2n < this.nextFrameDueNs) return false
+    this.nextFrameDueNs += period
+    return true
+  }
+
+  // Consumer requests, as the reply to a metadata message or on the control
+  // endpoint: {"fps": N} forwards N frames per second, {"pull": n} switches
+  // to pull mode and asks for n more frames. Returns the resulting state, or
+  // null for anything that is not a request.
+  handleControl (message) {
+    const request = parseRequest(message)
+    return request ? this.applyControl(request) : null
+  }
+
+  applyControl (request) {
+    if (request.fps !== undefined) {
+      const fps = Number(request.fps)
+      if (Number.isInteger(fps) && fps >= 1 && fps <= 240) {
+        this.pullMode = false
+        this.pullsPending = 0
+        this.setTargetFps(fps)
+      }
+    }
+    let pulled = 0
+    if (request.pull !== undefined) {
+      const n = Number(request.pull)
+      if (Number.isInteger(n) && n >= 0) {
+        this.pullMode = true
+        pulled = Math.min(n, MAX_PENDING_PULLS - this.pullsPending)
+        this.pullsPending += pulled
+      }
+    }
+    const wasPainting = this.painting
+    this.updatePainting()
+    // Already painting: make sure a new frame is produced for the pull
+    if (wasPainting && this.painting && pulled > 0) this.window.webContents.invalidate()
+    return this.controlState()
+  }
+
+  controlState () {
+    return {
+      name: this.name,
+      mode: this.pullMode ? 'pull' : 'push',
+      fps: this.fps,
+      pending: this.pullsPending,
+      painting: this.painting,
+      consumer: this.consumerPresent
+    }
+  }
+
+  async serveControl () {
+    const socket = new zmq.Reply()
+    this.controlSocket = socket
+    try {
+      await socket.bind(this.controlEndpoint)
+      for await (const [message] of socket) {
+        const state = this.handleControl(message)
+        await socket.send(JSON.stringify(state || { error: 'expected {"fps": N} or {"pull": n}' }))
+      }
+    } catch (err) {
+      if (!socket.closed) console.error(`[${this.name}] control error:`, err)
+    }
+  }
+
+  stop () {
+    this.forwarder.postMessage({ type: 'stop', index: this.index })
+    if (this.controlSocket) {
+      try { this.controlSocket.close() } catch {}
+      this.controlSocket = null
+    }
+    if (this.window && !this.window.isDestroyed()) this.window.destroy()
+    this.window = null
+    for (const histogram of Object.values(this.histograms)) histogram.destroy()
+    this.histograms = {}
+  }
+
+  record (name, us) {
+    const histogram = this.histograms[name]
+    if (histogram) histogram.record(us)
+    if (this.metrics) this.metrics.observe(name, us)
+  }
+
+  onPaint (e) {
+    const t0 = process.hrtime.bigint()
+    const paintUs = Number(t0 / 1000n)
+    const seq = ++this.paintSequence
+    this.interval.paints++
+    this.count('paints')
+    try {
+      if (!this.takeFrame()) {
+        this.count('dropped')
+        return
+      }
+      if (this.lastForwardUs !== null) this.record('interval', paintUs - this.lastForwardUs)
+      this.lastForwardUs = paintUs
+      const texJson = typeof e.texture?.toJSON === 'function' ? e.texture.toJSON() : e.texture
+      const fd = texJson?.textureInfo?.planes?.[0]?.fd
+      if (this.sendsFds() && typeof fd === 'number') this.forward(fd, seq, paintUs, texJson)
+    } catch (err) {
+      console.error(`[${this.name}] exception:`, err)
+    } finally {
+      e.texture.release()
+      this.record('handler', Number(process.hrtime.bigint() - t0) / 1000)
+    }
+  }
+
+  // Hands a painted frame to the forwarding thread. The fd is duplicated
+  // because the texture, and with it the original fd, is released as soon as
+  // the paint handler returns; the forwarding thread closes the duplicate
+  // once it is sent. A full ring drops the frame rather than wait.
+  forward (fd, seq, paintUs, texJson) {
+    const dup = this.fdpass.dupFd(fd)
+    if (!this.ring.push(this.index, dup, seq, paintUs, JSON.stringify(texJson))) {
+      this.fdpass.closeFd(dup)
+      this.count('dropped')
+    }
+  }
+
+  // Paint statistics since the last call, histograms snapshotted and reset.
+  // Plain data, completed by the forwarding thread with its own counters
+  // and formatted by the stats logger thread.
+  takeStats () {
+    const interval = this.interval
+    const histograms = {}
+    for (const [name, histogram] of Object.entries(this.histograms)) histograms[name] = histogram.snapshot()
+    const stats = {
+      index: this.index,
+      name: this.name,
+      elapsedMs: Date.now() - interval.start,
+      paints: interval.paints,
+      peers: this.peers,
+      painting: this.painting,
+      mode: this.pullMode ? 'pull' : `${this.fps}fps`,
+      totals: { ...this.totals },
+      histograms
+    }
+    this.resetInterval()
+    return stats
+  }
+}
+
+module.exports = { Output }
@@ -0,0 +1,44 @@
+// Worker thread that formats and prints the periodic per-output stats, so
+// string building and a slow or blocked stdout never delay paint handling
+// on the main thread or frame forwarding. The batches arrive from the
+// forwarding thread on workerData.port. console.log in a worker is relayed
+// through the main thread, hence the direct writes to fd 1.
+const { workerData } = require('node:worker_threads')
+const fs = require('node:fs')
+
+function formatHistogram (name, h) {
+  if (!h || h.count === 0) return `${name}_us -`
+  return `${name}_us p50=${h.p50} p90=${h.p90} p99=${h.p99} p99.9=${h.p999} max=${h.max}`
+}
+
+function formatStats (s) {
+  const elapsed = s.elapsedMs / 1000 // seconds
+  const paintsPerSecond = elapsed > 0 ? s.paints / elapsed : 0
+  const t = s.totals
+  const parts = [
+    `${s.paints} paints in ${elapsed.toFixed(1)}s = ${paintsPerSecond.toFixed(1)} paints/sec`,
+    `peers=${s.peers}, painting=${s.painting ? 'on' : 'off'}, mode=${s.mode}`,
+    `total paints=${t.paints} fds=${t.fdsSent} fd_errors=${t.fdErrors} metadata=${t.metadataSent} metadata_errors=${t.metadataErrors} pauses=${t.pauses} dropped=${t.dropped} repeated=${t.repeated} reconnects=${t.reconnects}`
+  ]
+  const h = s.histograms
+  if (h.handler) parts.push(formatHistogram('handler', h.handler))
+  if (h.interval) {
+    // Jitter is the standard deviation of the interval between forwarded frames
+    const jitter = h.interval.count > 0 ? ` jitter=${h.interval.stddev.toFixed(0)}` : ''
+    parts.push(formatHistogram('interval', h.interval) + jitter)
+  }
+  for (const stage of ['paint', 'fdSent', 'metadataSent', 'received']) {
+    if (h[stage] && h[stage].count > 0) parts.push(formatHistogram(`swap>${stage}`, h[stage]))
+  }
+  return `[${s.name}] Paint stats: ${parts.join(', ')}\n`
+}
+
+workerData.port.on('message', (batch) => {
+  let text = ''
+  for (const stats of batch) text += formatStats(stats)
+  try {
+    fs.writeSync(1, text)
+  } catch {
+    // A full non-blocking pipe drops this report rather than stalling
+  }
+})